@@ -6,7 +6,7 @@
 #pragma once
 #define GLM_FORCE_RADIANS
 
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 
 namespace Engine
 {
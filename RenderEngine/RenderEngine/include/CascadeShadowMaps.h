@@ -8,42 +8,94 @@
 #include <vector>
 
 #include "Camera.h"
-#include "instances/TextureInstance.h"
-#include "DeferredRenderObject.h"
 #include "ShadowCaster.h"
+#include "StaticShadowCache.h"
 
 namespace Engine
 {
+	// Mirrors the std140 ShadowCascades uniform block declared on the shadow receiving shaders
+	// (terrain, water and vegetation). Arrays of floats are packed 4 per vec4
+	typedef struct ShadowCascadesData
+	{
+		// View space to shadow map space (texture coordinates and depth) of every cascade
+		glm::mat4 cascadeMatrices[8];
+		// Far view depth of every cascade
+		float splits[8];
+		// Shadow map depth of one texel of every cascade, scaled by the slope on the shaders
+		float depthBias[8];
+		int numCascades;
+		int padding[3];
+	} ShadowCascadesData;
+
 	// Handles all shadow casters and give access to the shadow map textures to
-	// any shaders which need them
+	// any shaders which need them. The view frustum, up to Settings::shadowDistance, is split in
+	// Settings::shadowCascades slices (practical split scheme, Settings::shadowSplitLambda blends the
+	// logarithmic and the uniform splits). Each slice is covered by the orthographic projection of
+	// its bounding sphere, snapped to the shadow map texels so the shadows do not shimmer as the
+	// camera moves. All cascades are layers of a single 2D array texture.
+	// With Settings::shadowCache the landscape is not drawn on the cascades every frame but copied from
+	// a StaticShadowCache, and only the dynamic casters (trees) are drawn on top
 	class CascadeShadowMaps
 	{
+	public:
+		static const unsigned int MAX_CASCADES = 8;
+		// Width and height of every cascade
+		static const unsigned int RESOLUTION = 1024;
+		// Must match the binding of the ShadowCascades block on the shaders
+		static const unsigned int BINDING_POINT = 2;
 	private:
 		// Cascade level information
 		typedef struct ShadowMap
 		{
-			// Projection matrix (holds the projection volume)
-			glm::mat4 proj;
-			// Light depth projection matrix
+			// Light depth projection matrix (world space to light clip space)
 			glm::mat4 depth;
-			// FBO
-			DeferredRenderObject * rtt;
-			// Pointer to the shadow map texture
-			TextureInstance * shadowMap;
+			// Same volume reaching much further towards the light, used to cull the casters
+			glm::mat4 culling;
+			// View depth range of the frustum slice
+			float splitNear;
+			float splitFar;
+			// World space bounding sphere of the slice
+			glm::vec3 center;
+			float radius;
+			float texelsPerMeter;
+			// Static casters copied from the cache, and the global texel of the lower left corner
+			bool cached;
+			int texelX;
+			int texelY;
+			// FBO with the cascade layer as depth attachment
+			unsigned int fbo;
 		} ShadowMap;
 	private:
 		static CascadeShadowMaps * INSTANCE;
 	private:
-		// Cascade shadow maps (2 by default)
-		ShadowMap shadowMaps[2];
+		ShadowMap shadowMaps[MAX_CASCADES];
+		// Layers of the shadow map texture
+		unsigned int numCascades;
 		// varying variable used during runtime
 		int currentLevel;
-		
+		// Projection, culling volume and casters of the pass being rendered (a cascade or a strip of
+		// the static cache)
+		glm::mat4 passProjection;
+		glm::mat4 passCulling;
+		ShadowCasterSet casterSet;
+
+		// Light space orientation of the current frame
+		glm::mat4 lightRotation;
+		StaticShadowCache staticCache;
+
+		// GL_TEXTURE_2D_ARRAY with a depth layer per cascade
+		unsigned int shadowMapArray;
+		// Layered FBO, every layer is cleared with a single glClear
+		unsigned int layeredFbo;
+		unsigned int uniformBuffer;
+		ShadowCascadesData data;
+
 		// Shadow bias
 		glm::mat4 biasMatrix;
 
-		// Previous frame buffer before starting to render shadows to custom rtt
-		int previousFrameBuffer;
+		// Previous frame buffer and viewport before starting to render shadows to the cascades
+		unsigned int previousFrameBuffer;
+		int previousViewport[4];
 
 		// List of renderable objects which cast shadows
 		std::vector<ShadowCaster *> shadowCasters;
@@ -51,32 +103,53 @@ namespace Engine
 		static CascadeShadowMaps & getInstance();
 	private:
 		CascadeShadowMaps();
-		void initializeShadowMap(int level, float minX, float maxX, float minY, float maxY, float minZ, float maxZ);
+		// (Re)creates the shadow map array and the FBOs for the given amount of cascades
+		void allocate(unsigned int cascades);
+		void release();
+		// Splits the view frustum and fits a cascade to every slice
+		void computeCascades(Camera * eye);
+		void uploadCascades();
+		// Renders the static casters on the strips of the cache exposed since the last frame
+		void renderStaticCache(Camera * cam);
 	public:
 		// Init all static data not changed throught the execution
 		void init();
-		// Computes the depth matrices given the camera position at the beginning of each frame (only once per frame)
-		// We want the shadow maps to be projected around the camera
+		// Computes the depth matrices given the camera at the beginning of each frame (only once per frame)
+		// and renders the shadow maps
 		void initializeFrame(Camera * eye);
-		// Prepares the system to render to the shadow map
+		// Prepares the system to render to the given cascade
 		void beginShadowRender(int level);
-		// Restores engine previous state
-		void endShadowRender();
 		// Register a element which can cast shadows
 		void registerShadowCaster(ShadowCaster * caster);
 
 		// Calls the shadow render code of each registered shadowcaster
 		void renderShadows(Camera * cam);
 
+		// Light depth projection matrix of the pass being rendered
 		const glm::mat4 & getShadowProjectionMat();
+		// Volume whose casters can shadow the pass being rendered. Casters between the light
+		// and the near plane of the projection are flattened on it (GL_DEPTH_CLAMP)
+		const glm::mat4 & getShadowCullingMat();
+		// Cascade being rendered (or whose cache layer is being rendered)
+		unsigned int getCurrentLevel();
+		// Casters the pass being rendered expects (see ShadowCaster::renderShadow())
+		ShadowCasterSet getCasterSet();
 		const glm::mat4 & getBiasMat();
 
 		unsigned int getCascadeLevels();
+		// View depth range covered by a cascade
+		float getSplitNear(unsigned int level);
+		float getSplitFar(unsigned int level);
+		// Shadow map texels per world unit of a cascade
+		float getTexelsPerMeter(unsigned int level);
+		size_t getMemoryUsage();
+		// Cascades whose static casters were copied from the cache this frame
+		unsigned int getCachedCascades();
+		size_t getCacheMemoryUsage();
 
-		const glm::mat4 & getDepthMatrix0();
-		const glm::mat4 & getDepthMatrix1();
+		// Binds the shadow map array to the given texture unit (GL_TEXTUREi)
+		void bindShadowMaps(unsigned int textureUnit);
 
-		const TextureInstance * getDepthTexture0();
-		const TextureInstance * getDepthTexture1();
+		void destroy();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <vector>
+
+#include "StorageTable.h"
+#include "Camera.h"
+#include "LightClusterBuilder.h"
+#include "computeprograms/LightClusterProgram.h"
+
+namespace Engine
+{
+	namespace GPU
+	{
+		// Shader storage buffers with the clusters of the point and spot lights of the active scene
+		// (a grid of offset / count pairs into a list of LightStorage slots). Filled once per frame,
+		// either by LightClusterBuilder or by LightClusterProgram, and kept bound
+		class ClusteredLightBuffer : public StorageTable
+		{
+		public:
+			// Must match the bindings of DeferredShading.frag and LightClusters.comp (the lights are
+			// bound at LightBufferManager::LIGHTS_BINDING_POINT)
+			static const unsigned int GRID_BINDING_POINT = 5;
+			static const unsigned int INDICES_BINDING_POINT = 6;
+		private:
+			static ClusteredLightBuffer * INSTANCE;
+		private:
+			unsigned int gridBuffer;
+			unsigned int indexBuffer;
+			// Allocated size, in indices
+			size_t indexCapacity;
+
+			// View space bounds of every light storage slot
+			std::vector<ClusterLight> spheres;
+
+			LightClusterBuilder builder;
+			LightClusterProgram * program;
+
+			// Light slots of the last update, and indices stored by the CPU builder
+			unsigned int numLights;
+			size_t numIndices;
+			bool gridCleared;
+		private:
+			ClusteredLightBuffer();
+		public:
+			static ClusteredLightBuffer & getInstance();
+		public:
+			~ClusteredLightBuffer();
+
+			// Uploads the changed lights of the active scene, builds the clusters with the current
+			// builder and binds the buffers
+			void update(Camera * camera);
+
+			// The cluster slice of a view depth d is log(d) * sliceScale - sliceBias
+			float getSliceScale() const;
+			float getSliceBias() const;
+			unsigned int getNumLights() const;
+			// Only known when the clusters are built on the CPU
+			size_t getNumIndices() const;
+			// Builds the clusters of the last update on the CPU and compares them against a brute force test
+			LightClusterValidation validate();
+
+			void clean();
+		private:
+			void computeSpheres(Camera * camera);
+			void buildOnCPU();
+			void buildOnGPU(Camera * camera);
+			// Grows the buffer (discarding its content) if it can not hold the given size
+			void reserve(unsigned int & buffer, size_t & capacity, size_t size, size_t elementSize);
+		};
+	}
+}
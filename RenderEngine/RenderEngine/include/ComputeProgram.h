@@ -34,7 +34,10 @@ namespace Engine
 		void dispatch(unsigned int xDim, unsigned int yDim, unsigned int zDim, unsigned int barrier);
 
 		void destroy();
+	protected:
+		// Loads the compute shader source code
+		virtual std::string loadShaderSource();
 	private:
-		unsigned int loadShaderFile();
+		unsigned int compileShader(const std::string & source);
 	};
 }
\ No newline at end of file
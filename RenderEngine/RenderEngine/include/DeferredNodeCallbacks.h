@@ -19,8 +19,8 @@ namespace Engine
 	public:
 		DeferredCallback();
 		~DeferredCallback();
-		virtual void initialize(Object *obj, Program * prog, DeferredRenderObject * buffer);
-		virtual void execute(Object * obj, Program * prog, DeferredRenderObject * buffer, Camera * cam) = 0;
+		virtual void initialize(Object *obj, Program * prog);
+		virtual void execute(Object * obj, Program * prog, Camera * cam) = 0;
 	};
 
 	// ========================================================
@@ -6,7 +6,7 @@
 #pragma once
 
 #include <map>
-#include <gl/glew.h>
+#include <GL/glew.h>
 
 #include "Object.h"
 #include "instances/TextureInstance.h"
@@ -49,6 +49,8 @@ namespace Engine
 
 		// Width and height mod to apply on every resize
 		float widthMod, heightMod;
+		// Current size of the textures
+		unsigned int width, height;
 	public:
 		DeferredRenderObject(unsigned int numColorBuffers, bool renderDepth);
 		~DeferredRenderObject();
@@ -63,6 +65,11 @@ namespace Engine
 		void initialize();
 		void setResizeMod(float widthMod = 1.0f, float heightMod = 1.0f);
 		void resizeFBO(unsigned int w, unsigned int h);
+		unsigned int getWidth() const;
+		unsigned int getHeight() const;
+
+		// GPU memory taken by the textures, in bytes
+		size_t getMemoryUsage() const;
 
 		// Attaches the textures of this FBO as inputs for the object representing the
 		// post-process executed after the current one (this method is linked to the architecture
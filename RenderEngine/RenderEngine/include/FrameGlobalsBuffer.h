@@ -0,0 +1,69 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include "StorageTable.h"
+
+namespace Engine
+{
+	namespace GPU
+	{
+		// Mirrors the std140 FrameGlobals uniform block declared on the terrain, water and vegetation
+		// shaders. Every vec3 is followed by a float so both share a 16 bytes slot
+		typedef struct FrameGlobalsData
+		{
+			// Normalized
+			float lightDir[3];
+			float time;
+			float grass[3];
+			// Grass cut on the terrain (1 - Settings::grassCoverage)
+			float grassCoverage;
+			float rock[3];
+			float worldScale;
+			float sand[3];
+			float renderRadius;
+			float watercolor[3];
+			float waterspeed;
+			float windDirection[3];
+			float windStrength;
+			float terrainAmplitude;
+			float terrainFrecuency;
+			float terrainScale;
+			int terrainOctaves;
+			float waterHeight;
+			// Highest vegetation spawn height
+			float maxHeight;
+			// sin(time)^2, drives the wind sway
+			float sinTime;
+			float padding;
+		} FrameGlobalsData;
+
+		// Uniform buffer with the values every terrain, water and vegetation program used to upload
+		// on its own (Settings and Time). It is filled once per frame and stays bound at BINDING_POINT
+		class FrameGlobalsBuffer : public StorageTable
+		{
+		public:
+			// Must match the binding of the FrameGlobals block on the shaders
+			static const unsigned int BINDING_POINT = 3;
+		private:
+			static FrameGlobalsBuffer * INSTANCE;
+		private:
+			unsigned int buffer;
+			FrameGlobalsData data;
+		private:
+			FrameGlobalsBuffer();
+		public:
+			static FrameGlobalsBuffer & getInstance();
+		public:
+			~FrameGlobalsBuffer();
+
+			// Uploads the current Settings and Time values and binds the buffer
+			void update();
+			const FrameGlobalsData & getData() const;
+
+			void clean();
+		};
+	}
+}
@@ -0,0 +1,38 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Engine
+{
+	/**
+	 * View frustum as 6 planes (left, right, bottom, top, near, far) extracted from a
+	 * view projection matrix. Planes point inwards and are normalized
+	 */
+	class Frustum
+	{
+	private:
+		glm::vec4 planes[6];
+	public:
+		Frustum();
+		Frustum(const glm::mat4 & viewProjection);
+
+		void extract(const glm::mat4 & viewProjection);
+
+		const glm::vec4 & getPlane(unsigned int index) const { return planes[index]; }
+
+		// Returns true if the axis aligned box is at least partially inside
+		bool testAABB(const glm::vec3 & min, const glm::vec3 & max) const;
+
+		// Tests count boxes given in structure of arrays form. visible[k] receives 1 if box k
+		// is at least partially inside, 0 otherwise. Processes 4 boxes per iteration with SSE2
+		void testAABBBatch(const float * minX, const float * minY, const float * minZ,
+			const float * maxX, const float * maxY, const float * maxZ,
+			unsigned char * visible, size_t count) const;
+	};
+}
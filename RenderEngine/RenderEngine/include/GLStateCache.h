@@ -0,0 +1,114 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <GL/glew.h>
+
+namespace Engine
+{
+	/**
+	 * Shadow copy of the OpenGL state the engine changes the most (program, vertex array, framebuffers,
+	 * textures, capabilities, blending, viewport). Calls which would not change the state are not issued,
+	 * and the state is read from the copy instead of querying the driver. Issued and filtered calls are
+	 * counted on RenderStatistics.
+	 * Every engine call that changes this state must go through here, otherwise the copy would not match
+	 * the context. The user interface backend is the exception: it saves and restores what it changes
+	 */
+	class GLStateCache
+	{
+	public:
+		static const unsigned int MAX_TEXTURE_UNITS = 32;
+	private:
+		static GLStateCache * INSTANCE;
+
+		// Value of a binding not known by the cache (see invalidate())
+		static const GLuint UNKNOWN = 0xffffffff;
+
+		// Tracked texture targets
+		enum TextureTarget
+		{
+			TARGET_2D = 0,
+			TARGET_3D = 1,
+			TARGET_CUBE_MAP = 2,
+			TARGET_2D_ARRAY = 3,
+			TARGET_COUNT = 4
+		};
+
+		// Tracked capabilities
+		enum Capability
+		{
+			CAP_DEPTH_TEST = 0,
+			CAP_BLEND = 1,
+			CAP_CULL_FACE = 2,
+			CAP_COUNT = 3
+		};
+
+		GLuint program;
+		GLuint vertexArray;
+		GLuint drawFramebuffer;
+		GLuint readFramebuffer;
+
+		// Active texture unit index (0 = GL_TEXTURE0)
+		GLuint activeUnit;
+		GLuint textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+
+		// -1 unknown, 0 disabled, 1 enabled
+		int capabilities[CAP_COUNT];
+
+		GLenum blendSrc;
+		GLenum blendDst;
+
+		GLint viewportRect[4];
+		bool viewportKnown;
+
+		GLfloat clearColorValue[4];
+		bool clearColorKnown;
+	public:
+		static GLStateCache & getInstance();
+
+		void useProgram(GLuint program);
+		void bindVertexArray(GLuint vertexArray);
+		// Target might be GL_FRAMEBUFFER (both), GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER
+		void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+		// Unit as GL_TEXTUREi
+		void activeTexture(GLenum unit);
+		// Binds the texture on the active unit
+		void bindTexture(GLenum target, GLuint texture);
+
+		// Capabilities not tracked are always issued
+		void enable(GLenum capability);
+		void disable(GLenum capability);
+		void blendFunc(GLenum src, GLenum dst);
+
+		void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+		void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+
+		// The driver is only queried if the state is unknown
+		GLuint getProgram();
+		GLuint getVertexArray();
+		GLuint getDrawFramebuffer();
+		GLuint getReadFramebuffer();
+		void getViewport(GLint * rect);
+		void getClearColor(GLfloat * color);
+
+		// OpenGL unbinds deleted objects, and their names can be given to new ones
+		void deleteProgram(GLuint program);
+		void deleteVertexArray(GLuint vertexArray);
+		void deleteFramebuffer(GLuint framebuffer);
+		void deleteTexture(GLuint texture);
+
+		// Forgets the whole state, so the next calls are issued. Used after code
+		// which changes the state on its own
+		void invalidate();
+	private:
+		GLStateCache();
+
+		static int getTargetIndex(GLenum target);
+		static int getCapabilityIndex(GLenum capability);
+
+		void setCapability(GLenum capability, bool enabled);
+	};
+}
@@ -5,11 +5,20 @@
 
 #pragma once
 
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 #include <string>
 
 namespace Engine
 {
+	// Parts of a light changed since its last upload (see Light::getDirtyFlags())
+	enum LightDirtyFlags
+	{
+		// Position and direction
+		LIGHT_DIRTY_TRANSFORM = 1,
+		// Color, attenuation, factors, aperture and enabled state
+		LIGHT_DIRTY_PROPERTIES = 2
+	};
+
 	// Parent class of all of the classes which represent a light.
 	// Represent a common interface between different light types
 	class Light
@@ -17,12 +26,13 @@ namespace Engine
 	private:
 		bool enabled;
 		std::string name;
-		// Lights are stored in GPU as uniform buffer objects
-		// This variable holds the buffer id
+		// Lights are stored in GPU buffers
+		// This variable holds the slot of the light within its buffer
 		unsigned int bufferIndex;
 	protected:
 		glm::mat4 modelMatrix;
-		bool update;
+		// LightDirtyFlags
+		unsigned int dirtyFlags;
 	public:
 		Light(std::string name);
 		~Light();
@@ -41,9 +51,10 @@ namespace Engine
 
 		const glm::mat4 & getModelMatrix() const;
 
-		// Returns wether the uniform buffer object should be updated or not
+		// Returns wether the GPU copy should be updated or not
 		bool requiresUpdate();
-		// Clears the udpate flag
+		unsigned int getDirtyFlags() const;
+		// Clears the udpate flags
 		void clearUpdateFlag();
 
 		void setBufferIndex(unsigned int bi);
@@ -2,29 +2,31 @@
 * @author Nadir Romn Guerrero
 * @email nadir.ro.gue@gmail.com
 */
-#pragma
+#pragma once
 
 #include "Scene.h"
 #include "StorageTable.h"
+#include "LightStorage.h"
 
 namespace Engine
 {
 	namespace GPU
 	{
-		// Class which manages all light uniform buffer objects. Implements the update
-		// functionality, as well as the partial update functionality
-		// Its also in charge of clean up
+		// Class which manages all light buffers: the directional light uniform buffer object and
+		// the point and spot light storage, which follows the lights added to or removed from the
+		// active scene. Its also in charge of clean up
 		class LightBufferManager : public StorageTable
 		{
+		public:
+			// Must match the binding of the light storage buffer on DeferredShading.frag and LightClusters.comp
+			static const unsigned int LIGHTS_BINDING_POINT = 4;
 		private:
 			static LightBufferManager * INSTANCE;
 		private:
 			// Directional light buffer
 			unsigned int gboDL;
-			// Point light buffer
-			unsigned int gboPL;
-			// Spot light buffer
-			unsigned int gboSL;
+			// Point and spot lights of the active scene
+			LightStorage storage;
 		private:
 			LightBufferManager();
 		public:
@@ -34,14 +36,16 @@ namespace Engine
 			void onSceneStart();
 
 			void enableDirectionalLightBuffer();
-			void enablePointLightBuffer();
-			void enableSpotLightBuffer();
 			void enableDirectionalLightBufferAtIndex(unsigned int index);
-			void enablePointLightBufferAtIndex(unsigned int index);
-			void enableSpotLightBufferAtIndex(unsigned int index);
 			void updateDirectionalLight(DirectionalLight * dl, bool onlyViewDependent = false);
-			void updatePointLight(PointLight * pl, bool onlyViewDependent = false);
-			void updateSpotLight(SpotLight * sl, bool onlyViewDependent = false);
+
+			// Called by the active scene as lights come and go
+			void addPointLight(PointLight * pl);
+			void addSpotLight(SpotLight * sl);
+			void removeLight(Light * light);
+			// Uploads the changed point and spot lights and binds the storage
+			void updateLights();
+			const LightStorage & getLightStorage() const;
 
 			void clean();
 		private:
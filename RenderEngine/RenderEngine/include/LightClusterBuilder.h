@@ -0,0 +1,154 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "Threadpool.h"
+
+namespace Engine
+{
+	// View space bounding sphere of a light (the camera looks down -z). Lights without radius are skipped
+	typedef struct ClusterLight
+	{
+		float x;
+		float y;
+		float z;
+		float radius;
+	} ClusterLight;
+
+	// Build times with a given amount of lights and threads (see LightClusterBuilder::benchmark())
+	typedef struct LightClusterBenchmark
+	{
+		unsigned int lights;
+		unsigned int threads;
+		double buildMs;
+		// Light indices stored on the clusters
+		size_t indices;
+	} LightClusterBenchmark;
+
+	// Result of LightClusterBuilder::validate()
+	typedef struct LightClusterValidation
+	{
+		unsigned int clusters;
+		// Clusters whose light list differs from the brute force test
+		unsigned int mismatches;
+		size_t indices;
+	} LightClusterValidation;
+
+	/**
+	 * Splits the view frustum in a grid of GRID_X * GRID_Y screen tiles and GRID_Z exponential
+	 * depth slices (froxels), and builds the list of lights whose bounding sphere touches every
+	 * cluster. Slices are built concurrently on the thread pool. Lights are culled 4 at a time
+	 * (SSE) against the slice depth range, and tested against 4 clusters of a tile row at a time.
+	 * It does not depend on OpenGL, the result is uploaded by ClusteredLightBuffer
+	 */
+	class LightClusterBuilder
+	{
+	public:
+		static const unsigned int GRID_X = 16;
+		static const unsigned int GRID_Y = 9;
+		static const unsigned int GRID_Z = 24;
+		static const unsigned int NUM_CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+	private:
+		// Projection the cluster bounds were computed for
+		float xScale;
+		float yScale;
+		float nearPlane;
+		float farPlane;
+
+		// View depth of every slice boundary (GRID_Z + 1)
+		std::vector<float> sliceDepth;
+		// View space bounds of every cluster, SoA so a tile row is tested with 4 wide loads
+		std::vector<float> minX, minY, minZ;
+		std::vector<float> maxX, maxY, maxZ;
+
+		// Lights, SoA and padded to a multiple of 4 (padding never passes the depth test)
+		unsigned int numLights;
+		std::vector<float> posX, posY, posZ, radius;
+		// View depth range of every light, slightly widened so the test stays conservative
+		std::vector<float> depthMin, depthMax;
+
+		// Per cluster light lists, and their compacted form
+		std::vector<std::vector<unsigned int>> clusterLights;
+		// Offset and count of every cluster within indices
+		std::vector<unsigned int> grid;
+		std::vector<unsigned int> indices;
+	public:
+		// Influence radius of a light with the given (constant, linear, quadratic) attenuation,
+		// where its intensity falls below 1/256
+		static float computeRadius(const float * attenuation, float intensity, float maxRadius);
+
+		LightClusterBuilder();
+
+		// Only recomputes the cluster bounds if the projection changed
+		void setProjection(const glm::mat4 & projection);
+		void setLights(const ClusterLight * lights, unsigned int count);
+
+		// Builds the light lists, using the calling thread plus up to numThreads - 1 threads of the
+		// pool (0 = all of them, 1 = only the calling thread)
+		void build(unsigned int numThreads = 0);
+		// Builds the light lists of the slices [begin, end)
+		void buildSlices(unsigned int begin, unsigned int end);
+
+		unsigned int getNumLights() const { return numLights; }
+		// Offset and count pairs, one per cluster (x + y * GRID_X + z * GRID_X * GRID_Y)
+		const std::vector<unsigned int> & getGrid() const { return grid; }
+		const std::vector<unsigned int> & getIndices() const { return indices; }
+
+		// The slice of a view depth d is log(d) * sliceScale - sliceBias
+		float getSliceScale() const;
+		float getSliceBias() const;
+		float getNearPlane() const { return nearPlane; }
+		float getFarPlane() const { return farPlane; }
+
+		// Compares every cluster against a brute force sphere / box test of every light
+		LightClusterValidation validate() const;
+		// Builds count random lights on the pool and on the calling thread only, and validates both
+		static LightClusterValidation validateRandomLights(unsigned int count);
+		// Builds 100, 1,000 and 10,000 random lights with 1, 2, 4... threads up to the thread pool size
+		static std::vector<LightClusterBenchmark> benchmark();
+	private:
+		void computeClusterBounds();
+		// Tiles [first, last] of a slice whose bounds reach the view space range [low, high] along
+		// an axis. Conservative, the sphere / box test decides. Returns false if there are none
+		static bool tileRange(float low, float high, float scale, float sliceNear, float sliceFar, unsigned int numTiles, unsigned int & first, unsigned int & last);
+		bool intersects(unsigned int cluster, unsigned int light) const;
+	};
+
+	// ===============================================================
+	// Slices of a build, shared by the calling thread and the pool tasks. Tasks which start once
+	// every slice was taken just leave, so the job may outlive the build
+	class LightClusterJob
+	{
+	private:
+		LightClusterBuilder * builder;
+		std::atomic<unsigned int> nextSlice;
+		// Slices not built yet
+		Concurrent::CountDownLatch slicesLeft;
+	public:
+		LightClusterJob(LightClusterBuilder * builder);
+
+		// Builds slices until there are none left
+		void buildSlices();
+		// Blocks until the slices taken by other threads are built
+		void wait();
+	};
+
+	// Helps building the slices of a job
+	class LightClusterTask : public Concurrent::Runnable
+	{
+	private:
+		std::shared_ptr<LightClusterJob> job;
+	public:
+		LightClusterTask(std::shared_ptr<LightClusterJob> job);
+		void run();
+	};
+}
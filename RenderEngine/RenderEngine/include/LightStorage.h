@@ -0,0 +1,114 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <vector>
+
+#include "UploadRingBuffer.h"
+#include "lights/PointLight.h"
+#include "lights/SpotLight.h"
+
+namespace Engine
+{
+	namespace GPU
+	{
+		// Mirrors the std430 LightData struct of DeferredShading.frag and LightClusters.comp.
+		// Point and spot lights share it
+		typedef struct LightStorageData
+		{
+			// World space, w = influence radius (0 on free slots and disabled lights)
+			float position[4];
+			// World space spot direction, w = cosine of the aperture (-2 on point lights)
+			float direction[4];
+			// w = spot exponent
+			float color[4];
+			float attenuation[4];
+			float kFactors[4];
+		} LightStorageData;
+
+		// Update times with a given amount of lights, changing some of them every frame
+		// (see LightStorage::benchmark())
+		typedef struct LightUpdateBenchmark
+		{
+			unsigned int lights;
+			unsigned int updated;
+			double frameMs;
+			double lightsPerMs;
+			size_t bytesPerFrame;
+			unsigned int copiesPerFrame;
+		} LightUpdateBenchmark;
+
+		/**
+		 * Shader storage buffer with the point and spot lights of a scene. Every light owns a slot
+		 * (Light::getBufferIndex()) for as long as it is stored; released slots go to a free list and
+		 * are reused, so adding or removing a light never moves the others. The buffer doubles its
+		 * size (copied on the GPU) when it runs out of slots. Only the bytes touched by the dirty
+		 * flags of each light are uploaded, merged into ranges and sent through an UploadRingBuffer
+		 */
+		class LightStorage
+		{
+		public:
+			// Radius of the lights whose intensity never falls below the cluster threshold
+			static const float MAX_RADIUS;
+		private:
+			typedef struct LightSlot
+			{
+				// NULL on free slots
+				Light * light;
+				bool spot;
+				// LightDirtyFlags not coming from the light (new and released slots)
+				unsigned int pendingFlags;
+			} LightSlot;
+
+			unsigned int buffer;
+			// Slots allocated on the buffer
+			size_t capacity;
+
+			std::vector<LightSlot> slots;
+			// CPU copy of the buffer, one entry per slot
+			std::vector<LightStorageData> data;
+			// Released slots, reused last in first out
+			std::vector<unsigned int> freeSlots;
+
+			UploadRingBuffer ring;
+
+			unsigned int numLights;
+			// Slots uploaded by the last update
+			unsigned int updatedSlots;
+		public:
+			LightStorage();
+
+			// Assigns a slot to the light
+			void addPointLight(PointLight * pl);
+			void addSpotLight(SpotLight * sl);
+			// Releases the slot of the light, which is cleared on the next update
+			void removeLight(Light * light);
+			// Releases every slot
+			void clear();
+
+			// Refreshes the slots of the lights changed since the last update and uploads them
+			void update();
+			void bind(unsigned int bindingPoint);
+
+			// Used slots, including the free ones in between
+			unsigned int getNumSlots() const;
+			unsigned int getNumLights() const;
+			unsigned int getUpdatedSlots() const;
+			const std::vector<LightStorageData> & getData() const;
+			const UploadRingBuffer & getRing() const;
+
+			void destroy();
+
+			// Moves every light, and one of every ten, of 1,000, 10,000 and 50,000 point lights for
+			// a few frames. Needs a current OpenGL context
+			static std::vector<LightUpdateBenchmark> benchmark();
+		private:
+			unsigned int allocateSlot(Light * light, bool spot);
+			void refreshSlot(unsigned int slot);
+			// Grows the buffer, keeping its content, if it can not hold the given amount of slots
+			void reserve(size_t numSlots);
+		};
+	}
+}
@@ -5,7 +5,9 @@
 
 #pragma once
 
-#include <assimp\scene.h>
+#include <assimp/scene.h>
+
+#include "VertexLayout.h"
 
 namespace Engine
 {
@@ -26,20 +28,23 @@ namespace Engine
 		float *emission;
 		float *uvs;
 		float *tangents;
+
+		// GPU vertex data description
+		VertexLayout layout;
+		// Vertex buffers as described by the layout (a single one if interleaved)
+		unsigned int vbos[VERTEX_ATTRIBUTE_COUNT];
+		// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		unsigned int indexType;
+		// Bytes uploaded to the GPU (vertices + indices)
+		size_t gpuSize;
 	public:
 		unsigned int vao;
 		unsigned int vboFaces;
-		unsigned int vboVertices;
-		unsigned int vboNormals;
-		unsigned int vboColors;
-		unsigned int vboEmission;
-		unsigned int vboUVs;
-		unsigned int vboTangents;
 
 	public:
-		Mesh();
-		Mesh(aiMesh * mesh);
-		Mesh(const unsigned int numF, const unsigned int numV, const unsigned int *f, const float *v, const float *c, const float *n, const float *uv, const float *t, const float *e = 0);
+		Mesh(const VertexLayout & layout = VertexLayout::compact());
+		Mesh(aiMesh * mesh, const VertexLayout & layout = VertexLayout::compact());
+		Mesh(const unsigned int numF, const unsigned int numV, const unsigned int *f, const float *v, const float *c, const float *n, const float *uv, const float *t, const float *e = 0, const VertexLayout & layout = VertexLayout::compact());
 		Mesh(const Mesh &other);
 		~Mesh();
 
@@ -60,13 +65,24 @@ namespace Engine
 		void computeNormals();
 		void computeTangents();
 
+		const VertexLayout & getVertexLayout() const;
+		// Index type to use on the draw calls
+		const unsigned int getIndexType() const;
+		// Size of the mesh GPU buffers, in bytes
+		const size_t getGPUSize() const;
+
 		void syncGPU();
 
+		// Points the given program attribute location to the mesh data (mesh vertex array must be
+		// bound). Returns false if the mesh does not have the attribute
+		bool bindAttribute(VertexAttribute attribute, unsigned int location) const;
+
 		void releaseGPU();
 		void releaseCPU();
 
 		void use() const;
 	private:
+		void initGPUHandles();
 		void extractTopology(aiMesh * mesh);
 		void extractGeometry(aiMesh * mesh);
 	};
@@ -0,0 +1,83 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "VertexLayout.h"
+
+namespace Engine
+{
+	// Post transform cache efficiency of an index buffer
+	typedef struct
+	{
+		// Vertex shader invocations (cache misses)
+		unsigned int vertexTransforms;
+		// Average cache miss ratio: transforms per triangle (0.5 best, 3 worst)
+		float acmr;
+		// Average transform to vertex ratio: transforms per referenced vertex (1 best)
+		float atvr;
+	} VertexCacheStatistics;
+
+	// Result of MeshOptimizer::validate(): cache statistics before and after optimize() of a
+	// grid with shuffled triangles and vertices, and of the same grid in row order
+	typedef struct
+	{
+		VertexCacheStatistics shuffledInput;
+		VertexCacheStatistics shuffledOptimized;
+		VertexCacheStatistics orderedInput;
+		VertexCacheStatistics orderedOptimized;
+		// Triangles (by vertex position and winding) missing on the optimized meshes
+		unsigned int triangleMismatches;
+	} MeshOptimizerValidation;
+
+	/**
+	 * CPU only triangle mesh optimization passes, run on the mesh data before it is
+	 * uploaded to the GPU (see VertexLayout::setOptimized()):
+	 *  - Welding of bitwise identical vertices
+	 *  - Triangle reordering for the post transform vertex cache (Forsyth)
+	 *  - Triangle cluster reordering to reduce overdraw (Sander et al., Tipsify)
+	 *  - Vertex reordering by first use to improve vertex fetch locality
+	 * Does not require a GL context.
+	 */
+	class MeshOptimizer
+	{
+	public:
+		// FIFO cache size used to simulate the GPU post transform cache
+		static const unsigned int DEFAULT_CACHE_SIZE;
+		// Max ACMR increase (ratio) allowed when splitting triangles into clusters for overdraw
+		static const float DEFAULT_OVERDRAW_THRESHOLD;
+
+		// Runs the whole pipeline. streams holds the attribute data (empty if the attribute
+		// is not present), and is replaced, along with numVertices and indices, by the result
+		static void optimize(std::vector<float> streams[VERTEX_ATTRIBUTE_COUNT], unsigned int & numVertices, std::vector<unsigned int> & indices);
+
+		// Finds bitwise identical vertices (all present attributes). Fills remap (old index -> new index)
+		// and returns the number of unique vertices
+		static unsigned int weldVertices(const float * const data[VERTEX_ATTRIBUTE_COUNT], unsigned int numVertices, std::vector<unsigned int> & remap);
+		// Reorders the triangles to maximize post transform cache hits
+		static void optimizeVertexCache(unsigned int * indices, size_t numIndices, unsigned int numVertices);
+		// Splits an already cache optimized triangle list into clusters and sorts them so the outermost
+		// ones are drawn first. threshold bounds the ACMR loss caused by the extra cluster splits
+		static void optimizeOverdraw(unsigned int * indices, size_t numIndices, const float * positions, unsigned int numVertices, float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+		// Computes a remap that orders the vertices by first use on the index buffer. Unreferenced
+		// vertices are removed (remapped to ~0u). Returns the number of vertices kept
+		static unsigned int optimizeVertexFetch(const unsigned int * indices, size_t numIndices, unsigned int numVertices, std::vector<unsigned int> & remap);
+
+		// Applies a remap to an index buffer
+		static void remapIndices(unsigned int * indices, size_t numIndices, const std::vector<unsigned int> & remap);
+		// Applies a remap to an attribute stream of the given components per vertex
+		static void remapVertices(std::vector<float> & stream, unsigned int components, const std::vector<unsigned int> & remap, unsigned int newNumVertices);
+
+		// Simulates a FIFO post transform cache of the given size over the triangle list
+		static VertexCacheStatistics analyzeVertexCache(const unsigned int * indices, size_t numIndices, unsigned int numVertices, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Optimizes grids of gridSize x gridSize vertices and checks the ACMR improves while the
+		// triangles are kept
+		static MeshOptimizerValidation validate(unsigned int gridSize = 64);
+	};
+}
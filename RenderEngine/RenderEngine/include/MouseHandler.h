@@ -7,6 +7,7 @@
 
 #include <map>
 #include <list>
+#include <string>
 
 namespace Engine
 {
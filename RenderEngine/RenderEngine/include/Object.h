@@ -8,7 +8,7 @@
 
 #include <glm/glm.hpp>
 #include <map>
-#include <gl\glew.h>
+#include <GL/glew.h>
 
 #include "IRenderable.h"
 #include "Mesh.h"
@@ -88,6 +88,7 @@ namespace Engine
 		PostProcessObject(Mesh * mi);
 
 		void addTexture(std::string name, TextureInstance * instance);
+		void clearTextures();
 		TextureInstance * getTexture(std::string name);
 		const std::map<std::string, TextureInstance *> & getAllCustomTextures() const;
 	};
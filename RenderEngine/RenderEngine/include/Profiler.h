@@ -0,0 +1,179 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Engine
+{
+	// A finished profiling scope. Times are in microseconds since the profiler was created
+	typedef struct ProfileEvent
+	{
+		char name[48];
+		// Nesting level within the thread that recorded it
+		unsigned int depth;
+		unsigned int thread;
+		// Frame of the main thread scopes (0 on other threads)
+		unsigned long long frame;
+		double cpuStart;
+		double cpuEnd;
+		// Negative if the scope was not timed on the GPU (or the result was not ready)
+		double gpuStart;
+		double gpuEnd;
+	} ProfileEvent;
+
+	// Rolling averages of a main thread stage, identified by its scope path ("Frame/Terrain/Water")
+	typedef struct ProfileStageStats
+	{
+		std::string path;
+		std::string name;
+		unsigned int depth;
+		double cpuMs;
+		// Negative if the stage has no GPU timings
+		double gpuMs;
+	} ProfileStageStats;
+
+	// Stage timings of a single frame (not averaged), see Profiler::setFrameCapture()
+	typedef struct ProfileFrame
+	{
+		unsigned long long frame;
+		std::vector<ProfileStageStats> stages;
+	} ProfileFrame;
+
+	/**
+	 * Hierarchical frame profiler. Scopes are timed on the CPU and, on the main thread, on the
+	 * GPU with timestamp queries (which, unlike GL_TIME_ELAPSED queries, can be nested). GPU
+	 * results are read FRAME_LATENCY frames later so the pipeline never stalls. Finished scopes
+	 * go into a lock-free ring buffer, which can be exported as a Chrome trace_event file
+	 */
+	class Profiler
+	{
+	public:
+		static const unsigned int RING_CAPACITY = 16384;
+		static const unsigned int FRAME_LATENCY = 4;
+		// Frames averaged by the stage statistics
+		static const unsigned int ROLLING_FRAMES = 60;
+		static const unsigned int INVALID_SCOPE = 0xffffffff;
+		static const std::string DEFAULT_TRACE_FILE;
+	private:
+		static Profiler * INSTANCE;
+
+		// Ring buffer slot, the sequence tells readers whether the event is complete
+		typedef struct RingSlot
+		{
+			std::atomic<unsigned long long> sequence;
+			ProfileEvent event;
+		} RingSlot;
+
+		// Main thread scope waiting for its GPU timestamps
+		typedef struct PendingScope
+		{
+			ProfileEvent event;
+			// First of its two timestamp queries within the frame pool, INVALID_SCOPE if none
+			unsigned int query;
+		} PendingScope;
+
+		typedef struct FrameScopes
+		{
+			std::vector<PendingScope> scopes;
+			std::vector<unsigned int> queries;
+			unsigned int usedQueries;
+		} FrameScopes;
+
+		typedef struct StageHistory
+		{
+			double cpuMs[ROLLING_FRAMES];
+			double gpuMs[ROLLING_FRAMES];
+			unsigned int count;
+			unsigned int next;
+		} StageHistory;
+
+		RingSlot * ring;
+		std::atomic<unsigned long long> writeIndex;
+
+		FrameScopes frames[FRAME_LATENCY];
+		unsigned int currentFrame;
+		unsigned long long frameNumber;
+		unsigned int depth;
+
+		std::vector<ProfileStageStats> stages;
+		std::vector<StageHistory> history;
+		std::map<std::string, unsigned int> stageIndex;
+		// Stages of the last resolved frame, in scope order
+		std::vector<ProfileStageStats> frameStages;
+
+		std::chrono::high_resolution_clock::time_point epoch;
+		// GPU clock (ns) and CPU time (us) sampled at the same moment
+		long long gpuEpoch;
+		double gpuEpochCpu;
+
+		// Resolved frames, kept only while capturing
+		std::vector<ProfileFrame> capturedFrames;
+
+		std::thread::id mainThread;
+		bool started;
+		bool enabled;
+		bool captureFrames;
+		std::atomic<unsigned int> nextThread;
+	public:
+		static Profiler & getInstance();
+		~Profiler();
+
+		void setEnabled(bool enabled);
+		bool isEnabled() const;
+
+		// Starts a new frame and resolves the scopes of the frame FRAME_LATENCY frames ago
+		void beginFrame();
+		// Waits for the GPU and resolves every pending frame (stalls, meant for the end of a run)
+		void flush();
+
+		// Use ProfileScope instead
+		unsigned int beginScope(const char * name, bool gpu);
+		void endScope(unsigned int scope);
+		// Adds a finished event straight away (scopes of other threads)
+		void recordEvent(const ProfileEvent & event);
+
+		// Microseconds since the profiler was created
+		double now() const;
+		// Small index of the calling thread, used as trace thread id
+		unsigned int getThreadIndex();
+		bool isMainThread() const;
+
+		// Copies the events still in the ring buffer, oldest first
+		void getEvents(std::vector<ProfileEvent> & events) const;
+		const std::vector<ProfileStageStats> & getStageStats() const;
+
+		// Keeps the timings of every resolved frame, until they are taken
+		void setFrameCapture(bool capture);
+		void takeCapturedFrames(std::vector<ProfileFrame> & frames);
+		bool exportChromeTrace(const std::string & fileName = DEFAULT_TRACE_FILE) const;
+	private:
+		Profiler();
+		void resolveFrame(FrameScopes & frame);
+		void updateStage(const std::string & path, const std::string & name, unsigned int depth, double cpuMs, double gpuMs);
+	};
+
+	// ===============================================================
+	// Times the code until the end of the enclosing block
+	class ProfileScope
+	{
+	private:
+		unsigned int scope;
+		// Scopes of other threads are recorded when they end
+		bool worker;
+		ProfileEvent event;
+	public:
+		ProfileScope(const char * name, bool gpu = true);
+		~ProfileScope();
+	private:
+		ProfileScope(const ProfileScope & other);
+		ProfileScope & operator=(const ProfileScope & other);
+	};
+}
@@ -9,6 +9,8 @@
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "Camera.h"
 #include "lights/PointLight.h"
@@ -21,6 +23,17 @@ namespace Engine
 	class Program
 	{
 	protected:
+		// Shader stage of a program, as passed to linkProgram()
+		typedef struct ShaderStage
+		{
+			// Shader source file path
+			std::string fileName;
+			// Shader type (GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, ...)
+			GLenum type;
+			// Where to store the shader id (0 if the program binary was loaded from the cache)
+			unsigned int * shader;
+		} ShaderStage;
+
 		// Program id
 		unsigned int glProgram;
 		// Vertex shader id
@@ -71,6 +84,13 @@ namespace Engine
 	protected:
 		// Loads a shader source code and applies UBER Shader technique
 		unsigned int loadShader(std::string fileName, GLenum type, std::string configString = "", bool outputToFile = false, std::string outputFileName = "");
+		// Loads a shader source code and applies UBER Shader technique, without compiling it
+		std::string loadShaderSource(std::string fileName, std::string configString = "");
+		// Compiles a shader source code
+		unsigned int compileShader(const std::string & source, GLenum type, const std::string & fileName);
+		// Creates glProgram from the given stages. The program binary is loaded from the ShaderCache
+		// if sources, parameters and driver match; otherwise the stages are compiled and linked
+		void linkProgram(const std::vector<ShaderStage> & stages, std::string configString = "");
 	};
 
 	// ===================================================================================================
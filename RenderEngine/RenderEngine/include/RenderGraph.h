@@ -0,0 +1,137 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include "Object.h"
+#include "Program.h"
+#include "Camera.h"
+#include "instances/TextureInstance.h"
+
+namespace Engine
+{
+	// Render target written by a render graph pass
+	typedef struct RenderTargetDesc
+	{
+		GLenum internalFormat;
+		GLenum format;
+		GLenum pixelType;
+		int filter;
+		// Size relative to the screen
+		float widthScale;
+		float heightScale;
+	} RenderTargetDesc;
+
+	/**
+	 * Graph of full screen passes (the post-process chain). Passes declare the textures they read
+	 * and write. On compile, disabled passes are culled (whoever reads their outputs reads their
+	 * inputs instead, as if the pass was not there), the lifetime of every transient texture is
+	 * computed, and transient textures whose lifetimes do not overlap share the same pooled render
+	 * target (pooled by format and size)
+	 */
+	class RenderGraph
+	{
+	public:
+		static const unsigned int INVALID = 0xffffffff;
+	private:
+		typedef struct Resource
+		{
+			std::string name;
+			RenderTargetDesc desc;
+			// Textures owned by someone else (G-Buffers...), alive during the whole graph
+			TextureInstance * imported;
+			// Pass which writes it and the output index within the pass (INVALID if imported)
+			unsigned int producer;
+			unsigned int producerOutput;
+			// Compile results: schedule positions of the write and the last read, and the target
+			unsigned int firstUse;
+			unsigned int lastUse;
+			unsigned int target;
+		} Resource;
+
+		typedef struct Pass
+		{
+			std::string name;
+			Program * program;
+			PostProcessObject * obj;
+			std::vector<unsigned int> inputs;
+			std::vector<unsigned int> outputs;
+			bool enabled;
+			unsigned int fbo;
+		} Pass;
+
+		typedef struct PooledTarget
+		{
+			RenderTargetDesc desc;
+			unsigned int width;
+			unsigned int height;
+			TextureInstance * texture;
+			// Taken by a live resource while compiling
+			bool inUse;
+			// Used by the current schedule (unused targets are released)
+			bool used;
+		} PooledTarget;
+
+		std::vector<Resource> resources;
+		std::vector<Pass> passes;
+		// Passes to execute, in order
+		std::vector<unsigned int> schedule;
+		std::vector<PooledTarget> pool;
+
+		// Resource presented after the last pass, and the object which reads it
+		unsigned int output;
+		PostProcessObject * outputObj;
+
+		unsigned int screenWidth;
+		unsigned int screenHeight;
+		bool dirty;
+	public:
+		RenderGraph();
+		~RenderGraph();
+
+		unsigned int importTexture(const std::string & name, TextureInstance * texture);
+		unsigned int createTexture(const std::string & name, const RenderTargetDesc & desc);
+		// The pass object receives the inputs as color_0, color_1... (see PostProcessProgram)
+		unsigned int addPass(const std::string & name, Program * program, PostProcessObject * obj, const std::vector<unsigned int> & inputs, const std::vector<unsigned int> & outputs);
+		// Passes which only lead to other resources are culled, so the output can be moved
+		// up the chain to skip the last passes
+		void setOutput(unsigned int resource, PostProcessObject * obj);
+
+		void setPassEnabled(unsigned int pass, bool enabled);
+		bool isPassEnabled(unsigned int pass) const;
+		// Resolution of the pass outputs relative to the screen
+		void setPassScale(unsigned int pass, float scale);
+		float getPassScale(unsigned int pass) const;
+		unsigned int getNumPasses() const;
+		const std::string & getPassName(unsigned int pass) const;
+		// Passes which survived culling
+		unsigned int getNumScheduledPasses() const;
+
+		void onResize(unsigned int width, unsigned int height);
+		// Only does work if passes were enabled/disabled or the screen was resized since last time
+		void compile();
+		// Renders the scheduled passes (depth test is expected to be disabled)
+		void execute(Camera * cam);
+
+		// GPU memory of the pooled render targets, and what the same passes would take
+		// with a render target per output
+		size_t getAllocatedMemory() const;
+		size_t getUnaliasedMemory() const;
+		unsigned int getNumAllocatedTargets() const;
+
+		// Releases the pooled targets and the framebuffers
+		void clean();
+	private:
+		// Resource actually read in place of the given one once disabled passes are removed
+		unsigned int resolve(unsigned int resource) const;
+		void getTargetSize(const RenderTargetDesc & desc, unsigned int & width, unsigned int & height) const;
+		unsigned int acquireTarget(const RenderTargetDesc & desc);
+		void attachOutputs(Pass & pass);
+	};
+}
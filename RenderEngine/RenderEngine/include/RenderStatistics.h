@@ -0,0 +1,41 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+namespace Engine
+{
+	// Give access anywhere in the engine to the draw call counters of the
+	// frame being rendered. They are reset when a new frame starts
+	class RenderStatistics
+	{
+	public:
+		// Tree levels of detail: the reduced depth meshes, then the impostors
+		static const unsigned int TREE_LODS = 4;
+		// At least CascadeShadowMaps::MAX_CASCADES
+		static const unsigned int SHADOW_CASCADES = 8;
+
+		static unsigned int drawCalls;
+		static unsigned int drawnInstances;
+		static unsigned int uniformUploads;
+		// Shader storage buffer updates from the CPU (upload ring buffer copies of the lights,
+		// CPU built light clusters), counted apart from the uniforms
+		static unsigned int storageUploads;
+		// OpenGL state changes sent to the driver and the redundant ones dropped (see GLStateCache)
+		static unsigned int issuedStateChanges;
+		static unsigned int filteredStateChanges;
+		// CPU time spent issuing the terrain tiles (all passes), in milliseconds
+		static double terrainSubmitMs;
+		// Trees drawn on the main pass with each level of detail
+		static unsigned int treeLODInstances[TREE_LODS];
+		// Terrain tiles (all shadow casting components) drawn on every cascade
+		static unsigned int shadowCasterTiles[SHADOW_CASCADES];
+		// CPU time spent on the shadow map pass, in milliseconds
+		static double shadowPassMs;
+		// Texels of the static shadow cache re-rendered this frame
+		static unsigned int shadowCacheTexels;
+
+		static void reset();
+	};
+}
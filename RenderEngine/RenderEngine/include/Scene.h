@@ -60,6 +60,9 @@ namespace Engine
 
 		void addPointLight(PointLight * pl);
 		void addSpotLight(SpotLight * sl);
+		// Removes and deletes the light with the given name, if any
+		void removePointLight(std::string name);
+		void removeSpotLight(std::string name);
 		void setDirectionalLight(DirectionalLight * dl);
 		const std::map<std::string, PointLight *> & getPointLights() const;
 		const std::map<std::string, SpotLight *> & getSpotLights() const;
@@ -10,6 +10,16 @@
 
 namespace Engine
 {
+	// Casters a shadow pass draws (see CascadeShadowMaps::getCasterSet())
+	enum ShadowCasterSet
+	{
+		SHADOW_CASTERS_ALL,
+		// Only the casters that never move, rendered into the static shadow cache
+		SHADOW_CASTERS_STATIC,
+		// Only the moving casters, drawn on top of a cascade copied from the static shadow cache
+		SHADOW_CASTERS_DYNAMIC
+	};
+
 	// Class that represents an element that can cast shadows
 	class ShadowCaster
 	{
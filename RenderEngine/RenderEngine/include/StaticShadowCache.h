@@ -0,0 +1,114 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "TerrainHeightField.h"
+
+namespace Engine
+{
+	// Texels [x0, x1) x [y0, y1) of a shadow map
+	typedef struct ShadowTexelRect
+	{
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+	} ShadowTexelRect;
+
+	// Part of a cache region which is contiguous on the cache texture
+	typedef struct ShadowCachePiece
+	{
+		// Global texels (light space position / texel size)
+		ShadowTexelRect global;
+		// Texture texels of the lower left corner
+		int textureX;
+		int textureY;
+	} ShadowCachePiece;
+
+	/**
+	 * Depth of the static shadow casters (the landscape) around the camera, with a layer per cascade
+	 * sharing the cascade texel size and light space grid, so a cascade just copies its texels out of
+	 * it. Layers are addressed toroidally: global texel (x, y) is stored at (x mod RESOLUTION,
+	 * y mod RESOLUTION), so as the window follows the camera only the newly exposed strips have to be
+	 * rendered. A layer is rebuilt when the light direction, the terrain parameters or the cascade
+	 * texel size change, or when the camera leaves its depth range
+	 */
+	class StaticShadowCache
+	{
+	public:
+		// Width and height of every layer
+		static const unsigned int RESOLUTION = 2048;
+	private:
+		typedef struct CacheLayer
+		{
+			bool valid;
+			float texelSize;
+			// Global texel of the window lower left corner
+			int originX;
+			int originY;
+			// Light space depth range: depthCenter +- depthExtent
+			float depthCenter;
+			float depthExtent;
+			// FBO with the layer as depth attachment
+			unsigned int fbo;
+			// Global texels to render this frame
+			std::vector<ShadowTexelRect> dirty;
+		} CacheLayer;
+
+		// GL_TEXTURE_2D_ARRAY with a depth layer per cascade
+		unsigned int texture;
+		std::vector<CacheLayer> layers;
+
+		// Light and terrain the layers were rendered with
+		glm::vec3 lightDirection;
+		TerrainHeightField heightField;
+
+		// Texels rendered and layers rebuilt on the last frame
+		unsigned int renderedTexels;
+		unsigned int rebuiltLayers;
+	public:
+		StaticShadowCache();
+
+		// (Re)creates the cache with the given amount of layers, all of them invalid
+		void allocate(unsigned int numLayers);
+		void release();
+		unsigned int getNumLayers() const { return (unsigned int)layers.size(); }
+
+		// Starts a new frame. Invalidates every layer if the light direction or the terrain changed
+		void beginFrame(const glm::vec3 & lightDirection);
+
+		// Centers the window of a layer on the eye (global texel eyeX, eyeY and light space depth eyeDepth)
+		// and gathers the strips to render. reach is the distance from the eye to the furthest receiver of
+		// the cascade. Returns false, and the cascade must be rendered as usual, if its RES x RES texels
+		// starting at the global texel (cascadeX, cascadeY) do not fit on the window
+		bool update(unsigned int layer, float texelSize, int eyeX, int eyeY, float eyeDepth, float reach,
+			int cascadeX, int cascadeY, unsigned int cascadeResolution);
+
+		const std::vector<ShadowTexelRect> & getDirtyRegions(unsigned int layer) const { return layers[layer].dirty; }
+		float getDepthCenter(unsigned int layer) const { return layers[layer].depthCenter; }
+		float getDepthExtent(unsigned int layer) const { return layers[layer].depthExtent; }
+
+		// Splits a region of global texels where it wraps around the texture
+		void getPieces(const ShadowTexelRect & region, std::vector<ShadowCachePiece> & pieces) const;
+
+		// Binds the layer FBO, restricted (viewport and scissor) to a piece, and clears it
+		void beginPieceRender(unsigned int layer, const ShadowCachePiece & piece);
+		void endPieceRender();
+
+		// Copies size x size texels starting at the global texel (x, y) into a layer of a 2D array texture
+		void copyToTexture(unsigned int layer, int x, int y, unsigned int size, unsigned int dstTexture, unsigned int dstLayer) const;
+
+		unsigned int getRenderedTexels() const { return renderedTexels; }
+		unsigned int getRebuiltLayers() const { return rebuiltLayers; }
+		size_t getMemoryUsage() const;
+	private:
+		static int wrap(int x);
+	};
+}
@@ -10,6 +10,8 @@
 #include "TerrainComponent.h"
 #include "IRenderable.h"
 #include "ShadowCaster.h"
+#include "Frustum.h"
+#include "TileCuller.h"
 
 namespace Engine
 {
@@ -23,6 +25,13 @@ namespace Engine
 
 		std::vector<TerrainComponent*> renderableComponents;
 		std::vector<TerrainComponent*> shadowableComponents;
+
+		// Culls the tiles of the component being rendered
+		TileCuller culler;
+
+		// Culling statistics of the last rendered frame (main pass), added up for all components
+		unsigned int visibleTileCount;
+		unsigned int testedTileCount;
 	public:
 		Terrain();
 		Terrain(float tileWidth, unsigned int renderRadius);
@@ -37,11 +46,23 @@ namespace Engine
 
 		float getTileScale();
 		unsigned int getRenderRadius();
+
+		unsigned int getVisibleTileCount() { return visibleTileCount; }
+		unsigned int getTestedTileCount() { return testedTileCount; }
 	private:
 		void initialize();
 		void createTileMesh();
 
+		// Leaves on the culler the tiles of the given range whose component bounds intersect the frustum.
+		// With terrainHeightBounds the tiles span the terrain height range instead, so tiles far from the
+		// camera are not requested from the tile cache
+		void cullTiles(TerrainComponent * component, const Frustum & frustum, int xStart, int xEnd, int yStart, int yEnd, bool terrainHeightBounds = false);
+		// Range of tiles [xStart, xEnd) x [yStart, yEnd) under the part of a volume (given by its view
+		// projection matrix) between two heights. Returns false if there is none
+		bool getVolumeTiles(const glm::mat4 & volume, float minHeight, float maxHeight, int & xStart, int & xEnd, int & yStart, int & yEnd);
+
 		void renderTiledComponent(TerrainComponent * component, Camera * cam);
+		// Renders the casters of the shadow pass being rendered, culled against its light space volume
 		void renderTiledComponentShadow(TerrainComponent * component, Camera * cam, const glm::mat4 & proj);
 	};
 }
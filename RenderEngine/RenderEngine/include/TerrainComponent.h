@@ -9,6 +9,8 @@
 #include "WorldConfig.h"
 #include "Camera.h"
 #include "Program.h"
+#include "Mesh.h"
+#include "TerrainTileCache.h"
 
 namespace Engine
 {
@@ -36,12 +38,21 @@ namespace Engine
 			return isShadowable;
 		}
 
+		// Whether the shadow never changes (no animation), so it can be kept on the static shadow cache.
+		// The cache culls these tiles with the terrain height range instead of getTileBounds()
+		virtual bool hasStaticShadow()
+		{
+			return false;
+		}
+
 		virtual void initialize()
 		{
 
 		}
 
 		virtual unsigned int getRenderRadius() = 0;
+		// Name used by the profiler scopes
+		virtual const char * getName() = 0;
 		
 		virtual Program * getActiveShader()
 		{
@@ -77,5 +88,57 @@ namespace Engine
 		{
 
 		}
+
+		// World space bounding box of the component on tile (i, j), used for culling. Returns
+		// false if there is nothing to render on the tile. Defaults to the landscape bounds
+		virtual bool getTileBounds(int i, int j, glm::vec3 & min, glm::vec3 & max)
+		{
+			float minHeight, maxHeight;
+			Engine::TerrainTileCache::getInstance().getTileBounds(i, j, minHeight, maxHeight);
+
+			min = glm::vec3(float(i) * scale, TerrainHeightField::toWorldHeight(minHeight, scale), float(j) * scale);
+			max = glm::vec3(float(i + 1) * scale, TerrainHeightField::toWorldHeight(maxHeight, scale), float(j + 1) * scale);
+			return true;
+		}
+	protected:
+		// Bounds of vegetation placed on the terrain by the tree shaders (only within the vegetation
+		// height band), given the local bounds of the vegetation mesh
+		bool getVegetationTileBounds(int i, int j, const glm::vec3 & meshMin, const glm::vec3 & meshMax, glm::vec3 & min, glm::vec3 & max)
+		{
+			float minHeight, maxHeight;
+			Engine::TerrainTileCache::getInstance().getTileBounds(i, j, minHeight, maxHeight);
+
+			float bandMin = Engine::Settings::waterHeight;
+			float bandMax = Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight;
+			if (maxHeight <= bandMin || minHeight >= bandMax)
+			{
+				return false;
+			}
+
+			minHeight = glm::max(minHeight, bandMin);
+			maxHeight = glm::min(maxHeight, bandMax);
+
+			// Horizontal sway applied by the wind on tree.vert
+			glm::vec2 wind(Engine::Settings::windDirection.x, Engine::Settings::windDirection.z);
+			float sway = 0.01f * Engine::Settings::windStrength * glm::length(wind) * glm::max(glm::abs(meshMin.y), glm::abs(meshMax.y));
+
+			min = glm::vec3(float(i) * scale + meshMin.x - sway, TerrainHeightField::toWorldHeight(minHeight, scale) + meshMin.y, float(j) * scale + meshMin.z - sway);
+			max = glm::vec3(float(i + 1) * scale + meshMax.x + sway, TerrainHeightField::toWorldHeight(maxHeight, scale) + meshMax.y, float(j + 1) * scale + meshMax.z + sway);
+			return true;
+		}
+
+		// Local space bounds of the mesh vertices
+		static void computeMeshBounds(const Mesh * mesh, glm::vec3 & min, glm::vec3 & max)
+		{
+			const float * vertices = mesh->getVertices();
+			min = glm::vec3(vertices[0], vertices[1], vertices[2]);
+			max = min;
+			for (unsigned int v = 1; v < mesh->getNumVertices(); v++)
+			{
+				glm::vec3 p(vertices[v * 3], vertices[v * 3 + 1], vertices[v * 3 + 2]);
+				min = glm::min(min, p);
+				max = glm::max(max, p);
+			}
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Engine
+{
+	// Result of TerrainHeightField::validate()
+	typedef struct TerrainHeightValidation
+	{
+		unsigned int samples;
+		// Samples further than the tolerance from the shader formula
+		unsigned int failures;
+		// Samples where the batch path differs from the scalar one
+		unsigned int batchMismatches;
+		// Largest difference between the scalar height and the shader formula
+		float maxError;
+	} TerrainHeightValidation;
+
+	/**
+	 * CPU mirror of the procedural terrain height function (noiseHeight() on
+	 * shaders/terrain/terrain.teseval and shaders/vegetation/tree/tree.geom).
+	 * Allows to query the terrain height without any GPU round trip.
+	 * The lattice values come from an integer hash (Random2D() on the shaders). The former
+	 * fract(sin(x) * 43758.5) hash depended on the precision of each GPU sine, so no CPU
+	 * code could reproduce it
+	 */
+	class TerrainHeightField
+	{
+	public:
+		// Height multiplier applied by the terrain tessellation stage
+		static const float HEIGHT_SCALE;
+		// Largest difference allowed by validate(), relative to getMaxNoiseHeight()
+		static const float VALIDATION_TOLERANCE;
+	private:
+		float amplitude;
+		float frecuency;
+		float scale;
+		unsigned int octaves;
+	public:
+		// Takes a snapshot of the current Engine::Settings terrain parameters
+		TerrainHeightField();
+		TerrainHeightField(float amplitude, float frecuency, float scale, unsigned int octaves);
+
+		// Re-reads the terrain parameters from Engine::Settings. Returns true if any of them changed
+		bool update();
+
+		float getAmplitude() const { return amplitude; }
+		float getFrecuency() const { return frecuency; }
+		float getScale() const { return scale; }
+		unsigned int getOctaves() const { return octaves; }
+
+		// Normalized height at the given terrain uv, as computed by the shaders
+		float noiseHeight(const glm::vec2 & uv) const;
+		// Evaluates noiseHeight() for count uvs at once (4 per iteration with SSE2).
+		// Results are identical to the scalar version
+		void noiseHeightBatch(const float * u, const float * v, float * result, size_t count) const;
+
+		// Normalized height at the local coordinates (u, v) [0,1] of tile (i, j), matching the
+		// uv built by terrain.vert (abs(inUV + gridPos))
+		float getTileHeight(int i, int j, float u, float v) const;
+		// World space height at world position (x, z) for a terrain of the given tile scale
+		float getWorldHeight(float x, float z, float tileScale) const;
+
+		// Upper bound of noiseHeight() for the current parameters
+		float getMaxNoiseHeight() const;
+		// Max difference between the pre-cubed noise value at any point and the one at the closest
+		// sample of a regular grid with the given uv spacing. Used to build conservative bounds
+		float getSampleErrorBound(float uvSpacing) const;
+
+		// Compares the scalar and batch heights of samples spread over the terrain (lattice points
+		// included) with a literal port of the shader formula. Does not need OpenGL
+		TerrainHeightValidation validate(unsigned int samples) const;
+		// Uvs checked by validate(), also used to check the GPU heights (see TerrainHeightProgram)
+		void getValidationSamples(unsigned int samples, std::vector<float> & u, std::vector<float> & v) const;
+		// Largest difference allowed between a validated height and its reference
+		float getValidationTolerance() const;
+
+		// Converts a normalized height into world space units
+		static float toWorldHeight(float normalizedHeight, float tileScale) { return normalizedHeight * HEIGHT_SCALE * tileScale; }
+	};
+}
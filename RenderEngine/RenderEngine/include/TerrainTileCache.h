@@ -0,0 +1,178 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "TerrainHeightField.h"
+#include "Threadpool.h"
+
+namespace Engine
+{
+	// A vegetation instance accepted on a tile (its height is within the vegetation band, or close enough
+	// for the GPU to accept it)
+	typedef struct VegetationPlacement
+	{
+		// Index of the placement within the registered pattern
+		unsigned int index;
+		// Tile local coordinates [0, 1]
+		glm::vec2 uv;
+		// Normalized terrain height at the placement
+		float height;
+	} VegetationPlacement;
+
+	// Vegetation positions registered on the cache. Either a pattern of tile local positions shared by
+	// every tile, or a number of positions randomly scattered over each tile (seeded with its coordinates)
+	typedef struct VegetationPattern
+	{
+		std::vector<glm::vec2> positions;
+		unsigned int scatterCount;
+	} VegetationPattern;
+
+	// CPU side data of a terrain tile (i, j)
+	typedef struct TerrainTile
+	{
+		// Samples per side of the coarse height grid
+		static const unsigned int GRID_SIZE = 17;
+
+		int i, j;
+		// Conservative normalized height bounds of the whole tile
+		float minHeight;
+		float maxHeight;
+		// Normalized heights, row major (v major), GRID_SIZE x GRID_SIZE samples covering [0,1]^2
+		float heights[GRID_SIZE * GRID_SIZE];
+		// Accepted placements of every registered vegetation pattern, indexed by pattern id
+		std::vector<std::vector<VegetationPlacement>> vegetation;
+	} TerrainTile;
+
+	// Cache counters. Latencies measure the time from the first request of a tile until it is ready
+	typedef struct TerrainTileCacheStats
+	{
+		unsigned long long hits;
+		unsigned long long misses;
+		unsigned long long evictions;
+		unsigned long long generated;
+		double lastLatencyMs;
+		double avgLatencyMs;
+		double maxLatencyMs;
+		size_t residentTiles;
+		size_t pendingTiles;
+	} TerrainTileCacheStats;
+
+	/**
+	 * Cache of CPU terrain tile data, keyed by the (i, j) grid coordinates used by Engine::Terrain.
+	 * Tiles are built asynchronously on the Concurrent::ThreadPool as the camera approaches and
+	 * evicted in LRU order. Lookups never block: a tile that is not ready yet is reported as a miss
+	 * and conservative bounds are returned instead
+	 */
+	class TerrainTileCache
+	{
+		friend class TerrainTileTask;
+	public:
+		// Extra ring of tiles requested around the render radius
+		static const unsigned int PREFETCH_MARGIN = 2;
+		// Max tiles being built at the same time
+		static const unsigned int MAX_PENDING_TILES = 32;
+	private:
+		typedef struct CacheEntry
+		{
+			std::shared_ptr<const TerrainTile> tile;
+			std::list<unsigned long long>::iterator lruPosition;
+			std::chrono::steady_clock::time_point requestTime;
+		} CacheEntry;
+
+		static TerrainTileCache * INSTANCE;
+	private:
+		std::mutex lock;
+
+		std::unordered_map<unsigned long long, CacheEntry> entries;
+		// Most recently used first. Only holds ready tiles
+		std::list<unsigned long long> lru;
+		size_t pendingTiles;
+		size_t capacity;
+
+		// Increased on every invalidation, so tasks launched before it are dropped
+		unsigned int generation;
+
+		TerrainHeightField heightField;
+		float vegetationMinHeight;
+		float vegetationMaxHeight;
+		std::shared_ptr<const std::vector<VegetationPattern>> vegetationPatterns;
+
+		TerrainTileCacheStats stats;
+	public:
+		static TerrainTileCache & getInstance();
+	private:
+		TerrainTileCache();
+	public:
+		// Registers a set of tile local positions where vegetation may be placed. Returns the pattern id
+		unsigned int registerVegetationPattern(const std::vector<glm::vec2> & pattern);
+		// Registers count positions randomly scattered over each tile. Returns the pattern id
+		unsigned int registerScatteredVegetation(unsigned int count);
+
+		// Tile local positions of a scattered pattern on the tile (i, j), in placement index order
+		static void scatterVegetation(int i, int j, unsigned int count, std::vector<glm::vec2> & positions);
+
+		// To be called once per frame. Syncs with the terrain settings (invalidating the cache if they
+		// changed) and requests the tiles around (centerI, centerJ)
+		void update(int centerI, int centerJ, unsigned int radius);
+
+		// Returns the tile if ready, NULL otherwise. Does not request it: only update() does, closest
+		// tiles first and with at most MAX_PENDING_TILES being built
+		std::shared_ptr<const TerrainTile> getTile(int i, int j);
+		// Returns true if the tile was ready. Otherwise, minHeight and maxHeight receive the bounds of the whole terrain
+		bool getTileBounds(int i, int j, float & minHeight, float & maxHeight);
+
+		// Conservative bounds used for tiles that are not ready
+		float getFallbackMinHeight() { return 0.0f; }
+		float getFallbackMaxHeight();
+
+		const TerrainHeightField & getHeightField() { return heightField; }
+
+		TerrainTileCacheStats getStats();
+		void resetStats();
+
+		// Drops every tile. Tiles being built are discarded when they finish
+		void invalidate();
+
+		// Builds the data of a tile on the calling thread (used by the tile tasks and the culling validation)
+		static std::shared_ptr<TerrainTile> buildTile(int i, int j, const TerrainHeightField & field,
+			const std::vector<VegetationPattern> & patterns, float vegetationMin, float vegetationMax);
+	private:
+		static unsigned long long makeKey(int i, int j);
+
+		// Must be called with the lock held
+		void requestTile(int i, int j);
+		void onTileBuilt(unsigned int tileGeneration, std::shared_ptr<const TerrainTile> tile);
+		unsigned int addVegetationPattern(const VegetationPattern & pattern);
+		void evict();
+	};
+
+	// Thread pool task which builds one tile and hands it back to the cache
+	class TerrainTileTask : public Concurrent::Runnable
+	{
+	private:
+		int i, j;
+		unsigned int generation;
+		TerrainHeightField heightField;
+		float vegetationMinHeight;
+		float vegetationMaxHeight;
+		std::shared_ptr<const std::vector<VegetationPattern>> vegetationPatterns;
+	public:
+		TerrainTileTask(int i, int j, unsigned int generation, const TerrainHeightField & heightField,
+			float vegetationMinHeight, float vegetationMaxHeight,
+			std::shared_ptr<const std::vector<VegetationPattern>> vegetationPatterns);
+		void run();
+	};
+}
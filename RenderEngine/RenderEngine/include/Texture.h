@@ -38,6 +38,9 @@ namespace Engine
 
 		void generateTexture();
 		virtual void uploadTexture() = 0;
+
+		// Bytes per texel taken by the given internal format (memory reports)
+		static unsigned int getTexelSize(int internalFormat);
 		virtual void setSize(unsigned int w, unsigned int h, unsigned int d = 1) = 0;
 		virtual GLenum getTextureType() = 0;
 	};
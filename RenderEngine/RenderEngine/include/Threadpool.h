@@ -17,9 +17,26 @@ namespace Engine
 		class Runnable
 		{
 		public:
+			virtual ~Runnable() {}
 			virtual void run() = 0;
 		};
 
+		// Blocks the waiting thread until countDown() has been called count times
+		class CountDownLatch
+		{
+		private:
+			std::mutex lock;
+			std::condition_variable monitor;
+			size_t count;
+		public:
+			CountDownLatch(size_t count = 0);
+
+			// Adds n more pending tasks. Must be called before they are queued
+			void add(size_t n);
+			void countDown();
+			void wait();
+		};
+
 		class ThreadPool
 		{
 		private:
@@ -27,6 +44,8 @@ namespace Engine
 		private:
 			std::list<std::thread> pool;
 			std::queue<std::unique_ptr<Runnable>> tasks;
+			// Polled before tasks, for short jobs somebody is waiting on every frame
+			std::queue<std::unique_ptr<Runnable>> priorityTasks;
 
 			std::mutex globalLock;
 			std::condition_variable monitor;
@@ -44,6 +63,8 @@ namespace Engine
 			bool isActive() { return active; }
 			void init();
 			void addTask(std::unique_ptr<Runnable> task);
+			// Runs the task before any of the ones queued with addTask()
+			void addPriorityTask(std::unique_ptr<Runnable> task);
 			void shutDown();
 			void pollTask();
 		};
@@ -0,0 +1,72 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+
+namespace Engine
+{
+	// Visible tiles of one of the camera poses tested by TileCuller::validate()
+	typedef struct TileCullingPose
+	{
+		glm::vec3 eye;
+		glm::vec3 target;
+		unsigned int testedTiles;
+		unsigned int visibleTiles;
+	} TileCullingPose;
+
+	// Result of TileCuller::validate()
+	typedef struct TileCullingValidation
+	{
+		std::vector<TileCullingPose> poses;
+		unsigned int testedTiles;
+		// Tiles culled although part of the terrain within them is inside the view frustum
+		unsigned int falseNegatives;
+		// Tiles kept although their bounds are fully outside one of the frustum planes
+		unsigned int falsePositives;
+		// Tiles where the batch test and the single box test disagree
+		unsigned int batchMismatches;
+		// Terrain samples outside the bounds the tile cache built for their tile
+		unsigned int boundViolations;
+	} TileCullingValidation;
+
+	/**
+	 * Culls a set of terrain tiles against a frustum. Tile bounds are gathered as structure of
+	 * arrays and tested in a single batch (see Frustum::testAABBBatch()). Does not depend on OpenGL
+	 */
+	class TileCuller
+	{
+	private:
+		// Tile coordinates, tile bounds (min xyz, max xyz) and test results
+		std::vector<glm::ivec2> tileCoords;
+		std::vector<float> tileBounds[6];
+		std::vector<unsigned char> tileVisibility;
+		size_t numTiles;
+		// Tiles which passed the last culling
+		std::vector<glm::ivec2> visibleTiles;
+	public:
+		TileCuller();
+
+		// Starts a new set of at most maxTiles tiles
+		void begin(size_t maxTiles);
+		void addTile(int i, int j, const glm::vec3 & min, const glm::vec3 & max);
+		// Tests the tiles added since begin(), and fills the visible tiles list
+		void cull(const Frustum & frustum);
+
+		size_t getNumTiles() const { return numTiles; }
+		const std::vector<glm::ivec2> & getVisibleTiles() const { return visibleTiles; }
+
+		// Culls the landscape tiles around a fixed set of camera poses, with the bounds built by the
+		// tile cache for the given terrain, and checks the result against a brute force test of
+		// points sampled on the terrain of every tile
+		static TileCullingValidation validate(float tileWidth, unsigned int renderRadius);
+	};
+}
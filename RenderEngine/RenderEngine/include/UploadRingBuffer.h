@@ -0,0 +1,69 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+namespace Engine
+{
+	namespace GPU
+	{
+		/**
+		 * Staging buffer to update other buffers without stalling on glBufferSubData. It is
+		 * persistently mapped and split in NUM_REGIONS regions, one per frame in flight, each
+		 * guarded by a fence: the data is written on the current region and copied to its
+		 * destination with glCopyBufferSubData. Falls back to glBufferSubData if the context
+		 * lacks ARB_buffer_storage
+		 */
+		class UploadRingBuffer
+		{
+		public:
+			// Frames that may be in flight at the same time
+			static const unsigned int NUM_REGIONS = 3;
+		private:
+			unsigned int buffer;
+			unsigned char * mapped;
+			GLsync fences[NUM_REGIONS];
+
+			size_t regionSize;
+			unsigned int region;
+			// Bytes written on the current region
+			size_t regionOffset;
+
+			// Statistics of the last finished frame
+			size_t frameBytes;
+			unsigned int frameCopies;
+			size_t lastFrameBytes;
+			unsigned int lastFrameCopies;
+		public:
+			UploadRingBuffer();
+
+			static bool isSupported();
+
+			// Allocates NUM_REGIONS regions of regionSize bytes
+			void init(size_t regionSize);
+			bool isInitialized() const { return regionSize != 0; }
+
+			// Moves to the next region, waiting for the GPU to release it if needed
+			void beginFrame();
+			// Copies size bytes of data to dstBuffer at dstOffset. The region grows if it can not
+			// hold the frame uploads
+			void upload(unsigned int dstBuffer, size_t dstOffset, const void * data, size_t size);
+			// Fences the region written since beginFrame()
+			void endFrame();
+
+			size_t getRegionSize() const { return regionSize; }
+			size_t getFrameBytes() const { return lastFrameBytes; }
+			unsigned int getFrameCopies() const { return lastFrameCopies; }
+
+			void destroy();
+		private:
+			void allocate(size_t regionSize);
+			void release();
+		};
+	}
+}
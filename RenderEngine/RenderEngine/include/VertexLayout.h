@@ -0,0 +1,110 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Engine
+{
+	// Attributes a mesh vertex may carry
+	enum VertexAttribute
+	{
+		VERTEX_POSITION,
+		VERTEX_NORMAL,
+		VERTEX_COLOR,
+		VERTEX_EMISSION,
+		VERTEX_UV,
+		VERTEX_TANGENT,
+		VERTEX_ATTRIBUTE_COUNT
+	};
+
+	// GPU storage format of a vertex attribute
+	enum VertexFormat
+	{
+		VERTEX_FORMAT_NONE,			// Attribute not present
+		VERTEX_FORMAT_FLOAT,		// 32 bit float per component
+		VERTEX_FORMAT_HALF,			// 16 bit float per component
+		VERTEX_FORMAT_RGBA8,		// 8 bit normalized unsigned per component, padded to 4 (values within [0, 1])
+		VERTEX_FORMAT_OCTAHEDRAL	// Unit vector octahedral encoded on 2 normalized signed shorts
+	};
+
+	// Where and how an attribute is stored within the mesh vertex buffers
+	typedef struct
+	{
+		VertexFormat format;
+		// Source (float) components
+		unsigned int components;
+		// Vertex buffer holding the attribute (always 0 when interleaved)
+		unsigned int buffer;
+		size_t offset;
+		size_t stride;
+	} VertexAttributeLayout;
+
+	/**
+	 * Describes how a mesh stores its vertices on the GPU: one buffer per attribute or a
+	 * single interleaved buffer, the format of each attribute and the index size.
+	 * The formats are a request: when the mesh is synced, packed formats the data does
+	 * not fit on (colors out of [0, 1], uvs out of half float range) fall back to floats.
+	 * An optimized layout also welds, and reorders for the vertex cache, overdraw and vertex
+	 * fetch, the triangles and vertices uploaded (the mesh CPU data keeps its order)
+	 */
+	class VertexLayout
+	{
+	private:
+		bool interleaved;
+		bool shortIndices;
+		bool optimized;
+		VertexFormat requested[VERTEX_ATTRIBUTE_COUNT];
+
+		// Resolved layout, valid after resolve()
+		VertexAttributeLayout attributes[VERTEX_ATTRIBUTE_COUNT];
+		size_t vertexSize;
+		unsigned int numBuffers;
+	public:
+		VertexLayout();
+
+		// One float buffer per attribute and 32 bit indices
+		static VertexLayout separate();
+		// Single interleaved buffer with octahedral normals/tangents, RGBA8 colors, half float
+		// uvs and 16 bit indices when the mesh has less than 65536 vertices
+		static VertexLayout compact();
+
+		void setInterleaved(bool interleaved);
+		void setShortIndices(bool shortIndices);
+		// Only applies to triangle lists (see MeshOptimizer)
+		void setOptimized(bool optimized);
+		void setFormat(VertexAttribute attribute, VertexFormat format);
+
+		bool isInterleaved() const { return interleaved; }
+		bool isOptimized() const { return optimized; }
+		VertexFormat getRequestedFormat(VertexAttribute attribute) const { return requested[attribute]; }
+
+		// Picks the final format of each attribute given the mesh data (NULL if the attribute
+		// is not present) and computes offsets and strides
+		void resolve(const float * const data[VERTEX_ATTRIBUTE_COUNT], unsigned int numVertices);
+
+		// Packs the attributes stored on the given vertex buffer
+		void pack(unsigned int buffer, const float * const data[VERTEX_ATTRIBUTE_COUNT], unsigned int numVertices, std::vector<unsigned char> & result) const;
+
+		const VertexAttributeLayout & getAttribute(VertexAttribute attribute) const { return attributes[attribute]; }
+		bool hasAttribute(VertexAttribute attribute) const { return attributes[attribute].format != VERTEX_FORMAT_NONE; }
+		unsigned int getNumBuffers() const { return numBuffers; }
+		// Bytes of a single vertex (all buffers)
+		size_t getVertexSize() const { return vertexSize; }
+		// Wether a mesh with the given vertex count uses 16 bit indices
+		bool usesShortIndices(unsigned int numVertices) const { return shortIndices && numVertices < 65536; }
+
+		// Number of float components the attribute has on the CPU
+		static unsigned int getAttributeComponents(VertexAttribute attribute);
+		// Bytes used by a single vertex attribute with the given format
+		static size_t getFormatSize(VertexFormat format, unsigned int components);
+		// Float to IEEE 754 half float conversion (round to nearest)
+		static unsigned short toHalf(float value);
+		// Octahedral encoding of a unit vector, each component on [-32767, 32767]
+		static void toOctahedral(const float * v, short * result);
+	};
+}
@@ -21,6 +21,22 @@ namespace Engine
 		TRAVEL_STRAIGHT
 	};
 
+	// Quality presets of the post processes (resolution of each node, see PostProcessChainNode)
+	enum PostProcessQuality
+	{
+		POSTPROCESS_QUALITY_LOW,
+		POSTPROCESS_QUALITY_MEDIUM,
+		POSTPROCESS_QUALITY_HIGH,
+		POSTPROCESS_QUALITY_COUNT
+	};
+
+	// Builders of the point and spot light clusters (see ClusteredLightBuffer)
+	enum LightClusterBuilderType
+	{
+		LIGHT_CLUSTERS_CPU,
+		LIGHT_CLUSTERS_GPU
+	};
+
 	// Holds all the system configuration, given access anywhere in the engine
 	// where it is needed
 	class Settings
@@ -47,6 +63,9 @@ namespace Engine
 		static float terrainScale;
 		static unsigned int terrainOctaves;
 		static float vegetationMaxHeight;
+		static bool instancedVegetation;
+		static bool treeLODs;
+		static bool batchedTerrain;
 		static float grassCoverage;
 		static glm::vec3 grassColor;
 		static glm::vec3 sandColor;
@@ -60,6 +79,10 @@ namespace Engine
 		static float waterHeight;
 
 		static unsigned int drawClouds;
+		// Bakes the cloud noise textures on the CPU (and caches them on disk) instead of the compute shaders
+		static bool bakeCloudNoiseOnCPU;
+		// GPU time the compute shaders may spend generating cloud noise each frame (0 = all at once)
+		static float cloudNoiseFrameBudgetMs;
 		static float cloudType;
 		static float coverageMultiplier;
 		static float innerSphereRadius;
@@ -81,12 +104,30 @@ namespace Engine
 		static float dofFocalDist;
 		static float dofMaxDist;
 
+		// Tone mapping, depth of field and screen output in one compute dispatch instead of 3 passes
+		static bool fusedPostProcess;
+		// One of PostProcessQuality
+		static unsigned int postProcessQuality;
+		// One of LightClusterBuilderType
+		static unsigned int lightClusterBuilder;
+
+		// Shadow cascades of the directional light, from 1 to CascadeShadowMaps::MAX_CASCADES
+		static unsigned int shadowCascades;
+		// Blend between uniform (0) and logarithmic (1) cascade splits
+		static float shadowSplitLambda;
+		// View distance covered by the cascades
+		static float shadowDistance;
+		// Keep the landscape depth of every cascade in a StaticShadowCache, re-rendering only the texels
+		// exposed as the camera moves
+		static bool shadowCache;
+
 		static float godRaysExposure;
 		static float godRaysDensity;
 		static float godRaysDecay;
 		static float godRaysWeight;
 
 		static bool showUI;
+		static bool showProfiler;
 	public:
 		static void update();
 	};
@@ -0,0 +1,48 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include "ComputeProgram.h"
+#include "Camera.h"
+#include "instances/TextureInstance.h"
+
+namespace Engine
+{
+	/**
+	 * Class in charge to manage the compute shader which performs tone mapping, depth of field
+	 * and the screen output in a single tiled dispatch (instead of 3 full screen passes)
+	 */
+	class FusedPostProcessProgram : public ComputeProgram
+	{
+	public:
+		// Workgroup size declared by the shader
+		static const unsigned int LOCAL_SIZE_X;
+		static const unsigned int LOCAL_SIZE_Y;
+	private:
+		unsigned int uOutColor;
+		unsigned int uInColor;
+		unsigned int uDepthBuffer;
+		unsigned int uScreenSize;
+		unsigned int uToneMapping;
+		unsigned int uDepthOfField;
+		unsigned int uExposure;
+		unsigned int uGamma;
+		unsigned int uTint;
+		unsigned int uFocalDistance;
+		unsigned int uMaxDistanceFactor;
+		unsigned int uInverseProj;
+
+	public:
+		FusedPostProcessProgram();
+		FusedPostProcessProgram(const FusedPostProcessProgram & other);
+
+		void configureProgram();
+		// HDR color and depth inputs, and the (RGBA8) output
+		void bindTextures(const TextureInstance * color, const TextureInstance * depth, const TextureInstance * output);
+		// Disabled stages are skipped
+		void setParameters(Camera * camera, bool toneMapping, bool depthOfField);
+		void dispatchScreen(unsigned int width, unsigned int height, unsigned int barrier);
+	};
+}
@@ -0,0 +1,42 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include "ComputeProgram.h"
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Engine
+{
+	/**
+	 * Class in charge to manage the compute shader which builds the light clusters on the GPU
+	 * (alternative to LightClusterBuilder). One workgroup per cluster tests every light and
+	 * appends the ones it keeps to the shared index list
+	 */
+	class LightClusterProgram : public ComputeProgram
+	{
+	public:
+		// Lights a cluster can hold, must match the shader
+		static const unsigned int MAX_LIGHTS_PER_CLUSTER;
+	private:
+		unsigned int uNumLights;
+		unsigned int uProjScale;
+		unsigned int uNearPlane;
+		unsigned int uFarPlane;
+		unsigned int uViewMatrix;
+
+	public:
+		LightClusterProgram();
+		LightClusterProgram(const LightClusterProgram & other);
+
+		void configureProgram();
+		// Lights, grid and indices are read from / written to the ClusteredLightBuffer bindings.
+		// The lights are in world space, the clusters in view space
+		void setParameters(unsigned int numLights, float xScale, float yScale, float nearPlane, float farPlane, const glm::mat4 & view);
+		// One workgroup per cluster
+		void dispatchClusters(unsigned int barrier);
+	};
+}
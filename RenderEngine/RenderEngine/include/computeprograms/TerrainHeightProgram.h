@@ -0,0 +1,54 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include "ComputeProgram.h"
+#include "TerrainHeightField.h"
+
+#include <string>
+
+namespace Engine
+{
+	/**
+	 * Class in charge to manage the compute shader which evaluates the terrain height of a list of uvs.
+	 * The noise functions are taken as they are from one of the rendering shaders (terrain.teseval,
+	 * tree.geom...), so the heights read back are the ones that shader computes
+	 */
+	class TerrainHeightProgram : public ComputeProgram
+	{
+	public:
+		// Workgroup size declared by the shader
+		static const unsigned int LOCAL_SIZE_X;
+		// Shader storage bindings of the uvs and the heights, must match the shader
+		static const unsigned int UV_BINDING_POINT;
+		static const unsigned int HEIGHT_BINDING_POINT;
+	private:
+		// Rendering shader the noise functions are taken from
+		std::string noiseShaderFile;
+
+		unsigned int uNumSamples;
+		unsigned int uAmplitude;
+		unsigned int uFrecuency;
+		unsigned int uScale;
+		unsigned int uOctaves;
+
+	public:
+		TerrainHeightProgram(std::string noiseShaderFile);
+		TerrainHeightProgram(const TerrainHeightProgram & other);
+
+		void configureProgram();
+		// Terrain parameters of the given height field
+		void setParameters(unsigned int numSamples, const TerrainHeightField & field);
+		// One thread per sample
+		void dispatchSamples(unsigned int numSamples, unsigned int barrier);
+
+		// Evaluates the samples of TerrainHeightField::validate() on the GPU, reads them back and compares
+		// them with the CPU heights (batchMismatches is not used). Needs a current context
+		TerrainHeightValidation validate(const TerrainHeightField & field, unsigned int samples);
+	protected:
+		// Program source plus the noise functions (Random2D() to noiseHeight()) of the rendering shader
+		std::string loadShaderSource() override;
+	};
+}
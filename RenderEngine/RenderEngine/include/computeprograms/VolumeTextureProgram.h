@@ -15,14 +15,23 @@ namespace Engine
 	 */
 	class VolumeTextureProgram : public ComputeProgram
 	{
+	public:
+		// Workgroup size declared by the shaders
+		static const unsigned int LOCAL_SIZE_X;
+		static const unsigned int LOCAL_SIZE_Y;
+		static const unsigned int LOCAL_SIZE_Z;
 	private:
 		// Texture output shader location
 		unsigned int uOutput;
+		// First texel of the slab to generate
+		unsigned int uSlabOffset;
 	public:
 		VolumeTextureProgram(std::string shaderFile);
 		VolumeTextureProgram(const VolumeTextureProgram & other);
 
 		void configureProgram();
 		void bindOutput(const TextureInstance * ti);
+		// Generates the texels [offset, offset + size) of the bound output
+		void dispatchSlab(unsigned int offsetZ, unsigned int width, unsigned int height, unsigned int depth, unsigned int barrier);
 	};
 }
\ No newline at end of file
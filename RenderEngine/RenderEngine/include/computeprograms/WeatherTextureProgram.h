@@ -15,9 +15,15 @@ namespace Engine
 	 */
 	class WeatherTextureProgram : public ComputeProgram
 	{
+	public:
+		// Workgroup size declared by the shader
+		static const unsigned int LOCAL_SIZE_X;
+		static const unsigned int LOCAL_SIZE_Y;
 	private:
 		// Texture output location in shader
 		unsigned int uWeatherTex;
+		// First texel of the slab to generate
+		unsigned int uSlabOffset;
 
 	public:
 		WeatherTextureProgram();
@@ -25,5 +31,7 @@ namespace Engine
 
 		void configureProgram();
 		void bindOutput(const TextureInstance * ti);
+		// Generates the rows [offsetY, offsetY + height) of the bound output
+		void dispatchSlab(unsigned int offsetY, unsigned int width, unsigned int height, unsigned int barrier);
 	};
 }
\ No newline at end of file
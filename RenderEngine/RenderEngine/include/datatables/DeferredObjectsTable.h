@@ -31,6 +31,8 @@ namespace Engine
 		void registerDeferredObject(DeferredRenderObject * ro);
 		// Resizes all registered FBOs
 		void onResize(int width, int height);
+		// GPU memory taken by all registered FBOs, in bytes
+		size_t getMemoryUsage() const;
 		// Releases the FBOs from the GPU and CPU
 		void clean();
 	};
@@ -8,7 +8,7 @@
 #include "Mesh.h"
 #include <vector>
 #include <map>
-#include <assimp\scene.h>
+#include <assimp/scene.h>
 
 #include "StorageTable.h"
 
@@ -39,6 +39,10 @@ namespace Engine
 		// Manually place a mesh into the cache
 		void addMeshToCache(std::string name, const Mesh & mesh);
 
+		// GPU bytes used by each cached mesh, and by all of them
+		void getMeshSizes(std::vector<std::pair<std::string, size_t>> & sizes);
+		size_t getTotalMeshSize();
+
 		// Clean all meshes (GPU & CPU)
 		void clean();
 	};
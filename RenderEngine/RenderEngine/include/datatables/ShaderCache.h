@@ -0,0 +1,99 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "StorageTable.h"
+
+namespace Engine
+{
+	// Shader cache usage since the application started
+	typedef struct ShaderCacheStats
+	{
+		// Programs loaded from the cache
+		unsigned int hits;
+		// Programs compiled from source
+		unsigned int misses;
+		// Time spent loading cached binaries
+		double loadMs;
+		// Time spent compiling and linking programs
+		double buildMs;
+		// Compile and link time avoided by the cache hits
+		double savedMs;
+	} ShaderCacheStats;
+
+	/**
+	 * On disk cache of linked program binaries (glGetProgramBinary / glProgramBinary). Each
+	 * binary is stored under the program identifier (name and uber shader parameters) with a
+	 * key which hashes the preprocessed sources, the parameters and the driver vendor, renderer
+	 * and version, so any change on those falls back to source compilation. Drivers exposing no
+	 * binary formats disable the cache
+	 */
+	class ShaderCache : public StorageTable
+	{
+	public:
+		static const std::string DEFAULT_CACHE_FILE;
+	private:
+		static ShaderCache * INSTANCE;
+
+		typedef struct CacheEntry
+		{
+			unsigned long long key;
+			unsigned int format;
+			// Time it took to build the program from source
+			double buildMs;
+			std::vector<unsigned char> binary;
+		} CacheEntry;
+
+		std::string cacheFile;
+		std::map<std::string, CacheEntry> entries;
+
+		// Driver identification, part of every key
+		std::string driver;
+
+		bool enabled;
+		bool initialized;
+		bool supported;
+		bool dirty;
+
+		ShaderCacheStats stats;
+	private:
+		ShaderCache();
+
+	public:
+		static ShaderCache & getInstance();
+
+		~ShaderCache();
+
+		// Must be set before any program is created
+		void setCacheFile(const std::string & file);
+		void setEnabled(bool enabled);
+
+		// Hashes the given stage types and preprocessed sources with the parameters and driver
+		unsigned long long computeKey(unsigned long long parameters, const std::vector<unsigned int> & types, const std::vector<std::string> & sources);
+
+		// Attempts to load the cached binary of the given program. Returns false if there is
+		// none, it was built from other sources/driver, or the driver rejected it. The caller
+		// must compile it from source then
+		bool loadProgram(const std::string & id, unsigned long long key, unsigned int program);
+		// Must be called before linking a program which will be stored
+		void prepareProgram(unsigned int program);
+		// Retrieves the binary of a linked program
+		void storeProgram(const std::string & id, unsigned long long key, unsigned int program, double buildMs);
+
+		const ShaderCacheStats & getStats() const;
+		// Writes the cache to disk if it changed
+		void save();
+
+		void clean();
+	private:
+		void initializeCache();
+		void load();
+	};
+}
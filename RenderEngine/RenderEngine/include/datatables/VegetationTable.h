@@ -7,9 +7,37 @@
 
 #include "Mesh.h"
 #include "ProceduralVegetation.h"
+#include "vegetation/TreeImpostorAtlas.h"
+
+#include <vector>
 
 namespace Engine
 {
+	// Result of VegetationTable::benchmarkTreeGeneration(). Only the CPU geometry generation is
+	// measured (the mesh creation and GPU upload is the same for every generator). Both
+	// generators draw different random numbers, so the vertex count is given to compare them
+	typedef struct
+	{
+		unsigned int trees;
+		// Original recursive generator (Engine::RecursiveFractalTree)
+		double recursiveTreesPerSecond;
+		size_t recursivePeakBytes;
+		size_t recursiveVertices;
+		// Engine::FractalTree, built on the calling thread
+		double serialTreesPerSecond;
+		// Engine::FractalTree, every tree built at once on the thread pool
+		double parallelTreesPerSecond;
+		size_t peakBytes;
+		size_t vertices;
+	} TreeGenerationBenchmark;
+
+	// Discrete level of detail chain of a generated tree
+	typedef struct
+	{
+		// From the full detail tree to the coarsest one (see VegetationTable::getLODGenerationData())
+		std::vector<Mesh *> meshes;
+	} TreeLODChain;
+
 	/*
 	 * Class in charge to give access and manage the different procedural vegetation
 	 * engines available in the table
@@ -20,11 +48,31 @@ namespace Engine
 		static VegetationTable * INSTANCE;
 	public:
 		static VegetationTable & getInstance();
+	private:
+		// Configuration of every generated tree
+		std::vector<TreeGenerationData> generatedTrees;
 	private:
 		VegetationTable();
 
 	public:
 		// Generates a tree mesh using a fractal algorithm
 		Mesh * generateFractalTree(const TreeGenerationData & data, bool addToMeshTable =  true);
+		// Generates several trees at once, building all of them concurrently on the thread pool
+		void generateFractalTrees(const std::vector<TreeGenerationData> & data, std::vector<Mesh *> & result, bool addToMeshTable = true);
+
+		// Generates a tree along with numLODs - 1 reduced detail versions of it
+		TreeLODChain generateFractalTree(const TreeGenerationData & data, unsigned int numLODs, bool addToMeshTable = true);
+		// Generates several trees and their level of detail chains at once. When an atlas is given, the
+		// full detail trees are baked into it as billboard impostors (atlas row i holds data[i])
+		void generateFractalTreeLODs(const std::vector<TreeGenerationData> & data, unsigned int numLODs, std::vector<TreeLODChain> & result, TreeImpostorAtlas * atlas = NULL, bool addToMeshTable = true);
+		// Configuration of a level of detail of a tree. Each level drops the last depth level, the
+		// chunk random numbers do not depend on the depth so the result is a subset of the full tree
+		static TreeGenerationData getLODGenerationData(const TreeGenerationData & data, unsigned int lod);
+
+		// Regenerates the trees generated so far the given amount of times with each generator
+		TreeGenerationBenchmark benchmarkTreeGeneration(unsigned int iterations);
+	private:
+		// Builds all the trees concurrently on the thread pool
+		void buildFractalTrees(const std::vector<TreeGenerationData> & data, std::vector<Mesh *> & result);
 	};
 }
\ No newline at end of file
@@ -13,7 +13,7 @@ namespace Engine
 	typedef struct SpotLightData
 	{
 		float position[4];	// light position
-		float direction[4]; // 0 - 2: direction, 3: aperture
+		float direction[4]; // 0 - 2: direction, 3: aperture (half angle, radians)
 		float color[4];		// light color
 		float attenuation[4];	// attenuation coeficents (0=constant,1=lineal,2=cuadratic)
 		float kFactors[4];  // 0 - 2: Ka, Kd, Ks
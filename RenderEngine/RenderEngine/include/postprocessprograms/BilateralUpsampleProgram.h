@@ -0,0 +1,40 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include "PostProcessProgram.h"
+
+namespace Engine
+{
+	/**
+	 * Class in charge to manage the depth aware upsample which follows the post processes
+	 * rendered below full resolution. Inputs: the low resolution output of the post process
+	 * and its full resolution input
+	 */
+	class BilateralUpsampleProgram : public PostProcessProgram
+	{
+	public:
+		// Program unique name
+		static const std::string PROGRAM_NAME;
+	private:
+		// Depth texture id and inverse projection matrix id (to reconstruct the camera space position)
+		unsigned int uDepthBuffer;
+		unsigned int uInvProj;
+	public:
+		BilateralUpsampleProgram(std::string name, unsigned long long params);
+		BilateralUpsampleProgram(const BilateralUpsampleProgram & other);
+
+		void configureProgram();
+		void onRenderObject(const Object * obj, Camera * camera);
+	};
+
+	// =======================================================================
+	// Creates new bilateral upsample programs
+	class BilateralUpsampleProgramFactory : public ProgramFactory
+	{
+	protected:
+		Program * createProgram(unsigned long long params);
+	};
+}
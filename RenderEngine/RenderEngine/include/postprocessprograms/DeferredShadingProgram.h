@@ -22,12 +22,16 @@ namespace Engine
 	private:
 		// Directinal light data buffer
 		unsigned int uDLBuffer;
-		// Point lights data buffer
-		unsigned int uPLBuffer;
-		// Spot lights data buffer
-		unsigned int uSLBuffer;
+		// Log depth to cluster slice mapping (point and spot lights are read from the
+		// ClusteredLightBuffer storage buffers)
+		unsigned int uClusterScale;
+		unsigned int uClusterBias;
+		// The point and spot lights are stored in world space
+		unsigned int uViewMatrix;
 		// Light attenuation factor based on sun's position
 		unsigned int uColorFactor;
+		// Inverse projection matrix (to reconstruct the position from the depth)
+		unsigned int uInvProj;
 
 		// Zenit and horizon color (used for atmospheric fog)
 		unsigned int uSkyZenitColor;
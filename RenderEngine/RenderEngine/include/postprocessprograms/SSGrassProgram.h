@@ -22,8 +22,9 @@ namespace Engine
 		unsigned int uScreenSize;
 		// Grass info texture id
 		unsigned int uGrassInfoBuffer;
-		// Fragment camera space position texture id
-		unsigned int uPosBuffer;
+		// Depth texture id and inverse projection matrix id (to reconstruct the camera space position)
+		unsigned int uDepthBuffer;
+		unsigned int uInvProj;
 	public:
 		SSGrassProgram(std::string name, unsigned long long params);
 		SSGrassProgram(const SSGrassProgram & other);
@@ -20,14 +20,14 @@ namespace Engine
 	private:
 		// Projection matrix id
 		unsigned int uProjMat;
-		// Position texture buffer id
-		unsigned int uPosBuffer;
+		// Inverse projection matrix id (the position is reconstructed from the depth)
+		unsigned int uInvProj;
 		// Normal texture buffer id
 		unsigned int uNormalBuffer;
 		// Depth texture buffer id
 		unsigned int uDepthBuffer;
-		// Reflection texture buffer id
-		unsigned int uSpecularBuffer;
+		// Material texture buffer id (holds the specular intensity)
+		unsigned int uMaterialBuffer;
 		// Light direction
 		unsigned int uLightDir;
 	public:
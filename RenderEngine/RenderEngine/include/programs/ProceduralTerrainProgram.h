@@ -25,6 +25,9 @@ namespace Engine
 		static const unsigned long long POINT_DRAW_MODE;
 		// Render shadow map depth mode
 		static const unsigned long long SHADOW_MAP;
+		// Draw a batch of tiles with a single multi draw indirect, grid positions
+		// are read from a storage buffer (see TileDrawBatch)
+		static const unsigned long long MULTI_DRAW;
 	protected:
 		// Tessellation control shader path
 		std::string tcsShaderFile;
@@ -48,47 +51,17 @@ namespace Engine
 		// Normal (transpose(inverse(modelView)) matrix id
 		unsigned int uNormal;
 
-		// Cascade Shadow map level 0 projection matrix id
+		// Light depth projection matrix id (shadow map pass)
 		unsigned int uLightDepthMatrix;
-		// Cascade shadow map level 1 projection matrix id
-		unsigned int uLightDepthMatrix1;
-		// Cascade shadow map level 0 depth texture
-		unsigned int uDepthTexture;
-		// Cascade shadow map level 1 depth texture
-		unsigned int uDepthTexture1;
-		// Light direction id
-		unsigned int uLightDirection;
-
-		// Normalized water height (0 - 1) id
-		unsigned int uWaterLevel;
-		// World tile scale
-		unsigned int uWorldScale;
-		// Terrain render radius
-		unsigned int uRenderRadius;
-
-		// Time passed id
-		unsigned int uTime;
+		// Cascade shadow maps array texture
+		unsigned int uShadowMaps;
+		// Tessellation limit of the cascade being rendered id (shadow map pass)
+		unsigned int uMaxTessLevel;
+		// Lower tessellation limit id (shadow map pass)
+		unsigned int uMinTessLevel;
 
 		// World grid position id
 		unsigned int uGridPos;
-
-		// Perlin amplitude id
-		unsigned int uAmplitude;
-		// Perlin frequency id
-		unsigned int uFrecuency;
-		// Perlin scale id
-		unsigned int uScale;
-		// Perlin octaves id
-		unsigned int uOctaves;
-
-		// Grass coverage cut id (grass probability is the dot product of world up and surface normal)
-		unsigned int uGrassCoverage;
-		// Grass color id
-		unsigned int uGrassColor;
-		// Sand color id
-		unsigned int uSandColor;
-		// Rock color id
-		unsigned int uRockColor;
 	public:
 		ProceduralTerrainProgram(std::string name, unsigned long long params);
 		ProceduralTerrainProgram(const ProceduralTerrainProgram & other);
@@ -98,7 +71,8 @@ namespace Engine
 		virtual void configureProgram();
 		void configureMeshBuffers(Mesh * mesh);
 
-		// Apply all uniforms which are constants to all object instances using this shader
+		// Binds the shadow maps, or sets the tessellation limit of the cascade being rendered on the shadow
+		// map pass. The rest of the per frame values come from the FrameGlobals uniform block
 		void applyGlobalUniforms();
 		void onRenderObject(const Object * obj, Camera * camera);
 
@@ -106,10 +80,8 @@ namespace Engine
 
 		// Set current world grid position
 		void setUniformGridPosition(unsigned int i, unsigned int j);
-		// Sets cascade shadow maps level 0 light depth matrix
+		// Sets the light depth matrix of the cascade being rendered (shadow map pass)
 		void setUniformLightDepthMatrix(const glm::mat4 & ldm);
-		// Sets cascade shadow maps level 1 light depth matrix
-		void setUniformLightDepthMatrix1(const glm::mat4 & ldm);
 	};
 
 	// ===================================================================================
@@ -25,6 +25,9 @@ namespace Engine
 		static const unsigned long long POINT_DRAW_MODE;
 		// Render shadow map depth mode (unused, discared to render water shadows)
 		static const unsigned long long SHADOW_MAP;
+		// Draw a batch of tiles with a single multi draw indirect, grid positions
+		// are read from a storage buffer (see TileDrawBatch)
+		static const unsigned long long MULTI_DRAW;
 	private:
 		// Geometry shader file (we need geomtry shader to draw as wireframe, even though its just 2 triangles)
 		std::string gShaderFile;
@@ -51,25 +54,13 @@ namespace Engine
 
 		// Shadow render has been disabled for water
 		// Data is kept though
-		// Cascade shadow maps level 0 light depth matrix
+		// Light depth projection matrix (shadow map pass)
 		unsigned int uLightDepthMatrix;
-		// Cascade shadow maps level 1 light depth matrix
-		unsigned int uLightDepthMatrix1;
-		// Cascade shadow maps level 0 depth texture
-		unsigned int uDepthTexture;
-		// Cascade shadow maps level 1 depth texture
-		unsigned int uDepthTexture1;
-		// Light direction id
-		unsigned int uLightDirection;
+		// Cascade shadow maps array texture
+		unsigned int uShadowMaps;
 
 		// World grid position id
 		unsigned int uGridPos;
-		// Time passed id
-		unsigned int uTime;
-		// Water color id
-		unsigned int uWaterColor;
-		// Water movement speed id
-		unsigned int uWaterSpeed;
 	public:
 		ProceduralWaterProgram(std::string name, unsigned long long parameters);
 		ProceduralWaterProgram(const ProceduralWaterProgram & other);
@@ -78,7 +69,8 @@ namespace Engine
 		void configureProgram();
 		void configureMeshBuffers(Mesh * mesh);
 
-		// Apply uniform data which is common to all instances using this shader
+		// Binds the shadow maps and the G-Buffer info texture. Water settings, time and light
+		// direction come from the FrameGlobals uniform block
 		void applyGlobalUniforms();
 		void onRenderObject(const Object * obj, Camera * camera);
 
@@ -86,10 +78,8 @@ namespace Engine
 		
 		// Sets the world grid position
 		void setUniformGridPosition(unsigned int i, unsigned int j);
-		// Sets the cascade shadow map level 0 light projection matrix
+		// Sets the light projection matrix of the cascade being rendered (shadow map pass)
 		void setUniformLightDepthMatrix(const glm::mat4 & ldm);
-		// Sets the cascade shadow map level 1 light projection matrix
-		void setUniformLightDepthMatrix1(const glm::mat4 & ldm);
 	};
 
 	// =========================================================
@@ -0,0 +1,97 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include "Program.h"
+#include "vegetation/TreeImpostorAtlas.h"
+
+namespace Engine
+{
+	/**
+	 * Class in charge to manage the tree impostor program. Draws one point per tree (read from
+	 * the vegetation instance buffer), expanded into a billboard facing the viewer which
+	 * samples the closest baked view from a TreeImpostorAtlas
+	 */
+	class TreeImpostorProgram : public Program
+	{
+	public:
+		// Unique program name
+		static const std::string PROGRAM_NAME;
+
+		// UBER Shader parameters
+		// Render shadow map depth
+		const static unsigned long long SHADOW_MAP;
+		// Render as wireframe mode
+		const static unsigned long long WIRE_MODE;
+		// Render as point mode
+		const static unsigned long long POINT_MODE;
+	private:
+		// Geometry shader file path
+		std::string gShaderFile;
+
+		// Geometry shader id
+		unsigned int gShader;
+
+		// View projection matrix id
+		unsigned int uModelViewProj;
+		// View matrix id
+		unsigned int uModelView;
+		// Normal matrix id
+		unsigned int uNormal;
+		// World space eye position id
+		unsigned int uEyePos;
+		// Light depth matrix (shadow map pass)
+		unsigned int uLightDepthMat0;
+		// Cascade shadow maps array texture
+		unsigned int uShadowMaps;
+
+		// Impostor atlas color and normal textures
+		unsigned int uColorAtlas;
+		unsigned int uNormalAtlas;
+		// Atlas frames (views, trees)
+		unsigned int uAtlasSize;
+		// Billboard extents of the tree being drawn
+		unsigned int uImpostorExtents;
+		// Atlas row of the tree being drawn
+		unsigned int uImpostorRow;
+
+		// Instance data attribute id (world x, world z, tile u, tile v)
+		unsigned int uInInstance;
+	public:
+		TreeImpostorProgram(std::string name, unsigned long long params);
+		TreeImpostorProgram(const TreeImpostorProgram & other);
+
+		void initialize();
+
+		void configureProgram();
+		// Impostors do not use meshes (see configureInstanceBuffer())
+		void configureMeshBuffers(Mesh * mesh);
+		// Binds the instance buffer, one point per instance, to the given vertex array
+		void configureInstanceBuffer(unsigned int vertexArray, unsigned int instanceBuffer);
+
+		// Binds the shadow maps. Terrain data used to place the billboards comes from the
+		// FrameGlobals uniform block, like on TreeProgram
+		void applyGlobalUniforms();
+		void onRenderObject(const Object * obj, Camera * camera);
+
+		// Sets the light projection matrix of the cascade being rendered (shadow map pass)
+		void setUniformLightDepthMat(const glm::mat4 & ldp);
+		// Binds the atlas textures
+		void setUniformAtlas(const TreeImpostorAtlas & atlas);
+		// Selects the tree of the atlas to draw
+		void setUniformImpostor(const TreeImpostorAtlas & atlas, unsigned int tree);
+
+		void destroy();
+	};
+
+	// ===============================================================
+	// Create new tree impostor programs
+	class TreeImpostorProgramFactory : public ProgramFactory
+	{
+	protected:
+		Program * createProgram(unsigned long long params);
+	};
+}
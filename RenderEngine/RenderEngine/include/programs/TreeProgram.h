@@ -25,6 +25,10 @@ namespace Engine
 		const static unsigned long long WIRE_MODE;
 		// Render as point mode
 		const static unsigned long long POINT_MODE;
+		// Read the tree position and tile uv from a per instance attribute
+		const static unsigned long long INSTANCED;
+		// Render the tree on its local space, writing color and local normal (impostor baking)
+		const static unsigned long long IMPOSTOR_BAKE;
 	private:
 		// Geometry shader file path
 		std::string gShaderFile;
@@ -38,43 +42,13 @@ namespace Engine
 		unsigned int uModelView;
 		// Normal matrix id
 		unsigned int uNormal;
-		// Cascade shadow map level 0 light depth matrix
+		// Light depth matrix (shadow map pass)
 		unsigned int uLightDepthMat0;
-		// Cascade shadow map level 1 light depth matrix
-		unsigned int uLightDepthMat1;
-		// Cascade shadow map level 0 depth texture
-		unsigned int uDepthMap0;
-		// Cascade shadow map level 1 depth texture
-		unsigned int uDepthMap1;
+		// Cascade shadow maps array texture
+		unsigned int uShadowMaps;
 		// Normalized 2D position within the current World grid cell id
 		unsigned int uGridUV;
 
-		// Terrain data, used to emulate terrain to compute the vegetation height 
-		// and accept/drop tree depending on its position
-		// (discarded: on water or over the max vegetaion height)
-		// Perlin amplitude id
-		unsigned int uAmplitude;
-		// Perlin frequency id
-		unsigned int uFrecuency;
-		// Perlin scale id
-		unsigned int uScale;
-		// Perlin octaves id
-		unsigned int uOctaves;
-		// Light direction id
-		unsigned int uLightDir;
-		// Normalized water height id
-		unsigned int uWaterLevel;
-		// Normalized max vegetation spawn height id
-		unsigned int uMaxHeight;
-		// World tile scale
-		unsigned int uWorldScale;
-		// Sin of elapsed time since beggining
-		unsigned int uSinTime;
-		// Wind direction vector
-		unsigned int uWindDir;
-		// Wind strength
-		unsigned int uWindStrength;
-
 		// Vetex position attribute id
 		unsigned int uInPos;
 		// Vertex color attribute id
@@ -85,6 +59,8 @@ namespace Engine
 		unsigned int uInEmissive;
 		// Vertex texture coordinates attribute id
 		unsigned int uInUV;
+		// Instance data attribute id (world x, world z, tile u, tile v)
+		unsigned int uInInstance;
 	public:
 		TreeProgram(std::string name, unsigned long long params);
 		TreeProgram(const TreeProgram & other);
@@ -93,17 +69,23 @@ namespace Engine
 
 		void configureProgram();
 		void configureMeshBuffers(Mesh * mesh);
+		// Attaches the instance buffer to the mesh vertex array (only on INSTANCED programs)
+		void configureInstanceBuffer(const Mesh * mesh, unsigned int instanceBuffer);
+		// Points the instance attribute of the bound vertex array to the given first instance
+		void setInstanceBufferOffset(unsigned int instanceBuffer, size_t firstInstance);
 
-		// Apply all uniform data which is constant across all instances using this program
+		// Binds the shadow maps. Terrain data used to place the trees (and wind, light direction...)
+		// comes from the FrameGlobals uniform block
 		void applyGlobalUniforms();
 		void onRenderObject(const Object * obj, Camera * camera);
 
 		// Sets the normalized position within the current world grid cell
 		void setUniformTileUV(float u, float v);
-		// Sets the cascade shadow map level 0 light projection matrix
+		// Sets the light projection matrix of the cascade being rendered (shadow map pass)
 		void setUniformLightDepthMat(const glm::mat4 & ldp);
-		// Sets the cascade shadow map level 1 light projection matrix
-		void setUniformLightDepthMat1(const glm::mat4 & ldp);
+		// Sets the view and projection used to bake impostors (IMPOSTOR_BAKE programs only,
+		// replaces onRenderObject)
+		void setUniformBakeMatrices(const glm::mat4 & view, const glm::mat4 & proj);
 
 		void destroy();
 	};
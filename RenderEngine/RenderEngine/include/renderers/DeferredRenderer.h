@@ -8,8 +8,11 @@
 #include "Renderer.h"
 #include "Object.h"
 #include "DeferredNodeCallbacks.h"
+#include "RenderGraph.h"
+#include "WorldConfig.h"
 
 #include "postprocessprograms/DeferredShadingProgram.h"
+#include "computeprograms/FusedPostProcessProgram.h"
 
 namespace Engine
 {
@@ -22,8 +25,14 @@ namespace Engine
 		Program *postProcessProgram;
 		// Mesh to render (typcipally a screen quad)
 		PostProcessObject * obj;
-		// Render target
-		DeferredRenderObject * renderBuffer;
+		// Render targets written by the pass (allocated by the render graph)
+		std::vector<RenderTargetDesc> outputs;
+		// Resolution relative to the screen for each quality preset (see Settings::postProcessQuality).
+		// Below 1, the output is brought back to full resolution with a bilateral upsample
+		float resolutionScale[POSTPROCESS_QUALITY_COUNT];
+		// Render graph passes of the node and of its upsample (filled by the renderer)
+		unsigned int pass;
+		unsigned int upsamplePass;
 		// Optional initialization & execution code callback
 		DeferredCallback * callBack;
 	} typedef PostProcessChainNode;
@@ -58,6 +67,21 @@ namespace Engine
 
 		// List of image space post processes
 		std::list<PostProcessChainNode *> postProcessChain;
+		// Post process chain as passes of a render graph, which culls the disabled ones
+		// and aliases their render targets
+		RenderGraph renderGraph;
+		// Last resource of the chain, and the input of the tone mapping pass
+		unsigned int chainOutput;
+		unsigned int toneMappingInput;
+		unsigned int toneMappingPass;
+		unsigned int depthOfFieldPass;
+
+		// Fused tone mapping + depth of field + screen output (see Settings::fusedPostProcess).
+		// Only available if the chain ends with tone mapping followed by depth of field
+		FusedPostProcessProgram * fusedOutput;
+		// Output of the fused dispatch, blitted to screen. Created on first use
+		DeferredRenderObject * fusedBuffer;
+		TextureInstance * fusedTexture;
 
 		// Renderer initialization flag (prevents multiple initialization)
 		bool initialized;
@@ -65,14 +89,14 @@ namespace Engine
 		// Function pointer that points to the current render code
 		void (DeferredRenderer::*renderFunc)();
 
-		// G-Buffer textures
-		TextureInstance * gBufferPos;
+		// G-Buffer textures. The camera space position is reconstructed from the depth,
+		// the normal is octahedral encoded, and the material packs the grass flag, the shadow
+		// visibility, the terrain alpha below water and the specular intensity
 		TextureInstance * gBufferNormal;
 		TextureInstance * gBufferEmissive;
-		TextureInstance * gBufferSpecular;
 		TextureInstance * gBufferColor;
 		TextureInstance * gBufferDepth;
-		TextureInstance * gBufferInfo;
+		TextureInstance * gBufferMaterial;
 	public:
 		DeferredRenderer();
 		~DeferredRenderer();
@@ -82,14 +106,18 @@ namespace Engine
 		void initialize();
 		void doRender();
 		void onResize(unsigned int w, unsigned int h);
+
+		RenderGraph & getRenderGraph();
+		const std::list<PostProcessChainNode *> & getPostProcessChain();
+		bool isFusedPostProcessAvailable();
 		
-		const TextureInstance * getGBufferPos();
 		const TextureInstance * getGBufferNormal();
 		const TextureInstance * getGBufferEmissive();
-		const TextureInstance * getGBufferSpecular();
 		const TextureInstance * getGBufferColor();
 		const TextureInstance * getGBufferDepth();
-		const TextureInstance * getGBufferInfo();
+		const TextureInstance * getGBufferMaterial();
+		// GPU memory of the G-Buffers, in bytes
+		size_t getGBufferMemory();
 	private:
 		// Render function executed once at the beggining of the execution
 		// used to execute baking passes on the GPU
@@ -97,5 +125,7 @@ namespace Engine
 		// Actual render loop function
 		void renderLoop();
 		void runPostProcesses();
+		void renderScreenOutput();
+		void renderFusedOutput();
 	};
 }
\ No newline at end of file
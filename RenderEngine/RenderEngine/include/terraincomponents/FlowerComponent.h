@@ -7,6 +7,7 @@
 #include "TerrainComponent.h"
 
 #include "programs/TreeProgram.h"
+#include "terraincomponents/VegetationInstances.h"
 
 namespace Engine
 {
@@ -27,22 +28,45 @@ namespace Engine
 		// Active render shader
 		TreeProgram * activeShader;
 
+		// Instanced versions of the programs above
+		TreeProgram * instancedFillShader;
+		TreeProgram * instancedWireShader;
+		TreeProgram * instancedPointShader;
+		TreeProgram * activeInstancedShader;
+
 		// Flower instance
 		Object * flower;
+		// Local bounds of the flower mesh
+		glm::vec3 flowerMin;
+		glm::vec3 flowerMax;
+
+		// Flowers gathered during the current pass, drawn on postRenderComponent
+		VegetationInstances instances;
+		Camera * instanceCamera;
 		// Number of flowers per terrain tile
 		size_t flowersToSpawn;
+		// Id of the scattered flower pattern on the terrain tile cache
+		unsigned int vegetationPatternId;
+		// Flower positions of the tile being rendered
+		std::vector<glm::vec2> tilePositions;
 	public:
 		FlowerComponent();
 
 		unsigned int getRenderRadius();
+		const char * getName();
 
 		void initialize();
 		void preRenderComponent();
 		void renderComponent(int i, int j, Engine::Camera * camera);
+		void postRenderComponent();
 		void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam);
 		void notifyRenderModeChange(Engine::RenderMode mode);
+		bool getTileBounds(int i, int j, glm::vec3 & min, glm::vec3 & max);
 
 		Program * getActiveShader();
 		Program * getShadowMapShader();
+	private:
+		// Draws the gathered flowers with a single instanced draw call
+		void renderInstances();
 	};
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "TerrainComponent.h"
 
 #include "programs/ProceduralTerrainProgram.h"
+#include "terraincomponents/TileDrawBatch.h"
 
 namespace Engine
 {
@@ -29,20 +30,41 @@ namespace Engine
 		// Active program (shading or wire)
 		ProceduralTerrainProgram * activeShader;
 
+		// Multi draw indirect variants of the programs above
+		ProceduralTerrainProgram * batchedFillShader;
+		ProceduralTerrainProgram * batchedWireShader;
+		ProceduralTerrainProgram * batchedPointShader;
+		ProceduralTerrainProgram * batchedShadowShader;
+		ProceduralTerrainProgram * activeBatchedShader;
+
 		// Tile instance
 		Object * landscapeTile;
+		// Identity transform object, the batched shaders apply the tile transform themselves
+		Object * batchOrigin;
+
+		// Visible tiles of the current pass, when batched
+		TileDrawBatch tileBatch;
+		Camera * batchCamera;
+		bool batchShadow;
+		glm::mat4 batchShadowProjection;
 	public:
 		LandscapeComponent();
 
 		unsigned int getRenderRadius();
+		const char * getName();
 
 		void initialize();
 		void preRenderComponent();
 		void renderComponent(int i, int j, Engine::Camera * camera);
 		void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam);
+		void postRenderComponent();
 		void notifyRenderModeChange(Engine::RenderMode mode);
+		bool hasStaticShadow() { return true; }
 
 		Program * getActiveShader();
 		Program * getShadowMapShader();
+	private:
+		bool isBatched();
+		void renderBatch();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+/**
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Engine
+{
+	// Command layout read by glMultiDrawElementsIndirect
+	typedef struct
+	{
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		unsigned int baseInstance;
+	} DrawElementsIndirectCommand;
+
+	/**
+	 * Batches the visible tiles of a terrain component so a whole pass is issued with
+	 * a single glMultiDrawElementsIndirect. Each tile gets an indirect command whose base
+	 * instance is the index of its grid position on a shader storage buffer. Both buffers
+	 * are persistently mapped and split in segments (one per pass), guarded by fences so
+	 * we never overwrite data the GPU may still be reading
+	 */
+	class TileDrawBatch
+	{
+	public:
+		// Vertex attribute location of the per tile index (terrain.vert / water.vert)
+		static const unsigned int TILE_INDEX_LOCATION;
+		// Shader storage binding point of the tile grid positions
+		static const unsigned int GRID_POSITIONS_BINDING;
+		// Number of passes that may be in flight at the same time
+		static const unsigned int NUM_SEGMENTS;
+	private:
+		unsigned int commandBuffer;
+		unsigned int gridBuffer;
+		unsigned int tileIndexBuffer;
+
+		DrawElementsIndirectCommand * commands;
+		glm::ivec2 * gridPositions;
+		std::vector<GLsync> fences;
+
+		size_t maxTiles;
+		unsigned int indexCount;
+		unsigned int indexType;
+
+		unsigned int segment;
+		size_t tileCount;
+	public:
+		TileDrawBatch();
+
+		// Wether the context exposes buffer storage, multi draw indirect and storage buffers
+		static bool isSupported();
+
+		// Allocates room for maxTiles tiles per pass, each drawn with indexCount indices of the given type
+		void init(size_t maxTiles, unsigned int indexCount, unsigned int indexType);
+		bool isInitialized() { return commandBuffer != 0; }
+
+		// Starts a new pass, waiting for the GPU to release the segment if needed
+		void begin();
+		// Grows the buffers if the pass does not fit in a segment
+		void add(int i, int j);
+		size_t getTileCount() { return tileCount; }
+		size_t getMaxTiles() { return maxTiles; }
+
+		// Issues all the tiles added since begin() with the mesh vertex array bound
+		void draw(GLenum mode);
+
+		void destroy();
+	private:
+		// Reallocates the buffers with room for newMaxTiles tiles per pass, keeping the tiles of the current pass
+		void grow(size_t newMaxTiles);
+	};
+}
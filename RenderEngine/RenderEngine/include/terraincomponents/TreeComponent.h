@@ -7,7 +7,12 @@
 #include "TerrainComponent.h"
 
 #include "programs/TreeProgram.h"
+#include "programs/TreeImpostorProgram.h"
+#include "terraincomponents/VegetationInstances.h"
+#include "vegetation/TreeImpostorAtlas.h"
+#include "RenderStatistics.h"
 
+#include <unordered_map>
 #include <vector>
 
 namespace Engine
@@ -15,9 +20,29 @@ namespace Engine
 	/**
 	 * Terrain component in charge of rendering trees across the terrain
 	 * Cast shadows
+	 * Each tile picks a level of detail by its distance to the camera: the full tree, reduced
+	 * depth versions of it, and billboard impostors (only when drawing instanced)
 	 */
 	class TreeComponent : public TerrainComponent
 	{
+	public:
+		// Levels of detail, the last one being the impostors
+		static const unsigned int NUM_LODS = RenderStatistics::TREE_LODS;
+		static const unsigned int MESH_LODS = NUM_LODS - 1;
+		static const unsigned int IMPOSTOR_LOD = MESH_LODS;
+		// Distance (in tiles, from the camera to the tile center) at which each mesh level ends
+		static const float LOD_DISTANCES[MESH_LODS];
+		// Extra distance (in tiles) a tile has to move past a level range to switch level
+		static const float LOD_HYSTERESIS;
+		// Levels the shadow passes are moved down
+		static const unsigned int SHADOW_LOD_BIAS;
+	private:
+		// Level of detail picked for a tile and the frame it was last picked on
+		typedef struct
+		{
+			unsigned int lod;
+			unsigned int frame;
+		} TileLOD;
 	private:
 		// Shading program
 		TreeProgram * fillShader;
@@ -31,28 +56,88 @@ namespace Engine
 		// Active shader (shading or wireframe)
 		TreeProgram * activeShader;
 
-		// List of type of trees
-		std::vector<Object *> treeTypes;
+		// Instanced versions of the programs above
+		TreeProgram * instancedFillShader;
+		TreeProgram * instancedWireShader;
+		TreeProgram * instancedPointShader;
+		TreeProgram * instancedShadowShader;
+		TreeProgram * activeInstancedShader;
+
+		// Impostor programs
+		TreeImpostorProgram * impostorFillShader;
+		TreeImpostorProgram * impostorWireShader;
+		TreeImpostorProgram * impostorPointShader;
+		TreeImpostorProgram * impostorShadowShader;
+		TreeImpostorProgram * activeImpostorShader;
+
+		// List of type of trees, for each mesh level of detail
+		std::vector<Object *> treeTypes[MESH_LODS];
+		// Billboards of every tree type (row t holds treeTypes[0][t])
+		TreeImpostorAtlas impostorAtlas;
 		// Number of trees to spawn per terrain tile
 		size_t treesToSpawn;
 		// Equal amount of each tree type to spawn
 		size_t equalAmountOfTrees;
 		// shuffled jitter pattern to ensure trees are spread
 		glm::vec2 * jitterPattern;
+		// Tree type spawned at each jitter pattern position (-1 if none)
+		std::vector<int> jitterTreeType;
+		size_t jitterPatternSize;
+		// Id of the jitter pattern on the terrain tile cache
+		unsigned int vegetationPatternId;
+		// Local bounds enclosing every tree type
+		glm::vec3 treeMin;
+		glm::vec3 treeMax;
+
+		// Instances gathered during the current pass, drawn on postRenderComponent. The meshes
+		// are grouped by level of detail and type (lod * types + type), the impostors by type
+		VegetationInstances instances;
+		VegetationInstances impostorInstances;
+		// Vertex array reading the impostor instances as points
+		unsigned int impostorVertexArray;
+		// Whether the instances belong to a shadow pass, and its projection
+		bool shadowInstances;
+		glm::mat4 shadowProjection;
+		Camera * instanceCamera;
+
+		// Level of detail of the tiles drawn on the last frames, to apply the hysteresis
+		std::unordered_map<unsigned long long, TileLOD> tileLODs;
+		// Main passes rendered so far
+		unsigned int lodFrame;
+		// Whether the current pass is a main pass
+		bool lodPass;
 	public:
 		TreeComponent();
 
 		unsigned int getRenderRadius();
+		const char * getName();
 
 		void initialize();
+		void preRenderComponent();
 		void renderComponent(int i, int j, Engine::Camera * camera);
+		void postRenderComponent();
 		void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam);
 		void notifyRenderModeChange(Engine::RenderMode mode);
+		bool getTileBounds(int i, int j, glm::vec3 & min, glm::vec3 & max);
 
 		Program * getActiveShader();
 		Program * getShadowMapShader();
 	private:
 		// Run the fractal tree generator to build a fixed number of different procedural trees
 		void initTrees();
+
+		// Level of detail of the tile (i, j). The main pass updates the level kept for the hysteresis,
+		// the shadow passes reuse it
+		unsigned int selectTileLOD(int i, int j, Engine::Camera * cam, bool mainPass);
+		// Level of detail of the tile (i, j) on the cascade being rendered
+		unsigned int selectShadowLOD(int i, int j, Engine::Camera * cam);
+		// Forgets the tiles not drawn on the last frames
+		void pruneTileLODs();
+
+		// Adds the trees of the tile (i, j) to the instance lists
+		void addTileInstances(int i, int j, unsigned int lod);
+		void addInstance(int i, int j, unsigned int jitterIndex, unsigned int lod);
+		// Draws the gathered instances, one instanced draw call per tree type and level of detail
+		void renderInstances();
 	};
 }
\ No newline at end of file
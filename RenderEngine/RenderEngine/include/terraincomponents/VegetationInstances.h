@@ -0,0 +1,52 @@
+/**
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Engine
+{
+	/**
+	 * Per frame instance data of the vegetation components, grouped by vegetation type.
+	 * Each instance is packed as (world x, world z, tile u, tile v), and uploaded sorted
+	 * by type so every type can be drawn with a single instanced draw call
+	 */
+	class VegetationInstances
+	{
+	private:
+		std::vector<std::vector<glm::vec4>> instances;
+		std::vector<glm::vec4> packed;
+		std::vector<size_t> typeOffsets;
+
+		unsigned int buffer;
+		size_t bufferCapacity;
+	public:
+		VegetationInstances();
+
+		void init(size_t numTypes);
+
+		unsigned int getBuffer() { return buffer; }
+		size_t getNumTypes() { return instances.size(); }
+
+		void clear();
+		void add(size_t type, float x, float z, float u, float v)
+		{
+			instances[type].push_back(glm::vec4(x, z, u, v));
+		}
+
+		// Packs all the instances sorted by type and uploads them to the GPU
+		void upload();
+
+		// Instance counts, valid after upload()
+		size_t getInstanceCount() { return packed.size(); }
+		size_t getTypeOffset(size_t type) { return typeOffsets[type]; }
+		size_t getTypeCount(size_t type) { return instances[type].size(); }
+
+		void destroy();
+	};
+}
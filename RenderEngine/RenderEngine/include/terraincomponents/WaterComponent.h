@@ -7,6 +7,7 @@
 #include "TerrainComponent.h"
 
 #include "programs/ProceduralWaterProgram.h"
+#include "terraincomponents/TileDrawBatch.h"
 
 namespace Engine
 {
@@ -28,12 +29,25 @@ namespace Engine
 		// Active shader
 		ProceduralWaterProgram * activeShader;
 
+		// Multi draw indirect variants of the programs above
+		ProceduralWaterProgram * batchedFillShader;
+		ProceduralWaterProgram * batchedWireShader;
+		ProceduralWaterProgram * batchedPointShader;
+		ProceduralWaterProgram * activeBatchedShader;
+
 		// Tile instance to render
 		Object * waterTile;
+		// Identity transform object, the batched shaders apply the tile transform themselves
+		Object * batchOrigin;
+
+		// Visible tiles of the current pass, when batched
+		TileDrawBatch tileBatch;
+		Camera * batchCamera;
 	public:
 		WaterComponent();
 
 		unsigned int getRenderRadius();
+		const char * getName();
 
 		void initialize();
 
@@ -42,8 +56,11 @@ namespace Engine
 		void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam);
 		void postRenderComponent();
 		void notifyRenderModeChange(Engine::RenderMode mode);
+		bool getTileBounds(int i, int j, glm::vec3 & min, glm::vec3 & max);
 
 		Program * getActiveShader();
 		Program * getShadowMapShader();
+	private:
+		bool isBatched();
 	};
 }
\ No newline at end of file
@@ -5,6 +5,13 @@
 #pragma once
 
 #include "UserInterface.h"
+#include "datatables/VegetationTable.h"
+#include "volumetricclouds/CloudNoiseBaker.h"
+#include "LightClusterBuilder.h"
+#include "LightStorage.h"
+#include "TerrainHeightField.h"
+#include "TileCuller.h"
+#include "MeshOptimizer.h"
 
 namespace Engine
 {
@@ -15,9 +22,34 @@ namespace Engine
 		 */
 		class WorldControllerUI : public UserInterface
 		{
+		private:
+			// Last tree generation benchmark run from the statistics panel
+			TreeGenerationBenchmark treeBenchmark;
+			// Last cloud noise bake benchmark and validation
+			std::vector<CloudSystem::CloudNoiseBenchmark> cloudNoiseBenchmark;
+			CloudSystem::CloudNoiseValidation cloudNoiseValidation;
+			// Last light cluster build benchmark and validation
+			std::vector<LightClusterBenchmark> lightClusterBenchmark;
+			LightClusterValidation lightClusterValidation;
+			std::vector<GPU::LightUpdateBenchmark> lightUpdateBenchmark;
+			// Last terrain height field validation
+			TerrainHeightValidation heightFieldValidation;
+			// Last terrain tile culling validation
+			TileCullingValidation tileCullingValidation;
+			// Last mesh optimizer validation
+			MeshOptimizerValidation meshOptimizerValidation;
+			// Result of the last Chrome trace export
+			std::string traceStatus;
+			// Last GPU time of tone mapping + depth of field + screen output, as separate passes
+			// and fused (negative until measured)
+			double separatePostMs;
+			double fusedPostMs;
 		public:
 			WorldControllerUI(GLFWwindow * surface);
 			void drawGraphics();
+		private:
+			// Overlay with the rolling averages of the profiled stages
+			void drawProfiler();
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Engine
+{
+	namespace IO
+	{
+		/**
+		 * Read only memory mapping of a whole file
+		 */
+		class MappedFile
+		{
+		private:
+			const unsigned char * data;
+			size_t size;
+#ifdef _WIN32
+			void * fileHandle;
+			void * mappingHandle;
+#else
+			int fileDescriptor;
+#endif
+		public:
+			MappedFile();
+			~MappedFile();
+
+			// Maps the given file. Returns false if it does not exist, is empty or can not be mapped
+			bool open(const std::string & fileName);
+			void close();
+
+			bool isOpen() const { return data != 0; }
+			const unsigned char * getData() const { return data; }
+			size_t getSize() const { return size; }
+		private:
+			// Not copiable, the mapping is owned
+			MappedFile(const MappedFile & other);
+			MappedFile & operator=(const MappedFile & other);
+		};
+	}
+}
@@ -6,53 +6,106 @@
 
 #define GLM_FORCE_RADIANS
 
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 
 #include "ProceduralVegetation.h"
+#include "Threadpool.h"
+
 #include <vector>
-#include <random>
 
 namespace Engine
 {
 	/**
-	 * Procedural vegetation generator using a fractal algorithm
+	 * Procedural vegetation generator using a fractal algorithm.
+	 * Generation runs in two steps: prepare() walks the tree structure, computing the
+	 * exact vertex and face count and allocating the geometry in a single block, and
+	 * buildChunks() writes the geometry of any range of the tree chunks, so it can be
+	 * split among the thread pool. Random numbers are derived from the seed and the
+	 * chunk position within the tree, so the result does not depend on the build order
 	 */
 	class FractalTree : public ProceduralVegetation
 	{
+	public:
+		// Tree chunks built by each thread pool task
+		static const size_t CHUNKS_PER_TASK;
 	private:
-		// Vertices of the final generated tree
-		std::vector<glm::vec3> vertices;
-		// Faces of the final generated tree
-		std::vector<glm::ivec3> faces;
-		// Texture coordinates of the final generated tree
-		std::vector<glm::vec2> uvs;
-		// Per vertex color of the final generated tree
-		std::vector<glm::vec3> colors;
-		// Per vertex "emission" (actually is used to carry extra info) of the final generated tree
-		std::vector<glm::vec3> emission;
-		
+		// Geometry added by one processing step: an optional leaf and an optional branch
+		typedef struct
+		{
+			glm::mat4 leafModel;
+			glm::mat4 branchModel;
+			glm::vec3 leafScale;
+			glm::vec3 branchScale;
+			unsigned int depth;
+			// Vertex after the parent branch (its top ring are the 4 previous vertices)
+			size_t parentOffset;
+			size_t leafVertex;
+			size_t leafFace;
+			size_t branchVertex;
+			size_t branchFace;
+			bool hasLeaf;
+			bool hasBranch;
+		} TreeChunk;
+
+		// Chunks in generation (depth first) order
+		std::vector<TreeChunk> chunks;
+
+		// Single allocation holding the whole generated geometry
+		std::vector<unsigned char> arena;
+		float * vertices;
+		float * colors;
+		float * emission;
+		float * uvs;
+		unsigned int * faces;
+		size_t numVertices;
+		size_t numFaces;
+
 		// Cube base shape to build the tree
 		Mesh * base;
-		Mesh * leaf;
-
-		// Random number generator
-		std::uniform_real_distribution<float> randGen;
-		std::default_random_engine randEngine;
+		// Height of the base shape
+		float baseHeight;
 
 	public:
 		FractalTree(const TreeGenerationData & data);
 		Mesh * generate();
+
+		// Computes the tree structure and allocates its geometry
+		void prepare();
+		// Writes the geometry of chunks [begin, end). Disjoint ranges may be built concurrently
+		void buildChunks(size_t begin, size_t end);
+		// Queues the geometry build on the thread pool. The latch is counted down once per task
+		void buildChunksAsync(Concurrent::CountDownLatch & latch);
+		// Creates the mesh from the built geometry (needs the GL context)
+		Mesh * createMesh() const;
+
+		size_t getNumChunks() const { return chunks.size(); }
+		size_t getNumVertices() const { return numVertices; }
+		size_t getNumFaces() const { return numFaces; }
+		// Bytes used by the generator (geometry arena and chunk list)
+		size_t getMemoryUsage() const;
 	private:
-		// Process a chunk of the tree, adding base shape data according to the growth and stopping at the appropiate depth
-		void processChunk(glm::mat4 mat, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth);
-		// Adds leafs to the final tree data
-		void addLeaf(glm::mat4 mat, glm::vec3 lastScaling, size_t offset, unsigned int depth);
-		// Utility function used to fill the class vectors
-		void appendVerticesAndFaces(Mesh * source, glm::mat4 model, glm::vec3 scale, unsigned int depth, size_t vOffset, bool keepBase, bool isLeaf = false);
-
-		// Returns a random sign (either positive or negative)
-		float randSign();
+		// Process a chunk of the tree, recording the base shapes to add and stopping at the appropiate depth
+		void processChunk(const glm::mat4 & origin, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth, unsigned long long key);
+		// Writes a transformed copy of the base shape at the given vertex and face positions
+		void writeBaseShape(const glm::mat4 & model, glm::vec3 scale, unsigned int depth, size_t vOffset, size_t vertex, size_t face, bool keepBase, bool isLeaf);
+
+		// Random number within [0, 1): number n of the chunk with the given key
+		static float random(unsigned long long key, unsigned int n);
+		// Key of the given child of a chunk
+		static unsigned long long childKey(unsigned long long key, unsigned int child);
 		// Returns a random number within the given interval
-		float randInInterval(float a, float b);
+		static float randInInterval(unsigned long long key, unsigned int n, float a, float b);
+	};
+
+	// Thread pool task which builds a range of a tree chunks
+	class FractalTreeTask : public Concurrent::Runnable
+	{
+	private:
+		FractalTree * tree;
+		size_t begin, end;
+		Concurrent::CountDownLatch * latch;
+	public:
+		FractalTreeTask(FractalTree * tree, size_t begin, size_t end, Concurrent::CountDownLatch * latch);
+		void run();
 	};
-}
\ No newline at end of file
+}
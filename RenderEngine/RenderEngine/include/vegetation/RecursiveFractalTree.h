@@ -0,0 +1,76 @@
+/**
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <glm/glm.hpp>
+
+#include "ProceduralVegetation.h"
+#include <vector>
+#include <random>
+
+namespace Engine
+{
+	// CPU copy of a generated tree, as handed to the Engine::Mesh constructor
+	typedef struct
+	{
+		unsigned int numVertices;
+		unsigned int numFaces;
+		float * vertices;
+		float * colors;
+		float * emission;
+		float * uvs;
+		unsigned int * faces;
+	} RecursiveTreeArrays;
+
+	/**
+	 * Original procedural vegetation generator using a fractal algorithm, which grows
+	 * the tree recursively into std::vectors. Superseded by Engine::FractalTree, kept
+	 * as the baseline of VegetationTable::benchmarkTreeGeneration()
+	 */
+	class RecursiveFractalTree : public ProceduralVegetation
+	{
+	private:
+		// Vertices of the final generated tree
+		std::vector<glm::vec3> vertices;
+		// Faces of the final generated tree
+		std::vector<glm::ivec3> faces;
+		// Texture coordinates of the final generated tree
+		std::vector<glm::vec2> uvs;
+		// Per vertex color of the final generated tree
+		std::vector<glm::vec3> colors;
+		// Per vertex "emission" (actually is used to carry extra info) of the final generated tree
+		std::vector<glm::vec3> emission;
+		
+		// Cube base shape to build the tree
+		Mesh * base;
+		Mesh * leaf;
+
+		// Random number generator
+		std::uniform_real_distribution<float> randGen;
+		std::default_random_engine randEngine;
+
+	public:
+		RecursiveFractalTree(const TreeGenerationData & data);
+		Mesh * generate();
+		// Grows the tree and copies it to the given arrays (to be freed with releaseArrays()).
+		// Returns the peak amount of bytes used during the generation
+		size_t generateArrays(RecursiveTreeArrays & result);
+		static void releaseArrays(RecursiveTreeArrays & arrays);
+	private:
+		// Process a chunk of the tree, adding base shape data according to the growth and stopping at the appropiate depth
+		void processChunk(glm::mat4 mat, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth);
+		// Adds leafs to the final tree data
+		void addLeaf(glm::mat4 mat, glm::vec3 lastScaling, size_t offset, unsigned int depth);
+		// Utility function used to fill the class vectors
+		void appendVerticesAndFaces(Mesh * source, glm::mat4 model, glm::vec3 scale, unsigned int depth, size_t vOffset, bool keepBase, bool isLeaf = false);
+
+		// Returns a random sign (either positive or negative)
+		float randSign();
+		// Returns a random number within the given interval
+		float randInInterval(float a, float b);
+	};
+}
\ No newline at end of file
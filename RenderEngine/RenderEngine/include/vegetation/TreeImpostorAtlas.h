@@ -0,0 +1,51 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include "Mesh.h"
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Engine
+{
+	/**
+	 * Billboard impostors of a set of trees. Each tree is rendered from numViews directions
+	 * around its vertical axis into a row of the atlas (one frame per view). The color atlas
+	 * holds the tree color and coverage (alpha), the normal atlas the local space normal
+	 * (encoded to [0, 1]) and wether the texel is emissive (alpha)
+	 */
+	class TreeImpostorAtlas
+	{
+	public:
+		static const unsigned int DEFAULT_VIEWS;
+		static const unsigned int DEFAULT_FRAME_SIZE;
+	private:
+		unsigned int numViews;
+		unsigned int frameSize;
+
+		unsigned int colorTexture;
+		unsigned int normalTexture;
+
+		// Per tree billboard extents: (radius around the trunk axis, min height, max height)
+		std::vector<glm::vec3> extents;
+	public:
+		TreeImpostorAtlas(unsigned int numViews = DEFAULT_VIEWS, unsigned int frameSize = DEFAULT_FRAME_SIZE);
+
+		// Renders every tree into the atlas (one row per tree, in the given order). Requires
+		// the TreeProgram to be registered on the ProgramTable
+		void bake(const std::vector<Mesh *> & trees);
+
+		unsigned int getNumViews() const { return numViews; }
+		unsigned int getNumTrees() const { return (unsigned int)extents.size(); }
+		unsigned int getColorTexture() const { return colorTexture; }
+		unsigned int getNormalTexture() const { return normalTexture; }
+		const glm::vec3 & getExtents(unsigned int tree) const { return extents[tree]; }
+
+		void destroy();
+	};
+}
@@ -0,0 +1,191 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "Threadpool.h"
+#include "util/MappedFile.h"
+
+namespace Engine
+{
+	namespace CloudSystem
+	{
+		// Textures generated by the baker, all of them RGBA8
+		enum CloudNoiseTexture
+		{
+			// Perlin-Worley + 3 Worley octaves volume (perlinworley.comp)
+			CLOUD_NOISE_PERLIN_WORLEY = 0,
+			// 3 Worley octaves volume (worley.comp)
+			CLOUD_NOISE_WORLEY = 1,
+			// Weather map (weather.comp)
+			CLOUD_NOISE_WEATHER = 2,
+			CLOUD_NOISE_TEXTURE_COUNT = 3
+		};
+
+		// Generation parameters. The defaults reproduce the compute shaders
+		typedef struct CloudNoiseParameters
+		{
+			unsigned int perlinWorleySize;
+			unsigned int worleySize;
+			unsigned int weatherSize;
+
+			// Weather perlin noise
+			float weatherAmplitude;
+			float weatherFrecuency;
+			float weatherScale;
+			unsigned int weatherOctaves;
+
+			// Offsets the Worley cell hashes and the weather noise lattice (0 = same as the shaders)
+			unsigned int seed;
+		} CloudNoiseParameters;
+
+		// Bake times with a given amount of threads (see CloudNoiseBaker::benchmark())
+		typedef struct CloudNoiseBenchmark
+		{
+			unsigned int threads;
+			double textureMs[CLOUD_NOISE_TEXTURE_COUNT];
+			double totalMs;
+		} CloudNoiseBenchmark;
+
+		// Result of CloudNoiseBaker::validate()
+		typedef struct CloudNoiseValidation
+		{
+			unsigned int samples;
+			// Samples further than the tolerance from the shader formulas
+			unsigned int failures;
+			// Largest difference between a baked texel and the shader formulas (in [0, 1] units)
+			float maxError;
+		} CloudNoiseValidation;
+
+		/**
+		 * CPU implementation of the cloud noise compute shaders. Rows are baked concurrently on the
+		 * thread pool, 4 texels at a time (SSE). The per texel work is reduced with lookup tables:
+		 * the Worley jitter is always evaluated on integer cells (one hash per cell), and the 4D
+		 * Perlin noise always has w = 0 (one gradient per lattice corner). The result can be stored
+		 * on a versioned cache file, which later launches map and upload straight away
+		 */
+		class CloudNoiseBaker
+		{
+		public:
+			static const std::string DEFAULT_CACHE_FILE;
+			// Must be increased whenever the generated noise changes, so old cache files are discarded
+			static const unsigned int GENERATOR_VERSION;
+			// Largest difference allowed by validate(), half a RGBA8 step plus float error
+			static const float VALIDATION_TOLERANCE;
+		private:
+			// Worley noise tables for a given cell count
+			typedef struct WorleyTable
+			{
+				unsigned int cells;
+				// Jitter of every cell
+				std::vector<float> hashes;
+				// Per texel column and neighbour cell (-1, 0, 1): distance to the cell along x, and
+				// the wrapped cell index
+				std::vector<float> offsets[3];
+				std::vector<int> indices[3];
+			} WorleyTable;
+
+			// Perlin noise tables for a given frequency
+			typedef struct PerlinTable
+			{
+				unsigned int frequency;
+				// Normalized gradient (xyz) of every lattice corner with w = 0
+				std::vector<float> gradients;
+				// Per texel column: fractional position, fade curve and both lattice corners
+				std::vector<float> fraction;
+				std::vector<float> fade;
+				std::vector<int> corner0;
+				std::vector<int> corner1;
+			} PerlinTable;
+
+			// Weather noise tables for an octave
+			typedef struct WeatherOctave
+			{
+				float size;
+				float amplitude;
+				// Lattice rows are cached while baking if there are fewer lattice points than texels
+				bool cacheRows;
+				unsigned int latticeWidth;
+				// Per texel column: smoothed weight and lattice column
+				std::vector<float> weight;
+				std::vector<int> lattice;
+			} WeatherOctave;
+
+			CloudNoiseParameters params;
+
+			// Baked textures, or the mapped cache file
+			std::vector<unsigned char> baked[CLOUD_NOISE_TEXTURE_COUNT];
+			IO::MappedFile cache;
+			const unsigned char * data[CLOUD_NOISE_TEXTURE_COUNT];
+
+			// Tables of the texture being baked
+			std::vector<WorleyTable> worleyTables;
+			std::vector<PerlinTable> perlinTables;
+			std::vector<WeatherOctave> weatherOctaves;
+		public:
+			static CloudNoiseParameters getDefaultParameters();
+
+			CloudNoiseBaker(const CloudNoiseParameters & params = getDefaultParameters());
+
+			// Maps the cache file if it was baked with the same parameters and generator version
+			bool loadCache(const std::string & fileName = DEFAULT_CACHE_FILE);
+			bool saveCache(const std::string & fileName = DEFAULT_CACHE_FILE) const;
+
+			// Bakes every texture, using up to numThreads threads of the pool (0 = all of them)
+			void bake(unsigned int numThreads = 0);
+			// Bakes a single texture, returns the time it took in milliseconds
+			double bakeTexture(CloudNoiseTexture texture, unsigned int numThreads = 0);
+			// Bakes the rows [begin, end) of the current texture (row = y + z * size on volumes)
+			void bakeRows(CloudNoiseTexture texture, unsigned int begin, unsigned int end);
+
+			const CloudNoiseParameters & getParameters() const { return params; }
+			// Texture resolution (per axis)
+			unsigned int getSize(CloudNoiseTexture texture) const;
+			bool isVolume(CloudNoiseTexture texture) const { return texture != CLOUD_NOISE_WEATHER; }
+			// RGBA8 texels, NULL if the texture was neither baked nor loaded
+			const unsigned char * getData(CloudNoiseTexture texture) const { return data[texture]; }
+			size_t getDataSize(CloudNoiseTexture texture) const;
+			bool isReady() const;
+			// Releases the baked textures and unmaps the cache file
+			void release();
+
+			// Compares a set of texels of every texture against a literal port of the shaders
+			CloudNoiseValidation validate(unsigned int samplesPerTexture) const;
+			// Bakes every texture with 1, 2, 4... threads up to the thread pool size
+			static std::vector<CloudNoiseBenchmark> benchmark(const CloudNoiseParameters & params = getDefaultParameters());
+		private:
+			unsigned long long computeKey() const;
+			void prepareTables(CloudNoiseTexture texture);
+			void prepareWorleyTable(WorleyTable & table, unsigned int size) const;
+			void preparePerlinTable(PerlinTable & table, unsigned int size) const;
+
+			void bakePerlinWorleyRow(unsigned int y, unsigned int z, float * scratch, unsigned char * out) const;
+			void bakeWorleyRow(unsigned int y, unsigned int z, float * scratch, unsigned char * out) const;
+			void bakeWeatherRows(unsigned int begin, unsigned int end, float * scratch);
+			// Minimum squared distance to the cell points of a row of texels
+			void worleyRow(const WorleyTable & table, float y, float z, float * out) const;
+			// Perlin noise of a row of texels
+			void perlinRow(const PerlinTable & table, float y, float z, float * out) const;
+		};
+
+		// ===============================================================
+		// Bakes rows of a texture until there are none left
+		class CloudNoiseTask : public Concurrent::Runnable
+		{
+		private:
+			CloudNoiseBaker * baker;
+			CloudNoiseTexture texture;
+			std::atomic<unsigned int> * nextRow;
+			unsigned int numRows;
+			Concurrent::CountDownLatch * latch;
+		public:
+			CloudNoiseTask(CloudNoiseBaker * baker, CloudNoiseTexture texture, std::atomic<unsigned int> * nextRow, unsigned int numRows, Concurrent::CountDownLatch * latch);
+			void run();
+		};
+	}
+}
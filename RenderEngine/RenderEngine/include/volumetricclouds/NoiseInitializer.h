@@ -6,11 +6,27 @@
 
 #include "computeprograms/VolumeTextureProgram.h"
 #include "computeprograms/WeatherTextureProgram.h"
+#include "volumetricclouds/CloudNoiseBaker.h"
+
+#include <vector>
 
 namespace Engine
 {
 	namespace CloudSystem
 	{
+		// Part of a noise texture generated with a single dispatch
+		typedef struct CloudNoiseSlab
+		{
+			CloudNoiseTexture texture;
+			// First z slice (volumes) or row (weather), and how many of them
+			unsigned int offset;
+			unsigned int size;
+			unsigned int texels;
+			// GPU time, negative until the timer query result is read
+			unsigned int query;
+			double gpuMs;
+		} CloudNoiseSlab;
+
 		/**
 		 * Class in charge of filling the cloud's noise volume textures
 		 * as well as to generate the weather data texture and give access
@@ -20,6 +36,10 @@ namespace Engine
 		{
 		public:
 			static NoiseInitializer * INSTANCE;
+			// Texels generated by each dispatch on the GPU path
+			static const unsigned int SLAB_TEXELS;
+			// Time the clouds take to fade in once the textures are complete, in seconds
+			static const float FADE_IN_SECONDS;
 		private:
 			// We could go for more res, but it looks fine like this
 
@@ -53,7 +73,24 @@ namespace Engine
 			VolumeTextureProgram * worleyGen;
 			WeatherTextureProgram * weatherGen;
 
+			// CPU generation, mapped from disk after the first launch
+			CloudNoiseBaker baker;
+
+			// GPU generation, a few slabs per frame within Settings::cloudNoiseFrameBudgetMs
+			std::vector<CloudNoiseSlab> slabs;
+			unsigned int nextSlab;
+			// First slab whose timer query has not been read yet
+			unsigned int nextTiming;
+			// Measured GPU time per texture, used to estimate how many slabs fit the budget
+			double measuredMs[CLOUD_NOISE_TEXTURE_COUNT];
+			unsigned int measuredSlabs[CLOUD_NOISE_TEXTURE_COUNT];
+			unsigned int generatedTexels;
+			unsigned int totalTexels;
+			unsigned int generationFrames;
+
 			bool initialized;
+			bool complete;
+			float completeTime;
 		public:
 			static NoiseInitializer & getInstance();
 		public:
@@ -62,13 +99,31 @@ namespace Engine
 			const TextureInstance * getCurlNoise() const;
 			const TextureInstance * getWeatherData() const;
 
+			// Generates the textures. On the progressive GPU path only a part of the work is done
+			// per call, so it must be called every frame until isComplete()
 			void render();
+
+			bool isComplete() const;
+			// Generated fraction of the texels, in [0, 1]
+			float getProgress() const;
+			// Goes from 0 to 1 in FADE_IN_SECONDS once the textures are complete
+			float getFadeIn() const;
+			const std::vector<CloudNoiseSlab> & getSlabs() const;
 		private:
 			NoiseInitializer();
 			void init();
 			void initShader();
 			void initTextures();
 
+			void renderOnGPU();
+			void renderOnCPU();
+			void createSlabs();
+			void dispatchSlab(CloudNoiseSlab & slab);
+			void readSlabTimings();
+			double estimateSlabMs(CloudNoiseTexture texture, double budgetMs) const;
+			void finishGeneration(bool fadeIn);
+			void uploadBaked(CloudNoiseTexture texture, TextureInstance * instance);
+
 			void clean();
 		};
 	}
@@ -0,0 +1,70 @@
+/**
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include "WindowToolkit.h"
+
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	namespace Window
+	{
+		/**
+		 * Window toolkit without a visible window. Renders into an EGL pbuffer (Mesa's software
+		 * rasterizer on machines without GPU) for a fixed amount of frames, with a fixed time step
+		 * and an automatic camera flight, and writes the per frame profiler timings as CSV
+		 * (and, optionally, the rendered frames as PNG)
+		 */
+		class HeadlessWindow : public WindowToolkit
+		{
+		public:
+			static const std::string DEFAULT_CSV_FILE;
+		private:
+			// Measures of a rendered frame written next to the profiler timings
+			typedef struct HeadlessFrame
+			{
+				double wallMs;
+				// See RenderStatistics
+				double terrainSubmitMs;
+				unsigned int drawCalls;
+			} HeadlessFrame;
+
+			// EGL handles (EGLDisplay, EGLSurface, EGLContext)
+			void * display;
+			void * surface;
+			void * context;
+
+			// Benchmark configuration
+			unsigned int frameCount;
+			float timeStep;
+			unsigned int travelMethod;
+			std::string csvFile;
+			// Empty = no frames are saved
+			std::string pngFolder;
+			unsigned int pngInterval;
+
+		public:
+			HeadlessWindow(std::string title, unsigned int width, unsigned int height);
+			~HeadlessWindow();
+
+			// Only core profile contexts are created, the context profile is ignored
+			void initializeContext() override;
+			void mainLoop() override;
+
+			void setFrameCount(unsigned int frames);
+			void setTimeStep(float seconds);
+			// Camera movement during the run (see Engine::TravelMethod)
+			void setTravelMethod(unsigned int method);
+			void setCSVFile(const std::string & fileName);
+			// Saves one of every interval frames into the folder
+			void setPNGOutput(const std::string & folder, unsigned int interval = 1);
+		private:
+			void saveFrame(unsigned int frame);
+			void writeCSV(const std::vector<HeadlessFrame> & measures);
+		};
+	}
+}
@@ -0,0 +1,64 @@
+#version 430 core
+
+/*
+	Brings the result of a post process rendered at a lower resolution back to full
+	resolution. Only the contribution of the effect (its output minus the input it read)
+	is upsampled and added to the full resolution input, so the scene keeps its detail.
+	The 4 closest low resolution samples are weighted by the bilinear weights and by
+	how close their distance to the camera is to the distance of the pixel
+*/
+
+#define EPSILON 0.001
+
+layout (location=0) out vec4 outColor;
+
+layout (location=0) in vec2 texCoord;
+
+// Low resolution output of the effect
+uniform sampler2D postProcessing_0;
+// Full resolution input of the effect
+uniform sampler2D postProcessing_1;
+// G-Buffer depth, and the inverse projection to bring it back to camera space
+uniform sampler2D depthBuffer;
+uniform mat4 invProj;
+
+// Same as DeferredShading.frag
+vec3 reconstructPosition(vec2 uv, float d)
+{
+	if (d >= 1.0)
+		return vec3(0.0);
+
+	vec4 p = invProj * vec4(uv * 2.0 - 1.0, d * 2.0 - 1.0, 1.0);
+	return p.xyz / p.w;
+}
+
+void main()
+{
+	ivec2 lowSize = textureSize(postProcessing_0, 0);
+	vec2 lowPos = texCoord * vec2(lowSize) - 0.5;
+	vec2 base = floor(lowPos);
+	vec2 f = lowPos - base;
+
+	float dist = length(reconstructPosition(texCoord, texture(depthBuffer, texCoord).x));
+
+	vec3 contribution = vec3(0.0);
+	float totalWeight = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		vec2 offset = vec2(i & 1, i >> 1);
+		ivec2 texel = clamp(ivec2(base + offset), ivec2(0), lowSize - ivec2(1));
+		// Coordinates the effect used for this texel
+		vec2 sampleUV = (vec2(texel) + 0.5) / vec2(lowSize);
+
+		float bilinear = mix(1.0 - f.x, f.x, offset.x) * mix(1.0 - f.y, f.y, offset.y);
+		float sampleDist = length(reconstructPosition(sampleUV, texture(depthBuffer, sampleUV).x));
+		float weight = bilinear / (EPSILON + abs(sampleDist - dist) / max(dist, EPSILON));
+
+		vec3 effect = texelFetch(postProcessing_0, texel, 0).rgb - texture(postProcessing_1, sampleUV).rgb;
+		contribution += effect * weight;
+		totalWeight += weight;
+	}
+
+	vec3 color = texture(postProcessing_1, texCoord).rgb;
+	outColor = vec4(color + contribution / max(totalWeight, EPSILON), 1.0);
+}
@@ -7,12 +7,13 @@ layout (location=2) out vec4 outGodRaysInfo;
 layout (location=0) in vec2 texCoord;
 
 uniform sampler2D postProcessing_0; // color
-uniform sampler2D postProcessing_1; // normal
-uniform sampler2D postProcessing_2; // specular
+uniform sampler2D postProcessing_1; // normal (octahedral)
+uniform sampler2D postProcessing_2; // material (grass, shadow visibility, terrain alpha, specular)
 uniform sampler2D postProcessing_3; // emissive
-uniform sampler2D postProcessing_4; // pos
-uniform sampler2D postProcessing_5; // info
-uniform sampler2D postProcessing_6; // depth
+uniform sampler2D postProcessing_4; // depth
+
+// Camera space position is reconstructed from the depth
+uniform mat4 invProj;
 
 // ===============================================
 // back ground color, used for fog effect and ambient lighting
@@ -23,9 +24,6 @@ uniform float colorFactor;
 
 // Different lights data
 
-uniform int numSpotLights;
-uniform int numPointLights;
-
 layout(std140, binding = 0) uniform DLBuffer
 {
 	vec4 DLdirection [1];
@@ -33,24 +31,43 @@ layout(std140, binding = 0) uniform DLBuffer
 	vec4 DLkFactors [1];
 };
 
-/*
-layout(std140, binding = 1) uniform SLBuffer
+// Point and spot lights (see LightStorage), and the lights that touch every cluster of the
+// view frustum (see ClusteredLightBuffer). Must match LightClusterBuilder
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+
+struct LightData
+{
+	vec4 position;		// world space, w = influence radius
+	vec4 direction;		// world space spot direction, w = cosine of the aperture (< -1 on point lights)
+	vec4 color;			// w = spot exponent
+	vec4 attenuation;	// 0=constant,1=lineal,2=cuadratic
+	vec4 kFactors;		// 0=Ka,1=Kd,2=Ks
+};
+
+layout(std430, binding = 4) readonly buffer LightStorage
+{
+	LightData lights[];
+};
+
+// Offset and count of the cluster lights within lightIndices
+layout(std430, binding = 5) readonly buffer ClusterGrid
 {
-	vec4 SLposition [];
-	vec4 SLdirection [];
-	vec4 SLcolor [];
-	vec4 SLattenuation [];
-	vec4 SLkFactors [];
+	uvec2 clusters[];
 };
 
-layout(std140, binding = 2) uniform PLBuffer
+layout(std430, binding = 6) readonly buffer ClusterIndices
 {
-	vec4 PLposition [];
-	vec4 PLcolor [];
-	vec4 PLattenuation [];
-	vec4 PLkFactors [];
+	uint numIndices;
+	uint lightIndices[];
 };
-*/
+
+// The cluster slice of a view depth d is log(d) * clusterScale - clusterBias
+uniform float clusterScale;
+uniform float clusterBias;
+// Brings the stored lights to view space
+uniform mat4 viewMatrix;
 
 // Objects properties to be used across shading fuctions
 vec3 pos;
@@ -64,6 +81,29 @@ float depth;
 float alpha = 50.0;
 vec3 ambientColor;
 
+// ================================================================================
+// G-BUFFER DECODING
+// Inverse of encodeNormal() (see terrain.frag)
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0? -t : t, n.y >= 0.0? -t : t);
+	return normalize(n);
+}
+
+// Camera space position of the fragment. The background maps to the origin,
+// as it did when the position was stored in the G-Buffer
+vec3 reconstructPosition(vec2 uv, float d)
+{
+	if (d >= 1.0)
+		return vec3(0.0);
+
+	vec4 p = invProj * vec4(uv * 2.0 - 1.0, d * 2.0 - 1.0, 1.0);
+	return p.xyz / p.w;
+}
+
 // ================================================================================
 // SHADING FUNCTIONALITY
 vec3 diffuseOrenNayar(vec3 ld, float roughness, vec3 albedo) 
@@ -117,6 +157,60 @@ vec3 processDirectionalLight(in float visibility)
 	return c;
 }
 
+vec3 processClusteredLights()
+{
+	vec3 c = vec3(0,0,0);
+	// Background
+	if (depth >= 1.0)
+		return c;
+
+	ivec3 cell;
+	cell.xy = clamp(ivec2(texCoord * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y)), ivec2(0), ivec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+	cell.z = clamp(int(log(-pos.z) * clusterScale - clusterBias), 0, CLUSTER_GRID_Z - 1);
+	uvec2 cluster = clusters[cell.x + cell.y * CLUSTER_GRID_X + cell.z * CLUSTER_GRID_X * CLUSTER_GRID_Y];
+
+	vec3 V = normalize(-pos);
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		LightData light = lights[lightIndices[cluster.x + i]];
+
+		vec3 L = (viewMatrix * vec4(light.position.xyz, 1.0)).xyz - pos;
+		float d = length(L);
+		if (d >= light.position.w)
+			continue;
+		L /= d;
+
+		// Faded to 0 at the influence radius, so the cluster bounds do not show
+		float window = 1.0 - pow(d / light.position.w, 4.0);
+		float attenuation = window * window / dot(light.attenuation.xyz, vec3(1.0, d, d * d));
+
+		// Spot cone
+		if (light.direction.w >= -1.0)
+		{
+			float cosAngle = dot(-L, mat3(viewMatrix) * light.direction.xyz);
+			if (cosAngle < light.direction.w)
+				continue;
+			attenuation *= pow(max(cosAngle, 0.0), light.color.w);
+		}
+
+		vec3 lightColor = light.color.rgb * attenuation;
+		vec3 Kfactors = light.kFactors.xyz;
+
+		// Ambient
+		c += lightColor * Kfactors.x * Ka;
+
+		// Diffuse
+		c += diffuseLambert(L, lightColor * Kfactors.y * Kd);
+
+		// Specular
+		vec3 R = normalize(reflect(-L, N));
+		float sFactor = max(dot(R, V), 0.01);
+		c += lightColor * Kfactors.z * Ks * pow(sFactor, alpha);
+	}
+
+	return c;
+}
+
 vec3 processAtmosphericFog(in vec3 shadedColor)
 {
 	float d = length(pos);
@@ -131,23 +225,22 @@ vec3 processAtmosphericFog(in vec3 shadedColor)
 void main()
 {
 	vec4 gbuffercolor =		texture(postProcessing_0, texCoord);
-	vec4 gbuffernormal =	texture(postProcessing_1, texCoord);
-	vec4 gbufferspec =		texture(postProcessing_2, texCoord);
+	vec2 gbuffernormal =	texture(postProcessing_1, texCoord).xy;
+	vec4 gbuffermaterial =	texture(postProcessing_2, texCoord);
 	vec4 gbufferemissive =	texture(postProcessing_3, texCoord);
-	vec4 gbufferpos =		texture(postProcessing_4, texCoord);
-	vec4 gbufferinfo =		texture(postProcessing_5, texCoord);
-	depth =					texture(postProcessing_6, texCoord).x;
+	depth =					texture(postProcessing_4, texCoord).x;
 
-	N = gbuffernormal.xyz;
-	pos = gbufferpos.xyz;
+	N = decodeNormal(gbuffernormal);
+	pos = reconstructPosition(texCoord, depth);
 	Ka = gbuffercolor.rgb;;
 	Kd = Ka;
-	Ks = gbufferspec.rgb;
+	Ks = vec3(gbuffermaterial.a);
 	Ke = gbufferemissive.rgb;
 
 	ambientColor = mix(horizonColor, zenitColor, 0.2);
 
-	vec3 shaded = processDirectionalLight(gbufferinfo.y);
+	vec3 shaded = processDirectionalLight(gbuffermaterial.y);
+	shaded += processClusteredLights();
 	shaded = processAtmosphericFog(shaded);
 
 	outColor = vec4(shaded, 1.0);
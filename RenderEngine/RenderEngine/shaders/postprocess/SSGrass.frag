@@ -9,7 +9,8 @@ uniform vec2 screenSize;
 
 uniform sampler2D postProcessing_0;
 uniform sampler2D grassBuffer;
-uniform sampler2D posBuffer;
+uniform sampler2D depthBuffer;
+uniform mat4 invProj;
 
 // Same remap value function as in the volumetric clouds, returns the valor within a range of 
 // a valor which is mapped to a different range
@@ -21,6 +22,16 @@ float blend(float val , float val0 , float val1 , float res0 , float res1)
 	return res0 + (val - val0) * (res1 - res0) / (val1 - val0);
 }
 
+// Same as DeferredShading.frag
+vec3 reconstructPosition(vec2 uv, float d)
+{
+	if (d >= 1.0)
+		return vec3(0.0);
+
+	vec4 p = invProj * vec4(uv * 2.0 - 1.0, d * 2.0 - 1.0, 1.0);
+	return p.xyz / p.w;
+}
+
 void main()
 {
 	float isGrass = texture(grassBuffer, texCoord).x;
@@ -28,7 +39,7 @@ void main()
 	// Apply the effect only if we are treating a grass pixel
 	if(isGrass > 0.9)
 	{
-		vec3 pos = texture(posBuffer, texCoord).xyz;
+		vec3 pos = reconstructPosition(texCoord, texture(depthBuffer, texCoord).x);
 		float dist = length(pos);
 
 		float ar = screenSize.x / screenSize.y;
@@ -47,7 +58,7 @@ void main()
 		float yOffset = fract(y * d) / d;
 		vec2 uvOffset = texCoord - vec2(0, yOffset * 2.0 * 1.0/(dist * 0.2));
 
-		vec3 offsetPos = texture(posBuffer, uvOffset).xyz;
+		vec3 offsetPos = reconstructPosition(uvOffset, texture(depthBuffer, uvOffset).x);
 		// Make sure we dont paint grass in a zone oclude by non-grass data
 		outColor = offsetPos.z < pos.z? backColor : vec4(mix(backColor.rgb, texture(postProcessing_0, uvOffset).rgb, clamp(1 - yOffset * d / 3.4, 0, 1)), 1.0);
 		//texture(postProcessing_0, uvOffset).rgb
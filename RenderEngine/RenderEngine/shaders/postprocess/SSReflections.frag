@@ -5,15 +5,35 @@ layout (location = 0) out vec4 outColor;
 layout (location=0) in vec2 texCoord;
 
 uniform mat4 projMat;
+uniform mat4 invProj;
 
 uniform vec3 lightDirection;
 
 uniform sampler2D postProcessing_0;	// color
 
-uniform sampler2D posBuffer;
 uniform sampler2D depthBuffer;
 uniform sampler2D normalBuffer;
-uniform sampler2D specularBuffer;
+uniform sampler2D materialBuffer;
+
+// Same as DeferredShading.frag
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0? -t : t, n.y >= 0.0? -t : t);
+	return normalize(n);
+}
+
+// Same as DeferredShading.frag
+vec3 reconstructPosition(vec2 uv, float d)
+{
+	if (d >= 1.0)
+		return vec3(0.0);
+
+	vec4 p = invProj * vec4(uv * 2.0 - 1.0, d * 2.0 - 1.0, 1.0);
+	return p.xyz / p.w;
+}
 
 vec3 raymarch(vec3 position, vec3 direction, float step)
 {
@@ -77,10 +97,11 @@ vec3 computeReflectionColor(float depth, vec3 pos, vec3 N)
 
 void main()
 {
-	vec3 pos = texture(posBuffer, texCoord).xyz;
-	vec3 N = texture(normalBuffer, texCoord).xyz;
 	float depth = texture(depthBuffer, texCoord).x;
-	float reflection = texture(specularBuffer, texCoord).w;
+	vec3 pos = reconstructPosition(texCoord, depth);
+	vec3 N = decodeNormal(texture(normalBuffer, texCoord).xy);
+	// Specular surfaces reflect
+	float reflection = texture(materialBuffer, texCoord).w;
 
 	// Compute relfection only for specular surfaces
 	if(reflection > 0.0)
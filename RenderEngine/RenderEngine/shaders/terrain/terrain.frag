@@ -1,29 +1,57 @@
-#version 410 core
+#version 430 core
 
 #ifndef SHADOW_MAP
 layout (location=0) out vec4 outColor;
+// Octahedral encoded normal (see encodeNormal())
 layout (location=1) out vec4 outNormal;
-layout (location=2) out vec4 outSpecular;
+// Grass flag, shadow visibility, terrain alpha below water, specular intensity
+layout (location=2) out vec4 outMaterial;
 layout (location=3) out vec4 outEmissive;
-layout (location=4) out vec4 outPos;
-layout (location=5) out vec4 outInfo;
 
 layout (location=0) in vec2 inUV;
 layout (location=1) in vec3 inPos;
 layout (location=2) in float height;
-layout (location=3) in vec4 inShadowMapPos;
-layout (location=4) in vec4 inShadowMapPos1;
 
 uniform mat4 normal;
 uniform mat4 modelView;
 
-uniform float worldScale;
-uniform float renderRadius;
-
-uniform sampler2D depthTexture;
-uniform sampler2D depthTexture1;
+// Per frame values shared by the terrain, water and vegetation programs (see Engine::GPU::FrameGlobalsBuffer)
+layout(std140, binding = 3) uniform FrameGlobals
+{
+	vec3 lightDir;
+	float time;
+	vec3 grass;
+	float grassCoverage;
+	vec3 rock;
+	float worldScale;
+	vec3 sand;
+	float renderRadius;
+	vec3 watercolor;
+	float waterspeed;
+	vec3 windDirection;
+	float windStrength;
+	float terrainAmplitude;
+	float terrainFrecuency;
+	float terrainScale;
+	int terrainOctaves;
+	float waterHeight;
+	float maxHeight;
+	float sinTime;
+};
+
+// Shadow cascades of the directional light (see Engine::CascadeShadowMaps)
+layout(std140, binding = 2) uniform ShadowCascades
+{
+	// View space to shadow map space (texture coordinates and depth) of every cascade
+	mat4 cascadeMatrices[8];
+	// Far view depth of every cascade, 4 per vec4
+	vec4 cascadeSplits[2];
+	// Shadow map depth of one texel of every cascade, 4 per vec4
+	vec4 cascadeDepthBias[2];
+	int numCascades;
+};
 
-uniform vec3 lightDir;
+uniform sampler2DArray shadowMaps;
 
 // Random sample vectors used to apply percentage close filter to casted shadows
 uniform vec2 poissonDisk[4] = vec2[](
@@ -33,27 +61,25 @@ uniform vec2 poissonDisk[4] = vec2[](
   vec2( 0.34495938, 0.29387760 )
 );
 
-uniform vec3 rock;
-uniform vec3 grass;
-uniform vec3 sand;
-
-uniform float time;
-
-uniform float waterHeight;
-
+#ifdef MULTI_DRAW
+layout (location=5) flat in ivec2 gridPos;
+#else
 uniform ivec2 gridPos;
-
-uniform float grassCoverage;
-
-uniform float amplitude;
-uniform float frecuency;
-uniform float scale;
-uniform int octaves;
+#endif
 
 // ================================================================================
+// Integer hash of a lattice point. Avoids sin() so the CPU mirror
+// (Engine::TerrainHeightField) computes the very same values
 float Random2D(in vec2 st)
 {
-	return fract(sin(dot(st.xy, vec2(12.9898, 78.233))) * 43758.5453123);
+	uvec2 q = uvec2(ivec2(st));
+	uint h = q.x * 1597334677u ^ q.y * 3812015801u;
+	h ^= h >> 16u;
+	h *= 0x7feb352du;
+	h ^= h >> 15u;
+	h *= 0x846ca68bu;
+	h ^= h >> 16u;
+	return float(h >> 8u) * (1.0 / 16777216.0);
 }
 
 //uniform float cellularScale = 1500.0;
@@ -114,8 +140,8 @@ float noiseHeight(in vec2 pos, float localScale, int octaveCount)
 
 	float noiseValue = 0.0;
 
-	float localAplitude = amplitude;
-	float localFrecuency = frecuency;
+	float localAplitude = terrainAmplitude;
+	float localFrecuency = terrainFrecuency;
 
 	for (int index = 0; index < octaveCount; index++)
 	{
@@ -132,8 +158,8 @@ float bumpNoiseHeight(in vec2 pos, float localScale, int octaveCount)
 {
 	float noiseValue = 0.0;
 
-	float localAplitude = amplitude;
-	float localFrecuency = frecuency;
+	float localAplitude = terrainAmplitude;
+	float localFrecuency = terrainFrecuency;
 
 	for (int index = 0; index < octaveCount; index++)
 	{
@@ -155,37 +181,40 @@ bool whithinRange(vec2 texCoord)
 	return texCoord.x >= 0.0 && texCoord.x <= 1.0 && texCoord.y >= 0.0 && texCoord.y <= 1.0;
 }
 
+// Index of the first cascade whose frustum slice holds the view space position, numCascades if none does
+int selectCascade(vec3 viewPos)
+{
+	float depth = -viewPos.z;
+	int cascade = 0;
+	while (cascade < numCascades && depth > cascadeSplits[cascade / 4][cascade % 4])
+	{
+		cascade++;
+	}
+	return cascade;
+}
+
 // Looks up the shadow map to tell wether the fragment is in shadow
 // or should receive full lighting
 float getShadowVisibility(vec3 rawNormal)
 {
-	float bias = clamp(0.005 * tan(acos(dot(rawNormal, lightDir))), 0.0, 0.01);
+	// Use the highest resolution cascade that covers the fragment
+	int cascade = selectCascade(inPos);
+	if (cascade >= numCascades)
+		return 1.0;
+
+	vec3 shadowMapPos = (cascadeMatrices[cascade] * vec4(inPos, 1.0)).xyz;
+	if (!whithinRange(shadowMapPos.xy))
+		return 1.0;
+
+	// Bias in texels of the cascade, so every cascade gets the same amount of acne protection
+	float slope = clamp(tan(acos(dot(rawNormal, lightDir))), 0.0, 4.0);
+	float curDepth = shadowMapPos.z - cascadeDepthBias[cascade / 4][cascade % 4] * (2.0 + 2.0 * slope);
 	float visibility = 1.0;
 
-	// Check first the highest resolution (but smaller) map
-	if(whithinRange(inShadowMapPos.xy))
+	// Apply percentage close filter to get rid of the stair effect
+	for (int i = 0; i < 4; i++)
 	{
-		float curDepth = inShadowMapPos.z - bias;
-		//visibility = texture(depthTexture, inShadowMapPos.xy).x < curDepth? 0.0 : 1.0;
-		
-		// Apply percentage close filter to get rid of the stair effect
-		for (int i = 0; i < 4; i++)
-		{
-			visibility -= 0.25 * ( texture(depthTexture, inShadowMapPos.xy + poissonDisk[i] / 700.0).x  <  curDepth? 1.0 : 0.0 );
-		}
-		
-	}
-	// If not there, try in the lower resolution (but bigger) map
-	else if(whithinRange(inShadowMapPos1.xy))
-	{
-		float curDepth = inShadowMapPos1.z - bias;
-		//visibility = texture( depthTexture1, inShadowMapPos1.xy).x  <  curDepth? 0.0 : 1.0;
-		
-		for (int i = 0; i < 4; i++)
-		{
-			visibility -= 0.25 * ( texture( depthTexture1, inShadowMapPos1.xy + poissonDisk[i] / 700.0 ).x  <  curDepth? 1.0 : 0.0 );
-		}
-		
+		visibility -= 0.25 * ( texture(shadowMaps, vec3(shadowMapPos.xy + poissonDisk[i] / 700.0, float(cascade))).x  <  curDepth? 1.0 : 0.0 );
 	}
 
 	return visibility;
@@ -198,10 +227,10 @@ vec3 computeNormal()
 	float u = inUV.x;
 	float v = inUV.y;
 	float step = 0.01;
-	float tH = noiseHeight(vec2(u, v + step), scale, octaves); 
-	float bH = noiseHeight(vec2(u, v - step), scale, octaves);
-	float rH = noiseHeight(vec2(u + step, v), scale, octaves);
-	float lH = noiseHeight(vec2(u - step, v), scale, octaves); 
+	float tH = noiseHeight(vec2(u, v + step), terrainScale, terrainOctaves); 
+	float bH = noiseHeight(vec2(u, v - step), terrainScale, terrainOctaves);
+	float rH = noiseHeight(vec2(u + step, v), terrainScale, terrainOctaves);
+	float lH = noiseHeight(vec2(u - step, v), terrainScale, terrainOctaves); 
 
 	return normalize(vec3(lH - rH, step * step, bH - tH));
 }
@@ -214,14 +243,22 @@ vec3 computeBumpNormal(int octaveCount)
 	float v = inUV.y;
 	float step = 0.0025;
 	float slope = 2.0;
-	float tH = bumpNoiseHeight(vec2(u, v + step), scale * slope, octaveCount); 
-	float bH = bumpNoiseHeight(vec2(u, v - step), scale * slope, octaveCount);
-	float rH = bumpNoiseHeight(vec2(u + step, v), scale * slope, octaveCount);
-	float lH = bumpNoiseHeight(vec2(u - step, v), scale * slope, octaveCount); 
+	float tH = bumpNoiseHeight(vec2(u, v + step), terrainScale * slope, octaveCount); 
+	float bH = bumpNoiseHeight(vec2(u, v - step), terrainScale * slope, octaveCount);
+	float rH = bumpNoiseHeight(vec2(u + step, v), terrainScale * slope, octaveCount);
+	float lH = bumpNoiseHeight(vec2(u - step, v), terrainScale * slope, octaveCount); 
 
 	return normalize(vec3(lH - rH, step * step, bH - tH));
 }
 
+// Maps a unit normal to the [0, 1] square unfolding the octahedron (decoded in the deferred shading)
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0? 1.0 : -1.0, n.y >= 0.0? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+
 vec3 computeCaustics(vec2 uv)
 {
 	float val = cellularNoise(uv, 150.0);
@@ -247,7 +284,7 @@ void main()
 	float cosV = abs(dot(rawNormal, up));
 
 	// Compute bump normal
-	rawNormal = length(inPos) < float(renderRadius * worldScale) / 1.5? (height < waterHeight + 0.01? computeBumpNormal(8) : computeBumpNormal(octaves)) : rawNormal;
+	rawNormal = length(inPos) < float(renderRadius * worldScale) / 1.5? (height < waterHeight + 0.01? computeBumpNormal(8) : computeBumpNormal(terrainOctaves)) : rawNormal;
 
 	// Correct normal if we have pass from +X to -X, from +Z to -Z, viceversa, or both
 	int xSign = sign(gridPos.x);
@@ -284,10 +321,8 @@ void main()
 	// OUTPUT G BUFFERS
 	// ------------------------------------------------------------------------------
 	outColor = vec4(heightColor, 1.0);
-	outNormal = vec4(normalize(n), 1.0);
-	outPos = vec4(inPos, 1.0);
-	outSpecular = vec4(0);
+	outNormal = vec4(encodeNormal(normalize(n)), 0.0, 1.0);
+	outMaterial = vec4(grassData, visibility, alpha, 0.0);
 	outEmissive = vec4(0,0,0,0);
-	outInfo = vec4(grassData, visibility, alpha, 0);
 #endif
 }
\ No newline at end of file
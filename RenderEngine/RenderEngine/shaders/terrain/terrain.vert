@@ -1,16 +1,32 @@
-#version 410 core
+#version 430 core
 
 // INPUT
 layout (location=0) in vec3 inPos;
 layout (location=1) in vec2 inUV;
+#ifdef MULTI_DRAW
+// Batch index of the tile (instance number offset by the indirect command base instance)
+layout (location=2) in uint inTileIndex;
+#endif
 
 // OUTPUT
 layout (location=0) out vec2 outUV;
+#ifdef MULTI_DRAW
+layout (location=1) flat out ivec2 outGridPos;
 
+layout (std430, binding=0) readonly buffer TileGridPositions
+{
+	ivec2 tileGridPos[];
+};
+#else
 uniform ivec2 gridPos;
+#endif
 
 void main()
 {
+#ifdef MULTI_DRAW
+	ivec2 gridPos = tileGridPos[inTileIndex];
+	outGridPos = gridPos;
+#endif
 	gl_Position = vec4(inPos, 1.0);
 	outUV = abs(inUV + vec2(float(gridPos.x), float(gridPos.y)));
 }
\ No newline at end of file
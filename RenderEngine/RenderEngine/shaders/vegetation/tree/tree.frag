@@ -2,26 +2,58 @@
 
 #ifndef SHADOW_MAP
 layout (location=0) out vec4 outColor;
+// Octahedral encoded normal (see encodeNormal())
 layout (location=1) out vec4 outNormal;
-layout (location=2) out vec4 outSpecular;
+// Grass flag, shadow visibility, terrain alpha below water, specular intensity
+layout (location=2) out vec4 outMaterial;
 layout (location=3) out vec4 outEmissive;
-layout (location=4) out vec4 outPos;
-layout (location=5) out vec4 outInfo;
 
 layout (location=0) in vec3 inPos;
 layout (location=1) in vec3 inColor;
 layout (location=2) in vec3 inNormal;
 layout (location=3) in vec3 inEmission;
-layout (location=4) in vec3 inShadowMapPos;
-layout (location=5) in vec3 inShadowMapPos1;
 layout (location=6) in vec2 inTexCoord;
 
-uniform sampler2D depthTexture;
-uniform sampler2D depthTexture1;
+// Shadow cascades of the directional light (see Engine::CascadeShadowMaps)
+layout(std140, binding = 2) uniform ShadowCascades
+{
+	// View space to shadow map space (texture coordinates and depth) of every cascade
+	mat4 cascadeMatrices[8];
+	// Far view depth of every cascade, 4 per vec4
+	vec4 cascadeSplits[2];
+	// Shadow map depth of one texel of every cascade, 4 per vec4
+	vec4 cascadeDepthBias[2];
+	int numCascades;
+};
+
+uniform sampler2DArray shadowMaps;
 
 uniform mat4 normal;
 
-uniform vec3 lightDir;
+// Per frame values shared by the terrain, water and vegetation programs (see Engine::GPU::FrameGlobalsBuffer)
+layout(std140, binding = 3) uniform FrameGlobals
+{
+	vec3 lightDir;
+	float time;
+	vec3 grass;
+	float grassCoverage;
+	vec3 rock;
+	float worldScale;
+	vec3 sand;
+	float renderRadius;
+	vec3 watercolor;
+	float waterspeed;
+	vec3 windDirection;
+	float windStrength;
+	float terrainAmplitude;
+	float terrainFrecuency;
+	float terrainScale;
+	int terrainOctaves;
+	float waterHeight;
+	float maxHeight;
+	float sinTime;
+};
+
 // Percentage close filter random vector sampling
 uniform vec2 poissonDisk[4] = vec2[](
   vec2( -0.94201624, -0.39906216 ),
@@ -35,30 +67,54 @@ bool whithinRange(vec2 texCoord)
 	return texCoord.x >= 0.0 && texCoord.x <= 1.0 && texCoord.y >= 0.0 && texCoord.y <= 1.0;
 }
 
+// Same as terrain.frag
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0? 1.0 : -1.0, n.y >= 0.0? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+
+// Index of the first cascade whose frustum slice holds the view space position, numCascades if none does
+int selectCascade(vec3 viewPos)
+{
+	float depth = -viewPos.z;
+	int cascade = 0;
+	while (cascade < numCascades && depth > cascadeSplits[cascade / 4][cascade % 4])
+	{
+		cascade++;
+	}
+	return cascade;
+}
+
 // Looks up the shadow maps, checking if the point is inside of any of the light
 // projection volumes, and returning the visibility. If not inside the volumes, will return visible
 float getShadowVisibility(vec3 rawNormal)
 {
-	// Bias to prevent acne from numerical precission
-	float bias = clamp(0.005 * tan(acos(dot(rawNormal, lightDir))), 0.0, 0.01);
+	int cascade = selectCascade(inPos);
+	if (cascade >= numCascades)
+		return 1.0;
+
+	vec3 shadowMapPos = (cascadeMatrices[cascade] * vec4(inPos, 1.0)).xyz;
+	if (!whithinRange(shadowMapPos.xy))
+		return 1.0;
+
+	// Bias to prevent acne from numerical precission, in texels of the cascade
+	float slope = clamp(tan(acos(dot(rawNormal, lightDir))), 0.0, 4.0);
+	float curDepth = shadowMapPos.z - cascadeDepthBias[cascade / 4][cascade % 4] * (2.0 + 2.0 * slope);
+	float layer = float(cascade);
+
+	// Do not apply PCF past the first cascade, as it produces weird effects given the size
+	// of the trees vs the size of the shadow map texels
+	if (cascade > 0)
+		return texture(shadowMaps, vec3(shadowMapPos.xy, layer)).x < curDepth? 0.0 : 1.0;
+
 	// Point is visible by default
 	float visibility = 1.0;
-	if(whithinRange(inShadowMapPos.xy))
+	// Percentage close filter
+	for (int i = 0; i < 4; i++)
 	{
-		float curDepth = inShadowMapPos.z - bias;
-		// Percentage close filter
-		for (int i = 0; i < 4; i++)
-		{
-			visibility -= 0.25 * ( texture(depthTexture, inShadowMapPos.xy + poissonDisk[i] / 700.0).x  <  curDepth? 1.0 : 0.0 );
-		}
-	}
-	// Level 2 cascade shadow map is too low res for the high frequency details of the trees
-	else if(whithinRange(inShadowMapPos1.xy))
-	{
-		// Do not apply PCF on level 2 shadow maps for trees, as it produces weird effects given the size
-		// of the trees vs the size of the shadow map texels
-		float curDepth = inShadowMapPos1.z - bias;
-		visibility = texture(depthTexture1, inShadowMapPos1.xy).x < curDepth? 0.0 : 1.0;
+		visibility -= 0.25 * ( texture(shadowMaps, vec3(shadowMapPos.xy + poissonDisk[i] / 700.0, layer)).x  <  curDepth? 1.0 : 0.0 );
 	}
 
 	return visibility;
@@ -125,27 +181,30 @@ void main()
 	vec3 rawNormal = normalize(inNormal);
 #if defined WIRE_MODE || defined POINT_MODE
 	outColor = vec4(0,0,0,1);
-	outNormal = vec4(rawNormal, 0);
-	outSpecular = vec4(0,0,0,0);
+	outNormal = vec4(encodeNormal(rawNormal), 0, 0);
+	outMaterial = vec4(0);
 	outEmissive = vec4(0,0,0,0);
-	outPos = vec4(inPos, 1);
-	outInfo = vec4(0);
 #else
 	// Apply leaf effect. If we are treating a leaf (info is crompressed into emission vertex info), compute perlin
 	// map and discard those fragments whose value is below 0.4
 	if(inEmission.x > 0.0 && noise(inTexCoord, Tfrecuency, Tamplitude, Tscale) < 0.4)
 		discard;
 
+#ifdef IMPOSTOR_BAKE
+	// Only color and normal are baked. The normal is on the tree local space, encoded to [0, 1],
+	// and the alpha holds wether the fragment is emissive
+	outColor = vec4(inColor, 1.0);
+	outNormal = vec4(rawNormal * 0.5 + 0.5, inEmission.y > 0.0? 1.0 : 0.0);
+#else
 	// APPLY SHADOW MAP
 	// ------------------------------------------------------------------------------
 	float visibility = getShadowVisibility(rawNormal);
 
 	outColor = vec4(inColor, 1.0);
-	outNormal = vec4(rawNormal, 1);
-	outSpecular = vec4(0,0,0,0);
+	outNormal = vec4(encodeNormal(rawNormal), 0, 1);
+	outMaterial = vec4(0.0, visibility, 0, 0);
 	outEmissive = vec4(inEmission.y > 0.0? inColor * 0.5 : vec3(0),1);
-	outPos = vec4(inPos, 1);
-	outInfo = vec4(0.0, visibility,0,1);
+#endif
 #endif
 #else
 	lightdepth = vec4(gl_FragCoord.z, gl_FragCoord.z, gl_FragCoord.z, 0);
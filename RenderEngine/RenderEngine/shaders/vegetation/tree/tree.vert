@@ -2,20 +2,50 @@
 
 layout (location=0) in vec3 inPos;	
 layout (location=1) in vec3 inColor;
-layout (location=2) in vec3 inNormal;
+// Octahedral encoded (tree meshes use the compact vertex layout)
+layout (location=2) in vec2 inNormal;
 layout (location=3) in vec3 inEmission;
 layout (location=4) in vec2 inTexCoord;
+#ifdef INSTANCED
+// World position (x, z) and terrain uv of the tree
+layout (location=5) in vec4 inInstance;
+#endif
 
 layout(location = 0) out vec3 outColor;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec3 outEmission;
 layout(location = 3) out vec2 outTexCoord;
+#ifdef INSTANCED
+layout(location = 4) out vec2 outTileUV;
+#endif
 
-// Wind data
-uniform float sinTime;
-uniform vec3 windDirection;
-uniform float windStrength;
+// Per frame values shared by the terrain, water and vegetation programs (see Engine::GPU::FrameGlobalsBuffer)
+layout(std140, binding = 3) uniform FrameGlobals
+{
+	vec3 lightDir;
+	float time;
+	vec3 grass;
+	float grassCoverage;
+	vec3 rock;
+	float worldScale;
+	vec3 sand;
+	float renderRadius;
+	vec3 watercolor;
+	float waterspeed;
+	vec3 windDirection;
+	float windStrength;
+	float terrainAmplitude;
+	float terrainFrecuency;
+	float terrainScale;
+	int terrainOctaves;
+	float waterHeight;
+	float maxHeight;
+	float sinTime;
+};
+
+#ifndef INSTANCED
 uniform vec2 tileUV;
+#endif
 
 float Random2D(in vec2 st)
 {
@@ -23,17 +53,39 @@ float Random2D(in vec2 st)
 	return val < 0.0? -1.0 : 1.0;
 }
 
+vec3 decodeOctahedral(in vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main()
 {
+#ifdef INSTANCED
+	vec2 tileUV = inInstance.zw;
+	outTileUV = tileUV;
+#endif
+
+#ifdef IMPOSTOR_BAKE
+	// Impostors are baked at rest (FrameGlobals might not hold this frame values yet)
+	vec3 pos = inPos;
+#else
 	// Make wind direction y 0 to avoid stretching and squashing on the trees
 	vec3 wd = vec3(windDirection.x, 0, windDirection.z);
 
 	// Modify base pos by the wind dir/strength, vertex height and some randomness
 	vec3 pos = inPos + sinTime * 0.01 * wd * windStrength * inPos.y * Random2D(tileUV);
+#endif
+#ifdef INSTANCED
+	pos += vec3(inInstance.x, 0.0, inInstance.y);
+#endif
 
 	outColor = inColor;
 	outEmission = inEmission;
-	outNormal = inNormal;
+	outNormal = decodeOctahedral(inNormal);
 	outTexCoord = inTexCoord;
 
 	gl_Position = vec4(pos, 1);
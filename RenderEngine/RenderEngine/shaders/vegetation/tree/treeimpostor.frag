@@ -0,0 +1,152 @@
+#version 430 core
+
+layout (location=0) in vec2 inTexCoord;
+
+// Color and coverage of the baked trees
+uniform sampler2D colorAtlas;
+
+// Per frame values shared by the terrain, water and vegetation programs (see Engine::GPU::FrameGlobalsBuffer)
+layout(std140, binding = 3) uniform FrameGlobals
+{
+	vec3 lightDir;
+	float time;
+	vec3 grass;
+	float grassCoverage;
+	vec3 rock;
+	float worldScale;
+	vec3 sand;
+	float renderRadius;
+	vec3 watercolor;
+	float waterspeed;
+	vec3 windDirection;
+	float windStrength;
+	float terrainAmplitude;
+	float terrainFrecuency;
+	float terrainScale;
+	int terrainOctaves;
+	float waterHeight;
+	float maxHeight;
+	float sinTime;
+};
+
+#ifndef SHADOW_MAP
+layout (location=0) out vec4 outColor;
+// Octahedral encoded normal (see encodeNormal())
+layout (location=1) out vec4 outNormal;
+// Grass flag, shadow visibility, terrain alpha below water, specular intensity
+layout (location=2) out vec4 outMaterial;
+layout (location=3) out vec4 outEmissive;
+
+layout (location=1) in vec3 inPos;
+
+// Local space normal and emissive flag of the baked trees
+uniform sampler2D normalAtlas;
+
+// Shadow cascades of the directional light (see Engine::CascadeShadowMaps)
+layout(std140, binding = 2) uniform ShadowCascades
+{
+	// View space to shadow map space (texture coordinates and depth) of every cascade
+	mat4 cascadeMatrices[8];
+	// Far view depth of every cascade, 4 per vec4
+	vec4 cascadeSplits[2];
+	// Shadow map depth of one texel of every cascade, 4 per vec4
+	vec4 cascadeDepthBias[2];
+	int numCascades;
+};
+
+uniform sampler2DArray shadowMaps;
+
+uniform mat4 normal;
+
+// Percentage close filter random vector sampling
+uniform vec2 poissonDisk[4] = vec2[](
+  vec2( -0.94201624, -0.39906216 ),
+  vec2( 0.94558609, -0.76890725 ),
+  vec2( -0.094184101, -0.92938870 ),
+  vec2( 0.34495938, 0.29387760 )
+);
+
+bool whithinRange(vec2 texCoord)
+{
+	return texCoord.x >= 0.0 && texCoord.x <= 1.0 && texCoord.y >= 0.0 && texCoord.y <= 1.0;
+}
+
+// Same as terrain.frag
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0? 1.0 : -1.0, n.y >= 0.0? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+
+// Index of the first cascade whose frustum slice holds the view space position, numCascades if none does
+int selectCascade(vec3 viewPos)
+{
+	float depth = -viewPos.z;
+	int cascade = 0;
+	while (cascade < numCascades && depth > cascadeSplits[cascade / 4][cascade % 4])
+	{
+		cascade++;
+	}
+	return cascade;
+}
+
+// Same lookup as tree.frag
+float getShadowVisibility(vec3 rawNormal)
+{
+	int cascade = selectCascade(inPos);
+	if (cascade >= numCascades)
+		return 1.0;
+
+	vec3 shadowMapPos = (cascadeMatrices[cascade] * vec4(inPos, 1.0)).xyz;
+	if (!whithinRange(shadowMapPos.xy))
+		return 1.0;
+
+	float slope = clamp(tan(acos(dot(rawNormal, lightDir))), 0.0, 4.0);
+	float curDepth = shadowMapPos.z - cascadeDepthBias[cascade / 4][cascade % 4] * (2.0 + 2.0 * slope);
+	float layer = float(cascade);
+
+	if (cascade > 0)
+		return texture(shadowMaps, vec3(shadowMapPos.xy, layer)).x < curDepth? 0.0 : 1.0;
+
+	float visibility = 1.0;
+	for (int i = 0; i < 4; i++)
+	{
+		visibility -= 0.25 * ( texture(shadowMaps, vec3(shadowMapPos.xy + poissonDisk[i] / 700.0, layer)).x  <  curDepth? 1.0 : 0.0 );
+	}
+
+	return visibility;
+}
+#else
+layout (location=0) out vec4 lightdepth;
+#endif
+
+void main()
+{
+#if defined WIRE_MODE || defined POINT_MODE
+	outColor = vec4(0,0,0,1);
+	outNormal = vec4(encodeNormal(vec3(0,0,1)), 0, 0);
+	outMaterial = vec4(0);
+	outEmissive = vec4(0,0,0,0);
+#else
+	vec4 color = texture(colorAtlas, inTexCoord);
+	if(color.a < 0.5)
+		discard;
+
+#ifndef SHADOW_MAP
+	// The atlas is cleared to 0, so the filtered texels are weighted by the coverage
+	vec4 baked = texture(normalAtlas, inTexCoord) / color.a;
+	vec3 rawNormal = normalize((normal * vec4(baked.xyz * 2.0 - 1.0, 0)).xyz);
+	vec3 albedo = color.rgb / color.a;
+
+	float visibility = getShadowVisibility(rawNormal);
+
+	outColor = vec4(albedo, 1.0);
+	outNormal = vec4(encodeNormal(rawNormal), 0, 1);
+	outMaterial = vec4(0.0, visibility, 0, 0);
+	outEmissive = vec4(baked.a > 0.5? albedo * 0.5 : vec3(0),1);
+#else
+	lightdepth = vec4(gl_FragCoord.z, gl_FragCoord.z, gl_FragCoord.z, 0);
+#endif
+#endif
+}
@@ -0,0 +1,13 @@
+#version 430 core
+
+// World position (x, z) and terrain uv of the tree. One point per tree, expanded
+// into the billboard by the geometry shader
+layout (location=0) in vec4 inInstance;
+
+layout (location=0) out vec2 outTileUV;
+
+void main()
+{
+	outTileUV = inInstance.zw;
+	gl_Position = vec4(inInstance.x, 0.0, inInstance.y, 1.0);
+}
@@ -1,27 +1,59 @@
-#version 410 core
+#version 430 core
 
 #ifndef SHADOW_MAP
 layout (location=0) out vec4 outColor;
+// Octahedral encoded normal (see encodeNormal())
 layout (location=1) out vec4 outNormal;
-layout (location=2) out vec4 outSpecular;
+// Grass flag, shadow visibility, terrain alpha below water, specular intensity
+layout (location=2) out vec4 outMaterial;
 layout (location=3) out vec4 outEmissive;
-layout (location=4) out vec4 outPos;
-layout (location=5) out vec4 outInfo;
 
 layout (location=0) in vec2 inUV;
 layout (location=1) in vec3 inPos;
-layout (location=2) in vec4 inShadowMapPos;
-layout (location=3) in vec4 inShadowMapPos1;
 
 uniform mat4 normal;
 
-uniform sampler2D depthTexture;
-uniform sampler2D depthTexture1;
+// Shadow cascades of the directional light (see Engine::CascadeShadowMaps)
+layout(std140, binding = 2) uniform ShadowCascades
+{
+	// View space to shadow map space (texture coordinates and depth) of every cascade
+	mat4 cascadeMatrices[8];
+	// Far view depth of every cascade, 4 per vec4
+	vec4 cascadeSplits[2];
+	// Shadow map depth of one texel of every cascade, 4 per vec4
+	vec4 cascadeDepthBias[2];
+	int numCascades;
+};
+
+uniform sampler2DArray shadowMaps;
 
 uniform sampler2D inInfo;
 uniform vec2 screenSize;
 
-uniform vec3 lightDir;
+// Per frame values shared by the terrain, water and vegetation programs (see Engine::GPU::FrameGlobalsBuffer)
+layout(std140, binding = 3) uniform FrameGlobals
+{
+	vec3 lightDir;
+	float time;
+	vec3 grass;
+	float grassCoverage;
+	vec3 rock;
+	float worldScale;
+	vec3 sand;
+	float renderRadius;
+	vec3 watercolor;
+	float waterspeed;
+	vec3 windDirection;
+	float windStrength;
+	float terrainAmplitude;
+	float terrainFrecuency;
+	float terrainScale;
+	int terrainOctaves;
+	float waterHeight;
+	float maxHeight;
+	float sinTime;
+};
+
 vec2 poissonDisk[4] = vec2[](
   vec2( -0.94201624, -0.39906216 ),
   vec2( 0.94558609, -0.76890725 ),
@@ -29,11 +61,11 @@ vec2 poissonDisk[4] = vec2[](
   vec2( 0.34495938, 0.29387760 )
 );
 
+#ifdef MULTI_DRAW
+layout (location=4) flat in ivec2 gridPos;
+#else
 uniform ivec2 gridPos;
-
-uniform float time;
-uniform vec3 watercolor;
-uniform float waterspeed;
+#endif
 
 // ================================================================================
 
@@ -92,38 +124,50 @@ float noiseHeight(in vec2 pos)
 }
 
 // =====================================================================
+// Same as terrain.frag
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0? 1.0 : -1.0, n.y >= 0.0? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+
 // Shadow map look up
 bool whithinRange(vec2 texCoord)
 {
 	return texCoord.x >= 0.0 && texCoord.x <= 1.0 && texCoord.y >= 0.0 && texCoord.y <= 1.0;
 }
 
+// Index of the first cascade whose frustum slice holds the view space position, numCascades if none does
+int selectCascade(vec3 viewPos)
+{
+	float depth = -viewPos.z;
+	int cascade = 0;
+	while (cascade < numCascades && depth > cascadeSplits[cascade / 4][cascade % 4])
+	{
+		cascade++;
+	}
+	return cascade;
+}
+
+// Same as terrain.frag
 float getShadowVisibility(vec3 rawNormal)
 {
-	float bias = clamp(0.005 * tan(acos(dot(rawNormal, lightDir))), 0.0, 0.01);
+	int cascade = selectCascade(inPos);
+	if (cascade >= numCascades)
+		return 1.0;
+
+	vec3 shadowMapPos = (cascadeMatrices[cascade] * vec4(inPos, 1.0)).xyz;
+	if (!whithinRange(shadowMapPos.xy))
+		return 1.0;
+
+	float slope = clamp(tan(acos(dot(rawNormal, lightDir))), 0.0, 4.0);
+	float curDepth = shadowMapPos.z - cascadeDepthBias[cascade / 4][cascade % 4] * (2.0 + 2.0 * slope);
 	float visibility = 1.0;
 
-	if(whithinRange(inShadowMapPos.xy))
-	{
-		float curDepth = inShadowMapPos.z - bias;
-		//visibility = texture(depthTexture, inShadowMapPos.xy).x  <  curDepth? 0.0 : 1.0;
-		
-		for (int i = 0; i < 4; i++)
-		{
-			visibility -= 0.25 * ( texture(depthTexture, inShadowMapPos.xy + poissonDisk[i] / 700.0).x  <  curDepth? 1.0 : 0.0 );
-		}
-		
-	}
-	else if(whithinRange(inShadowMapPos1.xy))
+	for (int i = 0; i < 4; i++)
 	{
-		float curDepth = inShadowMapPos1.z - bias;
-		//visibility = texture(depthTexture1, inShadowMapPos1.xy).x  <  curDepth? 0.0 : 1.0;
-	
-		for (int i = 0; i < 4; i++)
-		{
-			visibility -= 0.25 * ( texture( depthTexture1, inShadowMapPos1.xy + poissonDisk[i] / 700.0 ).x  <  curDepth? 1.0 : 0.0 );
-		}
-		
+		visibility -= 0.25 * ( texture(shadowMaps, vec3(shadowMapPos.xy + poissonDisk[i] / 700.0, float(cascade))).x  <  curDepth? 1.0 : 0.0 );
 	}
 
 	return visibility;
@@ -182,14 +226,13 @@ void main()
 	// OUTPUT TO G-BUFFERS
 	// ------------------------------------------------------------------------------
 	outColor = vec4(color, alpha);
-	outNormal = vec4(n, 1.0);
-	outPos = vec4(inPos, 1.0);
-	outInfo = vec4(0, visibility, 0, alpha);
+	outNormal = vec4(encodeNormal(n), 0.0, 1.0);
+	// Not blended (see WaterComponent), water replaces the terrain material
 #if defined WIRE_MODE || defined POINT_MODE
-	outSpecular = vec4(0);
+	outMaterial = vec4(0, visibility, 0, 0);
 	outEmissive = vec4(0);
 #else
-	outSpecular = vec4(0.5,0.5,0.5,1);
+	outMaterial = vec4(0, visibility, 0, 0.5);
 	outEmissive = vec4(0);
 #endif
 #endif
@@ -1,31 +1,85 @@
-#version 410 core
+#version 430 core
 
 // INPUT
 layout (location=0) in vec3 inPos;
 layout (location=1) in vec2 inUV;
+#ifdef MULTI_DRAW
+// Batch index of the tile (instance number offset by the indirect command base instance)
+layout (location=2) in uint inTileIndex;
+#endif
 
 // OUTPUT
 layout (location=0) out vec2 outUV;
 layout (location=1) out vec3 outPos;
-layout (location=2) out vec4 outShadowMapPos;
-layout (location=3) out vec4 outShadowMapPos1;
 
+// Per frame values shared by the terrain, water and vegetation programs (see Engine::GPU::FrameGlobalsBuffer)
+layout(std140, binding = 3) uniform FrameGlobals
+{
+	vec3 lightDir;
+	float time;
+	vec3 grass;
+	float grassCoverage;
+	vec3 rock;
+	float worldScale;
+	vec3 sand;
+	float renderRadius;
+	vec3 watercolor;
+	float waterspeed;
+	vec3 windDirection;
+	float windStrength;
+	float terrainAmplitude;
+	float terrainFrecuency;
+	float terrainScale;
+	int terrainOctaves;
+	float waterHeight;
+	float maxHeight;
+	float sinTime;
+};
+
+#ifdef MULTI_DRAW
+layout (location=4) flat out ivec2 outGridPos;
+
+layout (std430, binding=0) readonly buffer TileGridPositions
+{
+	ivec2 tileGridPos[];
+};
+
+// Appends the tile model matrix (world scale and grid translation) to a per pass matrix
+mat4 tileMatrix(in mat4 m, in ivec2 tile, in float tileHeight)
+{
+	vec4 translation = vec4(float(tile.x) * worldScale, tileHeight, float(tile.y) * worldScale, 1.0);
+	return mat4(m[0] * worldScale, m[1] * worldScale, m[2] * worldScale, m * translation);
+}
+#else
 uniform ivec2 gridPos;
+#endif
 
 uniform mat4 modelView;
 uniform mat4 modelViewProj;
+// Shadow map pass only
 uniform mat4 lightDepthMat;
-uniform mat4 lightDepthMat1;
 
 void main()
 {
+#ifdef MULTI_DRAW
+	ivec2 gridPos = tileGridPos[inTileIndex];
+	outGridPos = gridPos;
+
+	float tileHeight = waterHeight * worldScale * 1.5;
+	mat4 tileModelView = tileMatrix(modelView, gridPos, tileHeight);
+	mat4 tileModelViewProj = tileMatrix(modelViewProj, gridPos, tileHeight);
+	mat4 tileLightDepthMat = tileMatrix(lightDepthMat, gridPos, tileHeight);
+#else
+	mat4 tileModelView = modelView;
+	mat4 tileModelViewProj = modelViewProj;
+	mat4 tileLightDepthMat = lightDepthMat;
+#endif
+
 #ifndef SHADOW_MAP
-	gl_Position = modelViewProj * vec4(inPos, 1.0);
-	outPos = (modelView * vec4(inPos, 1.0)).xyz;
+	gl_Position = tileModelViewProj * vec4(inPos, 1.0);
+	outPos = (tileModelView * vec4(inPos, 1.0)).xyz;
 	outUV = abs(inUV + vec2(float(gridPos.x), float(gridPos.y)));
-	outShadowMapPos = lightDepthMat * vec4(inPos, 1.0);
-	outShadowMapPos1 = lightDepthMat1 * vec4(inPos, 1.0);
 #else
-	gl_Position = lightDepthMat * vec4(inPos, 1);
+	gl_Position = tileLightDepthMat * vec4(inPos, 1);
 #endif
 }
\ No newline at end of file
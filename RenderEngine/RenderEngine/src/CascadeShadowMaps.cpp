@@ -1,8 +1,19 @@
 #include "CascadeShadowMaps.h"
 
+#include <GL/glew.h>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "Scene.h"
+#include "Profiler.h"
+#include "GLStateCache.h"
+#include "WorldConfig.h"
+#include "RenderStatistics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
 
 Engine::CascadeShadowMaps * Engine::CascadeShadowMaps::INSTANCE = new Engine::CascadeShadowMaps();
 
@@ -11,8 +22,25 @@ Engine::CascadeShadowMaps & Engine::CascadeShadowMaps::getInstance()
 	return *Engine::CascadeShadowMaps::INSTANCE;
 }
 
+// Distance the shadow volumes extend towards the light beyond the cascade spheres, so casters
+// outside of the view frustum still shadow it
+const float CASTER_MARGIN = 150.0f;
+// Distance the culling volumes extend towards the light. The casters beyond the projection near
+// plane are still drawn, clamped to it
+const float CASTER_CULL_DISTANCE = 10000.0f;
+
 Engine::CascadeShadowMaps::CascadeShadowMaps()
+	:numCascades(0), currentLevel(0), casterSet(Engine::ShadowCasterSet::SHADOW_CASTERS_ALL), shadowMapArray(0), layeredFbo(0), uniformBuffer(0), previousFrameBuffer(0)
 {
+	data = ShadowCascadesData();
+	for (unsigned int i = 0; i < MAX_CASCADES; i++)
+	{
+		shadowMaps[i].splitNear = shadowMaps[i].splitFar = 0.0f;
+		shadowMaps[i].radius = shadowMaps[i].texelsPerMeter = 0.0f;
+		shadowMaps[i].cached = false;
+		shadowMaps[i].texelX = shadowMaps[i].texelY = 0;
+		shadowMaps[i].fbo = 0;
+	}
 }
 
 void Engine::CascadeShadowMaps::init()
@@ -25,44 +53,241 @@ void Engine::CascadeShadowMaps::init()
 		0.5, 0.5, 0.5, 1.0
 	);
 
-	// Initialize shadow maps
-	initializeShadowMap(0, -5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 70.0f);
-	initializeShadowMap(1, -40.0f, 40.0f, -40.0f, 40.0f, 0.1f, 120.0f);
+	Engine::Settings::shadowCascades = glm::clamp(Engine::Settings::shadowCascades, 1u, (unsigned int)MAX_CASCADES);
+	allocate(Engine::Settings::shadowCascades);
+}
+
+void Engine::CascadeShadowMaps::allocate(unsigned int cascades)
+{
+	release();
+	numCascades = cascades;
+
+	glGenTextures(1, &shadowMapArray);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D_ARRAY, shadowMapArray);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, RESOLUTION, RESOLUTION, numCascades, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	unsigned int previous = Engine::GLStateCache::getInstance().getDrawFramebuffer();
+
+	// One FBO per layer, casters are culled and drawn per cascade
+	for (unsigned int i = 0; i < numCascades; i++)
+	{
+		glGenFramebuffers(1, &shadowMaps[i].fbo);
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, shadowMaps[i].fbo);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMapArray, 0, i);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "CascadeShadowMaps: Incomplete framebuffer for cascade " << i << std::endl;
+		}
+	}
+
+	glGenFramebuffers(1, &layeredFbo);
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, layeredFbo);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMapArray, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		// Each layer is cleared on its own
+		Engine::GLStateCache::getInstance().deleteFramebuffer(layeredFbo);
+		layeredFbo = 0;
+	}
+
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, previous);
 }
 
-void Engine::CascadeShadowMaps::initializeShadowMap(int level, float minX, float maxX, float minY, float maxY, float minZ, float maxZ)
+void Engine::CascadeShadowMaps::release()
 {
-	shadowMaps[level].proj = glm::ortho<float>(minX, maxX, minY, maxY, minZ, maxZ);
-	shadowMaps[level].rtt = new Engine::DeferredRenderObject(0, true);
-	shadowMaps[level].shadowMap = shadowMaps[level].rtt->addDepthBuffer24(1024, 1024);
-	shadowMaps[level].rtt->initialize();
+	for (unsigned int i = 0; i < numCascades; i++)
+	{
+		Engine::GLStateCache::getInstance().deleteFramebuffer(shadowMaps[i].fbo);
+		shadowMaps[i].fbo = 0;
+	}
+
+	if (layeredFbo != 0)
+	{
+		Engine::GLStateCache::getInstance().deleteFramebuffer(layeredFbo);
+		layeredFbo = 0;
+	}
+
+	if (shadowMapArray != 0)
+	{
+		Engine::GLStateCache::getInstance().deleteTexture(shadowMapArray);
+		shadowMapArray = 0;
+	}
+
+	numCascades = 0;
 }
 
 void Engine::CascadeShadowMaps::initializeFrame(Engine::Camera * eye)
 {
-	Engine::DirectionalLight * dl = Engine::SceneManager::getInstance().getActiveScene()->getDirectionalLight();
-	const glm::vec3 & cameraPosition = eye->getPosition();
-	glm::vec3 target = glm::vec3(-cameraPosition.x, 0, -cameraPosition.z);
-	glm::mat4 depthViewMatrix = glm::lookAt(target + (dl->getDirection() * 50.0f), target, glm::vec3(0, 1, 0));
+	Engine::Settings::shadowCascades = glm::clamp(Engine::Settings::shadowCascades, 1u, (unsigned int)MAX_CASCADES);
+	if (Engine::Settings::shadowCascades != numCascades)
+	{
+		allocate(Engine::Settings::shadowCascades);
+	}
 
-	for (unsigned int i = 0; i < getCascadeLevels(); i++)
+	unsigned int cacheLayers = Engine::Settings::shadowCache ? numCascades : 0;
+	if (staticCache.getNumLayers() != cacheLayers)
 	{
-		shadowMaps[i].depth = shadowMaps[i].proj * depthViewMatrix;
+		if (cacheLayers > 0)
+			staticCache.allocate(cacheLayers);
+		else
+			staticCache.release();
 	}
 
+	computeCascades(eye);
+	uploadCascades();
+
 	renderShadows(eye);
 }
 
-void Engine::CascadeShadowMaps::beginShadowRender(int level)
+void Engine::CascadeShadowMaps::computeCascades(Engine::Camera * eye)
 {
-	currentLevel = level;
-	glBindFramebuffer(GL_FRAMEBUFFER, shadowMaps[currentLevel].rtt->getFrameBufferId());
-	glClear(GL_DEPTH_BUFFER_BIT);
+	Engine::DirectionalLight * dl = Engine::SceneManager::getInstance().getActiveScene()->getDirectionalLight();
+
+	// Perspective projection (see Camera::initProjectionMatrix())
+	const glm::mat4 & projection = eye->getProjectionMatrix();
+	const float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	const float farPlane = std::max(std::min(projection[3][2] / (projection[2][2] + 1.0f), Engine::Settings::shadowDistance), nearPlane * 2.0f);
+	const float lambda = glm::clamp(Engine::Settings::shadowSplitLambda, 0.0f, 1.0f);
+	// Squared tangent of the half diagonal field of view
+	const float tanX = 1.0f / projection[0][0];
+	const float tanY = 1.0f / projection[1][1];
+	const float t2 = tanX * tanX + tanY * tanY;
+
+	// The inverse view matrix is only updated on demand
+	const glm::mat4 invView = glm::inverse(eye->getViewMatrix());
+	const glm::vec3 eyePosition = glm::vec3(invView[3]);
+	const glm::vec3 forward = -glm::normalize(glm::vec3(invView[2]));
+
+	// Light space orientation, the translation is applied per cascade so it can be snapped
+	glm::vec3 lightDir = glm::normalize(dl->getDirection());
+	glm::vec3 up = fabsf(lightDir.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	lightRotation = glm::lookAt(glm::vec3(0.0f), -lightDir, up);
+	const glm::vec3 eyeLight = glm::vec3(lightRotation * glm::vec4(eyePosition, 1.0f));
+
+	staticCache.beginFrame(lightDir);
+
+	float splitNear = nearPlane;
+	for (unsigned int i = 0; i < numCascades; i++)
+	{
+		ShadowMap & map = shadowMaps[i];
+
+		// Practical split scheme
+		float p = float(i + 1) / float(numCascades);
+		float logSplit = nearPlane * powf(farPlane / nearPlane, p);
+		float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+		float splitFar = i + 1 == numCascades ? farPlane : lambda * logSplit + (1.0f - lambda) * uniformSplit;
+
+		// Smallest sphere through the corners of the slice [splitNear, splitFar], centered on the view
+		// axis. Only depends on the projection and the splits, so its size does not change as the
+		// camera rotates
+		float centerDepth = std::min((splitNear + splitFar) * (1.0f + t2) * 0.5f, splitFar);
+		float dz = splitFar - centerDepth;
+		// Widened by a texel on every side, the snapping below moves the projection up to a texel
+		float radius = sqrtf(dz * dz + splitFar * splitFar * t2) * float(RESOLUTION) / float(RESOLUTION - 2);
+
+		// Move the projection by whole texels only
+		float texelSize = 2.0f * radius / float(RESOLUTION);
+		glm::vec3 center = eyePosition + forward * centerDepth;
+		glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+		// Keep the texel from the first floor, dividing the snapped position again may round down to the previous one
+		int centerTexelX = int(floorf(lightCenter.x / texelSize));
+		int centerTexelY = int(floorf(lightCenter.y / texelSize));
+		lightCenter.x = float(centerTexelX) * texelSize;
+		lightCenter.y = float(centerTexelY) * texelSize;
+		map.texelX = centerTexelX - int(RESOLUTION / 2);
+		map.texelY = centerTexelY - int(RESOLUTION / 2);
+		int eyeTexelX = int(floorf(eyeLight.x / texelSize));
+		int eyeTexelY = int(floorf(eyeLight.y / texelSize));
+
+		// Light space depth range around the sphere. Cached cascades use the range of their cache
+		// layer instead, so the copied depth matches
+		float depthNear = lightCenter.z - radius;
+		float depthFar = lightCenter.z + radius;
+		map.cached = staticCache.getNumLayers() > i
+			&& staticCache.update(i, texelSize, eyeTexelX, eyeTexelY,
+				eyeLight.z, centerDepth + radius, map.texelX, map.texelY, RESOLUTION);
+		if (map.cached)
+		{
+			depthNear = staticCache.getDepthCenter(i) - staticCache.getDepthExtent(i);
+			depthFar = staticCache.getDepthCenter(i) + staticCache.getDepthExtent(i);
+		}
+
+		// The light looks down -z, casters between the light and the sphere are on +z
+		glm::mat4 lightProjection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+			lightCenter.y - radius, lightCenter.y + radius,
+			-(depthFar + CASTER_MARGIN), -depthNear);
+
+		glm::mat4 cullingProjection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+			lightCenter.y - radius, lightCenter.y + radius,
+			-(depthFar + CASTER_CULL_DISTANCE), -depthNear);
+
+		map.depth = lightProjection * lightRotation;
+		map.culling = cullingProjection * lightRotation;
+		map.splitNear = splitNear;
+		map.splitFar = splitFar;
+		map.center = center;
+		map.radius = radius;
+		map.texelsPerMeter = float(RESOLUTION) / (2.0f * radius);
+
+		data.cascadeMatrices[i] = biasMatrix * map.depth * invView;
+		data.splits[i] = splitFar;
+		data.depthBias[i] = texelSize / (depthFar - depthNear + CASTER_MARGIN);
+
+		splitNear = splitFar;
+	}
+
+	data.numCascades = int(numCascades);
 }
 
-void Engine::CascadeShadowMaps::endShadowRender()
+void Engine::CascadeShadowMaps::uploadCascades()
 {
-	shadowMaps[currentLevel].depth = biasMatrix * shadowMaps[currentLevel].depth;
+	if (uniformBuffer == 0)
+	{
+		glGenBuffers(1, &uniformBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Engine::ShadowCascadesData), &data, GL_DYNAMIC_DRAW);
+	}
+	else
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Engine::ShadowCascadesData), &data);
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING_POINT, uniformBuffer);
+	Engine::RenderStatistics::uniformUploads++;
+}
+
+void Engine::CascadeShadowMaps::beginShadowRender(int level)
+{
+	currentLevel = level;
+	passProjection = shadowMaps[currentLevel].depth;
+	passCulling = shadowMaps[currentLevel].culling;
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, shadowMaps[currentLevel].fbo);
+	if (layeredFbo == 0)
+	{
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	if (shadowMaps[currentLevel].cached)
+	{
+		ShadowMap & map = shadowMaps[currentLevel];
+		staticCache.copyToTexture(currentLevel, map.texelX, map.texelY, RESOLUTION, shadowMapArray, currentLevel);
+		casterSet = Engine::ShadowCasterSet::SHADOW_CASTERS_DYNAMIC;
+	}
+	else
+	{
+		casterSet = Engine::ShadowCasterSet::SHADOW_CASTERS_ALL;
+	}
 }
 
 const glm::mat4 & Engine::CascadeShadowMaps::getBiasMat()
@@ -72,32 +297,70 @@ const glm::mat4 & Engine::CascadeShadowMaps::getBiasMat()
 
 const glm::mat4 & Engine::CascadeShadowMaps::getShadowProjectionMat()
 {
-	return shadowMaps[currentLevel].depth;
+	return passProjection;
+}
+
+const glm::mat4 & Engine::CascadeShadowMaps::getShadowCullingMat()
+{
+	return passCulling;
+}
+
+Engine::ShadowCasterSet Engine::CascadeShadowMaps::getCasterSet()
+{
+	return casterSet;
+}
+
+unsigned int Engine::CascadeShadowMaps::getCurrentLevel()
+{
+	return (unsigned int)currentLevel;
 }
 
 unsigned int Engine::CascadeShadowMaps::getCascadeLevels()
 {
-	return 2;
+	return numCascades;
 }
 
-const glm::mat4 & Engine::CascadeShadowMaps::getDepthMatrix0()
+float Engine::CascadeShadowMaps::getSplitNear(unsigned int level)
 {
-	return shadowMaps[0].depth;
+	return shadowMaps[level].splitNear;
 }
 
-const glm::mat4 & Engine::CascadeShadowMaps::getDepthMatrix1()
+float Engine::CascadeShadowMaps::getSplitFar(unsigned int level)
 {
-	return shadowMaps[1].depth;
+	return shadowMaps[level].splitFar;
 }
 
-const Engine::TextureInstance * Engine::CascadeShadowMaps::getDepthTexture0()
+float Engine::CascadeShadowMaps::getTexelsPerMeter(unsigned int level)
 {
-	return shadowMaps[0].shadowMap;
+	return shadowMaps[level].texelsPerMeter;
+}
+
+size_t Engine::CascadeShadowMaps::getMemoryUsage()
+{
+	// 24 bits depth, stored as 32 bits
+	return size_t(RESOLUTION) * RESOLUTION * numCascades * 4;
+}
+
+unsigned int Engine::CascadeShadowMaps::getCachedCascades()
+{
+	unsigned int cached = 0;
+	for (unsigned int i = 0; i < numCascades; i++)
+	{
+		if (shadowMaps[i].cached)
+			cached++;
+	}
+	return cached;
 }
 
-const Engine::TextureInstance * Engine::CascadeShadowMaps::getDepthTexture1()
+size_t Engine::CascadeShadowMaps::getCacheMemoryUsage()
 {
-	return shadowMaps[1].shadowMap;
+	return staticCache.getMemoryUsage();
+}
+
+void Engine::CascadeShadowMaps::bindShadowMaps(unsigned int textureUnit)
+{
+	Engine::GLStateCache::getInstance().activeTexture(textureUnit);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D_ARRAY, shadowMapArray);
 }
 
 void Engine::CascadeShadowMaps::registerShadowCaster(Engine::ShadowCaster * caster)
@@ -107,19 +370,97 @@ void Engine::CascadeShadowMaps::registerShadowCaster(Engine::ShadowCaster * cast
 
 void Engine::CascadeShadowMaps::renderShadows(Engine::Camera * cam)
 {
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFrameBuffer);
+	Engine::ProfileScope profile("Shadow maps");
+	auto passStart = std::chrono::high_resolution_clock::now();
+
+	previousFrameBuffer = Engine::GLStateCache::getInstance().getDrawFramebuffer();
+	Engine::GLStateCache::getInstance().getViewport(previousViewport);
+	Engine::GLStateCache::getInstance().viewport(0, 0, RESOLUTION, RESOLUTION);
+	// Pancaking: casters closer to the light than the near plane still write their depth
+	Engine::GLStateCache::getInstance().enable(GL_DEPTH_CLAMP);
+
+	renderStaticCache(cam);
+	Engine::GLStateCache::getInstance().viewport(0, 0, RESOLUTION, RESOLUTION);
+
+	// Every cascade at once
+	if (layeredFbo != 0)
+	{
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, layeredFbo);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
 
 	for (unsigned int i = 0; i < getCascadeLevels(); i++)
 	{
+		Engine::ProfileScope cascadeProfile(("Cascade " + std::to_string(i)).c_str());
+
 		beginShadowRender(i);
 
 		for (auto & v : shadowCasters)
 		{
 			v->renderShadow(cam, getShadowProjectionMat());
 		}
+	}
+
+	casterSet = Engine::ShadowCasterSet::SHADOW_CASTERS_ALL;
+	Engine::GLStateCache::getInstance().disable(GL_DEPTH_CLAMP);
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, previousFrameBuffer);
+	Engine::GLStateCache::getInstance().viewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+	std::chrono::duration<double, std::milli> passTime = std::chrono::high_resolution_clock::now() - passStart;
+	Engine::RenderStatistics::shadowPassMs += passTime.count();
+}
+
+void Engine::CascadeShadowMaps::renderStaticCache(Engine::Camera * cam)
+{
+	Engine::ProfileScope profile("Shadow cache");
 
-		endShadowRender();
+	casterSet = Engine::ShadowCasterSet::SHADOW_CASTERS_STATIC;
+
+	std::vector<Engine::ShadowCachePiece> pieces;
+	for (unsigned int i = 0; i < numCascades; i++)
+	{
+		if (!shadowMaps[i].cached)
+			continue;
+
+		currentLevel = i;
+		float texelSize = 2.0f * shadowMaps[i].radius / float(RESOLUTION);
+		float depthNear = staticCache.getDepthCenter(i) - staticCache.getDepthExtent(i);
+		float depthFar = staticCache.getDepthCenter(i) + staticCache.getDepthExtent(i);
+
+		for (auto & region : staticCache.getDirtyRegions(i))
+		{
+			staticCache.getPieces(region, pieces);
+			for (auto & piece : pieces)
+			{
+				// Same texel grid and depth range as the cascade
+				float left = float(piece.global.x0) * texelSize;
+				float right = float(piece.global.x1) * texelSize;
+				float bottom = float(piece.global.y0) * texelSize;
+				float top = float(piece.global.y1) * texelSize;
+				passProjection = glm::ortho(left, right, bottom, top, -(depthFar + CASTER_MARGIN), -depthNear) * lightRotation;
+				passCulling = glm::ortho(left, right, bottom, top, -(depthFar + CASTER_CULL_DISTANCE), -depthNear) * lightRotation;
+
+				staticCache.beginPieceRender(i, piece);
+				for (auto & v : shadowCasters)
+				{
+					v->renderShadow(cam, getShadowProjectionMat());
+				}
+				staticCache.endPieceRender();
+			}
+		}
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, previousFrameBuffer);
-}
\ No newline at end of file
+	Engine::RenderStatistics::shadowCacheTexels += staticCache.getRenderedTexels();
+}
+
+void Engine::CascadeShadowMaps::destroy()
+{
+	release();
+	staticCache.release();
+
+	if (uniformBuffer != 0)
+	{
+		glDeleteBuffers(1, &uniformBuffer);
+		uniformBuffer = 0;
+	}
+}
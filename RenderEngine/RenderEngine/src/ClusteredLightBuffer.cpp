@@ -0,0 +1,201 @@
+#include "ClusteredLightBuffer.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+#include "GLStateCache.h"
+#include "WorldConfig.h"
+#include "RenderStatistics.h"
+#include "LightBufferManager.h"
+
+Engine::GPU::ClusteredLightBuffer * Engine::GPU::ClusteredLightBuffer::INSTANCE = new Engine::GPU::ClusteredLightBuffer();
+
+Engine::GPU::ClusteredLightBuffer & Engine::GPU::ClusteredLightBuffer::getInstance()
+{
+	return *Engine::GPU::ClusteredLightBuffer::INSTANCE;
+}
+
+// =====================================================================================
+
+// Below this amount of lights the clusters are built on the render thread
+const unsigned int MIN_LIGHTS_PER_THREAD = 256;
+
+Engine::GPU::ClusteredLightBuffer::ClusteredLightBuffer()
+	:gridBuffer(0), indexBuffer(0), indexCapacity(0), program(NULL), numLights(0), numIndices(0), gridCleared(false)
+{
+}
+
+Engine::GPU::ClusteredLightBuffer::~ClusteredLightBuffer()
+{
+	clean();
+}
+
+void Engine::GPU::ClusteredLightBuffer::update(Engine::Camera * camera)
+{
+	Engine::GPU::LightBufferManager::getInstance().updateLights();
+
+	builder.setProjection(camera->getProjectionMatrix());
+	computeSpheres(camera);
+
+	if (gridBuffer == 0)
+	{
+		glGenBuffers(1, &gridBuffer);
+		glGenBuffers(1, &indexBuffer);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * 2 * Engine::LightClusterBuilder::NUM_CLUSTERS, NULL, GL_DYNAMIC_DRAW);
+		gridCleared = false;
+	}
+
+	if (numLights == 0)
+	{
+		// Empty clusters, uploaded once
+		if (!gridCleared)
+		{
+			std::vector<unsigned int> empty(2 * Engine::LightClusterBuilder::NUM_CLUSTERS, 0);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridBuffer);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int) * empty.size(), &empty[0]);
+			reserve(indexBuffer, indexCapacity, 1, sizeof(unsigned int));
+			gridCleared = true;
+		}
+		numIndices = 0;
+	}
+	else
+	{
+		gridCleared = false;
+		if (Engine::Settings::lightClusterBuilder == Engine::LightClusterBuilderType::LIGHT_CLUSTERS_GPU)
+			buildOnGPU(camera);
+		else
+			buildOnCPU();
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GRID_BINDING_POINT, gridBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING_POINT, indexBuffer);
+}
+
+void Engine::GPU::ClusteredLightBuffer::computeSpheres(Engine::Camera * camera)
+{
+	// Free slots and disabled lights have no radius and stay out of every cluster
+	const std::vector<Engine::GPU::LightStorageData> & lights = Engine::GPU::LightBufferManager::getInstance().getLightStorage().getData();
+	const glm::mat4 & view = camera->getViewMatrix();
+	// Lights without attenuation reach the whole frustum
+	const float maxRadius = builder.getFarPlane();
+
+	numLights = (unsigned int)lights.size();
+	spheres.resize(numLights);
+
+	for (unsigned int i = 0; i < numLights; i++)
+	{
+		const Engine::GPU::LightStorageData & light = lights[i];
+		glm::vec4 pos = view * glm::vec4(light.position[0], light.position[1], light.position[2], 1.0f);
+
+		Engine::ClusterLight & sphere = spheres[i];
+		sphere.x = pos.x;
+		sphere.y = pos.y;
+		sphere.z = pos.z;
+		sphere.radius = std::min(light.position[3], maxRadius);
+	}
+}
+
+void Engine::GPU::ClusteredLightBuffer::buildOnCPU()
+{
+	builder.setLights(&spheres[0], numLights);
+	builder.build(numLights < MIN_LIGHTS_PER_THREAD ? 1 : 0);
+
+	const std::vector<unsigned int> & grid = builder.getGrid();
+	const std::vector<unsigned int> & indices = builder.getIndices();
+	numIndices = indices.size();
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int) * grid.size(), &grid[0]);
+
+	// Index count first, then the indices
+	unsigned int count = (unsigned int)numIndices;
+	reserve(indexBuffer, indexCapacity, 1 + numIndices, sizeof(unsigned int));
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int), &count);
+	if (numIndices > 0)
+	{
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int), sizeof(unsigned int) * numIndices, &indices[0]);
+	}
+	Engine::RenderStatistics::storageUploads += 2;
+}
+
+void Engine::GPU::ClusteredLightBuffer::buildOnGPU(Engine::Camera * camera)
+{
+	if (program == NULL)
+	{
+		program = new Engine::LightClusterProgram();
+		program->initialize();
+	}
+
+	// Room for every cluster at full capacity, the counter is reset every frame
+	unsigned int zero = 0;
+	reserve(indexBuffer, indexCapacity, 1 + size_t(Engine::LightClusterBuilder::NUM_CLUSTERS) * Engine::LightClusterProgram::MAX_LIGHTS_PER_CLUSTER, sizeof(unsigned int));
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int), &zero);
+	numIndices = 0;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GRID_BINDING_POINT, gridBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING_POINT, indexBuffer);
+
+	// The lights are stored in world space
+	const glm::mat4 & projection = camera->getProjectionMatrix();
+	Engine::GLStateCache::getInstance().useProgram(program->getProgramId());
+	program->setParameters(numLights, projection[0][0], projection[1][1], builder.getNearPlane(), builder.getFarPlane(), camera->getViewMatrix());
+	program->dispatchClusters(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void Engine::GPU::ClusteredLightBuffer::reserve(unsigned int & buffer, size_t & capacity, size_t size, size_t elementSize)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if (size <= capacity)
+		return;
+
+	capacity = std::max(size, capacity * 2);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * elementSize, NULL, GL_DYNAMIC_DRAW);
+}
+
+float Engine::GPU::ClusteredLightBuffer::getSliceScale() const
+{
+	return builder.getSliceScale();
+}
+
+float Engine::GPU::ClusteredLightBuffer::getSliceBias() const
+{
+	return builder.getSliceBias();
+}
+
+unsigned int Engine::GPU::ClusteredLightBuffer::getNumLights() const
+{
+	return numLights;
+}
+
+size_t Engine::GPU::ClusteredLightBuffer::getNumIndices() const
+{
+	return numIndices;
+}
+
+Engine::LightClusterValidation Engine::GPU::ClusteredLightBuffer::validate()
+{
+	builder.setLights(spheres.empty() ? NULL : &spheres[0], numLights);
+	builder.build();
+	return builder.validate();
+}
+
+void Engine::GPU::ClusteredLightBuffer::clean()
+{
+	if (gridBuffer != 0)
+	{
+		glDeleteBuffers(1, &gridBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+		gridBuffer = indexBuffer = 0;
+		indexCapacity = 0;
+	}
+
+	if (program != NULL)
+	{
+		program->destroy();
+		delete program;
+		program = NULL;
+	}
+}
@@ -1,43 +1,19 @@
 #include "ComputeProgram.h"
 
 #include <string>
+#include <chrono>
 #include <iostream>
-#include <fstream>
+#include <vector>
 #include <GL/glew.h>
 
-//#include "util/IOUtils.h"
-
-char * loadStringFromFile(const char * fileName, unsigned long long & fileLen)
-{
-	std::ifstream file;
-	file.open(fileName, std::ios::in);
-	if (!file)
-	{
-		return 0;
-	}
-
-	file.seekg(0, std::ios::end);
-	fileLen = file.tellg();
-	file.seekg(std::ios::beg);
-
-	char * content = new char[fileLen + 1];
-
-	int i = 0;
-	while (file.good())
-	{
-		content[i] = char(file.get());
-		if (!file.eof()) i++;
-		else fileLen = i;
-	}
-
-	content[fileLen] = '\0';
-	file.close();
-
-	return content;
-}
+#include "datatables/ShaderCache.h"
+#include "util/IOUtils.h"
+#include "GLStateCache.h"
 
 Engine::ComputeProgram::ComputeProgram(std::string shaderFile)
-	:computeShaderFile(shaderFile)
+	:glProgram(0)
+	,computeShader(0)
+	,computeShaderFile(shaderFile)
 {
 }
 
@@ -56,25 +32,39 @@ unsigned int Engine::ComputeProgram::getProgramId()
 
 void Engine::ComputeProgram::initialize()
 {
-	computeShader = loadShaderFile();
-	
-	glProgram = glCreateProgram();
+	std::string source = loadShaderSource();
+
+	Engine::ShaderCache & cache = Engine::ShaderCache::getInstance();
+	unsigned long long key = cache.computeKey(0, std::vector<unsigned int>(1, GL_COMPUTE_SHADER), std::vector<std::string>(1, source));
 
-	glAttachShader(glProgram, computeShader);
-	
-	glLinkProgram(glProgram);
+	glProgram = glCreateProgram();
+	computeShader = 0;
 
-	int linked;
-	glGetProgramiv(glProgram, GL_LINK_STATUS, &linked);
-	if (!linked)
+	if (!cache.loadProgram(computeShaderFile, key, glProgram))
 	{
-		GLint logLen;
-		glGetProgramiv(glProgram, GL_INFO_LOG_LENGTH, &logLen);
-		char *logString = new char[logLen];
-		glGetProgramInfoLog(glProgram, logLen, NULL, logString);
-		std::cout << "Error: " << logString << std::endl;
-		delete[] logString;
-		exit(-1);
+		auto start = std::chrono::high_resolution_clock::now();
+
+		computeShader = compileShader(source);
+		glAttachShader(glProgram, computeShader);
+
+		cache.prepareProgram(glProgram);
+		glLinkProgram(glProgram);
+
+		int linked;
+		glGetProgramiv(glProgram, GL_LINK_STATUS, &linked);
+		if (!linked)
+		{
+			GLint logLen;
+			glGetProgramiv(glProgram, GL_INFO_LOG_LENGTH, &logLen);
+			char *logString = new char[logLen];
+			glGetProgramInfoLog(glProgram, logLen, NULL, logString);
+			std::cout << "Error: " << logString << std::endl;
+			delete[] logString;
+			exit(-1);
+		}
+
+		std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - start;
+		cache.storeProgram(computeShaderFile, key, glProgram, buildTime.count());
 	}
 
 	configureProgram();
@@ -88,28 +78,41 @@ void Engine::ComputeProgram::dispatch(unsigned int xDim, unsigned int yDim, unsi
 
 void Engine::ComputeProgram::destroy()
 {
-	glDetachShader(glProgram, computeShader);
-	glDeleteShader(computeShader);
+	// Programs loaded from the ShaderCache have no shader
+	if (computeShader != 0)
+	{
+		glDetachShader(glProgram, computeShader);
+		glDeleteShader(computeShader);
+	}
 
-	glDeleteProgram(glProgram);
+	Engine::GLStateCache::getInstance().deleteProgram(glProgram);
 }
 
-unsigned int Engine::ComputeProgram::loadShaderFile()
+std::string Engine::ComputeProgram::loadShaderSource()
 {
-	size_t fileLen;
-	std::string temp = computeShaderFile;
-	char * source = loadStringFromFile(temp.c_str(), fileLen);
+	unsigned long long fileLen;
+	char * source = Engine::IO::loadStringFromFile(computeShaderFile.c_str(), fileLen);
+	if (source == 0)
+	{
+		std::cout << "ComputeProgram: Could not read " << computeShaderFile << std::endl;
+		exit(-1);
+	}
 
-	std::string buf(source);
+	std::string result(source, fileLen);
+	delete[] source;
 
-	char * result = new char[fileLen];
-	memcpy(result, buf.c_str(), fileLen);
+	return result;
+}
+
+unsigned int Engine::ComputeProgram::compileShader(const std::string & source)
+{
+	const GLchar * sourceStr = source.c_str();
+	GLint sourceLen = (GLint)source.size();
 
 	GLuint shader;
 	shader = glCreateShader(GL_COMPUTE_SHADER);
-	glShaderSource(shader, 1, (const GLchar **)&result, (const GLint *)&fileLen);
+	glShaderSource(shader, 1, &sourceStr, &sourceLen);
 	glCompileShader(shader);
-	delete[] source;
 
 	GLint compiled;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
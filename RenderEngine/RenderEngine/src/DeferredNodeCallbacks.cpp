@@ -20,7 +20,7 @@ Engine::DeferredCallback::~DeferredCallback()
 
 }
 
-void Engine::DeferredCallback::initialize(Engine::Object *obj, Program * prog, Engine::DeferredRenderObject * buffer)
+void Engine::DeferredCallback::initialize(Engine::Object *obj, Program * prog)
 {
 
 }
@@ -6,6 +6,7 @@
 #include "textures/Texture2D.h"
 
 #include "datatables/DeferredObjectsTable.h"
+#include "GLStateCache.h"
 
 #include <iostream>
 
@@ -43,6 +44,7 @@ Engine::DeferredRenderObject::DeferredRenderObject(unsigned int numBuffers, bool
 	Engine::DeferredObjectsTable::getInstance().registerDeferredObject(this);
 
 	widthMod = heightMod = 1.0;
+	width = height = 0;
 }
 
 Engine::DeferredRenderObject::~DeferredRenderObject()
@@ -185,8 +187,12 @@ void Engine::DeferredRenderObject::initialize()
 		colorBuffers[i].texture->configureTexture();
 	}
 
-	depthBuffer.texture->generateTexture();
-	depthBuffer.texture->configureTexture();
+	// Depth is optional
+	if (depthBuffer.texture != NULL)
+	{
+		depthBuffer.texture->generateTexture();
+		depthBuffer.texture->configureTexture();
+	}
 }
 
 void Engine::DeferredRenderObject::setResizeMod(float wm, float hm)
@@ -207,9 +213,15 @@ void Engine::DeferredRenderObject::resizeFBO(unsigned int w, unsigned int h)
 		colorBuffers[i].texture->resize(w, h);
 	}
 
-	depthBuffer.texture->resize(w, h);
+	if (depthBuffer.texture != NULL)
+	{
+		depthBuffer.texture->resize(w, h);
+	}
+
+	width = w;
+	height = h;
 
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, fbo);
 
 	GLenum * buffers = new GLenum[colorBuffersSize];
 	for (unsigned int i = 0; i < colorBuffersSize; i++)
@@ -218,7 +230,10 @@ void Engine::DeferredRenderObject::resizeFBO(unsigned int w, unsigned int h)
 		buffers[i] = colorBuffers[i].bufferType;
 	}
 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthBuffer.texture->getTexture()->getTextureId(), 0); 
+	if (depthBuffer.texture != NULL)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthBuffer.texture->getTexture()->getTextureId(), 0);
+	}
 	
 	if (colorBuffersSize > 0)
 	{
@@ -234,7 +249,7 @@ void Engine::DeferredRenderObject::resizeFBO(unsigned int w, unsigned int h)
 		exit(-1);
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Engine::DeferredRenderObject::populateDeferredObject(Engine::PostProcessObject * object)
@@ -244,8 +259,35 @@ void Engine::DeferredRenderObject::populateDeferredObject(Engine::PostProcessObj
 		object->addTexture("color_" + std::to_string(i), colorBuffers[i].texture);
 	}
 
-	if (renderDepth)
+	if (renderDepth && depthBuffer.texture != NULL)
 	{
 		object->addTexture("depth", depthBuffer.texture);
 	}
+}
+
+unsigned int Engine::DeferredRenderObject::getWidth() const
+{
+	return width;
+}
+
+unsigned int Engine::DeferredRenderObject::getHeight() const
+{
+	return height;
+}
+
+size_t Engine::DeferredRenderObject::getMemoryUsage() const
+{
+	size_t texels = size_t(width) * size_t(height);
+	size_t bytes = 0;
+	for (unsigned int i = 0; i < colorBuffersSize; i++)
+	{
+		bytes += texels * Engine::AbstractTexture::getTexelSize(colorBuffers[i].texture->getTexture()->getMemoryLayoutFormat());
+	}
+
+	if (depthBuffer.texture != NULL)
+	{
+		bytes += texels * Engine::AbstractTexture::getTexelSize(depthBuffer.texture->getTexture()->getMemoryLayoutFormat());
+	}
+
+	return bytes;
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "FrameGlobalsBuffer.h"
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "WorldConfig.h"
+#include "TimeAccesor.h"
+#include "RenderStatistics.h"
+
+Engine::GPU::FrameGlobalsBuffer * Engine::GPU::FrameGlobalsBuffer::INSTANCE = new Engine::GPU::FrameGlobalsBuffer();
+
+Engine::GPU::FrameGlobalsBuffer & Engine::GPU::FrameGlobalsBuffer::getInstance()
+{
+	return *Engine::GPU::FrameGlobalsBuffer::INSTANCE;
+}
+
+// =====================================================================================
+
+static void copyVec3(float * dst, const glm::vec3 & src)
+{
+	dst[0] = src.x;
+	dst[1] = src.y;
+	dst[2] = src.z;
+}
+
+Engine::GPU::FrameGlobalsBuffer::FrameGlobalsBuffer()
+	:buffer(0)
+{
+}
+
+Engine::GPU::FrameGlobalsBuffer::~FrameGlobalsBuffer()
+{
+	clean();
+}
+
+void Engine::GPU::FrameGlobalsBuffer::update()
+{
+	copyVec3(data.lightDir, glm::normalize(Engine::Settings::lightDirection));
+	data.time = Engine::Time::timeSinceBegining;
+	copyVec3(data.grass, Engine::Settings::grassColor);
+	data.grassCoverage = 1.0f - Engine::Settings::grassCoverage;
+	copyVec3(data.rock, Engine::Settings::rockColor);
+	data.worldScale = Engine::Settings::worldTileScale;
+	copyVec3(data.sand, Engine::Settings::sandColor);
+	data.renderRadius = (float)Engine::Settings::worldRenderRadius;
+	copyVec3(data.watercolor, Engine::Settings::waterColor);
+	data.waterspeed = Engine::Settings::waterSpeed;
+	copyVec3(data.windDirection, Engine::Settings::windDirection);
+	data.windStrength = Engine::Settings::windStrength;
+	data.terrainAmplitude = Engine::Settings::terrainAmplitude;
+	data.terrainFrecuency = Engine::Settings::terrainFrecuency;
+	data.terrainScale = Engine::Settings::terrainScale;
+	data.terrainOctaves = int(Engine::Settings::terrainOctaves);
+	data.waterHeight = Engine::Settings::waterHeight;
+	data.maxHeight = Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight;
+	float sinTime = glm::sin(Engine::Time::timeSinceBegining);
+	data.sinTime = sinTime * sinTime;
+	data.padding = 0.0f;
+
+	if (buffer == 0)
+	{
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Engine::GPU::FrameGlobalsData), &data, GL_DYNAMIC_DRAW);
+	}
+	else
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Engine::GPU::FrameGlobalsData), &data);
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING_POINT, buffer);
+	Engine::RenderStatistics::uniformUploads++;
+}
+
+const Engine::GPU::FrameGlobalsData & Engine::GPU::FrameGlobalsBuffer::getData() const
+{
+	return data;
+}
+
+void Engine::GPU::FrameGlobalsBuffer::clean()
+{
+	if (buffer != 0)
+	{
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+}
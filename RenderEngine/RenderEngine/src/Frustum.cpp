@@ -0,0 +1,101 @@
+#include "Frustum.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_SSE2
+#include <emmintrin.h>
+#endif
+
+Engine::Frustum::Frustum()
+{
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+Engine::Frustum::Frustum(const glm::mat4 & viewProjection)
+{
+	extract(viewProjection);
+}
+
+void Engine::Frustum::extract(const glm::mat4 & viewProjection)
+{
+	// Gribb & Hartmann. glm is column major, so row k is (m[0][k], m[1][k], m[2][k], m[3][k])
+	const glm::mat4 & m = viewProjection;
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	planes[0] = row3 + row0;
+	planes[1] = row3 - row0;
+	planes[2] = row3 + row1;
+	planes[3] = row3 - row1;
+	planes[4] = row3 + row2;
+	planes[5] = row3 - row2;
+
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+		{
+			planes[i] /= length;
+		}
+	}
+}
+
+bool Engine::Frustum::testAABB(const glm::vec3 & min, const glm::vec3 & max) const
+{
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		const glm::vec4 & p = planes[i];
+
+		// Box corner furthest along the plane normal
+		glm::vec3 positive(p.x > 0.0f ? max.x : min.x, p.y > 0.0f ? max.y : min.y, p.z > 0.0f ? max.z : min.z);
+		if (p.x * positive.x + p.y * positive.y + p.z * positive.z + p.w < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Engine::Frustum::testAABBBatch(const float * minX, const float * minY, const float * minZ,
+	const float * maxX, const float * maxY, const float * maxZ,
+	unsigned char * visible, size_t count) const
+{
+	size_t k = 0;
+
+#ifdef FRUSTUM_SSE2
+	for (; k + 4 <= count; k += 4)
+	{
+		__m128 outside = _mm_setzero_ps();
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			const glm::vec4 & p = planes[i];
+
+			// The furthest corner only depends on the plane normal signs, so just pick the arrays
+			__m128 x = _mm_loadu_ps((p.x > 0.0f ? maxX : minX) + k);
+			__m128 y = _mm_loadu_ps((p.y > 0.0f ? maxY : minY) + k);
+			__m128 z = _mm_loadu_ps((p.z > 0.0f ? maxZ : minZ) + k);
+
+			// Same order of operations as testAABB(), so both give the same result
+			__m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(p.x)), _mm_mul_ps(y, _mm_set1_ps(p.y)));
+			distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(p.z))), _mm_set1_ps(p.w));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		visible[k] = (mask & 0x1) == 0;
+		visible[k + 1] = (mask & 0x2) == 0;
+		visible[k + 2] = (mask & 0x4) == 0;
+		visible[k + 3] = (mask & 0x8) == 0;
+	}
+#endif
+
+	for (; k < count; k++)
+	{
+		visible[k] = testAABB(glm::vec3(minX[k], minY[k], minZ[k]), glm::vec3(maxX[k], maxY[k], maxZ[k])) ? 1 : 0;
+	}
+}
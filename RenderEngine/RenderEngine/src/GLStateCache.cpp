@@ -0,0 +1,376 @@
+#include "GLStateCache.h"
+
+#include "RenderStatistics.h"
+
+Engine::GLStateCache * Engine::GLStateCache::INSTANCE = new Engine::GLStateCache();
+
+Engine::GLStateCache & Engine::GLStateCache::getInstance()
+{
+	return *INSTANCE;
+}
+
+// Starts with the state of a newly created context
+Engine::GLStateCache::GLStateCache()
+	:program(0)
+	,vertexArray(0)
+	,drawFramebuffer(0)
+	,readFramebuffer(0)
+	,activeUnit(0)
+	,blendSrc(GL_ONE)
+	,blendDst(GL_ZERO)
+	,viewportKnown(false)
+	,clearColorKnown(true)
+{
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		for (unsigned int j = 0; j < TARGET_COUNT; j++)
+		{
+			textures[i][j] = 0;
+		}
+	}
+
+	for (unsigned int i = 0; i < CAP_COUNT; i++)
+	{
+		capabilities[i] = 0;
+	}
+
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		viewportRect[i] = 0;
+		clearColorValue[i] = 0.0f;
+	}
+}
+
+int Engine::GLStateCache::getTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return TARGET_2D;
+	case GL_TEXTURE_3D:
+		return TARGET_3D;
+	case GL_TEXTURE_CUBE_MAP:
+		return TARGET_CUBE_MAP;
+	case GL_TEXTURE_2D_ARRAY:
+		return TARGET_2D_ARRAY;
+	default:
+		return -1;
+	}
+}
+
+int Engine::GLStateCache::getCapabilityIndex(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST:
+		return CAP_DEPTH_TEST;
+	case GL_BLEND:
+		return CAP_BLEND;
+	case GL_CULL_FACE:
+		return CAP_CULL_FACE;
+	default:
+		return -1;
+	}
+}
+
+void Engine::GLStateCache::useProgram(GLuint newProgram)
+{
+	if (program == newProgram)
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	glUseProgram(newProgram);
+	program = newProgram;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+void Engine::GLStateCache::bindVertexArray(GLuint newVertexArray)
+{
+	if (vertexArray == newVertexArray)
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	glBindVertexArray(newVertexArray);
+	vertexArray = newVertexArray;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+void Engine::GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+
+	if ((!draw || drawFramebuffer == framebuffer) && (!read || readFramebuffer == framebuffer))
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	glBindFramebuffer(target, framebuffer);
+	if (draw)
+		drawFramebuffer = framebuffer;
+	if (read)
+		readFramebuffer = framebuffer;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+void Engine::GLStateCache::activeTexture(GLenum unit)
+{
+	GLuint index = unit - GL_TEXTURE0;
+	if (activeUnit == index)
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	glActiveTexture(unit);
+	activeUnit = index;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+void Engine::GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+	int targetIndex = getTargetIndex(target);
+	bool tracked = targetIndex >= 0 && activeUnit < MAX_TEXTURE_UNITS;
+
+	if (tracked && textures[activeUnit][targetIndex] == texture)
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	glBindTexture(target, texture);
+	if (tracked)
+		textures[activeUnit][targetIndex] = texture;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+void Engine::GLStateCache::setCapability(GLenum capability, bool enabled)
+{
+	int index = getCapabilityIndex(capability);
+	int value = enabled ? 1 : 0;
+
+	if (index >= 0 && capabilities[index] == value)
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+
+	if (index >= 0)
+		capabilities[index] = value;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+void Engine::GLStateCache::enable(GLenum capability)
+{
+	setCapability(capability, true);
+}
+
+void Engine::GLStateCache::disable(GLenum capability)
+{
+	setCapability(capability, false);
+}
+
+void Engine::GLStateCache::blendFunc(GLenum src, GLenum dst)
+{
+	if (blendSrc == src && blendDst == dst)
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	glBlendFunc(src, dst);
+	blendSrc = src;
+	blendDst = dst;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+void Engine::GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (viewportKnown && viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width && viewportRect[3] == height)
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	glViewport(x, y, width, height);
+	viewportRect[0] = x;
+	viewportRect[1] = y;
+	viewportRect[2] = width;
+	viewportRect[3] = height;
+	viewportKnown = true;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+void Engine::GLStateCache::clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	if (clearColorKnown && clearColorValue[0] == r && clearColorValue[1] == g && clearColorValue[2] == b && clearColorValue[3] == a)
+	{
+		Engine::RenderStatistics::filteredStateChanges++;
+		return;
+	}
+
+	glClearColor(r, g, b, a);
+	clearColorValue[0] = r;
+	clearColorValue[1] = g;
+	clearColorValue[2] = b;
+	clearColorValue[3] = a;
+	clearColorKnown = true;
+	Engine::RenderStatistics::issuedStateChanges++;
+}
+
+GLuint Engine::GLStateCache::getProgram()
+{
+	if (program == UNKNOWN)
+	{
+		GLint value;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+		program = GLuint(value);
+	}
+
+	return program;
+}
+
+GLuint Engine::GLStateCache::getVertexArray()
+{
+	if (vertexArray == UNKNOWN)
+	{
+		GLint value;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+		vertexArray = GLuint(value);
+	}
+
+	return vertexArray;
+}
+
+GLuint Engine::GLStateCache::getDrawFramebuffer()
+{
+	if (drawFramebuffer == UNKNOWN)
+	{
+		GLint value;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &value);
+		drawFramebuffer = GLuint(value);
+	}
+
+	return drawFramebuffer;
+}
+
+GLuint Engine::GLStateCache::getReadFramebuffer()
+{
+	if (readFramebuffer == UNKNOWN)
+	{
+		GLint value;
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &value);
+		readFramebuffer = GLuint(value);
+	}
+
+	return readFramebuffer;
+}
+
+void Engine::GLStateCache::getViewport(GLint * rect)
+{
+	if (!viewportKnown)
+	{
+		glGetIntegerv(GL_VIEWPORT, viewportRect);
+		viewportKnown = true;
+	}
+
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		rect[i] = viewportRect[i];
+	}
+}
+
+void Engine::GLStateCache::getClearColor(GLfloat * color)
+{
+	if (!clearColorKnown)
+	{
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColorValue);
+		clearColorKnown = true;
+	}
+
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		color[i] = clearColorValue[i];
+	}
+}
+
+void Engine::GLStateCache::deleteProgram(GLuint deleted)
+{
+	glDeleteProgram(deleted);
+
+	// A program in use is only flagged for deletion, it stays current
+	// until another one is bound
+	if (program == deleted)
+		program = UNKNOWN;
+}
+
+void Engine::GLStateCache::deleteVertexArray(GLuint deleted)
+{
+	glDeleteVertexArrays(1, &deleted);
+
+	if (vertexArray == deleted)
+		vertexArray = 0;
+}
+
+void Engine::GLStateCache::deleteFramebuffer(GLuint deleted)
+{
+	glDeleteFramebuffers(1, &deleted);
+
+	if (drawFramebuffer == deleted)
+		drawFramebuffer = 0;
+	if (readFramebuffer == deleted)
+		readFramebuffer = 0;
+}
+
+void Engine::GLStateCache::deleteTexture(GLuint deleted)
+{
+	glDeleteTextures(1, &deleted);
+
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		for (unsigned int j = 0; j < TARGET_COUNT; j++)
+		{
+			if (textures[i][j] == deleted)
+				textures[i][j] = 0;
+		}
+	}
+}
+
+void Engine::GLStateCache::invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	drawFramebuffer = UNKNOWN;
+	readFramebuffer = UNKNOWN;
+	activeUnit = UNKNOWN;
+
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		for (unsigned int j = 0; j < TARGET_COUNT; j++)
+		{
+			textures[i][j] = UNKNOWN;
+		}
+	}
+
+	for (unsigned int i = 0; i < CAP_COUNT; i++)
+	{
+		capabilities[i] = -1;
+	}
+
+	// Not valid blending factors
+	blendSrc = UNKNOWN;
+	blendDst = UNKNOWN;
+
+	viewportKnown = false;
+	clearColorKnown = false;
+}
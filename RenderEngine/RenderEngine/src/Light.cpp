@@ -8,8 +8,8 @@
 Engine::Light::Light(std::string name)
 	:name(name)
 {
+	dirtyFlags = LIGHT_DIRTY_TRANSFORM | LIGHT_DIRTY_PROPERTIES;
 	setEnabled(true);
-	update = true;
 
 	modelMatrix = glm::mat4(1.0f);
 }
@@ -26,6 +26,7 @@ const std::string & Engine::Light::getName() const
 void Engine::Light::setEnabled(bool val)
 {
 	enabled = val;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 const bool Engine::Light::isEnabled() const
@@ -40,12 +41,17 @@ const glm::mat4 & Engine::Light::getModelMatrix() const
 
 bool Engine::Light::requiresUpdate()
 {
-	return update;
+	return dirtyFlags != 0;
+}
+
+unsigned int Engine::Light::getDirtyFlags() const
+{
+	return dirtyFlags;
 }
 
 void Engine::Light::clearUpdateFlag()
 {
-	update = false;
+	dirtyFlags = 0;
 }
 
 void Engine::Light::setBufferIndex(unsigned int bi)
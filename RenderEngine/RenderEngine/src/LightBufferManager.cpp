@@ -2,8 +2,6 @@
 
 #include <GL/glew.h>
 #include <map>
-#include <vector>
-#include <iostream>
 
 #include "lights/DirectionalLight.h"
 #include "lights/PointLight.h"
@@ -19,6 +17,7 @@ Engine::GPU::LightBufferManager & Engine::GPU::LightBufferManager::getInstance()
 // =====================================================================================
 
 Engine::GPU::LightBufferManager::LightBufferManager()
+	:gboDL(0)
 {
 }
 
@@ -40,9 +39,6 @@ void Engine::GPU::LightBufferManager::onSceneStart()
 
 void Engine::GPU::LightBufferManager::initializeBuffers(Engine::Scene * scene)
 {
-	// FIXME
-	// ADD SUPPORT FOR SCENE DYNAMIC LIGHT ADD / REMOVAL
-
 	Engine::DirectionalLight * dl = scene->getDirectionalLight();
 	const std::map<std::string, Engine::PointLight *> & pl = scene->getPointLights();
 	const std::map<std::string, Engine::SpotLight *> & sl = scene->getSpotLights();
@@ -55,51 +51,30 @@ void Engine::GPU::LightBufferManager::initializeBuffers(Engine::Scene * scene)
 		glBufferData(GL_UNIFORM_BUFFER, sizeof(Engine::DirectionalLightData), &dl->getData(), GL_DYNAMIC_DRAW);
 	}
 
-	if (pl.size() > 0)
+	// Lights added later on are stored as the scene receives them
+	std::map<std::string, Engine::PointLight *>::const_iterator pit = pl.cbegin();
+	for (; pit != pl.cend(); pit++)
 	{
-		// Point lights
-		glGenBuffers(1, &gboPL);
-		glBindBuffer(GL_UNIFORM_BUFFER, gboPL);
-		
-		std::vector<Engine::PointLightData> plData(pl.size());
-		std::map<std::string, Engine::PointLight *>::const_iterator cit = pl.cbegin();
-		while (cit != pl.cend())
-		{
-			plData.push_back(cit->second->getData());
-			cit++;
-		}
-
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(Engine::PointLightData) * plData.size(), &plData[0], GL_DYNAMIC_DRAW);
+		storage.addPointLight(pit->second);
 	}
 
-	if (sl.size() > 0)
+	std::map<std::string, Engine::SpotLight *>::const_iterator sit = sl.cbegin();
+	for (; sit != sl.cend(); sit++)
 	{
-		// Spot lights
-		glGenBuffers(1, &gboSL);
-		glBindBuffer(GL_UNIFORM_BUFFER, gboSL);
-
-		std::vector<Engine::SpotLightData> slData(sl.size());
-		std::map<std::string, Engine::SpotLight *>::const_iterator cit = sl.cbegin();
-		while (cit != sl.end())
-		{
-			slData.push_back(cit->second->getData());
-			cit++;
-		}
-
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(Engine::SpotLightData) * slData.size(), &slData[0], GL_DYNAMIC_DRAW);
+		storage.addSpotLight(sit->second);
 	}
 }
 
 void Engine::GPU::LightBufferManager::clean()
 {
-	if (gboDL != -1)
+	if (gboDL != 0)
+	{
 		glDeleteBuffers(1, &gboDL);
+		gboDL = 0;
+	}
 
-	if (gboPL != -1)
-		glDeleteBuffers(1, &gboPL);
-
-	if (gboSL != -1)
-		glDeleteBuffers(1, &gboSL);
+	storage.clear();
+	storage.destroy();
 }
 
 void Engine::GPU::LightBufferManager::enableDirectionalLightBuffer()
@@ -107,31 +82,11 @@ void Engine::GPU::LightBufferManager::enableDirectionalLightBuffer()
 	glBindBuffer(GL_UNIFORM_BUFFER, gboDL);
 }
 
-void Engine::GPU::LightBufferManager::enablePointLightBuffer()
-{
-	glBindBuffer(GL_UNIFORM_BUFFER, gboPL);
-}
-
-void Engine::GPU::LightBufferManager::enableSpotLightBuffer()
-{
-	glBindBuffer(GL_UNIFORM_BUFFER, gboSL);
-}
-
 void Engine::GPU::LightBufferManager::enableDirectionalLightBufferAtIndex(unsigned int index)
 {
 	glBindBufferBase(GL_UNIFORM_BUFFER, index, gboDL);
 }
 
-void Engine::GPU::LightBufferManager::enablePointLightBufferAtIndex(unsigned int index)
-{
-	glBindBufferBase(GL_UNIFORM_BUFFER, index, gboPL);
-}
-
-void Engine::GPU::LightBufferManager::enableSpotLightBufferAtIndex(unsigned int index)
-{
-	glBindBufferBase(GL_UNIFORM_BUFFER, index, gboSL);
-}
-
 void Engine::GPU::LightBufferManager::updateDirectionalLight(DirectionalLight * dl, bool onlyViewDependent)
 {
 	size_t structSize = sizeof(Engine::DirectionalLightData);
@@ -145,29 +100,28 @@ void Engine::GPU::LightBufferManager::updateDirectionalLight(DirectionalLight *
 	}
 }
 
-void Engine::GPU::LightBufferManager::updatePointLight(PointLight * pl, bool onlyViewDependent)
+void Engine::GPU::LightBufferManager::addPointLight(PointLight * pl)
 {
-	size_t structSize = sizeof(Engine::PointLight);
-	if (onlyViewDependent)
-	{
-		glBufferSubData(GL_UNIFORM_BUFFER, structSize * pl->getBufferIndex(), sizeof(float) * 4, pl->getData().position);
-	}
-	else
-	{
-		glBufferSubData(GL_UNIFORM_BUFFER, structSize * pl->getBufferIndex(), structSize, &pl->getData());
-	}
+	storage.addPointLight(pl);
 }
 
-void Engine::GPU::LightBufferManager::updateSpotLight(SpotLight * sl, bool onlyViewDependent)
+void Engine::GPU::LightBufferManager::addSpotLight(SpotLight * sl)
 {
-	size_t structSize = sizeof(Engine::SpotLightData);
-	if (onlyViewDependent)
-	{
-		// 8: 4 pos + 4 dir
-		glBufferSubData(GL_UNIFORM_BUFFER, structSize * sl->getBufferIndex(), sizeof(float) * 8, &sl->getData().direction);
-	}
-	else
-	{
-		glBufferSubData(GL_UNIFORM_BUFFER, structSize * sl->getBufferIndex(), structSize, &sl->getData());
-	}
-}
\ No newline at end of file
+	storage.addSpotLight(sl);
+}
+
+void Engine::GPU::LightBufferManager::removeLight(Light * light)
+{
+	storage.removeLight(light);
+}
+
+void Engine::GPU::LightBufferManager::updateLights()
+{
+	storage.update();
+	storage.bind(LIGHTS_BINDING_POINT);
+}
+
+const Engine::GPU::LightStorage & Engine::GPU::LightBufferManager::getLightStorage() const
+{
+	return storage;
+}
@@ -0,0 +1,453 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "LightClusterBuilder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+#include <emmintrin.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Widening of the tile ranges (in tiles) and the light depth ranges (relative), so float
+// rounding never drops a cluster the sphere / box test would accept
+const float TILE_MARGIN = 1.0e-3f;
+const float DEPTH_MARGIN = 1.0e-5f;
+
+// Lights spread over the first 250 units of the frustum, with a LCG so every run is the same
+static void generateLights(const glm::mat4 & projection, float nearPlane, unsigned int count, std::vector<Engine::ClusterLight> & lights)
+{
+	lights.resize(count);
+	unsigned long long state = 0x9e3779b97f4a7c15ULL + count;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float u[4];
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			u[k] = float(state >> 40) / float(1 << 24);
+		}
+
+		float depth = nearPlane + u[2] * 250.0f;
+		lights[i].x = (u[0] * 2.0f - 1.0f) * depth / projection[0][0];
+		lights[i].y = (u[1] * 2.0f - 1.0f) * depth / projection[1][1];
+		lights[i].z = -depth;
+		lights[i].radius = 1.0f + u[3] * 15.0f;
+	}
+}
+
+float Engine::LightClusterBuilder::computeRadius(const float * attenuation, float intensity, float maxRadius)
+{
+	// Distance where intensity / (c + l * d + q * d^2) = 1 / 256
+	const float c = attenuation[0];
+	const float l = attenuation[1];
+	const float q = attenuation[2];
+	const float target = intensity * 256.0f;
+
+	if (target <= c)
+		return 0.0f;
+
+	float radius = maxRadius;
+	if (q > 0.0f)
+		radius = (-l + sqrtf(l * l - 4.0f * q * (c - target))) / (2.0f * q);
+	else if (l > 0.0f)
+		radius = (target - c) / l;
+
+	return std::min(radius, maxRadius);
+}
+
+Engine::LightClusterBuilder::LightClusterBuilder()
+	:xScale(0.0f), yScale(0.0f), nearPlane(0.0f), farPlane(0.0f), numLights(0)
+{
+	clusterLights.resize(NUM_CLUSTERS);
+	grid.resize(NUM_CLUSTERS * 2, 0);
+}
+
+void Engine::LightClusterBuilder::setProjection(const glm::mat4 & projection)
+{
+	// Perspective projection (see Camera::initProjectionMatrix())
+	float a = projection[2][2];
+	float b = projection[3][2];
+	float n = b / (a - 1.0f);
+	float f = b / (a + 1.0f);
+
+	if (projection[0][0] == xScale && projection[1][1] == yScale && n == nearPlane && f == farPlane)
+		return;
+
+	xScale = projection[0][0];
+	yScale = projection[1][1];
+	nearPlane = n;
+	farPlane = f;
+
+	computeClusterBounds();
+}
+
+void Engine::LightClusterBuilder::computeClusterBounds()
+{
+	sliceDepth.resize(GRID_Z + 1);
+	for (unsigned int z = 0; z < GRID_Z; z++)
+	{
+		sliceDepth[z] = nearPlane * powf(farPlane / nearPlane, float(z) / float(GRID_Z));
+	}
+	sliceDepth[GRID_Z] = farPlane;
+
+	minX.resize(NUM_CLUSTERS); minY.resize(NUM_CLUSTERS); minZ.resize(NUM_CLUSTERS);
+	maxX.resize(NUM_CLUSTERS); maxY.resize(NUM_CLUSTERS); maxZ.resize(NUM_CLUSTERS);
+
+	// Bounding box of the frustum piece: the tile edges at the near and far slice depths
+	for (unsigned int z = 0; z < GRID_Z; z++)
+	{
+		const float dn = sliceDepth[z];
+		const float df = sliceDepth[z + 1];
+		for (unsigned int y = 0; y < GRID_Y; y++)
+		{
+			const float y0 = -1.0f + 2.0f * float(y) / float(GRID_Y);
+			const float y1 = -1.0f + 2.0f * float(y + 1) / float(GRID_Y);
+			for (unsigned int x = 0; x < GRID_X; x++)
+			{
+				const float x0 = -1.0f + 2.0f * float(x) / float(GRID_X);
+				const float x1 = -1.0f + 2.0f * float(x + 1) / float(GRID_X);
+
+				unsigned int cluster = x + y * GRID_X + z * GRID_X * GRID_Y;
+				minX[cluster] = std::min(x0 * dn, x0 * df) / xScale;
+				maxX[cluster] = std::max(x1 * dn, x1 * df) / xScale;
+				minY[cluster] = std::min(y0 * dn, y0 * df) / yScale;
+				maxY[cluster] = std::max(y1 * dn, y1 * df) / yScale;
+				minZ[cluster] = -df;
+				maxZ[cluster] = -dn;
+			}
+		}
+	}
+}
+
+void Engine::LightClusterBuilder::setLights(const Engine::ClusterLight * lights, unsigned int count)
+{
+	numLights = count;
+	const size_t padded = (size_t(count) + 3) & ~size_t(3);
+
+	posX.resize(padded); posY.resize(padded); posZ.resize(padded); radius.resize(padded);
+	depthMin.resize(padded); depthMax.resize(padded);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const Engine::ClusterLight & light = lights[i];
+		posX[i] = light.x;
+		posY[i] = light.y;
+		posZ[i] = light.z;
+		radius[i] = light.radius;
+
+		// Free light slots, kept out of every cluster like the padding
+		if (light.radius <= 0.0f)
+		{
+			depthMin[i] = std::numeric_limits<float>::max();
+			depthMax[i] = -std::numeric_limits<float>::max();
+			continue;
+		}
+
+		float depth = -light.z;
+		float margin = (fabsf(depth) + light.radius) * DEPTH_MARGIN;
+		depthMin[i] = depth - light.radius - margin;
+		depthMax[i] = depth + light.radius + margin;
+	}
+
+	for (size_t i = count; i < padded; i++)
+	{
+		posX[i] = posY[i] = posZ[i] = radius[i] = 0.0f;
+		depthMin[i] = std::numeric_limits<float>::max();
+		depthMax[i] = -std::numeric_limits<float>::max();
+	}
+}
+
+float Engine::LightClusterBuilder::getSliceScale() const
+{
+	return float(GRID_Z) / logf(farPlane / nearPlane);
+}
+
+float Engine::LightClusterBuilder::getSliceBias() const
+{
+	return logf(nearPlane) * getSliceScale();
+}
+
+void Engine::LightClusterBuilder::build(unsigned int numThreads)
+{
+	unsigned int poolSize = Engine::Concurrent::ThreadPool::getInstance().getPoolSize();
+	numThreads = numThreads == 0 || numThreads > poolSize ? poolSize : numThreads;
+
+	if (numThreads <= 1)
+	{
+		buildSlices(0, GRID_Z);
+	}
+	else
+	{
+		// Per frame work: the tasks skip the queued tile builds. The calling thread builds slices too,
+		// so it only waits for the slices other threads already started, never for queued tasks
+		std::shared_ptr<Engine::LightClusterJob> job = std::make_shared<Engine::LightClusterJob>(this);
+		for (unsigned int t = 1; t < numThreads; t++)
+		{
+			std::unique_ptr<Engine::Concurrent::Runnable> task(new Engine::LightClusterTask(job));
+			Engine::Concurrent::ThreadPool::getInstance().addPriorityTask(std::move(task));
+		}
+		job->buildSlices();
+		job->wait();
+	}
+
+	// Compact the lists
+	indices.clear();
+	for (unsigned int c = 0; c < NUM_CLUSTERS; c++)
+	{
+		grid[c * 2] = (unsigned int)indices.size();
+		grid[c * 2 + 1] = (unsigned int)clusterLights[c].size();
+		indices.insert(indices.end(), clusterLights[c].begin(), clusterLights[c].end());
+	}
+}
+
+bool Engine::LightClusterBuilder::tileRange(float low, float high, float scale, float sliceNear, float sliceFar, unsigned int numTiles, unsigned int & first, unsigned int & last)
+{
+	// A tile [t0, t1] (in NDC) reaches low if t1 * depth / scale >= low for some depth of the slice,
+	// and reaches high if t0 * depth / scale <= high
+	float l = low * scale;
+	float h = high * scale;
+	float endMin = l >= 0.0f ? l / sliceFar : l / sliceNear;
+	float startMax = h >= 0.0f ? h / sliceNear : h / sliceFar;
+
+	float a = (endMin + 1.0f) * 0.5f * float(numTiles) - 1.0f - TILE_MARGIN;
+	float b = (startMax + 1.0f) * 0.5f * float(numTiles) + TILE_MARGIN;
+	if (b < 0.0f || a >= float(numTiles))
+		return false;
+
+	first = a <= 0.0f ? 0 : (unsigned int)ceilf(a);
+	last = std::min((unsigned int)b, numTiles - 1);
+	return first <= last;
+}
+
+void Engine::LightClusterBuilder::buildSlices(unsigned int begin, unsigned int end)
+{
+	const unsigned int paddedLights = (numLights + 3) & ~3u;
+	const __m128 zero = _mm_setzero_ps();
+
+	for (unsigned int z = begin; z < end; z++)
+	{
+		const float dn = sliceDepth[z];
+		const float df = sliceDepth[z + 1];
+		const unsigned int sliceBase = z * GRID_X * GRID_Y;
+
+		for (unsigned int c = 0; c < GRID_X * GRID_Y; c++)
+		{
+			clusterLights[sliceBase + c].clear();
+		}
+
+		const __m128 sliceNear = _mm_set1_ps(dn);
+		const __m128 sliceFar = _mm_set1_ps(df);
+
+		for (unsigned int l = 0; l < paddedLights; l += 4)
+		{
+			// Depth range of 4 lights against the slice
+			__m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&depthMin[l]), sliceFar), _mm_cmpge_ps(_mm_loadu_ps(&depthMax[l]), sliceNear));
+			int lightMask = _mm_movemask_ps(overlap);
+			if (lightMask == 0)
+				continue;
+
+			for (unsigned int b = 0; b < 4; b++)
+			{
+				if ((lightMask & (1 << b)) == 0)
+					continue;
+
+				const unsigned int light = l + b;
+				const float r = radius[light];
+
+				unsigned int x0, x1, y0, y1;
+				if (!tileRange(posX[light] - r, posX[light] + r, xScale, dn, df, GRID_X, x0, x1)
+					|| !tileRange(posY[light] - r, posY[light] + r, yScale, dn, df, GRID_Y, y0, y1))
+					continue;
+
+				const __m128 cx = _mm_set1_ps(posX[light]);
+				const __m128 cy = _mm_set1_ps(posY[light]);
+				const __m128 cz = _mm_set1_ps(posZ[light]);
+				const __m128 r2 = _mm_set1_ps(r * r);
+
+				for (unsigned int y = y0; y <= y1; y++)
+				{
+					const unsigned int row = sliceBase + y * GRID_X;
+					// Sphere / box test against 4 clusters of the row at a time
+					for (unsigned int x = x0 & ~3u; x <= x1; x += 4)
+					{
+						const unsigned int c = row + x;
+						__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[c]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&maxX[c]))), zero);
+						__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[c]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&maxY[c]))), zero);
+						__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[c]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&maxZ[c]))), zero);
+						__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+						int clusterMask = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+						for (unsigned int i = 0; i < 4; i++)
+						{
+							if ((clusterMask & (1 << i)) != 0)
+								clusterLights[c + i].push_back(light);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+bool Engine::LightClusterBuilder::intersects(unsigned int cluster, unsigned int light) const
+{
+	// Same operations as the SSE path of buildSlices()
+	float dx = std::max(std::max(minX[cluster] - posX[light], posX[light] - maxX[cluster]), 0.0f);
+	float dy = std::max(std::max(minY[cluster] - posY[light], posY[light] - maxY[cluster]), 0.0f);
+	float dz = std::max(std::max(minZ[cluster] - posZ[light], posZ[light] - maxZ[cluster]), 0.0f);
+	return radius[light] > 0.0f && dx * dx + dy * dy + dz * dz <= radius[light] * radius[light];
+}
+
+Engine::LightClusterValidation Engine::LightClusterBuilder::validate() const
+{
+	Engine::LightClusterValidation result;
+	result.clusters = NUM_CLUSTERS;
+	result.mismatches = 0;
+	result.indices = indices.size();
+
+	std::vector<unsigned int> expected;
+	for (unsigned int c = 0; c < NUM_CLUSTERS; c++)
+	{
+		expected.clear();
+		for (unsigned int l = 0; l < numLights; l++)
+		{
+			if (intersects(c, l))
+				expected.push_back(l);
+		}
+
+		// Both lists are sorted by light index
+		const unsigned int offset = grid[c * 2];
+		const unsigned int count = grid[c * 2 + 1];
+		bool equal = count == expected.size() && std::equal(expected.begin(), expected.end(), indices.begin() + offset);
+		result.mismatches += equal ? 0 : 1;
+	}
+
+	std::cout << "LightClusterBuilder: " << result.clusters - result.mismatches << "/" << result.clusters
+		<< " clusters match the brute force test (" << numLights << " lights, " << result.indices << " indices)" << std::endl;
+
+	return result;
+}
+
+Engine::LightClusterValidation Engine::LightClusterBuilder::validateRandomLights(unsigned int count)
+{
+	Engine::LightClusterBuilder builder;
+	const float nearPlane = 0.5f;
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, nearPlane, 1000.0f);
+	builder.setProjection(projection);
+
+	std::vector<Engine::ClusterLight> lights;
+	generateLights(projection, nearPlane, count, lights);
+	builder.setLights(lights.empty() ? NULL : &lights[0], count);
+
+	Engine::LightClusterValidation result;
+	result.clusters = 0;
+	result.mismatches = 0;
+	result.indices = 0;
+
+	// Thread pool build first, then the calling thread only
+	for (unsigned int threads = 0; threads <= 1; threads++)
+	{
+		builder.build(threads);
+		Engine::LightClusterValidation pass = builder.validate();
+		result.clusters += pass.clusters;
+		result.mismatches += pass.mismatches;
+		result.indices += pass.indices;
+	}
+
+	return result;
+}
+
+std::vector<Engine::LightClusterBenchmark> Engine::LightClusterBuilder::benchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int ITERATIONS = 20;
+	const unsigned int LIGHT_COUNTS[] = { 100, 1000, 10000 };
+
+	std::vector<Engine::LightClusterBenchmark> result;
+	const unsigned int poolSize = Engine::Concurrent::ThreadPool::getInstance().getPoolSize();
+
+	Engine::LightClusterBuilder builder;
+	const float nearPlane = 0.5f;
+	const float farPlane = 1000.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, nearPlane, farPlane);
+	builder.setProjection(projection);
+
+	std::cout << "LightClusterBuilder: Build benchmark (ms, " << GRID_X << "x" << GRID_Y << "x" << GRID_Z << " clusters)" << std::endl;
+
+	for (unsigned int count : LIGHT_COUNTS)
+	{
+		std::vector<Engine::ClusterLight> lights;
+		generateLights(projection, nearPlane, count, lights);
+		builder.setLights(&lights[0], count);
+
+		for (unsigned int threads = 1; ; threads *= 2)
+		{
+			threads = std::max(1u, std::min(threads, poolSize));
+
+			Clock::time_point start = Clock::now();
+			for (unsigned int i = 0; i < ITERATIONS; i++)
+			{
+				builder.build(threads);
+			}
+
+			Engine::LightClusterBenchmark entry;
+			entry.lights = count;
+			entry.threads = threads;
+			entry.buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / double(ITERATIONS);
+			entry.indices = builder.getIndices().size();
+			result.push_back(entry);
+
+			std::cout << "\t" << count << " lights, " << threads << " thread(s): " << entry.buildMs << " (" << entry.indices << " indices)" << std::endl;
+
+			if (threads >= poolSize)
+				break;
+		}
+
+		builder.validate();
+	}
+
+	return result;
+}
+
+// ========================================================================================
+
+Engine::LightClusterJob::LightClusterJob(Engine::LightClusterBuilder * builder)
+	:builder(builder), nextSlice(0), slicesLeft(Engine::LightClusterBuilder::GRID_Z)
+{
+}
+
+void Engine::LightClusterJob::buildSlices()
+{
+	while (true)
+	{
+		unsigned int slice = nextSlice.fetch_add(1);
+		if (slice >= Engine::LightClusterBuilder::GRID_Z)
+			break;
+
+		builder->buildSlices(slice, slice + 1);
+		slicesLeft.countDown();
+	}
+}
+
+void Engine::LightClusterJob::wait()
+{
+	slicesLeft.wait();
+}
+
+Engine::LightClusterTask::LightClusterTask(std::shared_ptr<Engine::LightClusterJob> job)
+	:job(job)
+{
+}
+
+void Engine::LightClusterTask::run()
+{
+	job->buildSlices();
+}
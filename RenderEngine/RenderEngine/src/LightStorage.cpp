@@ -0,0 +1,324 @@
+#include "LightStorage.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "LightClusterBuilder.h"
+
+const float Engine::GPU::LightStorage::MAX_RADIUS = 10000.0f;
+
+// Marks point lights on LightStorageData::direction[3]
+const float POINT_LIGHT_APERTURE = -2.0f;
+// Bytes of a slot touched by LIGHT_DIRTY_TRANSFORM (position and direction) and
+// LIGHT_DIRTY_PROPERTIES (from the radius onwards)
+const size_t TRANSFORM_END = offsetof(Engine::GPU::LightStorageData, color);
+const size_t PROPERTIES_BEGIN = offsetof(Engine::GPU::LightStorageData, position) + sizeof(float) * 3;
+// Dirty ranges closer than this are uploaded as one. A copy costs more than sending a few
+// kilobytes of clean data along
+const size_t MERGE_GAP = 4096;
+const size_t INITIAL_SLOTS = 64;
+const size_t INITIAL_RING_SIZE = 64 * 1024;
+
+Engine::GPU::LightStorage::LightStorage()
+	:buffer(0), capacity(0), numLights(0), updatedSlots(0)
+{
+}
+
+void Engine::GPU::LightStorage::addPointLight(Engine::PointLight * pl)
+{
+	pl->setBufferIndex(allocateSlot(pl, false));
+}
+
+void Engine::GPU::LightStorage::addSpotLight(Engine::SpotLight * sl)
+{
+	sl->setBufferIndex(allocateSlot(sl, true));
+}
+
+unsigned int Engine::GPU::LightStorage::allocateSlot(Engine::Light * light, bool spot)
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (unsigned int)slots.size();
+		slots.push_back(LightSlot());
+		data.push_back(LightStorageData());
+	}
+
+	slots[slot].light = light;
+	slots[slot].spot = spot;
+	slots[slot].pendingFlags = LIGHT_DIRTY_TRANSFORM | LIGHT_DIRTY_PROPERTIES;
+	numLights++;
+
+	return slot;
+}
+
+void Engine::GPU::LightStorage::removeLight(Engine::Light * light)
+{
+	unsigned int slot = light->getBufferIndex();
+	if (slot >= slots.size() || slots[slot].light != light)
+		return;
+
+	// A zero radius keeps the slot out of every cluster
+	slots[slot].light = NULL;
+	slots[slot].pendingFlags = LIGHT_DIRTY_TRANSFORM | LIGHT_DIRTY_PROPERTIES;
+	memset(&data[slot], 0, sizeof(LightStorageData));
+	freeSlots.push_back(slot);
+	numLights--;
+}
+
+void Engine::GPU::LightStorage::clear()
+{
+	slots.clear();
+	data.clear();
+	freeSlots.clear();
+	numLights = 0;
+}
+
+void Engine::GPU::LightStorage::refreshSlot(unsigned int slot)
+{
+	LightStorageData & dst = data[slot];
+	const Engine::Light * light = slots[slot].light;
+	const glm::vec4 & position = light->getModelMatrix()[3];
+	const float * color;
+	const float * attenuation;
+	const float * kFactors;
+
+	if (slots[slot].spot)
+	{
+		Engine::SpotLight * sl = (Engine::SpotLight *)light;
+		const Engine::SpotLightData & src = sl->getData();
+		glm::vec3 dir(sl->getDirModelMatrix()[3]);
+		dir = glm::dot(dir, dir) > 0.0f ? glm::normalize(dir) : glm::vec3(0.0f, -1.0f, 0.0f);
+
+		dst.direction[0] = dir.x; dst.direction[1] = dir.y; dst.direction[2] = dir.z;
+		dst.direction[3] = cosf(src.direction[3]);
+		dst.color[3] = src.position[3];
+		color = src.color;
+		attenuation = src.attenuation;
+		kFactors = src.kFactors;
+	}
+	else
+	{
+		Engine::PointLight * pl = (Engine::PointLight *)light;
+		const Engine::PointLightData & src = pl->getData();
+
+		dst.direction[0] = dst.direction[1] = dst.direction[2] = 0.0f;
+		dst.direction[3] = POINT_LIGHT_APERTURE;
+		dst.color[3] = 0.0f;
+		color = src.color;
+		attenuation = src.attenuation;
+		kFactors = src.kFactors;
+	}
+
+	dst.position[0] = position.x; dst.position[1] = position.y; dst.position[2] = position.z;
+	memcpy(dst.color, color, sizeof(float) * 3);
+	memcpy(dst.attenuation, attenuation, sizeof(float) * 4);
+	memcpy(dst.kFactors, kFactors, sizeof(float) * 4);
+
+	// The whole sphere is clustered, also for spot lights
+	float intensity = std::max(color[0], std::max(color[1], color[2])) * (kFactors[0] + kFactors[1] + kFactors[2]);
+	dst.position[3] = light->isEnabled() ? Engine::LightClusterBuilder::computeRadius(attenuation, intensity, MAX_RADIUS) : 0.0f;
+}
+
+void Engine::GPU::LightStorage::update()
+{
+	if (!ring.isInitialized())
+	{
+		ring.init(INITIAL_RING_SIZE);
+	}
+
+	// The buffer must exist even without lights
+	reserve(std::max(slots.size(), size_t(1)));
+
+	ring.beginFrame();
+	updatedSlots = 0;
+
+	const size_t stride = sizeof(LightStorageData);
+	const unsigned char * src = (const unsigned char *)data.data();
+	size_t rangeBegin = 0;
+	size_t rangeEnd = 0;
+
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		LightSlot & slot = slots[i];
+		unsigned int flags = slot.pendingFlags;
+		if (slot.light != NULL)
+			flags |= slot.light->getDirtyFlags();
+
+		if (flags == 0)
+			continue;
+
+		if (slot.light != NULL)
+		{
+			refreshSlot((unsigned int)i);
+			slot.light->clearUpdateFlag();
+		}
+		slot.pendingFlags = 0;
+		updatedSlots++;
+
+		size_t begin = i * stride + ((flags & LIGHT_DIRTY_TRANSFORM) ? 0 : PROPERTIES_BEGIN);
+		size_t end = i * stride + ((flags & LIGHT_DIRTY_PROPERTIES) ? stride : TRANSFORM_END);
+
+		if (rangeEnd > 0 && begin <= rangeEnd + MERGE_GAP)
+		{
+			rangeEnd = end;
+		}
+		else
+		{
+			ring.upload(buffer, rangeBegin, src + rangeBegin, rangeEnd - rangeBegin);
+			rangeBegin = begin;
+			rangeEnd = end;
+		}
+	}
+
+	ring.upload(buffer, rangeBegin, src + rangeBegin, rangeEnd - rangeBegin);
+	ring.endFrame();
+}
+
+void Engine::GPU::LightStorage::reserve(size_t numSlots)
+{
+	if (numSlots <= capacity)
+		return;
+
+	size_t newCapacity = std::max(numSlots, std::max(capacity * 2, INITIAL_SLOTS));
+
+	unsigned int newBuffer;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * sizeof(LightStorageData), NULL, GL_DYNAMIC_DRAW);
+
+	if (buffer != 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity * sizeof(LightStorageData));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	buffer = newBuffer;
+	capacity = newCapacity;
+}
+
+void Engine::GPU::LightStorage::bind(unsigned int bindingPoint)
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, buffer);
+}
+
+unsigned int Engine::GPU::LightStorage::getNumSlots() const
+{
+	return (unsigned int)slots.size();
+}
+
+unsigned int Engine::GPU::LightStorage::getNumLights() const
+{
+	return numLights;
+}
+
+unsigned int Engine::GPU::LightStorage::getUpdatedSlots() const
+{
+	return updatedSlots;
+}
+
+const std::vector<Engine::GPU::LightStorageData> & Engine::GPU::LightStorage::getData() const
+{
+	return data;
+}
+
+const Engine::GPU::UploadRingBuffer & Engine::GPU::LightStorage::getRing() const
+{
+	return ring;
+}
+
+void Engine::GPU::LightStorage::destroy()
+{
+	ring.destroy();
+
+	if (buffer != 0)
+	{
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		capacity = 0;
+	}
+}
+
+std::vector<Engine::GPU::LightUpdateBenchmark> Engine::GPU::LightStorage::benchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int FRAMES = 60;
+	const unsigned int LIGHT_COUNTS[] = { 1000, 10000, 50000 };
+	// Every light, and one of every ten
+	const unsigned int UPDATE_STEPS[] = { 1, 10 };
+
+	std::vector<Engine::GPU::LightUpdateBenchmark> result;
+
+	Engine::GPU::LightStorage storage;
+	std::vector<Engine::PointLight *> lights;
+
+	std::cout << "LightStorage: Update benchmark (" << FRAMES << " frames, " << (Engine::GPU::UploadRingBuffer::isSupported() ? "persistent ring" : "glBufferSubData") << ")" << std::endl;
+
+	for (unsigned int count : LIGHT_COUNTS)
+	{
+		while (lights.size() < count)
+		{
+			Engine::PointLight * pl = new Engine::PointLight("benchmark_" + std::to_string(lights.size()));
+			pl->setColor(glm::vec3(1.0f));
+			pl->setAttenuation(glm::vec3(1.0f, 0.0f, 0.5f));
+			pl->setKa(0.0f);
+			pl->setKd(1.0f);
+			pl->setKs(0.5f);
+			storage.addPointLight(pl);
+			lights.push_back(pl);
+		}
+
+		// First upload of the new lights left out
+		storage.update();
+		glFinish();
+
+		for (unsigned int step : UPDATE_STEPS)
+		{
+			Clock::time_point start = Clock::now();
+			for (unsigned int frame = 0; frame < FRAMES; frame++)
+			{
+				float offset = float(frame);
+				for (unsigned int i = 0; i < count; i += step)
+				{
+					lights[i]->setPosition(glm::vec3(float(i % 1000), offset, float(i / 1000)));
+				}
+				storage.update();
+			}
+			glFinish();
+
+			Engine::GPU::LightUpdateBenchmark entry;
+			entry.lights = count;
+			entry.updated = (count + step - 1) / step;
+			entry.frameMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / double(FRAMES);
+			entry.lightsPerMs = double(entry.updated) / std::max(entry.frameMs, 1e-6);
+			entry.bytesPerFrame = storage.getRing().getFrameBytes();
+			entry.copiesPerFrame = storage.getRing().getFrameCopies();
+			result.push_back(entry);
+
+			std::cout << "\t" << count << " lights, " << entry.updated << " moved: " << entry.frameMs << " ms ("
+				<< entry.lightsPerMs << " lights/ms, " << entry.bytesPerFrame << " bytes in " << entry.copiesPerFrame << " copies)" << std::endl;
+		}
+	}
+
+	storage.destroy();
+	for (auto pl : lights)
+	{
+		delete pl;
+	}
+
+	return result;
+}
@@ -6,23 +6,29 @@
 #include "Mesh.h"
 
 #include "CustomMaths.h"
+#include "MeshOptimizer.h"
+#include "GLStateCache.h"
 
 #include <glm/glm.hpp>
 #include <vector>
 #include <iostream>
 
-#include <gl\glew.h>
+#include <GL/glew.h>
 
-Engine::Mesh::Mesh()
+Engine::Mesh::Mesh(const Engine::VertexLayout & layout)
+	:layout(layout)
 {
 	faces = 0;
 	vertices = colors = normals = tangents = uvs = emission = 0;
+	initGPUHandles();
 }
 
-Engine::Mesh::Mesh(aiMesh * mesh)
+Engine::Mesh::Mesh(aiMesh * mesh, const Engine::VertexLayout & layout)
+	:layout(layout)
 {
 	faces = 0;
 	vertices = colors = normals = tangents = uvs = emission = 0;
+	initGPUHandles();
 
 	loadFromMesh(mesh);
 
@@ -30,6 +36,7 @@ Engine::Mesh::Mesh(aiMesh * mesh)
 }
 
 Engine::Mesh::Mesh(const Engine::Mesh &other)
+	:layout(other.layout)
 {
 	faces = 0;
 	vertices = colors = normals = tangents = uvs = emission = 0;
@@ -76,22 +83,27 @@ Engine::Mesh::Mesh(const Engine::Mesh &other)
 		memcpy(uvs, other.uvs, numVertices * 2 * sizeof(float));
 	}
 
+	if (other.emission != 0)
+	{
+		emission = new float[bufferSize];
+		memcpy(emission, other.emission, copySize);
+	}
+
 	verticesPerFace = other.verticesPerFace;
 
 	vao = other.vao;
-	vboColors = other.vboColors;
 	vboFaces = other.vboFaces;
-	vboNormals = other.vboNormals;
-	vboTangents = other.vboTangents;
-	vboUVs = other.vboUVs;
-	vboVertices = other.vboVertices;
+	memcpy(vbos, other.vbos, sizeof(vbos));
+	indexType = other.indexType;
+	gpuSize = other.gpuSize;
 }
 
-Engine::Mesh::Mesh(const unsigned int numF, const unsigned int numV, const unsigned int *f, const float *v, const float *c, const float *n, const float *uv, const float *t, const float *e)
-	:numFaces(numF), numVertices(numV)
+Engine::Mesh::Mesh(const unsigned int numF, const unsigned int numV, const unsigned int *f, const float *v, const float *c, const float *n, const float *uv, const float *t, const float *e, const Engine::VertexLayout & layout)
+	:numFaces(numF), numVertices(numV), layout(layout)
 {
 	faces = 0;
 	vertices = colors = normals = tangents = uvs = emission = 0;
+	initGPUHandles();
 
 	if (numFaces > 0)
 	{
@@ -163,6 +175,18 @@ Engine::Mesh::~Mesh()
 	releaseCPU();
 }
 
+void Engine::Mesh::initGPUHandles()
+{
+	vao = 0;
+	vboFaces = 0;
+	for (unsigned int i = 0; i < VERTEX_ATTRIBUTE_COUNT; i++)
+	{
+		vbos[i] = 0;
+	}
+	indexType = GL_UNSIGNED_INT;
+	gpuSize = 0;
+}
+
 void Engine::Mesh::extractTopology(aiMesh * mesh)
 {
 	numFaces = mesh->mNumFaces;
@@ -378,61 +402,138 @@ const float * Engine::Mesh::getEmissive() const
 	return emission;
 }
 
+const Engine::VertexLayout & Engine::Mesh::getVertexLayout() const
+{
+	return layout;
+}
+
+const unsigned int Engine::Mesh::getIndexType() const
+{
+	return indexType;
+}
+
+const size_t Engine::Mesh::getGPUSize() const
+{
+	return gpuSize;
+}
+
 void Engine::Mesh::syncGPU()
 {
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	Engine::GLStateCache::getInstance().bindVertexArray(vao);
 	
 	unsigned int numFaces = getNumFaces();
 	unsigned int numVertex = getNumVertices();
 
-	glGenBuffers(1, &vboVertices);
-	glBindBuffer(GL_ARRAY_BUFFER, vboVertices);
-	glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, getVertices(), GL_STATIC_DRAW);
+	const float * data[VERTEX_ATTRIBUTE_COUNT];
+	data[VERTEX_POSITION] = vertices;
+	data[VERTEX_NORMAL] = normals;
+	data[VERTEX_COLOR] = colors;
+	data[VERTEX_EMISSION] = emission;
+	data[VERTEX_UV] = uvs;
+	data[VERTEX_TANGENT] = tangents;
 
-	if (colors != 0)
-	{
-		glGenBuffers(1, &vboColors);
-		glBindBuffer(GL_ARRAY_BUFFER, vboColors);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, colors, GL_STATIC_DRAW);
-	}
+	const unsigned int * indices = faces;
 
-	if (normals != 0)
+	// Optimize a copy of the data, so the CPU side keeps its original order (the tree
+	// generator relies on the base shapes vertex order)
+	std::vector<float> streams[VERTEX_ATTRIBUTE_COUNT];
+	std::vector<unsigned int> optimizedFaces;
+	if (layout.isOptimized() && faces != 0 && vertices != 0 && verticesPerFace == 3)
 	{
-		glGenBuffers(1, &vboNormals);
-		glBindBuffer(GL_ARRAY_BUFFER, vboNormals);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, normals, GL_STATIC_DRAW);
-	}
+		for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+		{
+			if (data[a] != 0)
+			{
+				streams[a].assign(data[a], data[a] + size_t(numVertex) * VertexLayout::getAttributeComponents(VertexAttribute(a)));
+			}
+		}
+		optimizedFaces.assign(faces, faces + numFaces * 3);
 
-	if (uvs != 0)
-	{
-		glGenBuffers(1, &vboUVs);
-		glBindBuffer(GL_ARRAY_BUFFER, vboUVs);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 2, uvs, GL_STATIC_DRAW);
-	}
+		Engine::MeshOptimizer::optimize(streams, numVertex, optimizedFaces);
 
-	if (tangents != 0)
-	{
-		glGenBuffers(1, &vboTangents);
-		glBindBuffer(GL_ARRAY_BUFFER, vboTangents);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, tangents, GL_STATIC_DRAW);
+		for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+		{
+			data[a] = streams[a].empty() ? 0 : &streams[a][0];
+		}
+		indices = &optimizedFaces[0];
 	}
 
-	if (emission != 0)
+	layout.resolve(data, numVertex);
+	gpuSize = 0;
+
+	std::vector<unsigned char> packed;
+	for (unsigned int b = 0; b < layout.getNumBuffers(); b++)
 	{
-		glGenBuffers(1, &vboEmission);
-		glBindBuffer(GL_ARRAY_BUFFER, vboEmission);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, emission, GL_STATIC_DRAW);
+		layout.pack(b, data, numVertex, packed);
+
+		glGenBuffers(1, &vbos[b]);
+		glBindBuffer(GL_ARRAY_BUFFER, vbos[b]);
+		glBufferData(GL_ARRAY_BUFFER, packed.size(), &packed[0], GL_STATIC_DRAW);
+		gpuSize += packed.size();
 	}
 
-	if (faces != 0)
+	if (indices != 0)
 	{
 		glGenBuffers(1, &vboFaces);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboFaces);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, numFaces * sizeof(unsigned int) * 3, faces, GL_STATIC_DRAW);
+
+		unsigned int numIndices = numFaces * 3;
+		if (layout.usesShortIndices(numVertex))
+		{
+			std::vector<unsigned short> shortFaces(indices, indices + numIndices);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned short), &shortFaces[0], GL_STATIC_DRAW);
+			indexType = GL_UNSIGNED_SHORT;
+			gpuSize += numIndices * sizeof(unsigned short);
+		}
+		else
+		{
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+			indexType = GL_UNSIGNED_INT;
+			gpuSize += numIndices * sizeof(unsigned int);
+		}
 	}
 }
 
+bool Engine::Mesh::bindAttribute(Engine::VertexAttribute attribute, unsigned int location) const
+{
+	const Engine::VertexAttributeLayout & attr = layout.getAttribute(attribute);
+
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	switch (attr.format)
+	{
+	case VERTEX_FORMAT_FLOAT:
+		size = attr.components;
+		type = GL_FLOAT;
+		normalized = GL_FALSE;
+		break;
+	case VERTEX_FORMAT_HALF:
+		size = attr.components;
+		type = GL_HALF_FLOAT;
+		normalized = GL_FALSE;
+		break;
+	case VERTEX_FORMAT_RGBA8:
+		size = 4;
+		type = GL_UNSIGNED_BYTE;
+		normalized = GL_TRUE;
+		break;
+	case VERTEX_FORMAT_OCTAHEDRAL:
+		size = 2;
+		type = GL_SHORT;
+		normalized = GL_TRUE;
+		break;
+	default:
+		return false;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbos[attr.buffer]);
+	glVertexAttribPointer(location, size, type, normalized, GLsizei(attr.stride), (void*)attr.offset);
+	glEnableVertexAttribArray(location);
+	return true;
+}
+
 void Engine::Mesh::releaseCPU()
 {
 	if (faces != 0)
@@ -480,48 +581,28 @@ void Engine::Mesh::releaseCPU()
 
 void Engine::Mesh::releaseGPU()
 {
-	if (vboVertices != -1)
+	for (unsigned int b = 0; b < layout.getNumBuffers(); b++)
 	{
-		glDeleteBuffers(1, &vboVertices);
+		glDeleteBuffers(1, &vbos[b]);
+		vbos[b] = 0;
 	}
 
-	if (vboNormals != -1)
-	{
-		glDeleteBuffers(1, &vboNormals);
-	}
-
-	if (vboColors != -1)
-	{
-		glDeleteBuffers(1, &vboColors);
-	}
-
-	if (vboUVs != -1)
-	{
-		glDeleteBuffers(1, &vboUVs);
-	}
-
-	if (vboTangents != -1)
-	{
-		glDeleteBuffers(1, &vboTangents);
-	}
-
-	if (vboFaces != -1)
+	if (vboFaces != 0)
 	{
 		glDeleteBuffers(1, &vboFaces);
+		vboFaces = 0;
 	}
 
-	if (vboEmission != -1)
+	if (vao != 0)
 	{
-		glDeleteBuffers(1, &vboEmission);
+		Engine::GLStateCache::getInstance().deleteVertexArray(vao);
+		vao = 0;
 	}
 
-	if (vao != -1)
-	{
-		glDeleteVertexArrays(1, &vao);
-	}
+	gpuSize = 0;
 }
 
 void Engine::Mesh::use() const
 {
-	glBindVertexArray(vao);
+	Engine::GLStateCache::getInstance().bindVertexArray(vao);
 }
\ No newline at end of file
@@ -0,0 +1,657 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+const unsigned int Engine::MeshOptimizer::DEFAULT_CACHE_SIZE = 16;
+const float Engine::MeshOptimizer::DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+// Forsyth's linear-speed vertex cache optimization scoring parameters
+const unsigned int FORSYTH_CACHE_SIZE = 32;
+const unsigned int FORSYTH_MAX_VALENCE = 32;
+const float FORSYTH_LAST_TRI_SCORE = 0.75f;
+const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+const unsigned int INVALID_INDEX = ~0u;
+
+// Returns the number of vertices of the triangle not present on the cache, and pushes them
+static unsigned int simulateFIFO(const unsigned int * triangle, std::vector<unsigned int> & cacheTimestamp, unsigned int & timestamp, unsigned int cacheSize)
+{
+	unsigned int misses = 0;
+	for (unsigned int k = 0; k < 3; k++)
+	{
+		unsigned int v = triangle[k];
+		// A vertex is cached if it was pushed less than cacheSize pushes ago
+		if (timestamp - cacheTimestamp[v] >= cacheSize)
+		{
+			cacheTimestamp[v] = ++timestamp;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+// Triangles as vertex positions, each rotated to start with its smallest vertex (keeps the winding), sorted
+static std::vector<std::array<float, 9>> sortedTriangles(const std::vector<float> & positions, const std::vector<unsigned int> & indices)
+{
+	std::vector<std::array<float, 9>> triangles(indices.size() / 3);
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		std::array<std::array<float, 3>, 3> corners;
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			const float * p = &positions[size_t(indices[t * 3 + k]) * 3];
+			corners[k] = { p[0], p[1], p[2] };
+		}
+
+		size_t first = std::min_element(corners.begin(), corners.end()) - corners.begin();
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			memcpy(&triangles[t][k * 3], &corners[(first + k) % 3][0], 3 * sizeof(float));
+		}
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle vertices get a fixed score so the next triangle does not reuse them all
+		if (cachePosition < 3)
+		{
+			score = FORSYTH_LAST_TRI_SCORE;
+		}
+		else
+		{
+			const float scaler = 1.0f / float(FORSYTH_CACHE_SIZE - 3);
+			score = pow(1.0f - float(cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	// Boost vertices with few triangles left, to finish them off and avoid leaving lone triangles
+	score += FORSYTH_VALENCE_BOOST_SCALE * pow(float(remainingTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+	return score;
+}
+
+void Engine::MeshOptimizer::optimize(std::vector<float> streams[VERTEX_ATTRIBUTE_COUNT], unsigned int & numVertices, std::vector<unsigned int> & indices)
+{
+	if (indices.size() < 3 || numVertices == 0 || streams[VERTEX_POSITION].empty())
+	{
+		return;
+	}
+
+	// Weld duplicates
+	const float * data[VERTEX_ATTRIBUTE_COUNT];
+	for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+	{
+		data[a] = streams[a].empty() ? 0 : &streams[a][0];
+	}
+
+	std::vector<unsigned int> remap;
+	unsigned int uniqueVertices = weldVertices(data, numVertices, remap);
+	if (uniqueVertices < numVertices)
+	{
+		remapIndices(&indices[0], indices.size(), remap);
+		for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+		{
+			if (!streams[a].empty())
+				remapVertices(streams[a], VertexLayout::getAttributeComponents(VertexAttribute(a)), remap, uniqueVertices);
+		}
+		numVertices = uniqueVertices;
+	}
+
+	// Reorder triangles
+	optimizeVertexCache(&indices[0], indices.size(), numVertices);
+	optimizeOverdraw(&indices[0], indices.size(), &streams[VERTEX_POSITION][0], numVertices);
+
+	// Reorder vertices
+	unsigned int usedVertices = optimizeVertexFetch(&indices[0], indices.size(), numVertices, remap);
+	remapIndices(&indices[0], indices.size(), remap);
+	for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+	{
+		if (!streams[a].empty())
+			remapVertices(streams[a], VertexLayout::getAttributeComponents(VertexAttribute(a)), remap, usedVertices);
+	}
+	numVertices = usedVertices;
+}
+
+unsigned int Engine::MeshOptimizer::weldVertices(const float * const data[VERTEX_ATTRIBUTE_COUNT], unsigned int numVertices, std::vector<unsigned int> & remap)
+{
+	remap.assign(numVertices, INVALID_INDEX);
+
+	// Open addressing hash table of vertex indices
+	size_t tableSize = 1;
+	while (tableSize < size_t(numVertices) * 2)
+	{
+		tableSize <<= 1;
+	}
+	std::vector<unsigned int> table(tableSize, INVALID_INDEX);
+
+	unsigned int uniqueVertices = 0;
+	for (unsigned int v = 0; v < numVertices; v++)
+	{
+		// FNV-1a over the bits of every attribute
+		unsigned int hash = 2166136261u;
+		for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+		{
+			if (data[a] == 0)
+				continue;
+
+			const unsigned int components = VertexLayout::getAttributeComponents(VertexAttribute(a));
+			const unsigned char * bytes = (const unsigned char *)(data[a] + size_t(v) * components);
+			for (size_t b = 0; b < components * sizeof(float); b++)
+			{
+				hash = (hash ^ bytes[b]) * 16777619u;
+			}
+		}
+
+		size_t slot = hash & (tableSize - 1);
+		while (true)
+		{
+			unsigned int other = table[slot];
+			if (other == INVALID_INDEX)
+			{
+				table[slot] = v;
+				remap[v] = uniqueVertices++;
+				break;
+			}
+
+			bool equal = true;
+			for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT && equal; a++)
+			{
+				if (data[a] == 0)
+					continue;
+
+				const unsigned int components = VertexLayout::getAttributeComponents(VertexAttribute(a));
+				equal = memcmp(data[a] + size_t(v) * components, data[a] + size_t(other) * components, components * sizeof(float)) == 0;
+			}
+
+			if (equal)
+			{
+				remap[v] = remap[other];
+				break;
+			}
+
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+
+	return uniqueVertices;
+}
+
+void Engine::MeshOptimizer::optimizeVertexCache(unsigned int * indices, size_t numIndices, unsigned int numVertices)
+{
+	const size_t numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+	{
+		return;
+	}
+
+	// Score lookup tables
+	float cacheScores[FORSYTH_CACHE_SIZE + 1];
+	float valenceScores[FORSYTH_MAX_VALENCE];
+	for (unsigned int i = 0; i <= FORSYTH_CACHE_SIZE; i++)
+	{
+		cacheScores[i] = forsythVertexScore(i < FORSYTH_CACHE_SIZE ? int(i) : -1, 1) - forsythVertexScore(-1, 1);
+	}
+	for (unsigned int i = 0; i < FORSYTH_MAX_VALENCE; i++)
+	{
+		valenceScores[i] = forsythVertexScore(-1, i);
+	}
+
+	// Vertex -> triangles adjacency. Only the first remaining[v] entries of each vertex are still to be emitted
+	std::vector<unsigned int> remaining(numVertices, 0);
+	for (size_t i = 0; i < numTriangles * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+
+	std::vector<unsigned int> adjacencyOffset(numVertices + 1, 0);
+	for (unsigned int v = 0; v < numVertices; v++)
+	{
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+	}
+
+	std::vector<unsigned int> adjacency(numTriangles * 3);
+	std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			adjacency[fill[v]++] = (unsigned int)t;
+		}
+	}
+
+	std::vector<float> vertexScore(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++)
+	{
+		vertexScore[v] = remaining[v] < FORSYTH_MAX_VALENCE ? valenceScores[remaining[v]] : forsythVertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<bool> emitted(numTriangles, false);
+	size_t bestTriangle = 0;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		const unsigned int * tri = indices + t * 3;
+		triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+		if (triangleScore[t] > bestScore)
+		{
+			bestScore = triangleScore[t];
+			bestTriangle = t;
+		}
+	}
+
+	std::vector<unsigned int> result(numTriangles * 3);
+	std::vector<unsigned int> cache, newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	size_t nextCandidate = 0;
+
+	for (size_t out = 0; out < numTriangles; out++)
+	{
+		// No triangle touches the cache: continue from the next triangle in input order
+		if (bestScore < 0.0f)
+		{
+			while (emitted[nextCandidate])
+			{
+				nextCandidate++;
+			}
+			bestTriangle = nextCandidate;
+		}
+
+		const unsigned int * tri = indices + bestTriangle * 3;
+		memcpy(&result[out * 3], tri, 3 * sizeof(unsigned int));
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from its vertices adjacency
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			unsigned int * list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == bestTriangle)
+				{
+					std::swap(list[i], list[remaining[v] - 1]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// LRU cache update: triangle vertices go to the front
+		newCache.clear();
+		newCache.insert(newCache.end(), tri, tri + 3);
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+			{
+				newCache.push_back(v);
+			}
+		}
+
+		// Rescore the vertices whose cache position or valence changed (including the evicted ones)
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			unsigned int v = newCache[i];
+			int position = i < FORSYTH_CACHE_SIZE ? int(i) : -1;
+
+			float score = -1.0f;
+			if (remaining[v] > 0)
+			{
+				score = remaining[v] < FORSYTH_MAX_VALENCE ? valenceScores[remaining[v]] : forsythVertexScore(-1, remaining[v]);
+				score += cacheScores[position >= 0 ? position : FORSYTH_CACHE_SIZE];
+			}
+
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const unsigned int * list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				triangleScore[list[j]] += delta;
+			}
+		}
+
+		cache.assign(newCache.begin(), newCache.begin() + std::min<size_t>(newCache.size(), FORSYTH_CACHE_SIZE));
+
+		// Next triangle: the best one among those touching the cache
+		bestScore = -1.0f;
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			const unsigned int * list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				if (triangleScore[list[j]] > bestScore)
+				{
+					bestScore = triangleScore[list[j]];
+					bestTriangle = list[j];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, &result[0], numTriangles * 3 * sizeof(unsigned int));
+}
+
+void Engine::MeshOptimizer::optimizeOverdraw(unsigned int * indices, size_t numIndices, const float * positions, unsigned int numVertices, float threshold)
+{
+	const size_t numTriangles = numIndices / 3;
+	if (numTriangles < 2)
+	{
+		return;
+	}
+
+	const float targetACMR = analyzeVertexCache(indices, numIndices, numVertices).acmr * threshold;
+
+	// Hard boundaries: triangles that miss the cache entirely (the ordering restarts there)
+	std::vector<unsigned int> cacheTimestamp(numVertices, 0);
+	unsigned int timestamp = DEFAULT_CACHE_SIZE + 1;
+	std::vector<size_t> hardClusters;
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		if (simulateFIFO(indices + t * 3, cacheTimestamp, timestamp, DEFAULT_CACHE_SIZE) == 3)
+		{
+			hardClusters.push_back(t);
+		}
+	}
+	if (hardClusters.empty() || hardClusters[0] != 0)
+	{
+		hardClusters.insert(hardClusters.begin(), 0);
+	}
+	hardClusters.push_back(numTriangles);
+
+	// Soft boundaries: split the hard clusters further as long as every piece, simulated
+	// with a cold cache, stays under the target ACMR
+	std::vector<size_t> clusters;
+	for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+	{
+		const size_t end = hardClusters[c + 1];
+		size_t start = hardClusters[c];
+		clusters.push_back(start);
+
+		timestamp += DEFAULT_CACHE_SIZE + 1;
+		unsigned int misses = 0;
+		for (size_t t = start; t < end; t++)
+		{
+			misses += simulateFIFO(indices + t * 3, cacheTimestamp, timestamp, DEFAULT_CACHE_SIZE);
+			if (t + 1 < end && float(misses) / float(t + 1 - start) <= targetACMR)
+			{
+				start = t + 1;
+				clusters.push_back(start);
+				timestamp += DEFAULT_CACHE_SIZE + 1;
+				misses = 0;
+			}
+		}
+	}
+	clusters.push_back(numTriangles);
+
+	const size_t numClusters = clusters.size() - 1;
+	if (numClusters < 2)
+	{
+		return;
+	}
+
+	// Area weighted centroid and normal of each cluster and of the whole mesh
+	std::vector<float> clusterData(numClusters * 6, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		float * centroid = &clusterData[c * 6];
+		float * normal = centroid + 3;
+		float clusterArea = 0.0f;
+
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const float * a = positions + size_t(indices[t * 3]) * 3;
+			const float * b = positions + size_t(indices[t * 3 + 1]) * 3;
+			const float * c3 = positions + size_t(indices[t * 3 + 2]) * 3;
+
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { c3[0] - a[0], c3[1] - a[1], c3[2] - a[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				centroid[k] += (a[k] + b[k] + c3[k]) * area / 3.0f;
+				normal[k] += n[k];
+			}
+			clusterArea += area;
+		}
+
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			meshCentroid[k] += centroid[k];
+			if (clusterArea > 0.0f)
+				centroid[k] /= clusterArea;
+		}
+		meshArea += clusterArea;
+	}
+
+	if (meshArea > 0.0f)
+	{
+		for (unsigned int k = 0; k < 3; k++)
+			meshCentroid[k] /= meshArea;
+	}
+
+	// Clusters facing away from the mesh center are more likely to occlude the rest: draw them first
+	std::vector<float> sortKey(numClusters);
+	std::vector<size_t> order(numClusters);
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		const float * centroid = &clusterData[c * 6];
+		const float * normal = centroid + 3;
+		float length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		float key = 0.0f;
+		if (length > 0.0f)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+				key += (centroid[k] - meshCentroid[k]) * normal[k];
+			key /= length;
+		}
+
+		sortKey[c] = key;
+		order[c] = c;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<unsigned int> result;
+	result.reserve(numTriangles * 3);
+	for (size_t i = 0; i < numClusters; i++)
+	{
+		size_t c = order[i];
+		result.insert(result.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+	}
+
+	memcpy(indices, &result[0], numTriangles * 3 * sizeof(unsigned int));
+}
+
+unsigned int Engine::MeshOptimizer::optimizeVertexFetch(const unsigned int * indices, size_t numIndices, unsigned int numVertices, std::vector<unsigned int> & remap)
+{
+	remap.assign(numVertices, INVALID_INDEX);
+
+	unsigned int next = 0;
+	for (size_t i = 0; i < numIndices; i++)
+	{
+		unsigned int v = indices[i];
+		if (remap[v] == INVALID_INDEX)
+		{
+			remap[v] = next++;
+		}
+	}
+
+	return next;
+}
+
+void Engine::MeshOptimizer::remapIndices(unsigned int * indices, size_t numIndices, const std::vector<unsigned int> & remap)
+{
+	for (size_t i = 0; i < numIndices; i++)
+	{
+		indices[i] = remap[indices[i]];
+	}
+}
+
+void Engine::MeshOptimizer::remapVertices(std::vector<float> & stream, unsigned int components, const std::vector<unsigned int> & remap, unsigned int newNumVertices)
+{
+	std::vector<float> result(size_t(newNumVertices) * components);
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		if (remap[v] != INVALID_INDEX)
+		{
+			memcpy(&result[size_t(remap[v]) * components], &stream[v * components], components * sizeof(float));
+		}
+	}
+	stream.swap(result);
+}
+
+Engine::VertexCacheStatistics Engine::MeshOptimizer::analyzeVertexCache(const unsigned int * indices, size_t numIndices, unsigned int numVertices, unsigned int cacheSize)
+{
+	VertexCacheStatistics stats;
+	stats.vertexTransforms = 0;
+	stats.acmr = 0.0f;
+	stats.atvr = 0.0f;
+
+	const size_t numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+	{
+		return stats;
+	}
+
+	std::vector<unsigned int> cacheTimestamp(numVertices, 0);
+	std::vector<bool> referenced(numVertices, false);
+	unsigned int timestamp = cacheSize + 1;
+	for (size_t t = 0; t < numTriangles; t++)
+	{
+		stats.vertexTransforms += simulateFIFO(indices + t * 3, cacheTimestamp, timestamp, cacheSize);
+		for (unsigned int k = 0; k < 3; k++)
+			referenced[indices[t * 3 + k]] = true;
+	}
+
+	unsigned int numReferenced = (unsigned int)std::count(referenced.begin(), referenced.end(), true);
+	stats.acmr = float(stats.vertexTransforms) / float(numTriangles);
+	stats.atvr = numReferenced > 0 ? float(stats.vertexTransforms) / float(numReferenced) : 0.0f;
+	return stats;
+}
+
+Engine::MeshOptimizerValidation Engine::MeshOptimizer::validate(unsigned int gridSize)
+{
+	MeshOptimizerValidation result;
+	memset(&result, 0, sizeof(result));
+
+	if (gridSize < 2)
+	{
+		return result;
+	}
+
+	// Row ordered grid on the XZ plane
+	const unsigned int gridVertices = gridSize * gridSize;
+	std::vector<float> gridPositions(size_t(gridVertices) * 3);
+	for (unsigned int z = 0; z < gridSize; z++)
+	{
+		for (unsigned int x = 0; x < gridSize; x++)
+		{
+			float * p = &gridPositions[size_t(z * gridSize + x) * 3];
+			p[0] = float(x);
+			p[1] = 0.0f;
+			p[2] = float(z);
+		}
+	}
+
+	std::vector<unsigned int> gridIndices;
+	gridIndices.reserve(size_t(gridSize - 1) * (gridSize - 1) * 6);
+	for (unsigned int z = 0; z + 1 < gridSize; z++)
+	{
+		for (unsigned int x = 0; x + 1 < gridSize; x++)
+		{
+			unsigned int v = z * gridSize + x;
+			unsigned int quad[6] = { v, v + gridSize, v + 1, v + 1, v + gridSize, v + gridSize + 1 };
+			gridIndices.insert(gridIndices.end(), quad, quad + 6);
+		}
+	}
+
+	// Same grid with the triangles and the vertices shuffled
+	std::default_random_engine generator(1234);
+	std::vector<unsigned int> triangleOrder(gridIndices.size() / 3);
+	for (size_t t = 0; t < triangleOrder.size(); t++)
+	{
+		triangleOrder[t] = (unsigned int)t;
+	}
+	std::shuffle(triangleOrder.begin(), triangleOrder.end(), generator);
+
+	std::vector<unsigned int> vertexRemap(gridVertices);
+	for (unsigned int v = 0; v < gridVertices; v++)
+	{
+		vertexRemap[v] = v;
+	}
+	std::shuffle(vertexRemap.begin(), vertexRemap.end(), generator);
+
+	std::vector<unsigned int> shuffledIndices;
+	shuffledIndices.reserve(gridIndices.size());
+	for (auto t : triangleOrder)
+	{
+		shuffledIndices.insert(shuffledIndices.end(), gridIndices.begin() + t * 3, gridIndices.begin() + t * 3 + 3);
+	}
+	remapIndices(&shuffledIndices[0], shuffledIndices.size(), vertexRemap);
+
+	std::vector<float> shuffledPositions = gridPositions;
+	remapVertices(shuffledPositions, 3, vertexRemap, gridVertices);
+
+	const std::vector<std::array<float, 9>> expected = sortedTriangles(gridPositions, gridIndices);
+
+	for (unsigned int c = 0; c < 2; c++)
+	{
+		const bool shuffled = c == 0;
+		std::vector<float> streams[VERTEX_ATTRIBUTE_COUNT];
+		streams[VERTEX_POSITION] = shuffled ? shuffledPositions : gridPositions;
+		std::vector<unsigned int> indices = shuffled ? shuffledIndices : gridIndices;
+		unsigned int numVertices = gridVertices;
+
+		VertexCacheStatistics input = analyzeVertexCache(&indices[0], indices.size(), numVertices);
+		optimize(streams, numVertices, indices);
+		VertexCacheStatistics optimized = analyzeVertexCache(&indices[0], indices.size(), numVertices);
+
+		std::vector<std::array<float, 9>> triangles = sortedTriangles(streams[VERTEX_POSITION], indices);
+		std::vector<std::array<float, 9>> missing;
+		std::set_difference(expected.begin(), expected.end(), triangles.begin(), triangles.end(), std::back_inserter(missing));
+		result.triangleMismatches += (unsigned int)missing.size();
+
+		(shuffled ? result.shuffledInput : result.orderedInput) = input;
+		(shuffled ? result.shuffledOptimized : result.orderedOptimized) = optimized;
+
+		std::cout << "MeshOptimizer: " << (shuffled ? "shuffled" : "ordered") << " " << gridSize << "x" << gridSize
+			<< " grid ACMR " << input.acmr << " -> " << optimized.acmr << ", ATVR " << input.atvr << " -> " << optimized.atvr << std::endl;
+	}
+
+	std::cout << "MeshOptimizer: " << result.triangleMismatches << " triangles lost" << std::endl;
+
+	return result;
+}
@@ -194,6 +194,11 @@ void Engine::PostProcessObject::addTexture(std::string name, Engine::TextureInst
 	inputBuffers[name] = instance;
 }
 
+void Engine::PostProcessObject::clearTextures()
+{
+	inputBuffers.clear();
+}
+
 Engine::TextureInstance * Engine::PostProcessObject::getTexture(std::string name)
 {
 	std::map<std::string, Engine::TextureInstance *>::iterator it = inputBuffers.find(name);
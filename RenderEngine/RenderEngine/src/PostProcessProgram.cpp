@@ -6,6 +6,7 @@
 #include "PostProcessProgram.h"
 
 #include "instances/TextureInstance.h"
+#include "GLStateCache.h"
 
 #include "volumetricclouds/NoiseInitializer.h"
 
@@ -55,13 +56,9 @@ void Engine::PostProcessProgram::configureMeshBuffers(Engine::Mesh * data)
 {
 	data->use();
 	
-	glBindBuffer(GL_ARRAY_BUFFER, data->vboVertices);
-	glVertexAttribPointer(inPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(inPos);
+	data->bindAttribute(Engine::VERTEX_POSITION, inPos);
 
-	glBindBuffer(GL_ARRAY_BUFFER, data->vboUVs);
-	glVertexAttribPointer(inTexCoord, 2, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(inTexCoord);
+	data->bindAttribute(Engine::VERTEX_UV, inTexCoord);
 }
 
 void Engine::PostProcessProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
@@ -76,16 +73,16 @@ void Engine::PostProcessProgram::onRenderObject(const Engine::Object * obj, Engi
 		if (uRenderedTextures[start] != -1)
 		{
 			glUniform1i(uRenderedTextures[start], start);
-			glActiveTexture(GL_TEXTURE0 + start);
-			glBindTexture(GL_TEXTURE_2D, it->second->getTexture()->getTextureId());
+			Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0 + start);
+			Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, it->second->getTexture()->getTextureId());
 		}
 		start++;
 		it++;
 	}
 	/*
 	glUniform1i(uRenderedTextures[0], 0);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, Engine::CloudSystem::NoiseInitializer::getInstance().getWeatherData()->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, Engine::CloudSystem::NoiseInitializer::getInstance().getWeatherData()->getTexture()->getTextureId());
 	*/
 }
 
@@ -0,0 +1,470 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "Profiler.h"
+
+#include <GL/glew.h>
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+const std::string Engine::Profiler::DEFAULT_TRACE_FILE = "profile_trace.json";
+
+// Scope nesting of threads other than the main one
+static thread_local unsigned int workerDepth = 0;
+
+static void copyName(char * dst, const char * src)
+{
+	const size_t capacity = sizeof(((Engine::ProfileEvent *)0)->name);
+	strncpy(dst, src != NULL ? src : "", capacity - 1);
+	dst[capacity - 1] = '\0';
+}
+
+static void writeJSONString(std::ofstream & file, const char * str)
+{
+	file << '"';
+	for (; *str != '\0'; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			file << '\\';
+		file << *str;
+	}
+	file << '"';
+}
+
+Engine::Profiler * Engine::Profiler::INSTANCE = new Engine::Profiler();
+
+Engine::Profiler & Engine::Profiler::getInstance()
+{
+	return *INSTANCE;
+}
+
+Engine::Profiler::Profiler()
+	:writeIndex(0)
+	,currentFrame(0)
+	,frameNumber(0)
+	,depth(0)
+	,gpuEpoch(0)
+	,gpuEpochCpu(0.0)
+	,started(false)
+	,enabled(true)
+	,captureFrames(false)
+	,nextThread(0)
+{
+	ring = new RingSlot[RING_CAPACITY];
+	for (unsigned int i = 0; i < RING_CAPACITY; i++)
+	{
+		ring[i].sequence.store(0);
+	}
+
+	for (unsigned int i = 0; i < FRAME_LATENCY; i++)
+	{
+		frames[i].usedQueries = 0;
+	}
+
+	epoch = std::chrono::high_resolution_clock::now();
+}
+
+Engine::Profiler::~Profiler()
+{
+	delete[] ring;
+}
+
+void Engine::Profiler::setEnabled(bool enabled)
+{
+	this->enabled = enabled;
+}
+
+bool Engine::Profiler::isEnabled() const
+{
+	return enabled;
+}
+
+double Engine::Profiler::now() const
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - epoch).count();
+}
+
+unsigned int Engine::Profiler::getThreadIndex()
+{
+	static thread_local unsigned int index = nextThread.fetch_add(1);
+	return index;
+}
+
+bool Engine::Profiler::isMainThread() const
+{
+	return started && std::this_thread::get_id() == mainThread;
+}
+
+void Engine::Profiler::beginFrame()
+{
+	if (!started)
+	{
+		// The thread that runs the frames is the only one allowed to issue GL queries
+		started = true;
+		mainThread = std::this_thread::get_id();
+		getThreadIndex();
+
+		GLint64 timestamp = 0;
+		glGetInteger64v(GL_TIMESTAMP, &timestamp);
+		gpuEpoch = timestamp;
+		gpuEpochCpu = now();
+		return;
+	}
+
+	// Unbalanced scopes of the previous frame
+	depth = 0;
+
+	currentFrame = (currentFrame + 1) % FRAME_LATENCY;
+	frameNumber++;
+
+	resolveFrame(frames[currentFrame]);
+}
+
+void Engine::Profiler::flush()
+{
+	if (!started)
+		return;
+
+	glFinish();
+
+	// Oldest first, the current frame last
+	for (unsigned int i = 1; i <= FRAME_LATENCY; i++)
+	{
+		resolveFrame(frames[(currentFrame + i) % FRAME_LATENCY]);
+	}
+}
+
+unsigned int Engine::Profiler::beginScope(const char * name, bool gpu)
+{
+	if (!enabled || !started)
+		return INVALID_SCOPE;
+
+	FrameScopes & frame = frames[currentFrame];
+
+	PendingScope scope;
+	copyName(scope.event.name, name);
+	scope.event.depth = depth++;
+	scope.event.thread = getThreadIndex();
+	scope.event.frame = frameNumber;
+	scope.event.cpuStart = now();
+	scope.event.cpuEnd = scope.event.cpuStart;
+	scope.event.gpuStart = scope.event.gpuEnd = -1.0;
+	scope.query = INVALID_SCOPE;
+
+	if (gpu)
+	{
+		if (frame.usedQueries + 2 > frame.queries.size())
+		{
+			size_t first = frame.queries.size();
+			frame.queries.resize(first + 32);
+			glGenQueries(32, &frame.queries[first]);
+		}
+
+		scope.query = frame.usedQueries;
+		frame.usedQueries += 2;
+		glQueryCounter(frame.queries[scope.query], GL_TIMESTAMP);
+	}
+
+	frame.scopes.push_back(scope);
+	return (unsigned int)frame.scopes.size() - 1;
+}
+
+void Engine::Profiler::endScope(unsigned int scope)
+{
+	FrameScopes & frame = frames[currentFrame];
+	if (scope == INVALID_SCOPE || scope >= frame.scopes.size())
+		return;
+
+	PendingScope & pending = frame.scopes[scope];
+	pending.event.cpuEnd = now();
+	if (pending.query != INVALID_SCOPE)
+	{
+		glQueryCounter(frame.queries[pending.query + 1], GL_TIMESTAMP);
+	}
+
+	depth = depth > 0 ? depth - 1 : 0;
+}
+
+void Engine::Profiler::recordEvent(const Engine::ProfileEvent & event)
+{
+	// Claim a slot, and mark it as being written (odd sequence) until the event is complete
+	unsigned long long ticket = writeIndex.fetch_add(1);
+	RingSlot & slot = ring[ticket % RING_CAPACITY];
+
+	slot.sequence.store(ticket * 2 + 1, std::memory_order_release);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.event = event;
+	slot.sequence.store(ticket * 2 + 2, std::memory_order_release);
+}
+
+void Engine::Profiler::getEvents(std::vector<Engine::ProfileEvent> & events) const
+{
+	unsigned long long end = writeIndex.load(std::memory_order_acquire);
+	unsigned long long begin = end > RING_CAPACITY ? end - RING_CAPACITY : 0;
+
+	events.clear();
+	events.reserve(size_t(end - begin));
+	for (unsigned long long ticket = begin; ticket < end; ticket++)
+	{
+		const RingSlot & slot = ring[ticket % RING_CAPACITY];
+
+		// Skip the slots being written or already overwritten by a newer event
+		unsigned long long sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != ticket * 2 + 2)
+			continue;
+
+		ProfileEvent event = slot.event;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+			continue;
+
+		events.push_back(event);
+	}
+}
+
+const std::vector<Engine::ProfileStageStats> & Engine::Profiler::getStageStats() const
+{
+	return frameStages;
+}
+
+void Engine::Profiler::setFrameCapture(bool capture)
+{
+	captureFrames = capture;
+	if (!capture)
+	{
+		capturedFrames.clear();
+	}
+}
+
+void Engine::Profiler::takeCapturedFrames(std::vector<Engine::ProfileFrame> & frames)
+{
+	frames.clear();
+	frames.swap(capturedFrames);
+}
+
+void Engine::Profiler::resolveFrame(FrameScopes & frame)
+{
+	if (frame.scopes.empty())
+		return;
+
+	frameStages.clear();
+
+	// Paths of the enclosing scopes, by depth
+	std::vector<std::string> paths;
+	// Stages might run several times per frame (one scope per cascade or tile group)
+	std::map<std::string, unsigned int> frameStageIndex;
+	std::vector<double> cpuTotals, gpuTotals;
+
+	for (auto & scope : frame.scopes)
+	{
+		ProfileEvent & event = scope.event;
+
+		if (scope.query != INVALID_SCOPE)
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(frame.queries[scope.query + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint64 start = 0, end = 0;
+				glGetQueryObjectui64v(frame.queries[scope.query], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(frame.queries[scope.query + 1], GL_QUERY_RESULT, &end);
+				event.gpuStart = double((long long)start - gpuEpoch) / 1000.0 + gpuEpochCpu;
+				event.gpuEnd = double((long long)end - gpuEpoch) / 1000.0 + gpuEpochCpu;
+			}
+		}
+
+		recordEvent(event);
+
+		paths.resize(event.depth + 1);
+		paths[event.depth] = event.depth > 0 ? paths[event.depth - 1] + "/" + event.name : std::string(event.name);
+		const std::string & path = paths[event.depth];
+
+		double cpuMs = (event.cpuEnd - event.cpuStart) / 1000.0;
+		double gpuMs = event.gpuStart >= 0.0 ? (event.gpuEnd - event.gpuStart) / 1000.0 : -1.0;
+
+		auto it = frameStageIndex.find(path);
+		if (it == frameStageIndex.end())
+		{
+			frameStageIndex[path] = (unsigned int)frameStages.size();
+
+			ProfileStageStats stage;
+			stage.path = path;
+			stage.name = event.name;
+			stage.depth = event.depth;
+			frameStages.push_back(stage);
+			cpuTotals.push_back(cpuMs);
+			gpuTotals.push_back(gpuMs);
+		}
+		else
+		{
+			cpuTotals[it->second] += cpuMs;
+			if (gpuMs >= 0.0)
+			{
+				gpuTotals[it->second] = gpuTotals[it->second] < 0.0 ? gpuMs : gpuTotals[it->second] + gpuMs;
+			}
+		}
+	}
+
+	if (captureFrames)
+	{
+		ProfileFrame captured;
+		captured.frame = frame.scopes[0].event.frame;
+		captured.stages = frameStages;
+		for (size_t i = 0; i < captured.stages.size(); i++)
+		{
+			captured.stages[i].cpuMs = cpuTotals[i];
+			captured.stages[i].gpuMs = gpuTotals[i];
+		}
+		capturedFrames.push_back(captured);
+	}
+
+	for (size_t i = 0; i < frameStages.size(); i++)
+	{
+		ProfileStageStats & stage = frameStages[i];
+		updateStage(stage.path, stage.name, stage.depth, cpuTotals[i], gpuTotals[i]);
+		stage = stages[stageIndex[stage.path]];
+	}
+
+	frame.scopes.clear();
+	frame.usedQueries = 0;
+}
+
+void Engine::Profiler::updateStage(const std::string & path, const std::string & name, unsigned int depth, double cpuMs, double gpuMs)
+{
+	auto it = stageIndex.find(path);
+	unsigned int index;
+	if (it == stageIndex.end())
+	{
+		index = (unsigned int)stages.size();
+		stageIndex[path] = index;
+
+		ProfileStageStats stage;
+		stage.path = path;
+		stage.name = name;
+		stage.depth = depth;
+		stages.push_back(stage);
+
+		StageHistory samples;
+		samples.count = samples.next = 0;
+		history.push_back(samples);
+	}
+	else
+	{
+		index = it->second;
+	}
+
+	StageHistory & samples = history[index];
+	samples.cpuMs[samples.next] = cpuMs;
+	samples.gpuMs[samples.next] = gpuMs;
+	samples.next = (samples.next + 1) % ROLLING_FRAMES;
+	samples.count = samples.count < ROLLING_FRAMES ? samples.count + 1 : ROLLING_FRAMES;
+
+	double cpuSum = 0.0, gpuSum = 0.0;
+	unsigned int gpuCount = 0;
+	for (unsigned int i = 0; i < samples.count; i++)
+	{
+		cpuSum += samples.cpuMs[i];
+		if (samples.gpuMs[i] >= 0.0)
+		{
+			gpuSum += samples.gpuMs[i];
+			gpuCount++;
+		}
+	}
+
+	stages[index].cpuMs = cpuSum / double(samples.count);
+	stages[index].gpuMs = gpuCount > 0 ? gpuSum / double(gpuCount) : -1.0;
+}
+
+bool Engine::Profiler::exportChromeTrace(const std::string & fileName) const
+{
+	std::vector<ProfileEvent> events;
+	getEvents(events);
+
+	std::ofstream file(fileName.c_str(), std::ios::out | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "Profiler: Could not write " << fileName << std::endl;
+		return false;
+	}
+
+	// GPU scopes go to their own track, after the CPU threads
+	const unsigned int gpuThread = nextThread.load() + 1;
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[" << std::endl;
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << gpuThread << ",\"args\":{\"name\":\"GPU\"}}";
+	for (unsigned int i = 0; i < nextThread.load(); i++)
+	{
+		file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i
+			<< ",\"args\":{\"name\":\"" << (i == 0 ? "Main thread" : "Worker thread") << "\"}}";
+	}
+
+	for (auto & event : events)
+	{
+		file << "," << std::endl << "{\"name\":";
+		writeJSONString(file, event.name);
+		file << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+			<< ",\"ts\":" << event.cpuStart << ",\"dur\":" << (event.cpuEnd - event.cpuStart)
+			<< ",\"args\":{\"frame\":" << event.frame << "}}";
+
+		if (event.gpuStart >= 0.0)
+		{
+			file << "," << std::endl << "{\"name\":";
+			writeJSONString(file, event.name);
+			file << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << gpuThread
+				<< ",\"ts\":" << event.gpuStart << ",\"dur\":" << (event.gpuEnd - event.gpuStart)
+				<< ",\"args\":{\"frame\":" << event.frame << "}}";
+		}
+	}
+
+	file << std::endl << "]}" << std::endl;
+
+	std::cout << "Profiler: " << events.size() << " scopes written to " << fileName << std::endl;
+	return file.good();
+}
+
+// ==============================================================================
+
+Engine::ProfileScope::ProfileScope(const char * name, bool gpu)
+	:scope(Engine::Profiler::INVALID_SCOPE)
+	,worker(false)
+{
+	Engine::Profiler & profiler = Engine::Profiler::getInstance();
+	if (!profiler.isEnabled())
+		return;
+
+	if (profiler.isMainThread())
+	{
+		scope = profiler.beginScope(name, gpu);
+		return;
+	}
+
+	worker = true;
+	copyName(event.name, name);
+	event.depth = workerDepth++;
+	event.thread = profiler.getThreadIndex();
+	event.frame = 0;
+	event.gpuStart = event.gpuEnd = -1.0;
+	event.cpuStart = profiler.now();
+}
+
+Engine::ProfileScope::~ProfileScope()
+{
+	Engine::Profiler & profiler = Engine::Profiler::getInstance();
+
+	if (worker)
+	{
+		event.cpuEnd = profiler.now();
+		workerDepth--;
+		profiler.recordEvent(event);
+	}
+	else
+	{
+		profiler.endScope(scope);
+	}
+}
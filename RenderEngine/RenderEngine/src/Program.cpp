@@ -5,16 +5,19 @@
 
 #include "Program.h"
 
+#include <chrono>
 #include <iostream>
 
+#include "datatables/ShaderCache.h"
 #include "util/IOUtils.h"
+#include "GLStateCache.h"
 
 const size_t VERSION_HEADER_LENGHT = 17;
 
 // ================================================================================
 
 Engine::Program::Program(std::string name, unsigned long long params)
-	:name(name),parameters(params)
+	:glProgram(0),vShader(0),fShader(0),parameters(params),name(name)
 {
 }
 
@@ -39,28 +42,10 @@ void Engine::Program::initialize()
 		return;
 	}
 
-	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER);
-	fShader = loadShader(fShaderFile, GL_FRAGMENT_SHADER);
-
-	glProgram = glCreateProgram();
-
-	glAttachShader(glProgram, vShader);
-	glAttachShader(glProgram, fShader);
-
-	glLinkProgram(glProgram);
-
-	int linked;
-	glGetProgramiv(glProgram, GL_LINK_STATUS, &linked);
-	if (!linked)
-	{
-		GLint logLen;
-		glGetProgramiv(glProgram, GL_INFO_LOG_LENGTH, &logLen);
-		char *logString = new char[logLen];
-		glGetProgramInfoLog(glProgram, logLen, NULL, logString);
-		std::cout << "Error: " << logString << std::endl;
-		delete[] logString;
-		exit(-1);
-	}
+	std::vector<ShaderStage> stages;
+	stages.push_back({ vShaderFile, GL_VERTEX_SHADER, &vShader });
+	stages.push_back({ fShaderFile, GL_FRAGMENT_SHADER, &fShader });
+	linkProgram(stages);
 
 	configureProgram();
 }
@@ -76,10 +61,21 @@ unsigned int Engine::Program::getProgramId() const
 
 unsigned int Engine::Program::loadShader(std::string fileName, GLenum type, std::string configString, bool outputToFile, std::string outputFileName)
 {
-	size_t fileLen;
+	return compileShader(loadShaderSource(fileName, configString), type, fileName);
+}
+
+std::string Engine::Program::loadShaderSource(std::string fileName, std::string configString)
+{
+	unsigned long long fileLen;
 	char *source = Engine::IO::loadStringFromFile(fileName.c_str(), fileLen);
+	if (source == 0)
+	{
+		std::cout << name << ": Could not read " << fileName << std::endl;
+		exit(-1);
+	}
 	
-	std::string result(source);
+	std::string result(source, fileLen);
+	delete[] source;
 
 	if (!configString.empty())
 	{
@@ -87,17 +83,19 @@ unsigned int Engine::Program::loadShader(std::string fileName, GLenum type, std:
 		std::string body = result.substr(VERSION_HEADER_LENGHT, result.size() - VERSION_HEADER_LENGHT);
 		result = header + "\n" + configString + "\n" + body;
 	}
-	
-	char * finalSourceCStr = new char[result.size()];
-	memcpy(finalSourceCStr, result.c_str(), result.size() * sizeof(char));
-	fileLen = result.size();
+
+	return result;
+}
+
+unsigned int Engine::Program::compileShader(const std::string & source, GLenum type, const std::string & fileName)
+{
+	const GLchar * sourceStr = source.c_str();
+	GLint sourceLen = (GLint)source.size();
 	
 	GLuint shader;
 	shader = glCreateShader(type);
-	glShaderSource(shader, 1, (const GLchar **)&finalSourceCStr, (const GLint *)&fileLen);
+	glShaderSource(shader, 1, &sourceStr, &sourceLen);
 	glCompileShader(shader);
-	delete[] source;
-	delete[] finalSourceCStr;
 
 	GLint compiled;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
@@ -116,6 +114,56 @@ unsigned int Engine::Program::loadShader(std::string fileName, GLenum type, std:
 	return shader;
 }
 
+void Engine::Program::linkProgram(const std::vector<ShaderStage> & stages, std::string configString)
+{
+	std::vector<std::string> sources;
+	std::vector<unsigned int> types;
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		sources.push_back(loadShaderSource(stages[i].fileName, configString));
+		types.push_back(stages[i].type);
+		*stages[i].shader = 0;
+	}
+
+	Engine::ShaderCache & cache = Engine::ShaderCache::getInstance();
+	std::string cacheId = name + "_" + std::to_string(parameters);
+	unsigned long long key = cache.computeKey(parameters, types, sources);
+
+	glProgram = glCreateProgram();
+
+	if (cache.loadProgram(cacheId, key, glProgram))
+	{
+		return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		*stages[i].shader = compileShader(sources[i], stages[i].type, stages[i].fileName);
+		glAttachShader(glProgram, *stages[i].shader);
+	}
+
+	cache.prepareProgram(glProgram);
+	glLinkProgram(glProgram);
+
+	int linked;
+	glGetProgramiv(glProgram, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		GLint logLen;
+		glGetProgramiv(glProgram, GL_INFO_LOG_LENGTH, &logLen);
+		char *logString = new char[logLen];
+		glGetProgramInfoLog(glProgram, logLen, NULL, logString);
+		std::cout << "Error: " << logString << std::endl;
+		delete[] logString;
+		exit(-1);
+	}
+
+	std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - start;
+	cache.storeProgram(cacheId, key, glProgram, buildTime.count());
+}
+
 void Engine::Program::applyGlobalUniforms()
 {
 }
@@ -127,18 +175,25 @@ std::string Engine::Program::getName() const
 
 void Engine::Program::destroy()
 {
-	glDetachShader(glProgram, vShader);
-	glDeleteShader(vShader);
+	// Programs loaded from the ShaderCache have no shaders
+	if (vShader != 0)
+	{
+		glDetachShader(glProgram, vShader);
+		glDeleteShader(vShader);
+	}
 
-	glDetachShader(glProgram, fShader);
-	glDeleteShader(fShader);
+	if (fShader != 0)
+	{
+		glDetachShader(glProgram, fShader);
+		glDeleteShader(fShader);
+	}
 
-	glDeleteProgram(glProgram);
+	Engine::GLStateCache::getInstance().deleteProgram(glProgram);
 }
 
 void Engine::Program::use()
 {
-	glUseProgram(glProgram);
+	Engine::GLStateCache::getInstance().useProgram(glProgram);
 }
 
 // ===========================================================
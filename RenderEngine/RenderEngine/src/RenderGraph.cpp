@@ -0,0 +1,449 @@
+#include "RenderGraph.h"
+
+#include "textures/Texture2D.h"
+#include "GLStateCache.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <iostream>
+
+const unsigned int Engine::RenderGraph::INVALID;
+
+Engine::RenderGraph::RenderGraph()
+	:output(INVALID)
+	,outputObj(NULL)
+	,screenWidth(0)
+	,screenHeight(0)
+	,dirty(true)
+{
+}
+
+Engine::RenderGraph::~RenderGraph()
+{
+}
+
+unsigned int Engine::RenderGraph::importTexture(const std::string & name, Engine::TextureInstance * texture)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = { GLenum(texture->getTexture()->getMemoryLayoutFormat()), texture->getTexture()->getImageFormat(), texture->getTexture()->getPixelFormat(), texture->getMagnificationFilterType(), 1.0f, 1.0f };
+	resource.imported = texture;
+	resource.producer = INVALID;
+	resource.producerOutput = INVALID;
+	resource.firstUse = resource.lastUse = resource.target = INVALID;
+
+	resources.push_back(resource);
+	dirty = true;
+	return (unsigned int)resources.size() - 1;
+}
+
+unsigned int Engine::RenderGraph::createTexture(const std::string & name, const Engine::RenderTargetDesc & desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = NULL;
+	resource.producer = INVALID;
+	resource.producerOutput = INVALID;
+	resource.firstUse = resource.lastUse = resource.target = INVALID;
+
+	resources.push_back(resource);
+	dirty = true;
+	return (unsigned int)resources.size() - 1;
+}
+
+unsigned int Engine::RenderGraph::addPass(const std::string & name, Engine::Program * program, Engine::PostProcessObject * obj, const std::vector<unsigned int> & inputs, const std::vector<unsigned int> & outputs)
+{
+	unsigned int index = (unsigned int)passes.size();
+
+	for (unsigned int i = 0; i < outputs.size(); i++)
+	{
+		Resource & resource = resources[outputs[i]];
+		if (resource.imported != NULL || resource.producer != INVALID)
+		{
+			std::cerr << "RenderGraph: " << resource.name << " can not be written by " << name << std::endl;
+			exit(-1);
+		}
+
+		resource.producer = index;
+		resource.producerOutput = i;
+	}
+
+	Pass pass;
+	pass.name = name;
+	pass.program = program;
+	pass.obj = obj;
+	pass.inputs = inputs;
+	pass.outputs = outputs;
+	pass.enabled = true;
+	glGenFramebuffers(1, &pass.fbo);
+
+	passes.push_back(pass);
+	dirty = true;
+	return index;
+}
+
+void Engine::RenderGraph::setOutput(unsigned int resource, Engine::PostProcessObject * obj)
+{
+	if (output != resource || outputObj != obj)
+	{
+		output = resource;
+		outputObj = obj;
+		dirty = true;
+	}
+}
+
+void Engine::RenderGraph::setPassEnabled(unsigned int pass, bool enabled)
+{
+	if (passes[pass].enabled != enabled)
+	{
+		passes[pass].enabled = enabled;
+		dirty = true;
+	}
+}
+
+bool Engine::RenderGraph::isPassEnabled(unsigned int pass) const
+{
+	return passes[pass].enabled;
+}
+
+void Engine::RenderGraph::setPassScale(unsigned int pass, float scale)
+{
+	for (auto o : passes[pass].outputs)
+	{
+		RenderTargetDesc & desc = resources[o].desc;
+		if (desc.widthScale != scale || desc.heightScale != scale)
+		{
+			desc.widthScale = desc.heightScale = scale;
+			dirty = true;
+		}
+	}
+}
+
+float Engine::RenderGraph::getPassScale(unsigned int pass) const
+{
+	return passes[pass].outputs.empty() ? 1.0f : resources[passes[pass].outputs[0]].desc.widthScale;
+}
+
+unsigned int Engine::RenderGraph::getNumPasses() const
+{
+	return (unsigned int)passes.size();
+}
+
+const std::string & Engine::RenderGraph::getPassName(unsigned int pass) const
+{
+	return passes[pass].name;
+}
+
+unsigned int Engine::RenderGraph::getNumScheduledPasses() const
+{
+	return (unsigned int)schedule.size();
+}
+
+void Engine::RenderGraph::onResize(unsigned int width, unsigned int height)
+{
+	screenWidth = width;
+	screenHeight = height;
+	dirty = true;
+}
+
+unsigned int Engine::RenderGraph::resolve(unsigned int resource) const
+{
+	while (true)
+	{
+		const Resource & r = resources[resource];
+		if (r.producer == INVALID)
+			return resource;
+
+		const Pass & producer = passes[r.producer];
+		if (producer.enabled || producer.inputs.empty())
+			return resource;
+
+		// Disabled pass, forward its matching input
+		resource = r.producerOutput < producer.inputs.size() ? producer.inputs[r.producerOutput] : producer.inputs[0];
+	}
+}
+
+void Engine::RenderGraph::getTargetSize(const Engine::RenderTargetDesc & desc, unsigned int & width, unsigned int & height) const
+{
+	width = (unsigned int)ceil(float(screenWidth) * desc.widthScale);
+	height = (unsigned int)ceil(float(screenHeight) * desc.heightScale);
+	width = width > 0 ? width : 1;
+	height = height > 0 ? height : 1;
+}
+
+unsigned int Engine::RenderGraph::acquireTarget(const Engine::RenderTargetDesc & desc)
+{
+	unsigned int width, height;
+	getTargetSize(desc, width, height);
+
+	for (unsigned int i = 0; i < pool.size(); i++)
+	{
+		PooledTarget & target = pool[i];
+		if (!target.inUse && target.width == width && target.height == height
+			&& target.desc.internalFormat == desc.internalFormat && target.desc.format == desc.format
+			&& target.desc.pixelType == desc.pixelType && target.desc.filter == desc.filter)
+		{
+			target.inUse = target.used = true;
+			return i;
+		}
+	}
+
+	Engine::Texture2D * texture = new Engine::Texture2D("", 0, width, height);
+	texture->setGenerateMipMaps(false);
+	texture->setMemoryLayoutFormat(desc.internalFormat);
+	texture->setImageFormatType(desc.format);
+	texture->setPixelFormatType(desc.pixelType);
+
+	Engine::TextureInstance * ti = new Engine::TextureInstance(texture);
+	ti->setMagnificationFilterType(desc.filter);
+	ti->setMinificationFilterType(desc.filter);
+	ti->setAnisotropicFilterEnabled(false);
+	ti->setSComponentWrapType(GL_CLAMP_TO_EDGE);
+	ti->setTComponentWrapType(GL_CLAMP_TO_EDGE);
+	ti->generateTexture();
+	ti->resize(width, height);
+
+	PooledTarget target;
+	target.desc = desc;
+	target.width = width;
+	target.height = height;
+	target.texture = ti;
+	target.inUse = target.used = true;
+	pool.push_back(target);
+
+	return (unsigned int)pool.size() - 1;
+}
+
+void Engine::RenderGraph::attachOutputs(Engine::RenderGraph::Pass & pass)
+{
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+
+	std::vector<GLenum> buffers;
+	for (unsigned int i = 0; i < pass.outputs.size(); i++)
+	{
+		const PooledTarget & target = pool[resources[pass.outputs[i]].target];
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, target.texture->getTexture()->getTextureId(), 0);
+		buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+	glDrawBuffers(GLsizei(buffers.size()), &buffers[0]);
+
+	if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+	{
+		std::cerr << "RenderGraph: Incomplete framebuffer on pass " << pass.name << std::endl;
+		exit(-1);
+	}
+
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Engine::RenderGraph::compile()
+{
+	if (!dirty || screenWidth == 0 || screenHeight == 0 || output == INVALID)
+		return;
+
+	dirty = false;
+
+	// Cull: walk backwards from the output, keeping the enabled passes whose outputs are read
+	std::vector<bool> needed(resources.size(), false);
+	std::vector<bool> scheduled(passes.size(), false);
+	needed[resolve(output)] = true;
+	for (int p = int(passes.size()) - 1; p >= 0; p--)
+	{
+		Pass & pass = passes[p];
+		if (!pass.enabled)
+			continue;
+
+		bool read = false;
+		for (auto o : pass.outputs)
+		{
+			read = read || needed[o];
+		}
+
+		if (!read)
+			continue;
+
+		scheduled[p] = true;
+		for (auto i : pass.inputs)
+		{
+			needed[resolve(i)] = true;
+		}
+	}
+
+	schedule.clear();
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		if (scheduled[p])
+			schedule.push_back(p);
+	}
+
+	// Lifetimes, as positions within the schedule
+	for (auto & resource : resources)
+	{
+		resource.firstUse = resource.lastUse = resource.target = INVALID;
+	}
+
+	for (unsigned int s = 0; s < schedule.size(); s++)
+	{
+		const Pass & pass = passes[schedule[s]];
+		for (auto o : pass.outputs)
+		{
+			resources[o].firstUse = resources[o].lastUse = s;
+		}
+
+		for (auto i : pass.inputs)
+		{
+			resources[resolve(i)].lastUse = s;
+		}
+	}
+
+	// The output is presented after the last pass
+	resources[resolve(output)].lastUse = (unsigned int)schedule.size();
+
+	// Aliasing: targets are taken when a pass writes them and given back after their last read
+	for (auto & target : pool)
+	{
+		target.inUse = target.used = false;
+	}
+
+	for (unsigned int s = 0; s < schedule.size(); s++)
+	{
+		const Pass & pass = passes[schedule[s]];
+		for (auto o : pass.outputs)
+		{
+			resources[o].target = acquireTarget(resources[o].desc);
+		}
+
+		for (auto o : pass.outputs)
+		{
+			if (resources[o].lastUse == s)
+				pool[resources[o].target].inUse = false;
+		}
+
+		for (auto i : pass.inputs)
+		{
+			const Resource & resource = resources[resolve(i)];
+			if (resource.imported == NULL && resource.lastUse == s)
+				pool[resource.target].inUse = false;
+		}
+	}
+
+	// Release the targets the schedule does not need anymore (passes disabled, screen resized)
+	std::vector<unsigned int> remap(pool.size(), INVALID);
+	std::vector<PooledTarget> kept;
+	for (unsigned int i = 0; i < pool.size(); i++)
+	{
+		if (pool[i].used)
+		{
+			remap[i] = (unsigned int)kept.size();
+			kept.push_back(pool[i]);
+		}
+		else
+		{
+			Engine::GLStateCache::getInstance().deleteTexture(pool[i].texture->getTexture()->getTextureId());
+			delete pool[i].texture->getTexture();
+			delete pool[i].texture;
+		}
+	}
+	pool = kept;
+
+	for (auto & resource : resources)
+	{
+		if (resource.target != INVALID)
+			resource.target = remap[resource.target];
+	}
+
+	// Framebuffers and pass inputs
+	for (auto p : schedule)
+	{
+		Pass & pass = passes[p];
+		attachOutputs(pass);
+
+		pass.obj->clearTextures();
+		for (unsigned int i = 0; i < pass.inputs.size(); i++)
+		{
+			const Resource & resource = resources[resolve(pass.inputs[i])];
+			pass.obj->addTexture("color_" + std::to_string(i), resource.imported != NULL ? resource.imported : pool[resource.target].texture);
+		}
+	}
+
+	const Resource & result = resources[resolve(output)];
+	outputObj->clearTextures();
+	outputObj->addTexture("color_0", result.imported != NULL ? result.imported : pool[result.target].texture);
+}
+
+void Engine::RenderGraph::execute(Engine::Camera * cam)
+{
+	compile();
+
+	for (auto p : schedule)
+	{
+		Pass & pass = passes[p];
+		Engine::ProfileScope profile(pass.name.c_str());
+
+		unsigned int width, height;
+		getTargetSize(resources[pass.outputs[0]].desc, width, height);
+
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+		Engine::GLStateCache::getInstance().viewport(0, 0, width, height);
+
+		pass.program->use();
+		pass.obj->getMesh()->use();
+		pass.program->onRenderObject(pass.obj, cam);
+
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
+
+	Engine::GLStateCache::getInstance().viewport(0, 0, screenWidth, screenHeight);
+}
+
+size_t Engine::RenderGraph::getAllocatedMemory() const
+{
+	size_t bytes = 0;
+	for (auto & target : pool)
+	{
+		bytes += size_t(target.width) * size_t(target.height) * Engine::AbstractTexture::getTexelSize(target.desc.internalFormat);
+	}
+
+	return bytes;
+}
+
+size_t Engine::RenderGraph::getUnaliasedMemory() const
+{
+	size_t bytes = 0;
+	for (auto p : schedule)
+	{
+		for (auto o : passes[p].outputs)
+		{
+			unsigned int width, height;
+			getTargetSize(resources[o].desc, width, height);
+			bytes += size_t(width) * size_t(height) * Engine::AbstractTexture::getTexelSize(resources[o].desc.internalFormat);
+		}
+	}
+
+	return bytes;
+}
+
+unsigned int Engine::RenderGraph::getNumAllocatedTargets() const
+{
+	return (unsigned int)pool.size();
+}
+
+void Engine::RenderGraph::clean()
+{
+	for (auto & target : pool)
+	{
+		Engine::GLStateCache::getInstance().deleteTexture(target.texture->getTexture()->getTextureId());
+		delete target.texture->getTexture();
+		delete target.texture;
+	}
+	pool.clear();
+
+	for (auto & pass : passes)
+	{
+		Engine::GLStateCache::getInstance().deleteFramebuffer(pass.fbo);
+		pass.fbo = 0;
+	}
+
+	dirty = true;
+}
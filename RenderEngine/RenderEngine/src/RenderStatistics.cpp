@@ -0,0 +1,34 @@
+#include "RenderStatistics.h"
+
+unsigned int Engine::RenderStatistics::drawCalls = 0;
+unsigned int Engine::RenderStatistics::drawnInstances = 0;
+unsigned int Engine::RenderStatistics::uniformUploads = 0;
+unsigned int Engine::RenderStatistics::storageUploads = 0;
+unsigned int Engine::RenderStatistics::issuedStateChanges = 0;
+unsigned int Engine::RenderStatistics::filteredStateChanges = 0;
+double Engine::RenderStatistics::terrainSubmitMs = 0.0;
+unsigned int Engine::RenderStatistics::treeLODInstances[Engine::RenderStatistics::TREE_LODS] = { 0 };
+unsigned int Engine::RenderStatistics::shadowCasterTiles[Engine::RenderStatistics::SHADOW_CASCADES] = { 0 };
+double Engine::RenderStatistics::shadowPassMs = 0.0;
+unsigned int Engine::RenderStatistics::shadowCacheTexels = 0;
+
+void Engine::RenderStatistics::reset()
+{
+	drawCalls = 0;
+	drawnInstances = 0;
+	uniformUploads = 0;
+	storageUploads = 0;
+	issuedStateChanges = 0;
+	filteredStateChanges = 0;
+	terrainSubmitMs = 0.0;
+	for (unsigned int i = 0; i < TREE_LODS; i++)
+	{
+		treeLODInstances[i] = 0;
+	}
+	for (unsigned int i = 0; i < SHADOW_CASCADES; i++)
+	{
+		shadowCasterTiles[i] = 0;
+	}
+	shadowPassMs = 0.0;
+	shadowCacheTexels = 0;
+}
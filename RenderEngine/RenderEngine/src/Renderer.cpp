@@ -6,6 +6,9 @@
 #include "Renderer.h"
 #include "PostProcessProgram.h"
 #include "Scene.h"
+#include "RenderStatistics.h"
+#include "Profiler.h"
+#include "FrameGlobalsBuffer.h"
 
 #include <iostream>
 
@@ -61,6 +64,14 @@ Engine::RenderManager::~RenderManager()
 
 void Engine::RenderManager::doRender()
 {
+	Engine::RenderStatistics::reset();
+	Engine::Profiler::getInstance().beginFrame();
+
+	Engine::ProfileScope profile("Frame");
+
+	// Settings might have changed since last frame (user interface, animations)
+	Engine::GPU::FrameGlobalsBuffer::getInstance().update();
+
 	activeRender->doRender();
 }
 
@@ -4,7 +4,7 @@
 */
 
 #include "Scene.h"
-#include <gl/glew.h>
+#include <GL/glew.h>
 
 #include <iostream>
 
@@ -113,14 +113,62 @@ void Engine::Scene::addObject(Engine::Object *obj)
 
 void Engine::Scene::addPointLight(Engine::PointLight * pl)
 {
-	pl->setBufferIndex(unsigned int(pointLights.size()));
+	if (getLightByName(pl->getName()) == pl)
+		return;
+
+	// A light with the same name is replaced
+	removePointLight(pl->getName());
 	pointLights[pl->getName()] = pl;
+
+	// Otherwise it is stored when the scene starts
+	if (Engine::SceneManager::getInstance().getActiveScene() == this)
+	{
+		Engine::GPU::LightBufferManager::getInstance().addPointLight(pl);
+	}
 }
 
 void Engine::Scene::addSpotLight(Engine::SpotLight * sl)
 {
-	sl->setBufferIndex(unsigned int(spotLights.size()));
+	if (getSpotLightByName(sl->getName()) == sl)
+		return;
+
+	removeSpotLight(sl->getName());
 	spotLights[sl->getName()] = sl;
+
+	if (Engine::SceneManager::getInstance().getActiveScene() == this)
+	{
+		Engine::GPU::LightBufferManager::getInstance().addSpotLight(sl);
+	}
+}
+
+void Engine::Scene::removePointLight(std::string name)
+{
+	std::map<std::string, Engine::PointLight *>::iterator it = pointLights.find(name);
+	if (it == pointLights.end())
+		return;
+
+	if (Engine::SceneManager::getInstance().getActiveScene() == this)
+	{
+		Engine::GPU::LightBufferManager::getInstance().removeLight(it->second);
+	}
+
+	delete it->second;
+	pointLights.erase(it);
+}
+
+void Engine::Scene::removeSpotLight(std::string name)
+{
+	std::map<std::string, Engine::SpotLight *>::iterator it = spotLights.find(name);
+	if (it == spotLights.end())
+		return;
+
+	if (Engine::SceneManager::getInstance().getActiveScene() == this)
+	{
+		Engine::GPU::LightBufferManager::getInstance().removeLight(it->second);
+	}
+
+	delete it->second;
+	spotLights.erase(it);
 }
 
 void Engine::Scene::setDirectionalLight(Engine::DirectionalLight * dl)
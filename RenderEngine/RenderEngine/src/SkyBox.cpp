@@ -3,6 +3,7 @@
 #include "datatables/ProgramTable.h"
 #include "datatables/MeshTable.h"
 #include "Scene.h"
+#include "GLStateCache.h"
 
 Engine::SkyBox::SkyBox()
 {
@@ -25,15 +26,15 @@ void Engine::SkyBox::render(Engine::Camera * camera)
 
 	const Engine::Mesh * data = cubeMesh->getMesh();
 
-	glUseProgram(shader->getProgramId());
-	glBindVertexArray(data->vao);
+	Engine::GLStateCache::getInstance().useProgram(shader->getProgramId());
+	Engine::GLStateCache::getInstance().bindVertexArray(data->vao);
 
 	const glm::vec3 pos = camera->getPosition();
 	glm::vec3 cubePos(pos);
 	cubeMesh->setTranslation(cubePos * -1.0f);
 	shader->onRenderObject(cubeMesh, camera->getViewMatrix(), camera->getProjectionMatrix());
 
-	glDrawElements(renderMode, data->getNumFaces() * data->getNumVerticesPerFace(), GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(renderMode, data->getNumFaces() * data->getNumVerticesPerFace(), data->getIndexType(), (void*)0);
 
 	glDepthFunc(GL_LESS);
 }
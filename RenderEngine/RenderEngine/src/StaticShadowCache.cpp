@@ -0,0 +1,221 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "StaticShadowCache.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "GLStateCache.h"
+
+Engine::StaticShadowCache::StaticShadowCache()
+	:texture(0), lightDirection(0.0f), renderedTexels(0), rebuiltLayers(0)
+{
+}
+
+void Engine::StaticShadowCache::allocate(unsigned int numLayers)
+{
+	release();
+
+	glGenTextures(1, &texture);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, RESOLUTION, RESOLUTION, numLayers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	unsigned int previous = Engine::GLStateCache::getInstance().getDrawFramebuffer();
+
+	layers.resize(numLayers);
+	for (unsigned int i = 0; i < numLayers; i++)
+	{
+		CacheLayer & layer = layers[i];
+		layer.valid = false;
+		layer.texelSize = 0.0f;
+		layer.originX = layer.originY = 0;
+		layer.depthCenter = layer.depthExtent = 0.0f;
+		layer.dirty.clear();
+
+		glGenFramebuffers(1, &layer.fbo);
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, layer.fbo);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, i);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "StaticShadowCache: Incomplete framebuffer for layer " << i << std::endl;
+		}
+	}
+
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void Engine::StaticShadowCache::release()
+{
+	for (auto & layer : layers)
+	{
+		Engine::GLStateCache::getInstance().deleteFramebuffer(layer.fbo);
+	}
+	layers.clear();
+
+	if (texture != 0)
+	{
+		Engine::GLStateCache::getInstance().deleteTexture(texture);
+		texture = 0;
+	}
+}
+
+void Engine::StaticShadowCache::beginFrame(const glm::vec3 & lightDirection)
+{
+	renderedTexels = 0;
+	rebuiltLayers = 0;
+
+	if (heightField.update() || lightDirection != this->lightDirection)
+	{
+		this->lightDirection = lightDirection;
+		for (auto & layer : layers)
+		{
+			layer.valid = false;
+		}
+	}
+}
+
+bool Engine::StaticShadowCache::update(unsigned int layerIndex, float texelSize, int eyeX, int eyeY, float eyeDepth, float reach,
+	int cascadeX, int cascadeY, unsigned int cascadeResolution)
+{
+	CacheLayer & layer = layers[layerIndex];
+	layer.dirty.clear();
+
+	const int size = int(RESOLUTION);
+	int originX = eyeX - size / 2;
+	int originY = eyeY - size / 2;
+
+	// The cascades move around the eye as the camera rotates, they only leave the window with narrow
+	// fields of view
+	if (cascadeX < originX || cascadeY < originY
+		|| cascadeX + int(cascadeResolution) > originX + size || cascadeY + int(cascadeResolution) > originY + size)
+	{
+		layer.valid = false;
+		return false;
+	}
+
+	// The depth range is twice the reach, so the eye can move its reach along the light before the
+	// receivers leave it
+	if (!layer.valid || layer.texelSize != texelSize || fabsf(eyeDepth - layer.depthCenter) > layer.depthExtent - reach)
+	{
+		layer.valid = true;
+		layer.texelSize = texelSize;
+		layer.depthCenter = eyeDepth;
+		layer.depthExtent = reach * 2.0f;
+		layer.originX = originX;
+		layer.originY = originY;
+		layer.dirty.push_back({ originX, originY, originX + size, originY + size });
+		rebuiltLayers++;
+		return true;
+	}
+
+	int dx = originX - layer.originX;
+	int dy = originY - layer.originY;
+	if (abs(dx) >= size || abs(dy) >= size)
+	{
+		layer.dirty.push_back({ originX, originY, originX + size, originY + size });
+	}
+	else
+	{
+		// Columns which entered the window
+		if (dx > 0)
+			layer.dirty.push_back({ layer.originX + size, originY, originX + size, originY + size });
+		else if (dx < 0)
+			layer.dirty.push_back({ originX, originY, layer.originX, originY + size });
+
+		// Rows which entered the window, except for the columns above
+		int x0 = std::max(originX, layer.originX);
+		int x1 = std::min(originX, layer.originX) + size;
+		if (dy > 0)
+			layer.dirty.push_back({ x0, layer.originY + size, x1, originY + size });
+		else if (dy < 0)
+			layer.dirty.push_back({ x0, originY, x1, layer.originY });
+	}
+
+	layer.originX = originX;
+	layer.originY = originY;
+	return true;
+}
+
+int Engine::StaticShadowCache::wrap(int x)
+{
+	const int size = int(RESOLUTION);
+	return ((x % size) + size) % size;
+}
+
+void Engine::StaticShadowCache::getPieces(const Engine::ShadowTexelRect & region, std::vector<Engine::ShadowCachePiece> & pieces) const
+{
+	// Regions are never wider than the texture, so they wrap at most once per axis
+	pieces.clear();
+	for (int x = region.x0; x < region.x1; )
+	{
+		int textureX = wrap(x);
+		int xEnd = std::min(region.x1, x + int(RESOLUTION) - textureX);
+		for (int y = region.y0; y < region.y1; )
+		{
+			int textureY = wrap(y);
+			int yEnd = std::min(region.y1, y + int(RESOLUTION) - textureY);
+
+			Engine::ShadowCachePiece piece;
+			piece.global = { x, y, xEnd, yEnd };
+			piece.textureX = textureX;
+			piece.textureY = textureY;
+			pieces.push_back(piece);
+
+			y = yEnd;
+		}
+		x = xEnd;
+	}
+}
+
+void Engine::StaticShadowCache::beginPieceRender(unsigned int layer, const Engine::ShadowCachePiece & piece)
+{
+	int width = piece.global.x1 - piece.global.x0;
+	int height = piece.global.y1 - piece.global.y0;
+
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, layers[layer].fbo);
+	Engine::GLStateCache::getInstance().viewport(piece.textureX, piece.textureY, width, height);
+	// glClear ignores the viewport
+	Engine::GLStateCache::getInstance().enable(GL_SCISSOR_TEST);
+	glScissor(piece.textureX, piece.textureY, width, height);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	renderedTexels += (unsigned int)(width * height);
+}
+
+void Engine::StaticShadowCache::endPieceRender()
+{
+	Engine::GLStateCache::getInstance().disable(GL_SCISSOR_TEST);
+}
+
+void Engine::StaticShadowCache::copyToTexture(unsigned int layer, int x, int y, unsigned int size, unsigned int dstTexture, unsigned int dstLayer) const
+{
+	Engine::ShadowTexelRect region = { x, y, x + int(size), y + int(size) };
+	std::vector<Engine::ShadowCachePiece> pieces;
+	getPieces(region, pieces);
+
+	for (auto & piece : pieces)
+	{
+		glCopyImageSubData(texture, GL_TEXTURE_2D_ARRAY, 0, piece.textureX, piece.textureY, GLint(layer),
+			dstTexture, GL_TEXTURE_2D_ARRAY, 0, piece.global.x0 - x, piece.global.y0 - y, GLint(dstLayer),
+			piece.global.x1 - piece.global.x0, piece.global.y1 - piece.global.y0, 1);
+	}
+}
+
+size_t Engine::StaticShadowCache::getMemoryUsage() const
+{
+	// 24 bits depth, stored as 32 bits
+	return size_t(RESOLUTION) * RESOLUTION * layers.size() * 4;
+}
@@ -10,8 +10,15 @@
 #include "terraincomponents/FlowerComponent.h"
 
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cfloat>
 
 #include "CascadeShadowMaps.h"
+#include "TerrainTileCache.h"
+#include "Frustum.h"
+#include "RenderStatistics.h"
+#include "Profiler.h"
 
 Engine::Terrain::Terrain()
 {
@@ -47,16 +54,32 @@ void Engine::Terrain::registerComponent(Engine::TerrainComponent * comp)
 
 void Engine::Terrain::render(Engine::Camera * camera)
 {
+	visibleTileCount = 0;
+	testedTileCount = 0;
+
+	// Keep the CPU tile data around the camera up to date
+	glm::vec3 cameraPosition = camera->getPosition();
+	int x = -int((floor(cameraPosition.x)) / tileWidth);
+	int y = -int((floor(cameraPosition.z)) / tileWidth);
+	Engine::TerrainTileCache::getInstance().update(x, y, renderRadius);
+
 	for (auto & tc : renderableComponents)
 	{
+		Engine::ProfileScope profile(tc->getName());
 		renderTiledComponent(tc, camera);
 	}
 }
 
 void Engine::Terrain::renderShadow(Camera * cam, const glm::mat4 & projectionMatrix)
 {
+	Engine::ShadowCasterSet casters = Engine::CascadeShadowMaps::getInstance().getCasterSet();
+
 	for (auto & sc : shadowableComponents)
 	{
+		if ((casters == Engine::ShadowCasterSet::SHADOW_CASTERS_STATIC && !sc->hasStaticShadow())
+			|| (casters == Engine::ShadowCasterSet::SHADOW_CASTERS_DYNAMIC && sc->hasStaticShadow()))
+			continue;
+
 		renderTiledComponentShadow(sc, cam, projectionMatrix);
 	}
 }
@@ -70,11 +93,19 @@ void Engine::Terrain::renderTiledComponent(Engine::TerrainComponent * component,
 	int x = -int((floor(cameraPosition.x)) / tileWidth);
 	int y = -int((floor(cameraPosition.z)) / tileWidth);
 
-	unsigned int rr = component->getRenderRadius();
-	int xStart = x - rr;
-	int xEnd = x + rr;
-	int yStart = y - rr;
-	int yEnd = y + rr;
+	int rr = int(component->getRenderRadius());
+
+	Engine::Frustum frustum(cam->getProjectionMatrix() * cam->getViewMatrix());
+	cullTiles(component, frustum, x - rr, x + rr, y - rr, y + rr);
+
+	const std::vector<glm::ivec2> & visibleTiles = culler.getVisibleTiles();
+	testedTileCount += (unsigned int)(4 * rr * rr);
+	visibleTileCount += (unsigned int)visibleTiles.size();
+
+	if (visibleTiles.empty())
+		return;
+
+	auto submitStart = std::chrono::high_resolution_clock::now();
 
 	component->preRenderComponent();
 
@@ -82,40 +113,68 @@ void Engine::Terrain::renderTiledComponent(Engine::TerrainComponent * component,
 	prog->use();
 	prog->applyGlobalUniforms();
 
-	// Culling parameters
-	glm::vec3 fwd = cam->getForwardVector();
-	fwd.y = 0;
-	fwd = -glm::normalize(fwd);
-	int px = -int(renderRadius), py = px;
-
-	for (int i = xStart; i < xEnd; i++, px++)
+	for (auto & tile : visibleTiles)
 	{
-		for (int j = yStart; j < yEnd; j++, py++)
-		{
-			// Culling (skips almost half)
-			glm::vec3 test(i - x, 0, j - y);
-			if (abs(px) > 2 && abs(py) > 2 && glm::dot(glm::normalize(test), fwd) < 0.1f)
-				continue;
-
-			component->renderComponent(i, j, cam);
-		}
+		component->renderComponent(tile.x, tile.y, cam);
 	}
 
 	component->postRenderComponent();
+
+	std::chrono::duration<double, std::milli> submitTime = std::chrono::high_resolution_clock::now() - submitStart;
+	Engine::RenderStatistics::terrainSubmitMs += submitTime.count();
 }
 
 void Engine::Terrain::renderTiledComponentShadow(Engine::TerrainComponent * component, Engine::Camera * cam, const glm::mat4 & proj)
 {
-	glm::vec3 cameraPosition = cam->getPosition();
+	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	const glm::mat4 & culling = csm.getShadowCullingMat();
+
+	// The static shadow cache must not depend on where the camera was when each texel was rendered,
+	// so its passes take every tile under the volume, within the terrain height range
+	bool staticPass = csm.getCasterSet() == Engine::ShadowCasterSet::SHADOW_CASTERS_STATIC;
+	float minHeight = -FLT_MAX;
+	float maxHeight = FLT_MAX;
+	if (staticPass)
+	{
+		Engine::TerrainTileCache & tileCache = Engine::TerrainTileCache::getInstance();
+		minHeight = TerrainHeightField::toWorldHeight(tileCache.getFallbackMinHeight(), tileWidth);
+		maxHeight = TerrainHeightField::toWorldHeight(tileCache.getFallbackMaxHeight(), tileWidth);
+	}
 
-	int x = -int((floor(cameraPosition.x)) / tileWidth);
-	int y = -int((floor(cameraPosition.z)) / tileWidth);
+	// Only the tiles under the volume, which reaches the casters outside of the view frustum towards
+	// the light. The frustum test below handles the tile heights
+	int xStart, xEnd, yStart, yEnd;
+	if (!getVolumeTiles(culling, minHeight, maxHeight, xStart, xEnd, yStart, yEnd))
+		return;
+
+	if (!staticPass)
+	{
+		glm::vec3 cameraPosition = cam->getPosition();
 
-	unsigned int rr = component->getRenderRadius();
-	int xStart = x - rr;
-	int xEnd = x + rr;
-	int yStart = y - rr;
-	int yEnd = y + rr;
+		int x = -int((floor(cameraPosition.x)) / tileWidth);
+		int y = -int((floor(cameraPosition.z)) / tileWidth);
+
+		int rr = int(component->getRenderRadius());
+		xStart = std::max(xStart, x - rr);
+		xEnd = std::min(xEnd, x + rr);
+		yStart = std::max(yStart, y - rr);
+		yEnd = std::min(yEnd, y + rr);
+	}
+
+	if (xStart >= xEnd || yStart >= yEnd)
+		return;
+
+	Engine::Frustum frustum(culling);
+	cullTiles(component, frustum, xStart, xEnd, yStart, yEnd, staticPass);
+	const std::vector<glm::ivec2> & visibleTiles = culler.getVisibleTiles();
+
+	if (!staticPass)
+		Engine::RenderStatistics::shadowCasterTiles[csm.getCurrentLevel()] += (unsigned int)visibleTiles.size();
+
+	if (visibleTiles.empty())
+		return;
+
+	auto submitStart = std::chrono::high_resolution_clock::now();
 
 	component->preRenderComponent();
 
@@ -123,32 +182,118 @@ void Engine::Terrain::renderTiledComponentShadow(Engine::TerrainComponent * comp
 	prog->use();
 	prog->applyGlobalUniforms();
 
-	// Culling parameters
-	glm::vec3 fwd = cam->getForwardVector();
-	fwd.y = 0;
-	fwd = -glm::normalize(fwd);
-	int px = -int(renderRadius), py = px;
+	for (auto & tile : visibleTiles)
+	{
+		component->renderShadow(proj, tile.x, tile.y, cam);
+	}
+
+	component->postRenderComponent();
+
+	std::chrono::duration<double, std::milli> submitTime = std::chrono::high_resolution_clock::now() - submitStart;
+	Engine::RenderStatistics::terrainSubmitMs += submitTime.count();
+}
 
-	for (int i = xStart; i < xEnd; i++, px++)
+bool Engine::Terrain::getVolumeTiles(const glm::mat4 & volume, float minHeight, float maxHeight, int & xStart, int & xEnd, int & yStart, int & yEnd)
+{
+	glm::mat4 invVolume = glm::inverse(volume);
+	glm::vec3 corners[8];
+	for (unsigned int k = 0; k < 8; k++)
 	{
-		for (int j = yStart; j < yEnd; j++, py++)
+		glm::vec4 corner = invVolume * glm::vec4(k & 1 ? 1.0f : -1.0f, k & 2 ? 1.0f : -1.0f, k & 4 ? 1.0f : -1.0f, 1.0f);
+		corners[k] = glm::vec3(corner) / corner.w;
+	}
+
+	// Ground bounds of the box edges clipped to the height range, which contain every vertex of the
+	// part of the box within the range
+	glm::vec2 volumeMin(FLT_MAX), volumeMax(-FLT_MAX);
+	bool empty = true;
+	for (unsigned int a = 0; a < 8; a++)
+	{
+		for (unsigned int axis = 1; axis < 8; axis <<= 1)
 		{
-			// Culling (skips almost half)
-			glm::vec3 test(i - x, 0, j - y);
-			if (abs(px) > 2 && abs(py) > 2 && glm::dot(glm::normalize(test), fwd) < 0.1f)
+			if (a & axis)
+				continue;
+
+			const glm::vec3 & p = corners[a];
+			glm::vec3 edge = corners[a | axis] - p;
+			float t0 = 0.0f;
+			float t1 = 1.0f;
+			if (fabsf(edge.y) > 1.0e-6f)
+			{
+				float ta = (minHeight - p.y) / edge.y;
+				float tb = (maxHeight - p.y) / edge.y;
+				t0 = std::max(t0, std::min(ta, tb));
+				t1 = std::min(t1, std::max(ta, tb));
+			}
+			else if (p.y < minHeight || p.y > maxHeight)
+			{
 				continue;
+			}
 
-			component->renderShadow(proj, i, j, cam);
+			if (t0 > t1)
+				continue;
+
+			glm::vec3 e0 = p + edge * t0;
+			glm::vec3 e1 = p + edge * t1;
+			volumeMin = glm::min(volumeMin, glm::min(glm::vec2(e0.x, e0.z), glm::vec2(e1.x, e1.z)));
+			volumeMax = glm::max(volumeMax, glm::max(glm::vec2(e0.x, e0.z), glm::vec2(e1.x, e1.z)));
+			empty = false;
 		}
 	}
 
-	component->postRenderComponent();
+	if (empty)
+		return false;
+
+	xStart = int(floor(volumeMin.x / tileWidth));
+	xEnd = int(floor(volumeMax.x / tileWidth)) + 1;
+	yStart = int(floor(volumeMin.y / tileWidth));
+	yEnd = int(floor(volumeMax.y / tileWidth)) + 1;
+	return true;
+}
+
+void Engine::Terrain::cullTiles(Engine::TerrainComponent * component, const Engine::Frustum & frustum, int xStart, int xEnd, int yStart, int yEnd, bool terrainHeightBounds)
+{
+	culler.begin(size_t(xEnd - xStart) * size_t(yEnd - yStart));
+
+	float minHeight = 0.0f;
+	float maxHeight = 0.0f;
+	if (terrainHeightBounds)
+	{
+		Engine::TerrainTileCache & tileCache = Engine::TerrainTileCache::getInstance();
+		minHeight = TerrainHeightField::toWorldHeight(tileCache.getFallbackMinHeight(), tileWidth);
+		maxHeight = TerrainHeightField::toWorldHeight(tileCache.getFallbackMaxHeight(), tileWidth);
+	}
+
+	// Gather the bounds of the tiles with something to render
+	glm::vec3 min, max;
+	for (int i = xStart; i < xEnd; i++)
+	{
+		for (int j = yStart; j < yEnd; j++)
+		{
+			if (terrainHeightBounds)
+			{
+				min = glm::vec3(float(i) * tileWidth, minHeight, float(j) * tileWidth);
+				max = glm::vec3(float(i + 1) * tileWidth, maxHeight, float(j + 1) * tileWidth);
+			}
+			else if (!component->getTileBounds(i, j, min, max))
+			{
+				continue;
+			}
+
+			culler.addTile(i, j, min, max);
+		}
+	}
+
+	culler.cull(frustum);
 }
 
 // ====================================================================================================================
 
 void Engine::Terrain::initialize()
 {
+	visibleTileCount = 0;
+	testedTileCount = 0;
+
 	Engine::RenderableNotifier::getInstance().registerRenderable(this);
 	Engine::CascadeShadowMaps::getInstance().registerShadowCaster(this);
 
@@ -0,0 +1,385 @@
+#include "TerrainHeightField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TERRAIN_HEIGHTFIELD_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "WorldConfig.h"
+
+const float Engine::TerrainHeightField::HEIGHT_SCALE = 1.5f;
+const float Engine::TerrainHeightField::VALIDATION_TOLERANCE = 1e-5f;
+
+// ============================================================================
+// Scalar implementation. Mirrors the GLSL code operation by operation so the
+// SIMD path below can reproduce it exactly
+
+namespace
+{
+	inline float fract(float x)
+	{
+		return x - std::floor(x);
+	}
+
+	// Integer hash of the lattice point (x, y), same as Random2D() on the terrain shaders
+	inline float random2D(float x, float y)
+	{
+		unsigned int h = (unsigned int)(int)x * 1597334677u ^ (unsigned int)(int)y * 3812015801u;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return float(h >> 8) * (1.0f / 16777216.0f);
+	}
+
+	inline float smoothStep01(float t)
+	{
+		t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+		return t * t * (3.0f - 2.0f * t);
+	}
+
+	inline float noiseInterpolation(float x, float y, float size)
+	{
+		float gx = x * size;
+		float gy = y * size;
+
+		float rx = std::floor(gx);
+		float ry = std::floor(gy);
+		float wx = gx - rx;
+		float wy = gy - ry;
+
+		float p0 = random2D(rx, ry);
+		float p1 = random2D(rx + 1.0f, ry);
+		float p2 = random2D(rx, ry + 1.0f);
+		float p3 = random2D(rx + 1.0f, ry + 1.0f);
+
+		wx = smoothStep01(wx);
+		wy = smoothStep01(wy);
+
+		return p0 +
+			(p1 - p0) * wx +
+			(p2 - p0) * wy * (1.0f - wx) +
+			(p3 - p1) * (wy * wx);
+	}
+
+#ifdef TERRAIN_HEIGHTFIELD_SSE2
+	// SSE2 has no floor instruction. Valid while |x| < 2^31, far beyond any reachable terrain uv
+	inline __m128 floor4(__m128 x)
+	{
+		__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+		return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+	}
+
+	// SSE2 has no 32 bit low multiply
+	inline __m128i mullo4(__m128i a, __m128i b)
+	{
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	inline __m128 random2D4(__m128 x, __m128 y)
+	{
+		__m128i hx = mullo4(_mm_cvttps_epi32(x), _mm_set1_epi32(int(1597334677u)));
+		__m128i hy = mullo4(_mm_cvttps_epi32(y), _mm_set1_epi32(int(3812015801u)));
+		__m128i h = _mm_xor_si128(hx, hy);
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+		h = mullo4(h, _mm_set1_epi32(int(0x7feb352du)));
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+		h = mullo4(h, _mm_set1_epi32(int(0x846ca68bu)));
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+		return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+	}
+
+	inline __m128 smoothStep014(__m128 t)
+	{
+		t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		return _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), t)));
+	}
+
+	inline __m128 noiseInterpolation4(__m128 x, __m128 y, __m128 size)
+	{
+		__m128 gx = _mm_mul_ps(x, size);
+		__m128 gy = _mm_mul_ps(y, size);
+
+		__m128 rx = floor4(gx);
+		__m128 ry = floor4(gy);
+		__m128 wx = _mm_sub_ps(gx, rx);
+		__m128 wy = _mm_sub_ps(gy, ry);
+
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 rx1 = _mm_add_ps(rx, one);
+		__m128 ry1 = _mm_add_ps(ry, one);
+
+		__m128 p0 = random2D4(rx, ry);
+		__m128 p1 = random2D4(rx1, ry);
+		__m128 p2 = random2D4(rx, ry1);
+		__m128 p3 = random2D4(rx1, ry1);
+
+		wx = smoothStep014(wx);
+		wy = smoothStep014(wy);
+
+		__m128 r = _mm_add_ps(p0, _mm_mul_ps(_mm_sub_ps(p1, p0), wx));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(p2, p0), wy), _mm_sub_ps(one, wx)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_sub_ps(p3, p1), _mm_mul_ps(wy, wx)));
+		return r;
+	}
+#endif
+
+	// ============================================================================
+	// Literal port of the terrain shaders (terrain.teseval), used to validate the paths above
+
+	float shaderRandom2D(const glm::vec2 & st)
+	{
+		glm::uvec2 q = glm::uvec2(glm::ivec2(st));
+		unsigned int h = q.x * 1597334677u ^ q.y * 3812015801u;
+		h ^= h >> 16u;
+		h *= 0x7feb352du;
+		h ^= h >> 15u;
+		h *= 0x846ca68bu;
+		h ^= h >> 16u;
+		return float(h >> 8u) * (1.0f / 16777216.0f);
+	}
+
+	float shaderNoiseInterpolation(const glm::vec2 & coord, float size)
+	{
+		glm::vec2 grid = coord * size;
+
+		glm::vec2 randomInput = glm::floor(grid);
+		glm::vec2 weights = glm::fract(grid);
+
+		float p0 = shaderRandom2D(randomInput);
+		float p1 = shaderRandom2D(randomInput + glm::vec2(1.0f, 0.0f));
+		float p2 = shaderRandom2D(randomInput + glm::vec2(0.0f, 1.0f));
+		float p3 = shaderRandom2D(randomInput + glm::vec2(1.0f, 1.0f));
+
+		weights = glm::smoothstep(glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 1.0f), weights);
+
+		return p0 +
+			(p1 - p0) * (weights.x) +
+			(p2 - p0) * (weights.y) * (1.0f - weights.x) +
+			(p3 - p1) * (weights.y * weights.x);
+	}
+
+	float shaderNoiseHeight(const glm::vec2 & pos, float amplitude, float frecuency, float scale, unsigned int octaves)
+	{
+		float noiseValue = 0.0f;
+
+		float localAplitude = amplitude;
+		float localFrecuency = frecuency;
+
+		for (int index = 0; index < int(octaves); index++)
+		{
+			noiseValue += shaderNoiseInterpolation(pos, scale * localFrecuency) * localAplitude;
+
+			localAplitude /= 2.0f;
+			localFrecuency *= 2.0f;
+		}
+
+		return noiseValue * noiseValue * noiseValue;
+	}
+}
+
+// ============================================================================
+
+Engine::TerrainHeightField::TerrainHeightField()
+	:amplitude(Engine::Settings::terrainAmplitude)
+	,frecuency(Engine::Settings::terrainFrecuency)
+	,scale(Engine::Settings::terrainScale)
+	,octaves(Engine::Settings::terrainOctaves)
+{
+}
+
+Engine::TerrainHeightField::TerrainHeightField(float amplitude, float frecuency, float scale, unsigned int octaves)
+	:amplitude(amplitude)
+	,frecuency(frecuency)
+	,scale(scale)
+	,octaves(octaves)
+{
+}
+
+bool Engine::TerrainHeightField::update()
+{
+	bool changed = amplitude != Engine::Settings::terrainAmplitude
+		|| frecuency != Engine::Settings::terrainFrecuency
+		|| scale != Engine::Settings::terrainScale
+		|| octaves != Engine::Settings::terrainOctaves;
+
+	amplitude = Engine::Settings::terrainAmplitude;
+	frecuency = Engine::Settings::terrainFrecuency;
+	scale = Engine::Settings::terrainScale;
+	octaves = Engine::Settings::terrainOctaves;
+
+	return changed;
+}
+
+float Engine::TerrainHeightField::noiseHeight(const glm::vec2 & uv) const
+{
+	float noiseValue = 0.0f;
+
+	float localAmplitude = amplitude;
+	float localFrecuency = frecuency;
+
+	for (unsigned int index = 0; index < octaves; index++)
+	{
+		noiseValue += noiseInterpolation(uv.x, uv.y, scale * localFrecuency) * localAmplitude;
+
+		localAmplitude /= 2.0f;
+		localFrecuency *= 2.0f;
+	}
+
+	return noiseValue * noiseValue * noiseValue;
+}
+
+void Engine::TerrainHeightField::noiseHeightBatch(const float * u, const float * v, float * result, size_t count) const
+{
+	size_t i = 0;
+
+#ifdef TERRAIN_HEIGHTFIELD_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(u + i);
+		__m128 y = _mm_loadu_ps(v + i);
+		__m128 noiseValue = _mm_setzero_ps();
+
+		float localAmplitude = amplitude;
+		float localFrecuency = frecuency;
+
+		for (unsigned int index = 0; index < octaves; index++)
+		{
+			__m128 n = noiseInterpolation4(x, y, _mm_set1_ps(scale * localFrecuency));
+			noiseValue = _mm_add_ps(noiseValue, _mm_mul_ps(n, _mm_set1_ps(localAmplitude)));
+
+			localAmplitude /= 2.0f;
+			localFrecuency *= 2.0f;
+		}
+
+		_mm_storeu_ps(result + i, _mm_mul_ps(_mm_mul_ps(noiseValue, noiseValue), noiseValue));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		result[i] = noiseHeight(glm::vec2(u[i], v[i]));
+	}
+}
+
+float Engine::TerrainHeightField::getMaxNoiseHeight() const
+{
+	// Each octave interpolates values within [0, 1]
+	float noiseValue = 0.0f;
+	float localAmplitude = amplitude;
+	for (unsigned int index = 0; index < octaves; index++)
+	{
+		noiseValue += localAmplitude;
+		localAmplitude /= 2.0f;
+	}
+
+	return noiseValue * noiseValue * noiseValue;
+}
+
+float Engine::TerrainHeightField::getSampleErrorBound(float uvSpacing) const
+{
+	// The smoothstep derivative peaks at 1.5 and the bilinear blend of [0, 1] values has a
+	// slope of at most 1 per axis, so an octave varies at most 1.5 * size * (|dx| + |dy|),
+	// and never more than its full range
+	float error = 0.0f;
+	float localAmplitude = amplitude;
+	float localFrecuency = frecuency;
+	for (unsigned int index = 0; index < octaves; index++)
+	{
+		float variation = 1.5f * scale * localFrecuency * uvSpacing;
+		error += (variation < 1.0f ? variation : 1.0f) * localAmplitude;
+
+		localAmplitude /= 2.0f;
+		localFrecuency *= 2.0f;
+	}
+
+	return error;
+}
+
+float Engine::TerrainHeightField::getTileHeight(int i, int j, float u, float v) const
+{
+	glm::vec2 uv = glm::abs(glm::vec2(u, v) + glm::vec2(float(i), float(j)));
+	return noiseHeight(uv);
+}
+
+float Engine::TerrainHeightField::getWorldHeight(float x, float z, float tileScale) const
+{
+	glm::vec2 uv = glm::abs(glm::vec2(x, z) / tileScale);
+	return toWorldHeight(noiseHeight(uv), tileScale);
+}
+
+Engine::TerrainHeightValidation Engine::TerrainHeightField::validate(unsigned int samples) const
+{
+	Engine::TerrainHeightValidation result;
+	result.samples = 0;
+	result.failures = 0;
+	result.batchMismatches = 0;
+	result.maxError = 0.0f;
+
+	std::vector<float> u, v, batch(samples);
+	getValidationSamples(samples, u, v);
+
+	// Odd sample counts also run the scalar tail of the batch path
+	noiseHeightBatch(u.data(), v.data(), batch.data(), samples);
+
+	const float tolerance = getValidationTolerance();
+	for (unsigned int s = 0; s < samples; s++)
+	{
+		glm::vec2 uv(u[s], v[s]);
+		float scalar = noiseHeight(uv);
+		float expected = shaderNoiseHeight(uv, amplitude, frecuency, scale, octaves);
+
+		float error = std::fabs(scalar - expected);
+		result.maxError = std::max(result.maxError, error);
+		result.failures += error > tolerance ? 1 : 0;
+		result.batchMismatches += batch[s] != scalar ? 1 : 0;
+		result.samples++;
+	}
+
+	std::cout << "TerrainHeightField: " << result.samples - result.failures << "/" << result.samples
+		<< " heights within tolerance of the shader formula (max error " << result.maxError << "), "
+		<< result.batchMismatches << " batch mismatches" << std::endl;
+
+	return result;
+}
+
+void Engine::TerrainHeightField::getValidationSamples(unsigned int samples, std::vector<float> & u, std::vector<float> & v) const
+{
+	u.resize(samples);
+	v.resize(samples);
+
+	// The first quarter of the samples lie on lattice points (and their neighbours) of the first octave,
+	// the rest are spread with a LCG over the first 4096 tiles in each direction
+	const float latticeStep = 1.0f / (scale * frecuency);
+	unsigned long long state = 0x9e3779b97f4a7c15ULL;
+	for (unsigned int s = 0; s < samples; s++)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		float x = float((state >> 40) & 0xffffff) * (4096.0f / 16777216.0f);
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		float y = float((state >> 40) & 0xffffff) * (4096.0f / 16777216.0f);
+
+		if (s < samples / 4)
+		{
+			const float nudge[3] = { -1e-3f, 0.0f, 1e-3f };
+			x = std::max(std::floor(x / latticeStep) * latticeStep + nudge[s % 3] * latticeStep, 0.0f);
+			y = std::max(std::floor(y / latticeStep) * latticeStep + nudge[(s / 3) % 3] * latticeStep, 0.0f);
+		}
+
+		u[s] = x;
+		v[s] = y;
+	}
+}
+
+float Engine::TerrainHeightField::getValidationTolerance() const
+{
+	return VALIDATION_TOLERANCE * std::max(getMaxNoiseHeight(), 1.0f);
+}
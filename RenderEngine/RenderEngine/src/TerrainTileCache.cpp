@@ -0,0 +1,330 @@
+#include "TerrainTileCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "WorldConfig.h"
+
+Engine::TerrainTileCache * Engine::TerrainTileCache::INSTANCE = new Engine::TerrainTileCache();
+
+Engine::TerrainTileCache & Engine::TerrainTileCache::getInstance()
+{
+	return *INSTANCE;
+}
+
+Engine::TerrainTileCache::TerrainTileCache()
+	:pendingTiles(0)
+	,capacity(0)
+	,generation(0)
+	,vegetationMinHeight(Engine::Settings::waterHeight)
+	,vegetationMaxHeight(Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight)
+	,vegetationPatterns(std::make_shared<std::vector<Engine::VegetationPattern>>())
+{
+	resetStats();
+}
+
+unsigned int Engine::TerrainTileCache::registerVegetationPattern(const std::vector<glm::vec2> & pattern)
+{
+	Engine::VegetationPattern vegetation;
+	vegetation.positions = pattern;
+	vegetation.scatterCount = 0;
+	return addVegetationPattern(vegetation);
+}
+
+unsigned int Engine::TerrainTileCache::registerScatteredVegetation(unsigned int count)
+{
+	Engine::VegetationPattern vegetation;
+	vegetation.scatterCount = count;
+	return addVegetationPattern(vegetation);
+}
+
+void Engine::TerrainTileCache::scatterVegetation(int i, int j, unsigned int count, std::vector<glm::vec2> & positions)
+{
+	// We have to travel way to much to make this seed system not to work...
+	unsigned int seed = (j << 16) | i;
+
+	std::uniform_real_distribution<float> dTerrain(0.0f, 1.0f);
+	std::default_random_engine eTerrain(seed);
+
+	positions.resize(count);
+	for (unsigned int k = 0; k < count; k++)
+	{
+		positions[k].x = dTerrain(eTerrain);
+		positions[k].y = dTerrain(eTerrain);
+	}
+}
+
+void Engine::TerrainTileCache::update(int centerI, int centerJ, unsigned int radius)
+{
+	float vegetationMin = Engine::Settings::waterHeight;
+	float vegetationMax = Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight;
+	if (heightField.update() || vegetationMin != vegetationMinHeight || vegetationMax != vegetationMaxHeight)
+	{
+		vegetationMinHeight = vegetationMin;
+		vegetationMaxHeight = vegetationMax;
+		invalidate();
+	}
+
+	int requestRadius = int(radius + PREFETCH_MARGIN);
+	size_t side = size_t(requestRadius) * 2 + 1;
+
+	std::unique_lock<std::mutex> guard(lock);
+
+	// Room for the visible area plus the same amount of recently left tiles
+	capacity = side * side * 2;
+
+	// Request ring by ring, so the closest tiles are built first
+	for (int ring = 0; ring <= requestRadius && pendingTiles < MAX_PENDING_TILES; ring++)
+	{
+		for (int i = centerI - ring; i <= centerI + ring && pendingTiles < MAX_PENDING_TILES; i++)
+		{
+			int step = (i == centerI - ring || i == centerI + ring) ? 1 : ring * 2;
+			for (int j = centerJ - ring; j <= centerJ + ring && pendingTiles < MAX_PENDING_TILES; j += step)
+			{
+				if (entries.find(makeKey(i, j)) == entries.end())
+				{
+					requestTile(i, j);
+				}
+			}
+		}
+	}
+
+	evict();
+}
+
+std::shared_ptr<const Engine::TerrainTile> Engine::TerrainTileCache::getTile(int i, int j)
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	auto it = entries.find(makeKey(i, j));
+	if (it != entries.end() && it->second.tile)
+	{
+		stats.hits++;
+		lru.splice(lru.begin(), lru, it->second.lruPosition);
+		return it->second.tile;
+	}
+
+	stats.misses++;
+	return std::shared_ptr<const TerrainTile>();
+}
+
+bool Engine::TerrainTileCache::getTileBounds(int i, int j, float & minHeight, float & maxHeight)
+{
+	std::shared_ptr<const TerrainTile> tile = getTile(i, j);
+	if (tile)
+	{
+		minHeight = tile->minHeight;
+		maxHeight = tile->maxHeight;
+		return true;
+	}
+
+	minHeight = getFallbackMinHeight();
+	maxHeight = getFallbackMaxHeight();
+	return false;
+}
+
+float Engine::TerrainTileCache::getFallbackMaxHeight()
+{
+	return heightField.getMaxNoiseHeight();
+}
+
+Engine::TerrainTileCacheStats Engine::TerrainTileCache::getStats()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	TerrainTileCacheStats result = stats;
+	result.residentTiles = lru.size();
+	result.pendingTiles = pendingTiles;
+	return result;
+}
+
+void Engine::TerrainTileCache::resetStats()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	stats.hits = 0;
+	stats.misses = 0;
+	stats.evictions = 0;
+	stats.generated = 0;
+	stats.lastLatencyMs = 0.0;
+	stats.avgLatencyMs = 0.0;
+	stats.maxLatencyMs = 0.0;
+	stats.residentTiles = 0;
+	stats.pendingTiles = 0;
+}
+
+void Engine::TerrainTileCache::invalidate()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	generation++;
+	entries.clear();
+	lru.clear();
+	pendingTiles = 0;
+}
+
+// ====================================================================================================================
+
+unsigned long long Engine::TerrainTileCache::makeKey(int i, int j)
+{
+	return (((unsigned long long)(unsigned int)i) << 32) | (unsigned long long)(unsigned int)j;
+}
+
+void Engine::TerrainTileCache::requestTile(int i, int j)
+{
+	CacheEntry & entry = entries[makeKey(i, j)];
+	entry.lruPosition = lru.end();
+	entry.requestTime = std::chrono::steady_clock::now();
+	pendingTiles++;
+
+	std::unique_ptr<Engine::Concurrent::Runnable> task(new Engine::TerrainTileTask(i, j, generation, heightField,
+		vegetationMinHeight, vegetationMaxHeight, vegetationPatterns));
+	Engine::Concurrent::ThreadPool::getInstance().addTask(std::move(task));
+}
+
+void Engine::TerrainTileCache::onTileBuilt(unsigned int tileGeneration, std::shared_ptr<const Engine::TerrainTile> tile)
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	// Built with outdated settings
+	if (tileGeneration != generation)
+		return;
+
+	auto it = entries.find(makeKey(tile->i, tile->j));
+	if (it == entries.end() || it->second.tile)
+		return;
+
+	it->second.tile = tile;
+	lru.push_front(it->first);
+	it->second.lruPosition = lru.begin();
+	pendingTiles--;
+
+	double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - it->second.requestTime).count();
+	stats.generated++;
+	stats.lastLatencyMs = latency;
+	stats.avgLatencyMs += (latency - stats.avgLatencyMs) / double(stats.generated);
+	stats.maxLatencyMs = std::max(stats.maxLatencyMs, latency);
+}
+
+unsigned int Engine::TerrainTileCache::addVegetationPattern(const Engine::VegetationPattern & pattern)
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	// Patterns are shared with running tasks, so they are never modified in place
+	std::shared_ptr<std::vector<Engine::VegetationPattern>> patterns =
+		std::make_shared<std::vector<Engine::VegetationPattern>>(*vegetationPatterns);
+	patterns->push_back(pattern);
+	vegetationPatterns = patterns;
+	unsigned int patternId = (unsigned int)(patterns->size() - 1);
+
+	guard.unlock();
+
+	// Tiles built so far lack the new pattern
+	invalidate();
+
+	return patternId;
+}
+
+void Engine::TerrainTileCache::evict()
+{
+	while (lru.size() > capacity)
+	{
+		entries.erase(lru.back());
+		lru.pop_back();
+		stats.evictions++;
+	}
+}
+
+std::shared_ptr<Engine::TerrainTile> Engine::TerrainTileCache::buildTile(int i, int j, const Engine::TerrainHeightField & field,
+	const std::vector<Engine::VegetationPattern> & patterns, float vegetationMin, float vegetationMax)
+{
+	const unsigned int gridSize = Engine::TerrainTile::GRID_SIZE;
+	const float spacing = 1.0f / float(gridSize - 1);
+
+	std::shared_ptr<Engine::TerrainTile> tile = std::make_shared<Engine::TerrainTile>();
+	tile->i = i;
+	tile->j = j;
+
+	// Same uv terrain.vert builds: abs(inUV + gridPos)
+	float u[gridSize * gridSize];
+	float v[gridSize * gridSize];
+	for (unsigned int y = 0; y < gridSize; y++)
+	{
+		for (unsigned int x = 0; x < gridSize; x++)
+		{
+			u[y * gridSize + x] = std::abs(float(x) * spacing + float(i));
+			v[y * gridSize + x] = std::abs(float(y) * spacing + float(j));
+		}
+	}
+
+	field.noiseHeightBatch(u, v, tile->heights, gridSize * gridSize);
+
+	float minValue = tile->heights[0];
+	float maxValue = tile->heights[0];
+	for (unsigned int k = 1; k < gridSize * gridSize; k++)
+	{
+		minValue = std::min(minValue, tile->heights[k]);
+		maxValue = std::max(maxValue, tile->heights[k]);
+	}
+
+	// Heights are the cube of a non negative noise value. Widen the noise range by the max
+	// variation between samples (plus some slack for the GPU rounding), then cube it back
+	float error = field.getSampleErrorBound(spacing) + 1e-4f;
+	float minNoise = std::max(std::cbrt(minValue) - error, 0.0f);
+	float maxNoise = std::cbrt(maxValue) + error;
+	tile->minHeight = minNoise * minNoise * minNoise;
+	tile->maxHeight = std::min(maxNoise * maxNoise * maxNoise, field.getMaxNoiseHeight());
+
+	// Vegetation placements
+	tile->vegetation.resize(patterns.size());
+	std::vector<glm::vec2> scattered;
+	for (size_t p = 0; p < patterns.size(); p++)
+	{
+		const std::vector<glm::vec2> * positions = &patterns[p].positions;
+		if (patterns[p].scatterCount > 0)
+		{
+			scatterVegetation(i, j, patterns[p].scatterCount, scattered);
+			positions = &scattered;
+		}
+
+		const std::vector<glm::vec2> & pattern = *positions;
+		std::vector<VegetationPlacement> & placements = tile->vegetation[p];
+		placements.reserve(pattern.size());
+
+		for (size_t k = 0; k < pattern.size(); k++)
+		{
+			// Keep the ones on the band edges too, the GPU may round them the other way
+			float height = field.getTileHeight(i, j, pattern[k].x, pattern[k].y);
+			if (height > vegetationMin - 1e-4f && height < vegetationMax + 1e-4f)
+			{
+				VegetationPlacement placement;
+				placement.index = (unsigned int)k;
+				placement.uv = pattern[k];
+				placement.height = height;
+				placements.push_back(placement);
+			}
+		}
+	}
+
+	return tile;
+}
+
+// ====================================================================================================================
+
+Engine::TerrainTileTask::TerrainTileTask(int i, int j, unsigned int generation, const Engine::TerrainHeightField & heightField,
+	float vegetationMinHeight, float vegetationMaxHeight,
+	std::shared_ptr<const std::vector<Engine::VegetationPattern>> vegetationPatterns)
+	:i(i)
+	,j(j)
+	,generation(generation)
+	,heightField(heightField)
+	,vegetationMinHeight(vegetationMinHeight)
+	,vegetationMaxHeight(vegetationMaxHeight)
+	,vegetationPatterns(vegetationPatterns)
+{
+}
+
+void Engine::TerrainTileTask::run()
+{
+	std::shared_ptr<const Engine::TerrainTile> tile = Engine::TerrainTileCache::buildTile(i, j, heightField,
+		*vegetationPatterns, vegetationMinHeight, vegetationMaxHeight);
+	Engine::TerrainTileCache::getInstance().onTileBuilt(generation, tile);
+}
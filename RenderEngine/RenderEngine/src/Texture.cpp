@@ -53,4 +53,41 @@ const GLenum Engine::AbstractTexture::getPixelFormat() const
 void Engine::AbstractTexture::generateTexture()
 {
 	glGenTextures(1, &textureId);
+}
+
+unsigned int Engine::AbstractTexture::getTexelSize(int internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+	case GL_R16F:
+		return 2;
+	case GL_RGB:
+	case GL_RGB8:
+		return 3;
+	case GL_RGBA:
+	case GL_RGBA8:
+	case GL_RG16:
+	case GL_RG16F:
+	case GL_R32F:
+	case GL_R11F_G11F_B10F:
+	case GL_RGB10_A2:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+		return 4;
+	case GL_RGB16F:
+		return 6;
+	case GL_RGBA16F:
+	case GL_RG32F:
+		return 8;
+	case GL_RGB32F:
+		return 12;
+	case GL_RGBA32F:
+		return 16;
+	default:
+		return 4;
+	}
 }
\ No newline at end of file
@@ -53,20 +53,29 @@ void Engine::Concurrent::ThreadPool::addTask(std::unique_ptr<Engine::Concurrent:
 	monitor.notify_one();
 }
 
+void Engine::Concurrent::ThreadPool::addPriorityTask(std::unique_ptr<Engine::Concurrent::Runnable> task)
+{
+	std::unique_lock<std::mutex> lock(globalLock);
+	priorityTasks.push(std::move(task));
+	lock.unlock();
+	monitor.notify_one();
+}
+
 void Engine::Concurrent::ThreadPool::pollTask()
 {
 	while (active)
 	{
 		std::unique_lock<std::mutex> lock(globalLock);
-		while (tasks.empty() && active)
+		while (tasks.empty() && priorityTasks.empty() && active)
 		{
 			monitor.wait(lock);
 		}
 
-		if (!tasks.empty())
+		std::queue<std::unique_ptr<Runnable>> & queue = priorityTasks.empty() ? tasks : priorityTasks;
+		if (!queue.empty())
 		{
-			std::unique_ptr<Runnable> task = std::move(tasks.front());
-			tasks.pop();
+			std::unique_ptr<Runnable> task = std::move(queue.front());
+			queue.pop();
 			lock.unlock();
 
 			task->run();
@@ -76,4 +85,35 @@ void Engine::Concurrent::ThreadPool::pollTask()
 			lock.unlock();
 		}
 	}
+}
+
+// ====================================================================================================================
+
+Engine::Concurrent::CountDownLatch::CountDownLatch(size_t count)
+	:count(count)
+{
+}
+
+void Engine::Concurrent::CountDownLatch::add(size_t n)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	count += n;
+}
+
+void Engine::Concurrent::CountDownLatch::countDown()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	if (count > 0 && --count == 0)
+	{
+		monitor.notify_all();
+	}
+}
+
+void Engine::Concurrent::CountDownLatch::wait()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (count > 0)
+	{
+		monitor.wait(guard);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "TileCuller.h"
+
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "TerrainHeightField.h"
+#include "TerrainTileCache.h"
+#include "WorldConfig.h"
+
+namespace
+{
+	// Clip space test used as reference. True if the point is inside by more than the margin
+	bool clipPointInside(const glm::vec4 & clip, float margin)
+	{
+		float w = clip.w - margin * std::fabs(clip.w);
+		return clip.x > -w && clip.x < w && clip.y > -w && clip.y < w && clip.z > -w && clip.z < w;
+	}
+
+	// True if every corner of the box lies outside the same clip plane (by more than the margin)
+	bool boxOutsideClipPlane(const glm::mat4 & viewProjection, const glm::vec3 & min, const glm::vec3 & max, float margin)
+	{
+		glm::vec4 clip[8];
+		for (unsigned int k = 0; k < 8; k++)
+		{
+			glm::vec3 corner(k & 1 ? max.x : min.x, k & 2 ? max.y : min.y, k & 4 ? max.z : min.z);
+			clip[k] = viewProjection * glm::vec4(corner, 1.0f);
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int side = -1; side <= 1; side += 2)
+			{
+				bool allOutside = true;
+				for (unsigned int k = 0; k < 8 && allOutside; k++)
+				{
+					float w = clip[k].w + margin * std::fabs(clip[k].w);
+					allOutside = float(side) * clip[k][axis] > w;
+				}
+
+				if (allOutside)
+					return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+Engine::TileCuller::TileCuller()
+	:numTiles(0)
+{
+}
+
+void Engine::TileCuller::begin(size_t maxTiles)
+{
+	tileCoords.resize(maxTiles);
+	for (unsigned int k = 0; k < 6; k++)
+	{
+		tileBounds[k].resize(maxTiles);
+	}
+	tileVisibility.resize(maxTiles);
+	numTiles = 0;
+}
+
+void Engine::TileCuller::addTile(int i, int j, const glm::vec3 & min, const glm::vec3 & max)
+{
+	tileCoords[numTiles] = glm::ivec2(i, j);
+	tileBounds[0][numTiles] = min.x;
+	tileBounds[1][numTiles] = min.y;
+	tileBounds[2][numTiles] = min.z;
+	tileBounds[3][numTiles] = max.x;
+	tileBounds[4][numTiles] = max.y;
+	tileBounds[5][numTiles] = max.z;
+	numTiles++;
+}
+
+void Engine::TileCuller::cull(const Engine::Frustum & frustum)
+{
+	frustum.testAABBBatch(tileBounds[0].data(), tileBounds[1].data(), tileBounds[2].data(),
+		tileBounds[3].data(), tileBounds[4].data(), tileBounds[5].data(), tileVisibility.data(), numTiles);
+
+	visibleTiles.clear();
+	for (size_t k = 0; k < numTiles; k++)
+	{
+		if (tileVisibility[k])
+		{
+			visibleTiles.push_back(tileCoords[k]);
+		}
+	}
+}
+
+Engine::TileCullingValidation Engine::TileCuller::validate(float tileWidth, unsigned int renderRadius)
+{
+	Engine::TileCullingValidation result;
+	result.testedTiles = 0;
+	result.falseNegatives = 0;
+	result.falsePositives = 0;
+	result.batchMismatches = 0;
+	result.boundViolations = 0;
+
+	// Eye and target, in tiles. Low flights in several directions, a steep look down, a look at the
+	// sky and a pose far from the origin
+	const glm::vec3 poses[][2] =
+	{
+		{ glm::vec3(0.5f, 0.6f, 0.5f), glm::vec3(8.0f, 0.3f, 6.0f) },
+		{ glm::vec3(0.5f, 0.6f, 0.5f), glm::vec3(-7.0f, 0.4f, 1.5f) },
+		{ glm::vec3(-3.2f, 1.0f, 4.7f), glm::vec3(-2.0f, 0.2f, -6.0f) },
+		{ glm::vec3(2.0f, 6.0f, 2.0f), glm::vec3(2.5f, 0.0f, 4.0f) },
+		{ glm::vec3(0.0f, 0.5f, 0.0f), glm::vec3(4.0f, 3.0f, 1.0f) },
+		{ glm::vec3(1000.3f, 0.8f, -750.6f), glm::vec3(990.0f, 0.4f, -741.0f) },
+	};
+
+	const unsigned int gridSamples = 21;
+	const float margin = 1e-4f;
+
+	Engine::TerrainHeightField heightField;
+	float vegetationMin = Engine::Settings::waterHeight;
+	float vegetationMax = Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight;
+	std::vector<Engine::VegetationPattern> noVegetation;
+
+	glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.5f, 1000.0f);
+
+	Engine::TileCuller culler;
+	std::vector<glm::vec3> tileMin, tileMax;
+	std::vector<std::vector<float>> tileSamples;
+
+	for (auto & pose : poses)
+	{
+		Engine::TileCullingPose poseResult;
+		poseResult.eye = pose[0] * tileWidth;
+		poseResult.target = pose[1] * tileWidth;
+
+		glm::mat4 viewProjection = projection * glm::lookAt(poseResult.eye, poseResult.target, glm::vec3(0.0f, 1.0f, 0.0f));
+		Engine::Frustum frustum(viewProjection);
+
+		int x = int(std::floor(poseResult.eye.x / tileWidth));
+		int y = int(std::floor(poseResult.eye.z / tileWidth));
+		int rr = int(renderRadius);
+
+		culler.begin(size_t(4 * rr * rr));
+		tileMin.clear();
+		tileMax.clear();
+		tileSamples.clear();
+		for (int i = x - rr; i < x + rr; i++)
+		{
+			for (int j = y - rr; j < y + rr; j++)
+			{
+				std::shared_ptr<Engine::TerrainTile> tile = Engine::TerrainTileCache::buildTile(i, j, heightField,
+					noVegetation, vegetationMin, vegetationMax);
+
+				glm::vec3 min(float(i) * tileWidth, Engine::TerrainHeightField::toWorldHeight(tile->minHeight, tileWidth), float(j) * tileWidth);
+				glm::vec3 max(float(i + 1) * tileWidth, Engine::TerrainHeightField::toWorldHeight(tile->maxHeight, tileWidth), float(j + 1) * tileWidth);
+				culler.addTile(i, j, min, max);
+				tileMin.push_back(min);
+				tileMax.push_back(max);
+
+				// Terrain heights between the samples the bounds were built from
+				std::vector<float> samples(gridSamples * gridSamples);
+				for (unsigned int sy = 0; sy < gridSamples; sy++)
+				{
+					for (unsigned int sx = 0; sx < gridSamples; sx++)
+					{
+						float u = float(sx) / float(gridSamples - 1);
+						float v = float(sy) / float(gridSamples - 1);
+						float height = heightField.getTileHeight(i, j, u, v);
+						if (height < tile->minHeight || height > tile->maxHeight)
+							result.boundViolations++;
+
+						samples[sy * gridSamples + sx] = Engine::TerrainHeightField::toWorldHeight(height, tileWidth);
+					}
+				}
+				tileSamples.push_back(samples);
+			}
+		}
+
+		culler.cull(frustum);
+
+		const size_t numTiles = culler.getNumTiles();
+		for (size_t k = 0; k < numTiles; k++)
+		{
+			bool visible = culler.tileVisibility[k] != 0;
+
+			if (visible != frustum.testAABB(tileMin[k], tileMax[k]))
+				result.batchMismatches++;
+
+			bool anyInside = false;
+			for (unsigned int s = 0; s < gridSamples * gridSamples && !anyInside; s++)
+			{
+				float u = float(s % gridSamples) / float(gridSamples - 1);
+				float v = float(s / gridSamples) / float(gridSamples - 1);
+				glm::vec3 point(tileMin[k].x + u * tileWidth, tileSamples[k][s], tileMin[k].z + v * tileWidth);
+				anyInside = clipPointInside(viewProjection * glm::vec4(point, 1.0f), margin);
+			}
+
+			if (!visible && anyInside)
+				result.falseNegatives++;
+			if (visible && boxOutsideClipPlane(viewProjection, tileMin[k], tileMax[k], margin))
+				result.falsePositives++;
+		}
+
+		poseResult.testedTiles = (unsigned int)numTiles;
+		poseResult.visibleTiles = (unsigned int)culler.getVisibleTiles().size();
+		result.testedTiles += poseResult.testedTiles;
+		result.poses.push_back(poseResult);
+
+		std::cout << "TileCuller: pose " << result.poses.size() - 1 << ", " << poseResult.visibleTiles << "/"
+			<< poseResult.testedTiles << " tiles visible" << std::endl;
+	}
+
+	std::cout << "TileCuller: " << result.falseNegatives << " false negatives, " << result.falsePositives << " false positives, "
+		<< result.batchMismatches << " batch mismatches, " << result.boundViolations << " samples out of the tile bounds" << std::endl;
+
+	return result;
+}
@@ -0,0 +1,151 @@
+#include "UploadRingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "RenderStatistics.h"
+
+// One second, in nanoseconds
+const GLuint64 UPLOAD_FENCE_TIMEOUT = 1000000000;
+// Copies start on 16 bytes boundaries
+const size_t UPLOAD_ALIGNMENT = 16;
+
+Engine::GPU::UploadRingBuffer::UploadRingBuffer()
+	:buffer(0)
+	,mapped(NULL)
+	,regionSize(0)
+	,region(0)
+	,regionOffset(0)
+	,frameBytes(0)
+	,frameCopies(0)
+	,lastFrameBytes(0)
+	,lastFrameCopies(0)
+{
+	for (unsigned int i = 0; i < NUM_REGIONS; i++)
+	{
+		fences[i] = 0;
+	}
+}
+
+bool Engine::GPU::UploadRingBuffer::isSupported()
+{
+	return GLEW_ARB_buffer_storage != 0;
+}
+
+void Engine::GPU::UploadRingBuffer::init(size_t regionSize)
+{
+	allocate(regionSize);
+	region = 0;
+	regionOffset = 0;
+}
+
+void Engine::GPU::UploadRingBuffer::allocate(size_t size)
+{
+	regionSize = (size + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+	if (!isSupported())
+		return;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	size_t totalSize = regionSize * NUM_REGIONS;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glBufferStorage(GL_COPY_READ_BUFFER, totalSize, NULL, flags);
+	mapped = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, totalSize, flags);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void Engine::GPU::UploadRingBuffer::beginFrame()
+{
+	region = (region + 1) % NUM_REGIONS;
+	regionOffset = 0;
+	frameBytes = 0;
+	frameCopies = 0;
+
+	if (fences[region] != 0)
+	{
+		GLenum result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_FENCE_TIMEOUT);
+		while (result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(fences[region], 0, UPLOAD_FENCE_TIMEOUT);
+		}
+
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+}
+
+void Engine::GPU::UploadRingBuffer::upload(unsigned int dstBuffer, size_t dstOffset, const void * data, size_t size)
+{
+	if (size == 0)
+		return;
+
+	frameBytes += size;
+	frameCopies++;
+	Engine::RenderStatistics::storageUploads++;
+
+	if (mapped == NULL)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, dstBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, dstOffset, size, data);
+		return;
+	}
+
+	if (regionOffset + size > regionSize)
+	{
+		// The copies already issued keep the old buffer alive until they are done, so it can
+		// be released right away. Every region of the new one is free
+		size_t newSize = std::max(regionSize * 2, regionOffset + size);
+		release();
+		allocate(newSize);
+		region = 0;
+		regionOffset = 0;
+	}
+
+	size_t srcOffset = region * regionSize + regionOffset;
+	memcpy(mapped + srcOffset, data, size);
+	regionOffset = (regionOffset + size + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, dstBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, srcOffset, dstOffset, size);
+}
+
+void Engine::GPU::UploadRingBuffer::endFrame()
+{
+	if (mapped != NULL && regionOffset > 0)
+	{
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	lastFrameBytes = frameBytes;
+	lastFrameCopies = frameCopies;
+}
+
+void Engine::GPU::UploadRingBuffer::release()
+{
+	for (unsigned int i = 0; i < NUM_REGIONS; i++)
+	{
+		if (fences[i] != 0)
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+
+	if (buffer != 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		mapped = NULL;
+	}
+}
+
+void Engine::GPU::UploadRingBuffer::destroy()
+{
+	release();
+	regionSize = 0;
+}
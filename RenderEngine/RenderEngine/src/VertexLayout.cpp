@@ -0,0 +1,299 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "VertexLayout.h"
+
+#include <cmath>
+#include <cstring>
+
+// Number of float components each attribute has on the CPU
+const unsigned int ATTRIBUTE_COMPONENTS[Engine::VERTEX_ATTRIBUTE_COUNT] = { 3, 3, 3, 3, 2, 3 };
+
+static bool withinRange(const float * data, size_t count, float min, float max)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		// Written this way so NaNs are out of range too
+		if (!(data[i] >= min && data[i] <= max))
+			return false;
+	}
+	return true;
+}
+
+Engine::VertexLayout::VertexLayout()
+	:interleaved(false)
+	,shortIndices(false)
+	,optimized(false)
+	,vertexSize(0)
+	,numBuffers(0)
+{
+	for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+	{
+		requested[a] = VERTEX_FORMAT_FLOAT;
+
+		attributes[a].format = VERTEX_FORMAT_NONE;
+		attributes[a].components = ATTRIBUTE_COMPONENTS[a];
+		attributes[a].buffer = 0;
+		attributes[a].offset = 0;
+		attributes[a].stride = 0;
+	}
+}
+
+Engine::VertexLayout Engine::VertexLayout::separate()
+{
+	return VertexLayout();
+}
+
+Engine::VertexLayout Engine::VertexLayout::compact()
+{
+	VertexLayout layout;
+	layout.setInterleaved(true);
+	layout.setShortIndices(true);
+	layout.setFormat(VERTEX_NORMAL, VERTEX_FORMAT_OCTAHEDRAL);
+	layout.setFormat(VERTEX_TANGENT, VERTEX_FORMAT_OCTAHEDRAL);
+	layout.setFormat(VERTEX_COLOR, VERTEX_FORMAT_RGBA8);
+	layout.setFormat(VERTEX_EMISSION, VERTEX_FORMAT_RGBA8);
+	layout.setFormat(VERTEX_UV, VERTEX_FORMAT_HALF);
+	return layout;
+}
+
+void Engine::VertexLayout::setInterleaved(bool interleaved)
+{
+	this->interleaved = interleaved;
+}
+
+void Engine::VertexLayout::setShortIndices(bool shortIndices)
+{
+	this->shortIndices = shortIndices;
+}
+
+void Engine::VertexLayout::setOptimized(bool optimized)
+{
+	this->optimized = optimized;
+}
+
+void Engine::VertexLayout::setFormat(Engine::VertexAttribute attribute, Engine::VertexFormat format)
+{
+	requested[attribute] = format;
+}
+
+void Engine::VertexLayout::resolve(const float * const data[VERTEX_ATTRIBUTE_COUNT], unsigned int numVertices)
+{
+	vertexSize = 0;
+	numBuffers = 0;
+
+	for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+	{
+		VertexAttributeLayout & attribute = attributes[a];
+		attribute.format = VERTEX_FORMAT_NONE;
+		attribute.buffer = 0;
+		attribute.offset = 0;
+		attribute.stride = 0;
+
+		if (data[a] == 0 || requested[a] == VERTEX_FORMAT_NONE)
+			continue;
+
+		// Fall back to floats when the data does not fit the packed format
+		VertexFormat format = requested[a];
+		size_t count = size_t(numVertices) * attribute.components;
+		if (format == VERTEX_FORMAT_RGBA8 && !withinRange(data[a], count, 0.0f, 1.0f))
+		{
+			format = VERTEX_FORMAT_FLOAT;
+		}
+		else if (format == VERTEX_FORMAT_HALF && !withinRange(data[a], count, -65504.0f, 65504.0f))
+		{
+			format = VERTEX_FORMAT_FLOAT;
+		}
+		else if (format == VERTEX_FORMAT_OCTAHEDRAL && attribute.components != 3)
+		{
+			format = VERTEX_FORMAT_FLOAT;
+		}
+
+		size_t size = getFormatSize(format, attribute.components);
+		attribute.format = format;
+
+		if (interleaved)
+		{
+			attribute.offset = vertexSize;
+		}
+		else
+		{
+			attribute.buffer = numBuffers++;
+			attribute.stride = size;
+		}
+
+		vertexSize += size;
+	}
+
+	if (interleaved)
+	{
+		numBuffers = vertexSize > 0 ? 1 : 0;
+		for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+		{
+			attributes[a].stride = vertexSize;
+		}
+	}
+}
+
+void Engine::VertexLayout::pack(unsigned int buffer, const float * const data[VERTEX_ATTRIBUTE_COUNT], unsigned int numVertices, std::vector<unsigned char> & result) const
+{
+	size_t stride = 0;
+	for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+	{
+		if (attributes[a].format != VERTEX_FORMAT_NONE && attributes[a].buffer == buffer)
+		{
+			stride = attributes[a].stride;
+			break;
+		}
+	}
+
+	result.assign(size_t(numVertices) * stride, 0);
+
+	for (unsigned int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+	{
+		const VertexAttributeLayout & attribute = attributes[a];
+		if (attribute.format == VERTEX_FORMAT_NONE || attribute.buffer != buffer)
+			continue;
+
+		const unsigned int components = attribute.components;
+		for (unsigned int v = 0; v < numVertices; v++)
+		{
+			const float * src = data[a] + size_t(v) * components;
+			unsigned char * dst = &result[size_t(v) * stride + attribute.offset];
+
+			switch (attribute.format)
+			{
+			case VERTEX_FORMAT_FLOAT:
+				memcpy(dst, src, components * sizeof(float));
+				break;
+			case VERTEX_FORMAT_HALF:
+				for (unsigned int c = 0; c < components; c++)
+				{
+					unsigned short half = toHalf(src[c]);
+					memcpy(dst + c * sizeof(unsigned short), &half, sizeof(unsigned short));
+				}
+				break;
+			case VERTEX_FORMAT_RGBA8:
+				for (unsigned int c = 0; c < 4; c++)
+				{
+					float value = c < components ? src[c] : 1.0f;
+					dst[c] = (unsigned char)floor(value * 255.0f + 0.5f);
+				}
+				break;
+			case VERTEX_FORMAT_OCTAHEDRAL:
+			{
+				short encoded[2];
+				toOctahedral(src, encoded);
+				memcpy(dst, encoded, sizeof(encoded));
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+}
+
+unsigned int Engine::VertexLayout::getAttributeComponents(Engine::VertexAttribute attribute)
+{
+	return ATTRIBUTE_COMPONENTS[attribute];
+}
+
+size_t Engine::VertexLayout::getFormatSize(Engine::VertexFormat format, unsigned int components)
+{
+	switch (format)
+	{
+	case VERTEX_FORMAT_FLOAT:
+		return components * sizeof(float);
+	case VERTEX_FORMAT_HALF:
+		// Keep the next attribute 4 bytes aligned
+		return ((components * sizeof(unsigned short) + 3) / 4) * 4;
+	case VERTEX_FORMAT_RGBA8:
+		return 4;
+	case VERTEX_FORMAT_OCTAHEDRAL:
+		return 2 * sizeof(short);
+	default:
+		return 0;
+	}
+}
+
+unsigned short Engine::VertexLayout::toHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(float));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int rawExponent = (bits >> 23) & 0xff;
+	unsigned int mantissa = bits & 0x007fffff;
+
+	// Infinity and NaN
+	if (rawExponent == 0xff)
+	{
+		return (unsigned short)(sign | 0x7c00 | (mantissa != 0 ? 0x0200 : 0));
+	}
+
+	int exponent = int(rawExponent) - 127 + 15;
+	if (exponent >= 31)
+	{
+		return (unsigned short)(sign | 0x7c00);
+	}
+
+	unsigned int half, rest, halfway;
+	if (exponent <= 0)
+	{
+		// Subnormal half (or zero)
+		if (exponent < -10)
+		{
+			return (unsigned short)sign;
+		}
+
+		mantissa |= 0x00800000;
+		unsigned int shift = (unsigned int)(14 - exponent);
+		half = mantissa >> shift;
+		rest = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	else
+	{
+		half = ((unsigned int)exponent << 10) | (mantissa >> 13);
+		rest = mantissa & 0x1fff;
+		halfway = 0x1000;
+	}
+
+	// Round to nearest even. A carry into the exponent is still a correct result
+	if (rest > halfway || (rest == halfway && (half & 1)))
+	{
+		half++;
+	}
+
+	return (unsigned short)(sign | half);
+}
+
+void Engine::VertexLayout::toOctahedral(const float * v, short * result)
+{
+	float l1 = fabs(v[0]) + fabs(v[1]) + fabs(v[2]);
+
+	float px = 0.0f, py = 0.0f;
+	if (l1 > 0.0f)
+	{
+		px = v[0] / l1;
+		py = v[1] / l1;
+
+		// Fold the lower hemisphere over the diagonals
+		if (v[2] < 0.0f)
+		{
+			float fx = (1.0f - fabs(py)) * (px >= 0.0f ? 1.0f : -1.0f);
+			float fy = (1.0f - fabs(px)) * (py >= 0.0f ? 1.0f : -1.0f);
+			px = fx;
+			py = fy;
+		}
+	}
+
+	px = px < -1.0f ? -1.0f : px > 1.0f ? 1.0f : px;
+	py = py < -1.0f ? -1.0f : py > 1.0f ? 1.0f : py;
+
+	result[0] = (short)floor(px * 32767.0f + 0.5f);
+	result[1] = (short)floor(py * 32767.0f + 0.5f);
+}
@@ -4,6 +4,7 @@
 
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
+#include "GLStateCache.h"
 
 // ===================================================================
 
@@ -36,6 +37,12 @@ void Engine::Window::WindowToolkit::initGlew()
 	// Initializes glew
 	glewExperimental = GL_TRUE;
 	GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLEW built for GLX fails on EGL contexts (headless) after loading the OpenGL functions,
+	// only the GLX extensions are missing
+	if (err == GLEW_ERROR_NO_GLX_DISPLAY)
+		err = GLEW_OK;
+#endif
 	if (GLEW_OK != err)
 	{
 		std::cerr << "Error: " << glewGetErrorString(err) << std::endl;
@@ -49,12 +56,12 @@ void Engine::Window::WindowToolkit::initGlew()
 void Engine::Window::WindowToolkit::initializeOGL()
 {
 	// Basic OPENGL Context configuration
-	glEnable(GL_DEPTH_TEST);
-	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	Engine::GLStateCache::getInstance().enable(GL_DEPTH_TEST);
+	Engine::GLStateCache::getInstance().clearColor(0.0f, 0.0f, 0.0f, 0.0f);
 	glFrontFace(GL_CCW);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_PROGRAM_POINT_SIZE);
+	Engine::GLStateCache::getInstance().enable(GL_CULL_FACE);
+	Engine::GLStateCache::getInstance().enable(GL_PROGRAM_POINT_SIZE);
 }
 
 void Engine::Window::WindowToolkit::setContextProfile(unsigned int contxtProfile)
@@ -21,6 +21,9 @@ float Engine::Settings::terrainFrecuency = 0.244f;
 float Engine::Settings::terrainScale = 0.9f;
 unsigned int Engine::Settings::terrainOctaves = 10;
 float Engine::Settings::vegetationMaxHeight = 0.1f;
+bool Engine::Settings::instancedVegetation = true;
+bool Engine::Settings::treeLODs = true;
+bool Engine::Settings::batchedTerrain = true;
 float Engine::Settings::grassCoverage = 0.5f;
 glm::vec3 Engine::Settings::grassColor = glm::vec3(0.1f, 0.3f, 0.0f);
 glm::vec3 Engine::Settings::sandColor = glm::vec3(0.94f, 0.89f, 0.5f);
@@ -34,6 +37,8 @@ float Engine::Settings::waterSpeed = 0.0025f;
 float Engine::Settings::waterHeight = 0.09f;
 
 unsigned int Engine::Settings::drawClouds = 0;
+bool Engine::Settings::bakeCloudNoiseOnCPU = true;
+float Engine::Settings::cloudNoiseFrameBudgetMs = 2.0f;
 float Engine::Settings::cloudType = 0.5f;
 float Engine::Settings::coverageMultiplier = 1.0f;
 float Engine::Settings::innerSphereRadius	= 10000000.0f * 2.0;
@@ -51,6 +56,15 @@ glm::vec3 Engine::Settings::cloudColor = glm::vec3(1, 1, 1);
 float Engine::Settings::dofFocalDist = 70.0f;
 float Engine::Settings::dofMaxDist = 0.01f;
 
+bool Engine::Settings::fusedPostProcess = false;
+unsigned int Engine::Settings::postProcessQuality = Engine::PostProcessQuality::POSTPROCESS_QUALITY_HIGH;
+unsigned int Engine::Settings::lightClusterBuilder = Engine::LightClusterBuilderType::LIGHT_CLUSTERS_CPU;
+
+unsigned int Engine::Settings::shadowCascades = 4;
+float Engine::Settings::shadowSplitLambda = 0.75f;
+float Engine::Settings::shadowDistance = 120.0f;
+bool Engine::Settings::shadowCache = true;
+
 float Engine::Settings::hdrExposure = 6.0f;
 float Engine::Settings::hdrGamma = 0.368f;
 glm::vec3 Engine::Settings::hdrTint = glm::vec3(1.0f);
@@ -60,6 +74,7 @@ float Engine::Settings::godRaysDensity = 0.318f;
 float Engine::Settings::godRaysExposure = 0.515f;
 float Engine::Settings::godRaysWeight = 0.2f;
 
+bool Engine::Settings::showProfiler = true;
 bool Engine::Settings::showUI = false;
 
 void Engine::Settings::update()
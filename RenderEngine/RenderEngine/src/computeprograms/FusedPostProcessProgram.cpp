@@ -0,0 +1,83 @@
+#include "computeprograms/FusedPostProcessProgram.h"
+
+#include "WorldConfig.h"
+#include "GLStateCache.h"
+
+#include <GL/glew.h>
+
+const unsigned int Engine::FusedPostProcessProgram::LOCAL_SIZE_X = 16;
+const unsigned int Engine::FusedPostProcessProgram::LOCAL_SIZE_Y = 16;
+
+Engine::FusedPostProcessProgram::FusedPostProcessProgram()
+	:Engine::ComputeProgram("shaders/postprocess/FusedToneMapDoF.comp")
+{
+
+}
+
+Engine::FusedPostProcessProgram::FusedPostProcessProgram(const Engine::FusedPostProcessProgram & other)
+	: Engine::ComputeProgram(other)
+{
+	uOutColor = other.uOutColor;
+	uInColor = other.uInColor;
+	uDepthBuffer = other.uDepthBuffer;
+	uScreenSize = other.uScreenSize;
+	uToneMapping = other.uToneMapping;
+	uDepthOfField = other.uDepthOfField;
+	uExposure = other.uExposure;
+	uGamma = other.uGamma;
+	uTint = other.uTint;
+	uFocalDistance = other.uFocalDistance;
+	uMaxDistanceFactor = other.uMaxDistanceFactor;
+	uInverseProj = other.uInverseProj;
+}
+
+void Engine::FusedPostProcessProgram::configureProgram()
+{
+	uOutColor = glGetUniformLocation(glProgram, "outColor");
+	uInColor = glGetUniformLocation(glProgram, "inColor");
+	uDepthBuffer = glGetUniformLocation(glProgram, "depthBuffer");
+	uScreenSize = glGetUniformLocation(glProgram, "screenSize");
+	uToneMapping = glGetUniformLocation(glProgram, "toneMapping");
+	uDepthOfField = glGetUniformLocation(glProgram, "depthOfField");
+	uExposure = glGetUniformLocation(glProgram, "exposure");
+	uGamma = glGetUniformLocation(glProgram, "gamma");
+	uTint = glGetUniformLocation(glProgram, "tint");
+	uFocalDistance = glGetUniformLocation(glProgram, "focalDistance");
+	uMaxDistanceFactor = glGetUniformLocation(glProgram, "maxDistanceFactor");
+	uInverseProj = glGetUniformLocation(glProgram, "invProj");
+}
+
+void Engine::FusedPostProcessProgram::bindTextures(const Engine::TextureInstance * color, const Engine::TextureInstance * depth, const Engine::TextureInstance * output)
+{
+	glUniform1i(uInColor, 0);
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, color->getTexture()->getTextureId());
+
+	glUniform1i(uDepthBuffer, 1);
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE1);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, depth->getTexture()->getTextureId());
+
+	glBindImageTexture(0, output->getTexture()->getTextureId(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	glUniform1i(uOutColor, 0);
+}
+
+void Engine::FusedPostProcessProgram::setParameters(Engine::Camera * camera, bool toneMapping, bool depthOfField)
+{
+	glUniform1i(uToneMapping, toneMapping ? 1 : 0);
+	glUniform1i(uDepthOfField, depthOfField ? 1 : 0);
+
+	glUniform1f(uExposure, Engine::Settings::hdrExposure);
+	glUniform1f(uGamma, Engine::Settings::hdrGamma);
+	glUniform3fv(uTint, 1, &Engine::Settings::hdrTint[0]);
+
+	glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
+	glUniform1f(uFocalDistance, Engine::Settings::dofFocalDist);
+	glUniform1f(uMaxDistanceFactor, Engine::Settings::dofMaxDist);
+	glUniformMatrix4fv(uInverseProj, 1, GL_FALSE, &invProj[0][0]);
+}
+
+void Engine::FusedPostProcessProgram::dispatchScreen(unsigned int width, unsigned int height, unsigned int barrier)
+{
+	glUniform2i(uScreenSize, GLint(width), GLint(height));
+	dispatch((width + LOCAL_SIZE_X - 1) / LOCAL_SIZE_X, (height + LOCAL_SIZE_Y - 1) / LOCAL_SIZE_Y, 1, barrier);
+}
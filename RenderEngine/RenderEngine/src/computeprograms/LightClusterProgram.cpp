@@ -0,0 +1,46 @@
+#include "computeprograms/LightClusterProgram.h"
+
+#include "LightClusterBuilder.h"
+
+#include <GL/glew.h>
+
+const unsigned int Engine::LightClusterProgram::MAX_LIGHTS_PER_CLUSTER = 256;
+
+Engine::LightClusterProgram::LightClusterProgram()
+	:Engine::ComputeProgram("shaders/postprocess/LightClusters.comp")
+{
+
+}
+
+Engine::LightClusterProgram::LightClusterProgram(const Engine::LightClusterProgram & other)
+	: Engine::ComputeProgram(other)
+{
+	uNumLights = other.uNumLights;
+	uProjScale = other.uProjScale;
+	uNearPlane = other.uNearPlane;
+	uFarPlane = other.uFarPlane;
+	uViewMatrix = other.uViewMatrix;
+}
+
+void Engine::LightClusterProgram::configureProgram()
+{
+	uNumLights = glGetUniformLocation(glProgram, "numLights");
+	uProjScale = glGetUniformLocation(glProgram, "projScale");
+	uNearPlane = glGetUniformLocation(glProgram, "nearPlane");
+	uFarPlane = glGetUniformLocation(glProgram, "farPlane");
+	uViewMatrix = glGetUniformLocation(glProgram, "viewMatrix");
+}
+
+void Engine::LightClusterProgram::setParameters(unsigned int numLights, float xScale, float yScale, float nearPlane, float farPlane, const glm::mat4 & view)
+{
+	glUniform1ui(uNumLights, numLights);
+	glUniform2f(uProjScale, xScale, yScale);
+	glUniform1f(uNearPlane, nearPlane);
+	glUniform1f(uFarPlane, farPlane);
+	glUniformMatrix4fv(uViewMatrix, 1, GL_FALSE, &view[0][0]);
+}
+
+void Engine::LightClusterProgram::dispatchClusters(unsigned int barrier)
+{
+	dispatch(Engine::LightClusterBuilder::GRID_X, Engine::LightClusterBuilder::GRID_Y, Engine::LightClusterBuilder::GRID_Z, barrier);
+}
@@ -0,0 +1,147 @@
+#include "computeprograms/TerrainHeightProgram.h"
+
+#include "GLStateCache.h"
+#include "util/IOUtils.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+const unsigned int Engine::TerrainHeightProgram::LOCAL_SIZE_X = 64;
+const unsigned int Engine::TerrainHeightProgram::UV_BINDING_POINT = 0;
+const unsigned int Engine::TerrainHeightProgram::HEIGHT_BINDING_POINT = 1;
+
+Engine::TerrainHeightProgram::TerrainHeightProgram(std::string noiseShaderFile)
+	:Engine::ComputeProgram("shaders/terrain/terrainheight.comp")
+	,noiseShaderFile(noiseShaderFile)
+{
+
+}
+
+Engine::TerrainHeightProgram::TerrainHeightProgram(const Engine::TerrainHeightProgram & other)
+	: Engine::ComputeProgram(other)
+{
+	noiseShaderFile = other.noiseShaderFile;
+	uNumSamples = other.uNumSamples;
+	uAmplitude = other.uAmplitude;
+	uFrecuency = other.uFrecuency;
+	uScale = other.uScale;
+	uOctaves = other.uOctaves;
+}
+
+void Engine::TerrainHeightProgram::configureProgram()
+{
+	uNumSamples = glGetUniformLocation(glProgram, "numSamples");
+	uAmplitude = glGetUniformLocation(glProgram, "terrainAmplitude");
+	uFrecuency = glGetUniformLocation(glProgram, "terrainFrecuency");
+	uScale = glGetUniformLocation(glProgram, "terrainScale");
+	uOctaves = glGetUniformLocation(glProgram, "terrainOctaves");
+}
+
+void Engine::TerrainHeightProgram::setParameters(unsigned int numSamples, const Engine::TerrainHeightField & field)
+{
+	glUniform1ui(uNumSamples, numSamples);
+	glUniform1f(uAmplitude, field.getAmplitude());
+	glUniform1f(uFrecuency, field.getFrecuency());
+	glUniform1f(uScale, field.getScale());
+	glUniform1i(uOctaves, int(field.getOctaves()));
+}
+
+void Engine::TerrainHeightProgram::dispatchSamples(unsigned int numSamples, unsigned int barrier)
+{
+	dispatch((numSamples + LOCAL_SIZE_X - 1) / LOCAL_SIZE_X, 1, 1, barrier);
+}
+
+Engine::TerrainHeightValidation Engine::TerrainHeightProgram::validate(const Engine::TerrainHeightField & field, unsigned int samples)
+{
+	Engine::TerrainHeightValidation result;
+	result.samples = 0;
+	result.failures = 0;
+	result.batchMismatches = 0;
+	result.maxError = 0.0f;
+
+	std::vector<float> u, v;
+	field.getValidationSamples(samples, u, v);
+
+	std::vector<glm::vec2> uvs(samples);
+	for (unsigned int s = 0; s < samples; s++)
+	{
+		uvs[s] = glm::vec2(u[s], v[s]);
+	}
+
+	GLuint buffers[2];
+	glGenBuffers(2, buffers);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec2) * samples, uvs.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(float) * samples, NULL, GL_STREAM_READ);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, UV_BINDING_POINT, buffers[0]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HEIGHT_BINDING_POINT, buffers[1]);
+
+	Engine::GLStateCache::getInstance().useProgram(glProgram);
+	setParameters(samples, field);
+	dispatchSamples(samples, GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	std::vector<float> heights(samples);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(float) * samples, heights.data());
+	glDeleteBuffers(2, buffers);
+
+	const float tolerance = field.getValidationTolerance();
+	for (unsigned int s = 0; s < samples; s++)
+	{
+		float error = std::fabs(field.noiseHeight(uvs[s]) - heights[s]);
+		result.maxError = std::max(result.maxError, error);
+		result.failures += error > tolerance ? 1 : 0;
+		result.samples++;
+	}
+
+	std::cout << "TerrainHeightProgram: " << result.samples - result.failures << "/" << result.samples
+		<< " GPU heights of " << noiseShaderFile << " within tolerance of the CPU height field (max error "
+		<< result.maxError << ")" << std::endl;
+
+	return result;
+}
+
+std::string Engine::TerrainHeightProgram::loadShaderSource()
+{
+	std::string source = Engine::ComputeProgram::loadShaderSource();
+
+	unsigned long long fileLen;
+	char * noiseSource = Engine::IO::loadStringFromFile(noiseShaderFile.c_str(), fileLen);
+	if (noiseSource == 0)
+	{
+		std::cout << "TerrainHeightProgram: Could not read " << noiseShaderFile << std::endl;
+		exit(-1);
+	}
+
+	std::string shader(noiseSource, fileLen);
+	delete[] noiseSource;
+
+	// From the hash to the end of the height function body
+	size_t begin = shader.find("float Random2D(");
+	size_t function = shader.find("float noiseHeight(in vec2 pos)", begin == std::string::npos ? 0 : begin);
+	size_t end = function == std::string::npos ? std::string::npos : shader.find('{', function);
+	for (int depth = 0; end != std::string::npos; end++)
+	{
+		if (end >= shader.size())
+		{
+			end = std::string::npos;
+			break;
+		}
+
+		depth += shader[end] == '{' ? 1 : shader[end] == '}' ? -1 : 0;
+		if (depth == 0)
+			break;
+	}
+
+	if (begin == std::string::npos || end == std::string::npos)
+	{
+		std::cout << "TerrainHeightProgram: No Random2D() to noiseHeight() functions on " << noiseShaderFile << std::endl;
+		exit(-1);
+	}
+
+	return source + "\n" + shader.substr(begin, end + 1 - begin) + "\n";
+}
@@ -1,8 +1,14 @@
 #include "computeprograms/VolumeTextureProgram.h" 
 
+#include "GLStateCache.h"
+
 #include <GL/glew.h>
 #include <iostream>
 
+const unsigned int Engine::VolumeTextureProgram::LOCAL_SIZE_X = 8;
+const unsigned int Engine::VolumeTextureProgram::LOCAL_SIZE_Y = 8;
+const unsigned int Engine::VolumeTextureProgram::LOCAL_SIZE_Z = 1;
+
 Engine::VolumeTextureProgram::VolumeTextureProgram(std::string shaderFile)
 	:Engine::ComputeProgram(shaderFile)
 {
@@ -12,18 +18,26 @@ Engine::VolumeTextureProgram::VolumeTextureProgram(std::string shaderFile)
 Engine::VolumeTextureProgram::VolumeTextureProgram(const Engine::VolumeTextureProgram & other)
 	: Engine::ComputeProgram(other)
 {
-
+	uOutput = other.uOutput;
+	uSlabOffset = other.uSlabOffset;
 }
 
 void Engine::VolumeTextureProgram::configureProgram()
 {
 	uOutput = glGetUniformLocation(glProgram, "outVolTex");
+	uSlabOffset = glGetUniformLocation(glProgram, "slabOffset");
 }
 
 void Engine::VolumeTextureProgram::bindOutput(const Engine::TextureInstance * ti)
 {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_3D, ti->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_3D, ti->getTexture()->getTextureId());
 	glBindImageTexture(0, ti->getTexture()->getTextureId(), 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
 	glUniform1i(uOutput, 0);
+}
+
+void Engine::VolumeTextureProgram::dispatchSlab(unsigned int offsetZ, unsigned int width, unsigned int height, unsigned int depth, unsigned int barrier)
+{
+	glUniform3i(uSlabOffset, 0, 0, (GLint)offsetZ);
+	dispatch((width + LOCAL_SIZE_X - 1) / LOCAL_SIZE_X, (height + LOCAL_SIZE_Y - 1) / LOCAL_SIZE_Y, (depth + LOCAL_SIZE_Z - 1) / LOCAL_SIZE_Z, barrier);
 }
\ No newline at end of file
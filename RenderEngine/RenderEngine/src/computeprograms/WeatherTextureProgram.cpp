@@ -1,5 +1,12 @@
 #include "computeprograms/WeatherTextureProgram.h"
 
+#include "GLStateCache.h"
+
+#include <GL/glew.h>
+
+const unsigned int Engine::WeatherTextureProgram::LOCAL_SIZE_X = 8;
+const unsigned int Engine::WeatherTextureProgram::LOCAL_SIZE_Y = 8;
+
 Engine::WeatherTextureProgram::WeatherTextureProgram()
 	:Engine::ComputeProgram("shaders/clouds/generation/weather.comp")
 {
@@ -10,17 +17,25 @@ Engine::WeatherTextureProgram::WeatherTextureProgram(const Engine::WeatherTextur
 	: Engine::ComputeProgram(other)
 {
 	uWeatherTex = other.uWeatherTex;
+	uSlabOffset = other.uSlabOffset;
 }
 
 void Engine::WeatherTextureProgram::configureProgram()
 {
 	uWeatherTex = glGetUniformLocation(glProgram, "outWeatherTex");
+	uSlabOffset = glGetUniformLocation(glProgram, "slabOffset");
 }
 
 void Engine::WeatherTextureProgram::bindOutput(const Engine::TextureInstance * ti)
 {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, ti->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, ti->getTexture()->getTextureId());
 	glBindImageTexture(0, ti->getTexture()->getTextureId(), 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
 	glUniform1i(uWeatherTex, 0);
+}
+
+void Engine::WeatherTextureProgram::dispatchSlab(unsigned int offsetY, unsigned int width, unsigned int height, unsigned int barrier)
+{
+	glUniform2i(uSlabOffset, 0, (GLint)offsetY);
+	dispatch((width + LOCAL_SIZE_X - 1) / LOCAL_SIZE_X, (height + LOCAL_SIZE_Y - 1) / LOCAL_SIZE_Y, 1, barrier);
 }
\ No newline at end of file
@@ -24,6 +24,17 @@ void Engine::DeferredObjectsTable::onResize(int width, int height)
 	}
 }
 
+size_t Engine::DeferredObjectsTable::getMemoryUsage() const
+{
+	size_t bytes = 0;
+	for (auto ro : deferredObjects)
+	{
+		bytes += ro->getMemoryUsage();
+	}
+
+	return bytes;
+}
+
 void Engine::DeferredObjectsTable::clean()
 {
 	for (auto ro : deferredObjects)
@@ -5,8 +5,8 @@
 
 #include "datatables/MeshTable.h"
 
-#include <assimp\cimport.h>
-#include <assimp\postprocess.h>
+#include <assimp/cimport.h>
+#include <assimp/postprocess.h>
 #include <iostream>
 
 Engine::MeshTable * Engine::MeshTable::INSTANCE = new Engine::MeshTable();
@@ -44,7 +44,9 @@ Engine::Mesh * Engine::MeshTable::getMesh(std::string filename)
 		if (scene->HasMeshes())
 		{
 			aiMesh * rawMesh = scene->mMeshes[0];
-			Mesh * m = new Mesh(rawMesh);
+			Engine::VertexLayout layout = Engine::VertexLayout::compact();
+			layout.setOptimized(true);
+			Mesh * m = new Mesh(rawMesh, layout);
 
 			meshCache[filename] = m;
 			aiReleaseImport(scene);
@@ -66,6 +68,25 @@ void Engine::MeshTable::addMeshToCache(std::string name, const Engine::Mesh & me
 	}
 }
 
+void Engine::MeshTable::getMeshSizes(std::vector<std::pair<std::string, size_t>> & sizes)
+{
+	sizes.clear();
+	for (auto & mesh : meshCache)
+	{
+		sizes.push_back(std::make_pair(mesh.first, mesh.second->getGPUSize()));
+	}
+}
+
+size_t Engine::MeshTable::getTotalMeshSize()
+{
+	size_t total = 0;
+	for (auto & mesh : meshCache)
+	{
+		total += mesh.second->getGPUSize();
+	}
+	return total;
+}
+
 void Engine::MeshTable::clean()
 {
 	std::map<std::string, Engine::Mesh* >::iterator it = meshCache.begin();
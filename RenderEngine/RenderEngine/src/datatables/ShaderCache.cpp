@@ -0,0 +1,322 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "datatables/ShaderCache.h"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+const std::string Engine::ShaderCache::DEFAULT_CACHE_FILE = "shadercache.bin";
+
+// Cache file header
+const unsigned int CACHE_MAGIC = 0x48435352; // RSCH
+const unsigned int CACHE_VERSION = 1;
+
+// FNV-1a 64 bits
+const unsigned long long HASH_OFFSET = 14695981039346656037ULL;
+const unsigned long long HASH_PRIME = 1099511628211ULL;
+
+static void hashBytes(unsigned long long & hash, const void * data, size_t size)
+{
+	const unsigned char * bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= HASH_PRIME;
+	}
+}
+
+static std::string getGLString(GLenum name)
+{
+	const GLubyte * str = glGetString(name);
+	return str != NULL ? std::string((const char *)str) : std::string();
+}
+
+template<typename T>
+static void writeValue(std::ofstream & file, const T & value)
+{
+	file.write((const char *)&value, sizeof(T));
+}
+
+template<typename T>
+static bool readValue(std::ifstream & file, T & value)
+{
+	file.read((char *)&value, sizeof(T));
+	return file.good();
+}
+
+// Bytes left to read until the given file size
+static std::streamoff remainingBytes(std::ifstream & file, std::streamoff fileSize)
+{
+	std::streamoff position = file.tellg();
+	return position >= 0 && position < fileSize ? fileSize - position : 0;
+}
+
+Engine::ShaderCache * Engine::ShaderCache::INSTANCE = new Engine::ShaderCache();
+
+Engine::ShaderCache & Engine::ShaderCache::getInstance()
+{
+	return *INSTANCE;
+}
+
+Engine::ShaderCache::ShaderCache()
+	:cacheFile(DEFAULT_CACHE_FILE)
+	,enabled(true)
+	,initialized(false)
+	,supported(false)
+	,dirty(false)
+{
+	stats.hits = 0;
+	stats.misses = 0;
+	stats.loadMs = 0.0;
+	stats.buildMs = 0.0;
+	stats.savedMs = 0.0;
+}
+
+Engine::ShaderCache::~ShaderCache()
+{
+}
+
+void Engine::ShaderCache::setCacheFile(const std::string & file)
+{
+	cacheFile = file;
+}
+
+void Engine::ShaderCache::setEnabled(bool enabled)
+{
+	this->enabled = enabled;
+}
+
+unsigned long long Engine::ShaderCache::computeKey(unsigned long long parameters, const std::vector<unsigned int> & types, const std::vector<std::string> & sources)
+{
+	initializeCache();
+
+	unsigned long long hash = HASH_OFFSET;
+	hashBytes(hash, driver.c_str(), driver.size());
+	hashBytes(hash, &parameters, sizeof(parameters));
+
+	for (size_t i = 0; i < types.size() && i < sources.size(); i++)
+	{
+		hashBytes(hash, &types[i], sizeof(unsigned int));
+		hashBytes(hash, sources[i].c_str(), sources[i].size());
+	}
+
+	return hash;
+}
+
+bool Engine::ShaderCache::loadProgram(const std::string & id, unsigned long long key, unsigned int program)
+{
+	initializeCache();
+
+	if (!enabled || !supported)
+	{
+		stats.misses++;
+		return false;
+	}
+
+	std::map<std::string, CacheEntry>::iterator it = entries.find(id);
+	if (it == entries.end() || it->second.key != key)
+	{
+		stats.misses++;
+		return false;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const CacheEntry & entry = it->second;
+	glProgramBinary(program, entry.format, &entry.binary[0], (GLsizei)entry.binary.size());
+
+	// Drivers may reject binaries even if the version strings did not change
+	int linked;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+	std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - start;
+
+	if (!linked)
+	{
+		entries.erase(it);
+		dirty = true;
+		stats.misses++;
+		return false;
+	}
+
+	stats.hits++;
+	stats.loadMs += loadTime.count();
+	if (entry.buildMs > loadTime.count())
+	{
+		stats.savedMs += entry.buildMs - loadTime.count();
+	}
+
+	return true;
+}
+
+void Engine::ShaderCache::prepareProgram(unsigned int program)
+{
+	if (enabled && supported)
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+void Engine::ShaderCache::storeProgram(const std::string & id, unsigned long long key, unsigned int program, double buildMs)
+{
+	stats.buildMs += buildMs;
+
+	if (!enabled || !supported)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	CacheEntry entry;
+	entry.key = key;
+	entry.buildMs = buildMs;
+	entry.binary.resize(length);
+
+	GLenum format;
+	glGetProgramBinary(program, length, NULL, &format, &entry.binary[0]);
+	entry.format = format;
+
+	entries[id] = entry;
+	dirty = true;
+}
+
+const Engine::ShaderCacheStats & Engine::ShaderCache::getStats() const
+{
+	return stats;
+}
+
+void Engine::ShaderCache::initializeCache()
+{
+	if (initialized)
+		return;
+
+	initialized = true;
+
+	driver = getGLString(GL_VENDOR) + "|" + getGLString(GL_RENDERER) + "|" + getGLString(GL_VERSION);
+
+	// Some drivers (Mesa's software rasterizer among them) might not expose any format
+	GLint numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	supported = numFormats > 0;
+
+	if (!supported)
+	{
+		std::cout << "ShaderCache: Driver exposes no program binary formats, programs will be compiled from source" << std::endl;
+		return;
+	}
+
+	if (enabled)
+	{
+		load();
+	}
+}
+
+void Engine::ShaderCache::load()
+{
+	std::ifstream file(cacheFile.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file)
+		return;
+
+	// Lengths are checked against it before allocating anything, a corrupted one could be huge
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	unsigned int magic, version, count;
+	if (!readValue(file, magic) || !readValue(file, version) || !readValue(file, count)
+		|| magic != CACHE_MAGIC || version != CACHE_VERSION)
+	{
+		std::cout << "ShaderCache: Ignoring incompatible cache file " << cacheFile << std::endl;
+		return;
+	}
+
+	std::map<std::string, CacheEntry> loaded;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int idLength, binaryLength;
+		CacheEntry entry;
+
+		if (!readValue(file, idLength) || std::streamoff(idLength) > remainingBytes(file, fileSize))
+			break;
+		std::string id(idLength, '\0');
+		if (idLength > 0)
+			file.read(&id[0], idLength);
+
+		if (!readValue(file, entry.key) || !readValue(file, entry.format)
+			|| !readValue(file, entry.buildMs) || !readValue(file, binaryLength) || binaryLength == 0
+			|| std::streamoff(binaryLength) > remainingBytes(file, fileSize))
+			break;
+
+		entry.binary.resize(binaryLength);
+		file.read((char *)&entry.binary[0], binaryLength);
+		if (!file.good())
+			break;
+
+		loaded[id] = entry;
+	}
+
+	// Entries from the first invalid one on are misses, and the file is rewritten on save()
+	if (loaded.size() != count)
+	{
+		std::cout << "ShaderCache: Corrupted cache file " << cacheFile << ", " << (count - loaded.size()) << " of "
+			<< count << " programs will be compiled from source" << std::endl;
+		dirty = true;
+	}
+
+	entries.swap(loaded);
+}
+
+void Engine::ShaderCache::save()
+{
+	if (!dirty)
+		return;
+
+	std::ofstream file(cacheFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ShaderCache: Could not write " << cacheFile << std::endl;
+		return;
+	}
+
+	writeValue(file, CACHE_MAGIC);
+	writeValue(file, CACHE_VERSION);
+	writeValue(file, (unsigned int)entries.size());
+
+	std::map<std::string, CacheEntry>::const_iterator it = entries.begin();
+	for (; it != entries.end(); it++)
+	{
+		const CacheEntry & entry = it->second;
+		writeValue(file, (unsigned int)it->first.size());
+		file.write(it->first.c_str(), it->first.size());
+		writeValue(file, entry.key);
+		writeValue(file, entry.format);
+		writeValue(file, entry.buildMs);
+		writeValue(file, (unsigned int)entry.binary.size());
+		file.write((const char *)&entry.binary[0], entry.binary.size());
+	}
+
+	dirty = false;
+}
+
+void Engine::ShaderCache::clean()
+{
+	save();
+
+	unsigned int total = stats.hits + stats.misses;
+	if (total > 0)
+	{
+		std::cout << "ShaderCache: " << stats.hits << "/" << total << " programs loaded from cache ("
+			<< (100.0 * stats.hits / total) << "% hit rate), "
+			<< stats.loadMs << " ms loading, " << stats.buildMs << " ms compiling, "
+			<< stats.savedMs << " ms of startup saved" << std::endl;
+	}
+
+	entries.clear();
+}
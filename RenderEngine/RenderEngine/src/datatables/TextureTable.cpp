@@ -4,6 +4,7 @@
 
 #include "textures/Texture2D.h"
 #include "textures/TextureCubemap.h"
+#include "GLStateCache.h"
 
 #include <FreeImage.h>
 #define _CRT_SECURE_DEPRECATE_MEMORY
@@ -189,8 +190,7 @@ void Engine::TextureTable::clean()
 	std::map<std::string, Engine::AbstractTexture *>::iterator it = textureTable.begin();
 	while (it != textureTable.end())
 	{
-		unsigned int id = it->second->getTextureId();
-		glDeleteTextures(1, &id);
+		Engine::GLStateCache::getInstance().deleteTexture(it->second->getTextureId());
 		it++;
 	}
 
@@ -2,6 +2,14 @@
 #include "datatables/MeshTable.h"
 
 #include "vegetation/FractalTree.h"
+#include "vegetation/RecursiveFractalTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
 
 Engine::VegetationTable * Engine::VegetationTable::INSTANCE = new Engine::VegetationTable();
 
@@ -19,6 +27,7 @@ Engine::Mesh * Engine::VegetationTable::generateFractalTree(const Engine::TreeGe
 {
 	Engine::FractalTree ft(data);
 	Engine::Mesh * tree = ft.generate();
+	generatedTrees.push_back(data);
 
 	if (addToMeshTable)
 	{
@@ -28,3 +37,176 @@ Engine::Mesh * Engine::VegetationTable::generateFractalTree(const Engine::TreeGe
 	return tree;
 }
 
+void Engine::VegetationTable::generateFractalTrees(const std::vector<Engine::TreeGenerationData> & data, std::vector<Engine::Mesh *> & result, bool addToMeshTable)
+{
+	buildFractalTrees(data, result);
+
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		generatedTrees.push_back(data[i]);
+
+		if (addToMeshTable)
+		{
+			Engine::MeshTable::getInstance().addMeshToCache(data[i].treeName, *result[i]);
+		}
+	}
+}
+
+Engine::TreeLODChain Engine::VegetationTable::generateFractalTree(const Engine::TreeGenerationData & data, unsigned int numLODs, bool addToMeshTable)
+{
+	std::vector<Engine::TreeLODChain> result;
+	generateFractalTreeLODs(std::vector<Engine::TreeGenerationData>(1, data), numLODs, result, NULL, addToMeshTable);
+	return result[0];
+}
+
+void Engine::VegetationTable::generateFractalTreeLODs(const std::vector<Engine::TreeGenerationData> & data, unsigned int numLODs, std::vector<Engine::TreeLODChain> & result, Engine::TreeImpostorAtlas * atlas, bool addToMeshTable)
+{
+	numLODs = numLODs < 1 ? 1 : numLODs;
+
+	// Every level of every tree is built at once
+	std::vector<Engine::TreeGenerationData> lodData;
+	lodData.reserve(data.size() * numLODs);
+	for (auto & treeData : data)
+	{
+		for (unsigned int lod = 0; lod < numLODs; lod++)
+		{
+			lodData.push_back(getLODGenerationData(treeData, lod));
+		}
+	}
+
+	std::vector<Engine::Mesh *> meshes;
+	buildFractalTrees(lodData, meshes);
+
+	result.clear();
+	result.resize(data.size());
+	std::vector<Engine::Mesh *> fullDetail;
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		// Only the full detail configuration is kept for the benchmark
+		generatedTrees.push_back(data[i]);
+
+		for (unsigned int lod = 0; lod < numLODs; lod++)
+		{
+			Engine::Mesh * tree = meshes[i * numLODs + lod];
+			result[i].meshes.push_back(tree);
+
+			if (addToMeshTable)
+			{
+				Engine::MeshTable::getInstance().addMeshToCache(lodData[i * numLODs + lod].treeName, *tree);
+			}
+		}
+
+		fullDetail.push_back(result[i].meshes[0]);
+	}
+
+	if (atlas != NULL)
+	{
+		atlas->bake(fullDetail);
+	}
+}
+
+Engine::TreeGenerationData Engine::VegetationTable::getLODGenerationData(const Engine::TreeGenerationData & data, unsigned int lod)
+{
+	Engine::TreeGenerationData result = data;
+	if (lod == 0)
+		return result;
+
+	// Keep at least the trunk
+	result.maxDepth = data.maxDepth > lod + 1 ? data.maxDepth - lod : 1;
+	// The leaves move up to the new last level, so the crown keeps its volume
+	result.depthStartingLeaf = std::min(data.depthStartingLeaf, result.maxDepth);
+	result.treeName = data.treeName + "_LOD" + std::to_string(lod);
+	return result;
+}
+
+void Engine::VegetationTable::buildFractalTrees(const std::vector<Engine::TreeGenerationData> & data, std::vector<Engine::Mesh *> & result)
+{
+	std::vector<std::unique_ptr<Engine::FractalTree>> generators;
+	generators.reserve(data.size());
+
+	// Queue every tree before waiting, so small trees do not leave the pool idle
+	Engine::Concurrent::CountDownLatch latch;
+	for (auto & treeData : data)
+	{
+		generators.push_back(std::unique_ptr<Engine::FractalTree>(new Engine::FractalTree(treeData)));
+		generators.back()->prepare();
+		generators.back()->buildChunksAsync(latch);
+	}
+	latch.wait();
+
+	result.clear();
+	for (auto & generator : generators)
+	{
+		result.push_back(generator->createMesh());
+	}
+}
+
+Engine::TreeGenerationBenchmark Engine::VegetationTable::benchmarkTreeGeneration(unsigned int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	Engine::TreeGenerationBenchmark result;
+	memset(&result, 0, sizeof(result));
+	result.trees = (unsigned int)generatedTrees.size() * iterations;
+	if (result.trees == 0)
+	{
+		return result;
+	}
+
+	// Original recursive generator
+	Clock::time_point start = Clock::now();
+	for (unsigned int it = 0; it < iterations; it++)
+	{
+		for (auto & treeData : generatedTrees)
+		{
+			Engine::RecursiveFractalTree ft(treeData);
+			Engine::RecursiveTreeArrays arrays;
+			result.recursivePeakBytes = std::max(result.recursivePeakBytes, ft.generateArrays(arrays));
+			result.recursiveVertices += arrays.numVertices;
+			Engine::RecursiveFractalTree::releaseArrays(arrays);
+		}
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	result.recursiveTreesPerSecond = double(result.trees) / seconds;
+
+	// Arena generator, single thread
+	start = Clock::now();
+	for (unsigned int it = 0; it < iterations; it++)
+	{
+		for (auto & treeData : generatedTrees)
+		{
+			Engine::FractalTree ft(treeData);
+			ft.prepare();
+			ft.buildChunks(0, ft.getNumChunks());
+			result.peakBytes = std::max(result.peakBytes, ft.getMemoryUsage());
+			result.vertices += ft.getNumVertices();
+		}
+	}
+	seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	result.serialTreesPerSecond = double(result.trees) / seconds;
+
+	// Arena generator, every tree of an iteration queued at once on the thread pool
+	start = Clock::now();
+	for (unsigned int it = 0; it < iterations; it++)
+	{
+		std::vector<std::unique_ptr<Engine::FractalTree>> generators;
+		Engine::Concurrent::CountDownLatch latch;
+		for (auto & treeData : generatedTrees)
+		{
+			generators.push_back(std::unique_ptr<Engine::FractalTree>(new Engine::FractalTree(treeData)));
+			generators.back()->prepare();
+			generators.back()->buildChunksAsync(latch);
+		}
+		latch.wait();
+	}
+	seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	result.parallelTreesPerSecond = double(result.trees) / seconds;
+
+	std::cout << "VegetationTable: Tree generation benchmark (" << result.trees << " trees)" << std::endl;
+	std::cout << "\tRecursive: " << result.recursiveTreesPerSecond << " trees/s, peak " << result.recursivePeakBytes / 1024 << " KB, "
+		<< result.recursiveVertices / result.trees << " vertices/tree" << std::endl;
+	std::cout << "\tArena: " << result.serialTreesPerSecond << " trees/s serial, " << result.parallelTreesPerSecond << " trees/s parallel, peak "
+		<< result.peakBytes / 1024 << " KB, " << result.vertices / result.trees << " vertices/tree" << std::endl;
+
+	return result;
+}
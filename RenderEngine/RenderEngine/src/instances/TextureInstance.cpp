@@ -1,6 +1,7 @@
 #include "instances/TextureInstance.h"
 
 #include "datatables/TextureTable.h"
+#include "GLStateCache.h"
 
 Engine::TextureInstance::TextureInstance(Engine::AbstractTexture * texture)
 	:texture(texture)
@@ -103,7 +104,7 @@ void Engine::TextureInstance::resize(unsigned int w, unsigned int h)
 void Engine::TextureInstance::configureTexture() const
 {
 	GLenum type = texture->getTextureType();
-	glBindTexture(type, texture->getTextureId());
+	Engine::GLStateCache::getInstance().bindTexture(type, texture->getTextureId());
 	glTexParameteri(type, GL_TEXTURE_MIN_FILTER, minificationFilter);
 	glTexParameteri(type, GL_TEXTURE_MAG_FILTER, magnificationFilter);
 	glTexParameteri(type, GL_TEXTURE_WRAP_T, tComponentWrapType);
@@ -119,6 +120,6 @@ void Engine::TextureInstance::configureTexture() const
 
 void Engine::TextureInstance::generateMipMaps()
 {
-	glBindTexture(texture->getTextureType(), texture->getTextureId());
+	Engine::GLStateCache::getInstance().bindTexture(texture->getTextureType(), texture->getTextureId());
 	glGenerateMipmap(texture->getTextureType());
 }
\ No newline at end of file
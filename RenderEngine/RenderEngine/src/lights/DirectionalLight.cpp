@@ -5,6 +5,7 @@
 
 #include "WorldConfig.h"
 
+#include <cstring>
 #include <iostream>
 
 Engine::DirectionalLight::DirectionalLight(std::string name)
@@ -34,6 +35,7 @@ void Engine::DirectionalLight::translate(const glm::vec3 & translation)
 	modelMatrix[3][3] = 0;
 
 	direction = glm::normalize(glm::vec3(modelMatrix[3][0], modelMatrix[3][1], modelMatrix[3][2]));
+	dirtyFlags |= LIGHT_DIRTY_TRANSFORM;
 }
 
 void Engine::DirectionalLight::setDirection(const glm::vec3 & direction)
@@ -44,25 +46,25 @@ void Engine::DirectionalLight::setDirection(const glm::vec3 & direction)
 void Engine::DirectionalLight::setColor(const glm::vec3 & color)
 {
 	memcpy(shaderData.color, &color[0], sizeof(float) * 3);
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::DirectionalLight::setKa(float a)
 {
 	shaderData.kFactors[0] = a;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::DirectionalLight::setKd(float d)
 {
 	shaderData.kFactors[1] = d;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::DirectionalLight::setKs(float s)
 {
 	shaderData.kFactors[2] = s;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 Engine::DirectionalLightData & Engine::DirectionalLight::getData()
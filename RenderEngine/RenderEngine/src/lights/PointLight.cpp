@@ -3,6 +3,8 @@
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <cstring>
+
 Engine::PointLight::PointLight(std::string name)
 	:Engine::Light(name)
 {
@@ -16,6 +18,7 @@ Engine::PointLight::~PointLight()
 void Engine::PointLight::translate(const glm::vec3 & translation)
 {
 	modelMatrix = glm::translate(glm::mat4(1.0f), translation);
+	dirtyFlags |= LIGHT_DIRTY_TRANSFORM;
 }
 
 void Engine::PointLight::setPosition(const glm::vec3 & pos)
@@ -26,31 +29,31 @@ void Engine::PointLight::setPosition(const glm::vec3 & pos)
 void Engine::PointLight::setAttenuation(const glm::vec3 & att)
 {
 	memcpy(&shaderData.attenuation[0], &att[0], sizeof(float) * 3);
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::PointLight::setColor(const  glm::vec3 & color)
 {
 	memcpy(shaderData.color, &color[0], sizeof(float) * 3);
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::PointLight::setKa(float a)
 {
 	shaderData.kFactors[0] = a;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::PointLight::setKd(float d)
 {
 	shaderData.kFactors[1] = d;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::PointLight::setKs(float s)
 {
 	shaderData.kFactors[2] = s;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 Engine::PointLightData & Engine::PointLight::getData()
@@ -3,6 +3,8 @@
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <cstring>
+
 Engine::SpotLight::SpotLight(std::string name)
 	:Engine::Light(name)
 {
@@ -21,6 +23,7 @@ void Engine::SpotLight::translate(const glm::vec3 & translation)
 {
 	modelMatrix = glm::mat4(1.0f);
 	modelMatrix = glm::translate(modelMatrix, translation);
+	dirtyFlags |= LIGHT_DIRTY_TRANSFORM;
 }
 
 void Engine::SpotLight::directTo(const glm::vec3 & dir)
@@ -28,6 +31,7 @@ void Engine::SpotLight::directTo(const glm::vec3 & dir)
 	dirMatrix = glm::mat4(1.0f);
 	dirMatrix = glm::translate(dirMatrix, dir);
 	dirMatrix[3][3] = 0.0f;
+	dirtyFlags |= LIGHT_DIRTY_TRANSFORM;
 }
 
 void Engine::SpotLight::setPosition(const glm::vec3 & pos)
@@ -43,43 +47,43 @@ void Engine::SpotLight::setDirection(const glm::vec3 & dir)
 void Engine::SpotLight::setAttenuation(const glm::vec3 & attenuation)
 {
 	memcpy(&shaderData.attenuation[0], &attenuation[0], sizeof(float) * 3);
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::SpotLight::setApperture(float app)
 {
 	shaderData.direction[3] = app;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::SpotLight::setM(float m)
 {
 	shaderData.position[3] = m;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::SpotLight::setColor(const glm::vec3 & color)
 {
 	memcpy(shaderData.color, &color[0], sizeof(float) * 3);
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::SpotLight::setKa(float a)
 {
 	shaderData.kFactors[0] = a;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::SpotLight::setKd(float d)
 {
 	shaderData.kFactors[1] = d;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 void Engine::SpotLight::setKs(float s)
 {
 	shaderData.kFactors[2] = s;
-	update = true;
+	dirtyFlags |= LIGHT_DIRTY_PROPERTIES;
 }
 
 Engine::SpotLightData & Engine::SpotLight::getData()
@@ -3,19 +3,26 @@
 * @email nadir.ro.gue@gmail.com
 */
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 #include "windowmanagers/GLUTWindow.h"
 #include "windowmanagers/GLFWWindow.h"
+#include "windowmanagers/HeadlessWindow.h"
 #include "windowmanagers/WindowManager.h"
 
 #include "userinterfaces/WorldControllerUI.h"
 
 #define SOLVE_FGLUT_WARNING
-#include <gl/freeglut.h> 
+#include <GL/freeglut.h> 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <random>
 
 #include "Scene.h"
 #include "Renderer.h"
@@ -25,10 +32,13 @@
 
 #include "StorageTable.h"
 #include "datatables/ProgramTable.h"
+#include "datatables/ShaderCache.h"
 #include "datatables/MeshTable.h"
 #include "datatables/TextureTable.h"
 #include "datatables/DeferredObjectsTable.h"
 #include "LightBufferManager.h"
+#include "FrameGlobalsBuffer.h"
+#include "ClusteredLightBuffer.h"
 
 #include "defaultobjects/Cube.h"
 #include "defaultobjects/Plane.h"
@@ -37,6 +47,7 @@
 #include "programs/ProceduralTerrainProgram.h"
 #include "programs/ProceduralWaterProgram.h"
 #include "programs/TreeProgram.h"
+#include "programs/TreeImpostorProgram.h"
 #include "programs/SkyProgram.h"
 #include "programs/CloudShadowProgram.h"
 #include "postprocessprograms/DeferredShadingProgram.h"
@@ -49,6 +60,8 @@
 #include "postprocessprograms/HDRToneMappingProgram.h"
 #include "postprocessprograms/SSGodRayProgram.h"
 #include "postprocessprograms/DepthOfFieldProgram.h"
+#include "postprocessprograms/BilateralUpsampleProgram.h"
+#include "computeprograms/TerrainHeightProgram.h"
 
 #include "inputhandlers/keyboardhandlers/CameraMovementHandler.h"
 #include "inputhandlers/keyboardhandlers/ToggleUIHandler.h"
@@ -61,14 +74,48 @@
 
 #include "CascadeShadowMaps.h"
 
-#include "WorldConfig.h"
+#include "lights/PointLight.h"
+#include "lights/SpotLight.h"
 
+#include "WorldConfig.h"
+#include "TerrainHeightField.h"
+#include "TileCuller.h"
+#include "MeshOptimizer.h"
+#include "LightClusterBuilder.h"
+#include "volumetricclouds/CloudNoiseBaker.h"
+
+// Command line options
+typedef struct LaunchOptions
+{
+	unsigned int width;
+	unsigned int height;
+	// Scripted benchmark without window (see HeadlessWindow)
+	bool headless;
+	unsigned int frames;
+	float timeStep;
+	unsigned int travelMethod;
+	std::string csvFile;
+	std::string pngFolder;
+	unsigned int pngInterval;
+	// Random point and spot lights added to the scene (see addRandomLights())
+	unsigned int lights;
+	// Runs the CPU side validations and exits (see runValidations()). With headless,
+	// the GPU ones too (see runGPUValidations())
+	bool validate;
+} LaunchOptions;
+
+LaunchOptions options;
+
+bool parseArguments(int argc, char ** argv);
 void initOpenGL();
 void initScene();
 void initTables();
 void initSceneObj();
 void initHandlers();
 void initRenderEngine();
+void addRandomLights(unsigned int count);
+bool runValidations();
+bool runGPUValidations();
 void destroy();
 
 // Initialize various post process nodes to be added to the scene renderer (see end of file)
@@ -83,7 +130,31 @@ Engine::PostProcessChainNode * createDOFNode();
 
 int main(int argc, char** argv)
 {
-	std::locale::global(std::locale("spanish")); // acentos ;)
+	try
+	{
+		std::locale::global(std::locale("spanish")); // acentos ;)
+	}
+	catch (const std::runtime_error &)
+	{
+		// Locale not available on this system (its name is platform dependent)
+	}
+
+	if (!parseArguments(argc, argv))
+	{
+		return -1;
+	}
+
+	// CPU validations do not need any OpenGL context, the GPU ones only get one without a window
+	if (options.validate)
+	{
+		bool passed = runValidations();
+		if (options.headless)
+		{
+			initOpenGL();
+			passed = runGPUValidations() && passed;
+		}
+		return passed ? 0 : 1;
+	}
 
 	// Initialize OpenGL and window system
 	initOpenGL();
@@ -104,7 +175,12 @@ int main(int argc, char** argv)
 	// Clean up
 	destroy();
 
-	system("pause");
+#ifdef _WIN32
+	if (!options.headless)
+	{
+		system("pause");
+	}
+#endif
 
 	return 0;
 }
@@ -112,11 +188,180 @@ int main(int argc, char** argv)
 // ======================================================================
 // ======================================================================
 
+// Reads the command line options:
+// --validate [--headless]
+// --headless --frames N --timestep S --travel manual|bezier|straight --csv file --png folder --png-interval N
+// --width W --height H --postprocess separate|fused --postprocess-quality low|medium|high
+// --lights N --light-clusters cpu|gpu --shadow-cascades N --shadow-cache on|off --terrain-batch on|off
+bool parseArguments(int argc, char ** argv)
+{
+	options.width = options.height = 1024;
+	options.headless = false;
+	options.frames = 600;
+	options.timeStep = 1.0f / 60.0f;
+	options.travelMethod = Engine::TravelMethod::TRAVEL_BEZIER;
+	options.csvFile = Engine::Window::HeadlessWindow::DEFAULT_CSV_FILE;
+	options.pngInterval = 1;
+	options.lights = 0;
+	options.validate = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		// Options without value
+		if (arg == "--headless")
+		{
+			options.headless = true;
+			continue;
+		}
+		if (arg == "--validate")
+		{
+			options.validate = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return false;
+		}
+
+		std::string value = argv[++i];
+		if (arg == "--width")
+			options.width = (unsigned int)atoi(value.c_str());
+		else if (arg == "--height")
+			options.height = (unsigned int)atoi(value.c_str());
+		else if (arg == "--frames")
+			options.frames = (unsigned int)atoi(value.c_str());
+		else if (arg == "--timestep")
+			options.timeStep = float(atof(value.c_str()));
+		else if (arg == "--csv")
+			options.csvFile = value;
+		else if (arg == "--png")
+			options.pngFolder = value;
+		else if (arg == "--png-interval")
+			options.pngInterval = (unsigned int)atoi(value.c_str());
+		else if (arg == "--lights")
+			options.lights = (unsigned int)atoi(value.c_str());
+		else if (arg == "--shadow-cascades")
+			Engine::Settings::shadowCascades = (unsigned int)atoi(value.c_str());
+		else if (arg == "--shadow-cache")
+		{
+			if (value == "on")
+				Engine::Settings::shadowCache = true;
+			else if (value == "off")
+				Engine::Settings::shadowCache = false;
+			else
+			{
+				std::cerr << "Unknown shadow cache mode " << value << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--terrain-batch")
+		{
+			if (value == "on")
+				Engine::Settings::batchedTerrain = true;
+			else if (value == "off")
+				Engine::Settings::batchedTerrain = false;
+			else
+			{
+				std::cerr << "Unknown terrain batch mode " << value << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--light-clusters")
+		{
+			if (value == "cpu")
+				Engine::Settings::lightClusterBuilder = Engine::LightClusterBuilderType::LIGHT_CLUSTERS_CPU;
+			else if (value == "gpu")
+				Engine::Settings::lightClusterBuilder = Engine::LightClusterBuilderType::LIGHT_CLUSTERS_GPU;
+			else
+			{
+				std::cerr << "Unknown light cluster builder " << value << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--postprocess")
+		{
+			if (value == "separate")
+				Engine::Settings::fusedPostProcess = false;
+			else if (value == "fused")
+				Engine::Settings::fusedPostProcess = true;
+			else
+			{
+				std::cerr << "Unknown post process path " << value << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--postprocess-quality")
+		{
+			if (value == "low")
+				Engine::Settings::postProcessQuality = Engine::PostProcessQuality::POSTPROCESS_QUALITY_LOW;
+			else if (value == "medium")
+				Engine::Settings::postProcessQuality = Engine::PostProcessQuality::POSTPROCESS_QUALITY_MEDIUM;
+			else if (value == "high")
+				Engine::Settings::postProcessQuality = Engine::PostProcessQuality::POSTPROCESS_QUALITY_HIGH;
+			else
+			{
+				std::cerr << "Unknown post process quality " << value << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--travel")
+		{
+			if (value == "manual")
+				options.travelMethod = Engine::TravelMethod::TRAVEL_MANUAL;
+			else if (value == "bezier")
+				options.travelMethod = Engine::TravelMethod::TRAVEL_BEZIER;
+			else if (value == "straight")
+				options.travelMethod = Engine::TravelMethod::TRAVEL_STRAIGHT;
+			else
+			{
+				std::cerr << "Unknown travel method " << value << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+
+	if (options.width == 0 || options.height == 0 || options.timeStep <= 0.0f)
+	{
+		std::cerr << "Invalid screen size or time step" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
 // Initializes OpenGL and the window system
 void initOpenGL()
 {
-	std::unique_ptr<Engine::Window::GLFWWindow> win = std::make_unique<Engine::Window::GLFWWindow>("No Man's Planet", 0, 30, 1024, 1024);
-	win->setOGLVersion(4, 1);
+	if (options.headless)
+	{
+		std::unique_ptr<Engine::Window::HeadlessWindow> win = std::make_unique<Engine::Window::HeadlessWindow>("No Man's Planet", options.width, options.height);
+		// Same version as the windowed mode, EGL creates exactly the one requested
+		win->setOGLVersion(4, 3);
+		win->setContextProfile(GLFW_OPENGL_CORE_PROFILE);
+		win->setFrameCount(options.frames);
+		win->setTimeStep(options.timeStep);
+		win->setTravelMethod(options.travelMethod);
+		win->setCSVFile(options.csvFile);
+		if (!options.pngFolder.empty())
+		{
+			win->setPNGOutput(options.pngFolder, options.pngInterval);
+		}
+
+		Engine::Window::WindowManager::getInstance().setToolkit(std::move(win));
+		return;
+	}
+
+	std::unique_ptr<Engine::Window::GLFWWindow> win = std::make_unique<Engine::Window::GLFWWindow>("No Man's Planet", 0, 30, options.width, options.height);
+	// Compute shaders and shader storage buffers are core since 4.3
+	win->setOGLVersion(4, 3);
 	win->setContextProfile(GLFW_OPENGL_CORE_PROFILE);
 
 	Engine::Window::WindowManager::getInstance().setToolkit(std::move(win));
@@ -142,7 +387,10 @@ void initTables()
 	Engine::TableManager::getInstance().registerTable(&Engine::MeshTable::getInstance());
 	Engine::TableManager::getInstance().registerTable(&Engine::TextureTable::getInstance());
 	Engine::TableManager::getInstance().registerTable(&Engine::ProgramTable::getInstance());
+	Engine::TableManager::getInstance().registerTable(&Engine::ShaderCache::getInstance());
 	Engine::TableManager::getInstance().registerTable(&Engine::GPU::LightBufferManager::getInstance());
+	Engine::TableManager::getInstance().registerTable(&Engine::GPU::FrameGlobalsBuffer::getInstance());
+	Engine::TableManager::getInstance().registerTable(&Engine::GPU::ClusteredLightBuffer::getInstance());
 	Engine::TableManager::getInstance().registerTable(&Engine::DeferredObjectsTable::getInstance());
 
 	// Texture table
@@ -157,6 +405,7 @@ void initTables()
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::SkyProgram::PROGRAM_NAME, new Engine::SkyProgramFactory());
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::BloomProgram::PROGRAM_NAME, new Engine::BloomProgramFactory());
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::TreeProgram::PROGRAM_NAME, new Engine::TreeProgramFactory());
+	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::TreeImpostorProgram::PROGRAM_NAME, new Engine::TreeImpostorProgramFactory());
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::SSReflectionProgram::PROGRAM_NAME, new Engine::SSReflectionProgramFactory());
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::SSGrassProgram::PROGRAM_NAME, new Engine::SSGrassProgramFactory());
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::VolumetricCloudProgram::PROGRAM_NAME, new Engine::VolumetricCloudProgramFactory());
@@ -165,6 +414,7 @@ void initTables()
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::SSGodRayProgram::PROGRAM_NAME, new Engine::SSGodRayProgramFactory());
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::DepthOfFieldProgram::PROGRAM_NAME, new Engine::DepthOfFieldProgramFactory());
 	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::CloudShadowProgram::PROGRAM_NAME, new Engine::CloudShadowProgramFactory());
+	Engine::ProgramTable::getInstance().registerProgramFactory(Engine::BilateralUpsampleProgram::PROGRAM_NAME, new Engine::BilateralUpsampleProgramFactory());
 	
 	// Mesh table
 	Engine::MeshTable::getInstance().addMeshToCache("cube", Engine::CreateCube());
@@ -187,6 +437,9 @@ void initSceneObj()
 	dl->setDirection(Engine::Settings::lightDirection);
 	scene->setDirectionalLight(dl);
 
+	// Add point and spot lights (clustered lighting benchmark)
+	addRandomLights(options.lights);
+
 	// Set a terrain
 	scene->setTerrain(new Engine::Terrain(Engine::Settings::worldTileScale, Engine::Settings::worldRenderRadius));
 	// Set a skybox
@@ -198,7 +451,49 @@ void initSceneObj()
 	scene->initialize();
 
 	// Trigger FBO resize according to screen size
-	Engine::RenderManager::getInstance().doResize(1024, 1024);
+	scene->onViewportResize(options.width, options.height);
+	Engine::RenderManager::getInstance().doResize(options.width, options.height);
+}
+
+// Scatters point lights, and a spot light every 4 lights, around the start of the camera path
+void addRandomLights(unsigned int count)
+{
+	Engine::Scene * scene = Engine::SceneManager::getInstance().getActiveScene();
+
+	std::mt19937 generator(Engine::Settings::worldSeed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm::vec3 position((unit(generator) * 2.0f - 1.0f) * 250.0f, unit(generator) * 20.0f, (unit(generator) * 2.0f - 1.0f) * 250.0f);
+		glm::vec3 color(0.2f + unit(generator) * 0.8f, 0.2f + unit(generator) * 0.8f, 0.2f + unit(generator) * 0.8f);
+
+		if (i % 4 == 3)
+		{
+			Engine::SpotLight * sl = new Engine::SpotLight("spot_light_" + std::to_string(i));
+			sl->setPosition(position);
+			sl->setDirection(glm::normalize(glm::vec3(unit(generator) - 0.5f, -1.0f, unit(generator) - 0.5f)));
+			sl->setApperture(0.5f);
+			sl->setM(8.0f);
+			sl->setColor(color);
+			sl->setAttenuation(glm::vec3(1.0f, 0.0f, 0.5f));
+			sl->setKa(0.0f);
+			sl->setKd(1.0f);
+			sl->setKs(0.5f);
+			scene->addSpotLight(sl);
+		}
+		else
+		{
+			Engine::PointLight * pl = new Engine::PointLight("point_light_" + std::to_string(i));
+			pl->setPosition(position);
+			pl->setColor(color);
+			pl->setAttenuation(glm::vec3(1.0f, 0.0f, 0.5f));
+			pl->setKa(0.0f);
+			pl->setKd(1.0f);
+			pl->setKs(0.5f);
+			scene->addPointLight(pl);
+		}
+	}
 }
 
 // Initialize user input and animation handlers (updated once per frame)
@@ -238,7 +533,60 @@ void initRenderEngine()
 	dr->addPostProcess(createDOFNode());			// Depth of field
 
 	Engine::RenderManager::getInstance().setRenderer(dr);
-	Engine::RenderManager::getInstance().doResize(1024, 1024);
+	Engine::RenderManager::getInstance().doResize(options.width, options.height);
+}
+
+// Checks the CPU implementations against their reference versions. Returns true if all of them pass
+bool runValidations()
+{
+	bool passed = true;
+
+	Engine::TerrainHeightField heightField;
+	Engine::TerrainHeightValidation heights = heightField.validate(10000);
+	passed = passed && heights.failures == 0 && heights.batchMismatches == 0;
+
+	Engine::TileCullingValidation culling = Engine::TileCuller::validate(Engine::Settings::worldTileScale, Engine::Settings::worldRenderRadius);
+	passed = passed && culling.falseNegatives == 0 && culling.falsePositives == 0 && culling.batchMismatches == 0
+		&& culling.boundViolations == 0;
+
+	// The default grid does not fit in the simulated cache, so both orders must improve
+	Engine::MeshOptimizerValidation meshes = Engine::MeshOptimizer::validate();
+	passed = passed && meshes.shuffledOptimized.acmr < meshes.shuffledInput.acmr && meshes.orderedOptimized.acmr < meshes.orderedInput.acmr
+		&& meshes.triangleMismatches == 0;
+
+	Engine::LightClusterValidation lightClusters = Engine::LightClusterBuilder::validateRandomLights(1000);
+	passed = passed && lightClusters.mismatches == 0;
+
+	// Baked noise against the formulas of the generation compute shaders
+	Engine::CloudSystem::CloudNoiseBaker cloudNoise;
+	cloudNoise.bake();
+	Engine::CloudSystem::CloudNoiseValidation cloudNoiseResult = cloudNoise.validate(1000);
+	passed = passed && cloudNoiseResult.samples > 0 && cloudNoiseResult.failures == 0;
+
+	std::cout << (passed ? "Validation passed" : "Validation FAILED") << std::endl;
+	return passed;
+}
+
+// Checks the shaders against the CPU implementations. Needs the OpenGL context. Returns true if all of them pass
+bool runGPUValidations()
+{
+	bool passed = true;
+
+	// Heights read back from the noise functions of every shader which places geometry on the terrain
+	Engine::TerrainHeightField heightField;
+	const char * heightShaders[] = { "shaders/terrain/terrain.teseval", "shaders/vegetation/tree/tree.geom",
+		"shaders/vegetation/tree/treeimpostor.geom" };
+	for (const char * shader : heightShaders)
+	{
+		Engine::TerrainHeightProgram heightProgram(shader);
+		heightProgram.initialize();
+		Engine::TerrainHeightValidation heights = heightProgram.validate(heightField, 10000);
+		heightProgram.destroy();
+		passed = passed && heights.failures == 0;
+	}
+
+	std::cout << (passed ? "GPU validation passed" : "GPU validation FAILED") << std::endl;
+	return passed;
 }
 
 // Clean up cache (both CPU and GPU)
@@ -249,18 +597,23 @@ void destroy()
 
 // ==========================================================================
 
-// Creates a screen-space anti aliasing post process
-Engine::PostProcessChainNode * createSSAANode()
+// Creates a post process node drawn over a screen plane into a single render target.
+// The scales are the resolution relative to the screen for each quality preset
+Engine::PostProcessChainNode * makeFullscreenNode(Engine::Program * program, GLenum format,
+	float lowScale, float mediumScale, float highScale)
 {
 	Engine::PostProcessChainNode * node = new Engine::PostProcessChainNode;
 
 	// Shader
-	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::SSAAProgram>();
+	node->postProcessProgram = program;
+
+	// Resolution per quality preset (low, medium, high)
+	node->resolutionScale[Engine::PostProcessQuality::POSTPROCESS_QUALITY_LOW] = lowScale;
+	node->resolutionScale[Engine::PostProcessQuality::POSTPROCESS_QUALITY_MEDIUM] = mediumScale;
+	node->resolutionScale[Engine::PostProcessQuality::POSTPROCESS_QUALITY_HIGH] = highScale;
 
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(2, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
+	// Render targets
+	node->outputs.push_back({ format, GL_RGBA, GL_FLOAT, GL_LINEAR, 1.0f, 1.0f });
 	node->callBack = 0;
 
 	// Render plane
@@ -274,154 +627,44 @@ Engine::PostProcessChainNode * createSSAANode()
 	return node;
 }
 
+// Creates a screen-space anti aliasing post process
+Engine::PostProcessChainNode * createSSAANode()
+{
+	return makeFullscreenNode(Engine::ProgramTable::getInstance().getProgram<Engine::SSAAProgram>(), GL_RGBA8, 1.0f, 1.0f, 1.0f);
+}
+
 // Creates a bloom post process
 Engine::PostProcessChainNode * createBloomNode()
 {
-	Engine::PostProcessChainNode * node = new Engine::PostProcessChainNode;
-	
-	// Shader
-	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::BloomProgram>();
-
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(2, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addColorBuffer(1, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
-	node->callBack = 0;
-
-	// Render plane
-	Engine::Mesh * mi = Engine::MeshTable::getInstance().getMesh("plane");
-	if (mi != 0)
-	{
-		node->postProcessProgram->configureMeshBuffers(mi);
-		node->obj = new Engine::PostProcessObject(mi);
-	}
-
-	return node;
+	return makeFullscreenNode(Engine::ProgramTable::getInstance().getProgram<Engine::BloomProgram>(), GL_RGBA16F, 0.5f, 0.5f, 1.0f);
 }
 
 // Creates a screen-space reflection post process
 Engine::PostProcessChainNode * createSSReflectionNode()
 {
-	Engine::PostProcessChainNode * node = new Engine::PostProcessChainNode;
-
-	// Shader
-	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::SSReflectionProgram>();
-
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(1, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
-	node->callBack = 0;
-
-	// Render plane
-	Engine::Mesh * mi = Engine::MeshTable::getInstance().getMesh("plane");
-	if (mi != 0)
-	{
-		node->postProcessProgram->configureMeshBuffers(mi);
-		node->obj = new Engine::PostProcessObject(mi);
-	}
-
-	return node;
+	return makeFullscreenNode(Engine::ProgramTable::getInstance().getProgram<Engine::SSReflectionProgram>(), GL_RGBA16F, 0.5f, 1.0f, 1.0f);
 }
 
 // Creates a screen-space grass post process
 Engine::PostProcessChainNode * createSSGrassNode()
 {
-	Engine::PostProcessChainNode * node = new Engine::PostProcessChainNode;
-
-	// Shader
-	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::SSGrassProgram>();
-
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(2, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addColorBuffer(1, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
-	node->callBack = 0;
-
-	// Render plane
-	Engine::Mesh * mi = Engine::MeshTable::getInstance().getMesh("plane");
-	if (mi != 0)
-	{
-		node->postProcessProgram->configureMeshBuffers(mi);
-		node->obj = new Engine::PostProcessObject(mi);
-	}
-
-	return node;
+	return makeFullscreenNode(Engine::ProgramTable::getInstance().getProgram<Engine::SSGrassProgram>(), GL_RGBA16F, 0.5f, 1.0f, 1.0f);
 }
 
 // Creates a hdr tone mapping post process
 Engine::PostProcessChainNode * createHDRNode()
 {
-	Engine::PostProcessChainNode * node = new Engine::PostProcessChainNode;
-
-	// Shader
-	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::HDRToneMappingProgram>();
-
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(1, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
-	node->callBack = 0;
-
-	// Render plane
-	Engine::Mesh * mi = Engine::MeshTable::getInstance().getMesh("plane");
-	if (mi != 0)
-	{
-		node->postProcessProgram->configureMeshBuffers(mi);
-		node->obj = new Engine::PostProcessObject(mi);
-	}
-
-	return node;
+	return makeFullscreenNode(Engine::ProgramTable::getInstance().getProgram<Engine::HDRToneMappingProgram>(), GL_RGBA8, 1.0f, 1.0f, 1.0f);
 }
 
 // Creates a screen-space light scatting post process
 Engine::PostProcessChainNode * createSSGodRayNode()
 {
-	Engine::PostProcessChainNode * node = new Engine::PostProcessChainNode;
-
-	// Shader
-	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::SSGodRayProgram>();
-
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(1, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
-	node->callBack = 0;
-
-	// Render plane
-	Engine::Mesh * mi = Engine::MeshTable::getInstance().getMesh("plane");
-	if (mi != 0)
-	{
-		node->postProcessProgram->configureMeshBuffers(mi);
-		node->obj = new Engine::PostProcessObject(mi);
-	}
-
-	return node;
+	return makeFullscreenNode(Engine::ProgramTable::getInstance().getProgram<Engine::SSGodRayProgram>(), GL_RGBA16F, 0.5f, 0.5f, 1.0f);
 }
 
 // Creates a Depth of Field post process node
 Engine::PostProcessChainNode * createDOFNode()
 {
-	Engine::PostProcessChainNode * node = new Engine::PostProcessChainNode;
-
-	// Shader
-	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::DepthOfFieldProgram>();
-
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(1, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
-	node->callBack = 0;
-
-	// Render plane
-	Engine::Mesh * mi = Engine::MeshTable::getInstance().getMesh("plane");
-	if (mi != 0)
-	{
-		node->postProcessProgram->configureMeshBuffers(mi);
-		node->obj = new Engine::PostProcessObject(mi);
-	}
-
-	return node;
-}
\ No newline at end of file
+	return makeFullscreenNode(Engine::ProgramTable::getInstance().getProgram<Engine::DepthOfFieldProgram>(), GL_RGBA8, 1.0f, 1.0f, 1.0f);
+}
@@ -0,0 +1,51 @@
+#include "postprocessprograms/BilateralUpsampleProgram.h"
+
+#include "renderers/DeferredRenderer.h"
+#include "GLStateCache.h"
+
+const std::string Engine::BilateralUpsampleProgram::PROGRAM_NAME = "BilateralUpsampleProgram";
+
+Engine::BilateralUpsampleProgram::BilateralUpsampleProgram(std::string name, unsigned long long params)
+	:Engine::PostProcessProgram(name, params)
+{
+	fShaderFile = "shaders/postprocess/BilateralUpsample.frag";
+}
+
+Engine::BilateralUpsampleProgram::BilateralUpsampleProgram(const Engine::BilateralUpsampleProgram & other)
+	: Engine::PostProcessProgram(other)
+{
+	uDepthBuffer = other.uDepthBuffer;
+	uInvProj = other.uInvProj;
+}
+
+void Engine::BilateralUpsampleProgram::configureProgram()
+{
+	Engine::PostProcessProgram::configureProgram();
+
+	uDepthBuffer = glGetUniformLocation(glProgram, "depthBuffer");
+	uInvProj = glGetUniformLocation(glProgram, "invProj");
+}
+
+void Engine::BilateralUpsampleProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
+{
+	Engine::PostProcessProgram::onRenderObject(obj, camera);
+
+	Engine::DeferredRenderer * dr = static_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
+
+	// Units 0 and 1 hold the inputs
+	glUniform1i(uDepthBuffer, 2);
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, dr->getGBufferDepth()->getTexture()->getTextureId());
+
+	glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
+	glUniformMatrix4fv(uInvProj, 1, GL_FALSE, &invProj[0][0]);
+}
+
+// ======================================================================================
+
+Engine::Program * Engine::BilateralUpsampleProgramFactory::createProgram(unsigned long long params)
+{
+	Engine::BilateralUpsampleProgram * p = new Engine::BilateralUpsampleProgram(Engine::BilateralUpsampleProgram::PROGRAM_NAME, params);
+	p->initialize();
+	return p;
+}
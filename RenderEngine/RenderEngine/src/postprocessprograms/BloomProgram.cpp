@@ -1,5 +1,7 @@
 #include "postprocessprograms/BloomProgram.h"
 
+#include "GLStateCache.h"
+
 const std::string Engine::BloomProgram::PROGRAM_NAME = "BloomProgram";
 
 Engine::BloomProgram::BloomProgram(std::string name, unsigned long long parameters)
@@ -10,13 +12,11 @@ Engine::BloomProgram::BloomProgram(std::string name, unsigned long long paramete
 	buf[0].pass = new Engine::DeferredRenderObject(2, false);
 	buf[0].color = buf[0].pass->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
 	buf[0].emissive = buf[0].pass->addColorBuffer(1, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	buf[0].pass->addDepthBuffer24(500, 500);
 	buf[0].pass->initialize();
 
 	buf[1].pass = new Engine::DeferredRenderObject(2, false);
 	buf[1].color = buf[1].pass->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
 	buf[1].emissive = buf[1].pass->addColorBuffer(1, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	buf[1].pass->addDepthBuffer24(500, 500);
 	buf[1].pass->initialize();
 
 	passes = 8;
@@ -41,8 +41,18 @@ void Engine::BloomProgram::onRenderObject(const Engine::Object * obj, Engine::Ca
 {
 	Engine::SSAAProgram::onRenderObject(obj, camera);
 
-	int prevFBO;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFBO);
+	unsigned int prevFBO = Engine::GLStateCache::getInstance().getDrawFramebuffer();
+
+	// The blur buffers follow the resolution the node is rendered at (see RenderGraph::setPassScale())
+	GLint viewport[4];
+	Engine::GLStateCache::getInstance().getViewport(viewport);
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		if (buf[i].pass->getWidth() != (unsigned int)viewport[2] || buf[i].pass->getHeight() != (unsigned int)viewport[3])
+		{
+			buf[i].pass->resizeFBO((unsigned int)viewport[2], (unsigned int)viewport[3]);
+		}
+	}
 
 	int bufferIndex;
 	for (unsigned int i = 0; i < passes - 1; i++)
@@ -51,7 +61,7 @@ void Engine::BloomProgram::onRenderObject(const Engine::Object * obj, Engine::Ca
 		SwitchableBuffers & sb = buf[bufferIndex];
 
 		// Bind current pass buffer
-		glBindFramebuffer(GL_FRAMEBUFFER, sb.pass->getFrameBufferId());
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, sb.pass->getFrameBufferId());
 
 		glUniform1i(uHorizontal, bufferIndex);
 		glUniform1i(uBlend, 0);
@@ -61,17 +71,17 @@ void Engine::BloomProgram::onRenderObject(const Engine::Object * obj, Engine::Ca
 
 		// Attach output for next pass
 		glUniform1i(uRenderedTextures[0], 0);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, sb.color->getTexture()->getTextureId());
+		Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0);
+		Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, sb.color->getTexture()->getTextureId());
 
 		glUniform1i(uRenderedTextures[1], 1);
-		glActiveTexture(GL_TEXTURE0 + 1);
-		glBindTexture(GL_TEXTURE_2D, sb.emissive->getTexture()->getTextureId());
+		Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0 + 1);
+		Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, sb.emissive->getTexture()->getTextureId());
 	}
 
 	glUniform1i(uBlend, 1);
 	glUniform1i(uHorizontal, bufferIndex == 0 ? 1 : 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, prevFBO);
 }
 
 // ==================================================================
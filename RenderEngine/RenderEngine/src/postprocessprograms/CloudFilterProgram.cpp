@@ -3,6 +3,7 @@
 #include "Renderer.h"
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
+#include "GLStateCache.h"
 
 #include "glm/ext.hpp"
 
@@ -66,41 +67,41 @@ void Engine::CloudFilterProgram::onRenderObject(const Engine::Object * obj, Engi
 void Engine::CloudFilterProgram::setBufferInput(Engine::TextureInstance ** buffer)
 {
 	glUniform1i(uRepro1, 0);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, buffer[0]->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, buffer[0]->getTexture()->getTextureId());
 
 	glUniform1i(uRepro2, 1);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, buffer[1]->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE1);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, buffer[1]->getTexture()->getTextureId());
 	/*
 	glUniform1i(uRepro3, 2);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, buffer[2]->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, buffer[2]->getTexture()->getTextureId());
 
 	glUniform1i(uRepro4, 3);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, buffer[3]->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE3);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, buffer[3]->getTexture()->getTextureId());
 	*/
 }
 
 void Engine::CloudFilterProgram::setVelocityInput(Engine::TextureInstance ** velocities)
 {
 	glUniform1i(uVel1, 2);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, velocities[0]->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, velocities[0]->getTexture()->getTextureId());
 
 	glUniform1i(uVel2, 3);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, velocities[1]->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE3);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, velocities[1]->getTexture()->getTextureId());
 
 	/*
 	glUniform1i(uVel3, 2);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, velocities[2]->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, velocities[2]->getTexture()->getTextureId());
 
 	glUniform1i(uVel4, 3);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, velocities[3]->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE3);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, velocities[3]->getTexture()->getTextureId());
 	*/
 }
 
@@ -2,6 +2,7 @@
 
 #include "Scene.h"
 #include "LightBufferManager.h"
+#include "ClusteredLightBuffer.h"
 #include "WorldConfig.h"
 
 std::string Engine::DeferredShadingProgram::PROGRAM_NAME = "DeferredShadingProgram";
@@ -16,13 +17,15 @@ Engine::DeferredShadingProgram::DeferredShadingProgram(const Engine::DeferredSha
 	: Engine::PostProcessProgram(other)
 {
 	uDLBuffer = other.uDLBuffer;
-	uPLBuffer = other.uPLBuffer;
-	uSLBuffer = other.uSLBuffer;
+	uClusterScale = other.uClusterScale;
+	uClusterBias = other.uClusterBias;
+	uViewMatrix = other.uViewMatrix;
 
 	uSkyHorizonColor = other.uSkyHorizonColor;
 	uSkyZenitColor = other.uSkyZenitColor;
 
 	uColorFactor = other.uColorFactor;
+	uInvProj = other.uInvProj;
 }
 
 void Engine::DeferredShadingProgram::processDirectionalLights(Engine::DirectionalLight * dl, const glm::mat4 & view)
@@ -35,7 +38,7 @@ void Engine::DeferredShadingProgram::processDirectionalLights(Engine::Directiona
 	memcpy(dl->getData().direction, &direction[0], sizeof(float) * 3);
 
 	Engine::GPU::LightBufferManager::getInstance().enableDirectionalLightBufferAtIndex(uDLBuffer);
-	Engine::GPU::LightBufferManager::getInstance().updateDirectionalLight(dl, dl->requiresUpdate());
+	Engine::GPU::LightBufferManager::getInstance().updateDirectionalLight(dl, !dl->requiresUpdate());
 	dl->clearUpdateFlag();
 }
 
@@ -54,6 +57,13 @@ void Engine::DeferredShadingProgram::onRenderObject(const Engine::Object * obj,
 	glUniform3fv(uSkyHorizonColor, 1, &Engine::Settings::skyHorizonColor[0]);
 
 	glUniform1f(uColorFactor, Engine::Settings::lightFactor);
+
+	glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
+	glUniformMatrix4fv(uInvProj, 1, GL_FALSE, &invProj[0][0]);
+
+	glUniform1f(uClusterScale, Engine::GPU::ClusteredLightBuffer::getInstance().getSliceScale());
+	glUniform1f(uClusterBias, Engine::GPU::ClusteredLightBuffer::getInstance().getSliceBias());
+	glUniformMatrix4fv(uViewMatrix, 1, GL_FALSE, &camera->getViewMatrix()[0][0]);
 }
 
 void Engine::DeferredShadingProgram::configureProgram()
@@ -64,10 +74,12 @@ void Engine::DeferredShadingProgram::configureProgram()
 	uSkyZenitColor = glGetUniformLocation(glProgram, "zenitColor");
 
 	uDLBuffer = glGetUniformBlockIndex(glProgram, "DLBuffer");
-	uPLBuffer = glGetUniformBlockIndex(glProgram, "PLBuffer");
-	uSLBuffer = glGetUniformBlockIndex(glProgram, "SLBuffer");
 
 	uColorFactor = glGetUniformLocation(glProgram, "colorFactor");
+	uInvProj = glGetUniformLocation(glProgram, "invProj");
+	uClusterScale = glGetUniformLocation(glProgram, "clusterScale");
+	uClusterBias = glGetUniformLocation(glProgram, "clusterBias");
+	uViewMatrix = glGetUniformLocation(glProgram, "viewMatrix");
 }
 
 // =====================================================
@@ -2,6 +2,7 @@
 
 #include "renderers/DeferredRenderer.h"
 #include "WorldConfig.h"
+#include "GLStateCache.h"
 
 std::string Engine::DepthOfFieldProgram::PROGRAM_NAME = "DepthOfFieldProgram";
 
@@ -50,8 +51,8 @@ void Engine::DepthOfFieldProgram::onRenderObject(const Engine::Object * obj, Eng
 	Engine::DeferredRenderer * dr = static_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
 	
 	glUniform1i(uDepthBuffer, 1);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, dr->getGBufferDepth()->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE1);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, dr->getGBufferDepth()->getTexture()->getTextureId());
 }
 
 // ==================================================================
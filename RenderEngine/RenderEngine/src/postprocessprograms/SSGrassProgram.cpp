@@ -1,6 +1,7 @@
 #include "postprocessprograms/SSGrassProgram.h"
 
 #include "renderers/DeferredRenderer.h"
+#include "GLStateCache.h"
 
 const std::string Engine::SSGrassProgram::PROGRAM_NAME = "SSGrassProgram";
 
@@ -15,7 +16,8 @@ Engine::SSGrassProgram::SSGrassProgram(const Engine::SSGrassProgram & other)
 {
 	uScreenSize = other.uScreenSize;
 	uGrassInfoBuffer = other.uGrassInfoBuffer;
-	uPosBuffer = other.uPosBuffer;
+	uDepthBuffer = other.uDepthBuffer;
+	uInvProj = other.uInvProj;
 }
 
 void Engine::SSGrassProgram::configureProgram()
@@ -24,7 +26,8 @@ void Engine::SSGrassProgram::configureProgram()
 
 	uScreenSize = glGetUniformLocation(glProgram, "screenSize");
 	uGrassInfoBuffer = glGetUniformLocation(glProgram, "grassBuffer");
-	uPosBuffer = glGetUniformLocation(glProgram, "posBuffer");
+	uDepthBuffer = glGetUniformLocation(glProgram, "depthBuffer");
+	uInvProj = glGetUniformLocation(glProgram, "invProj");
 }
 
 void Engine::SSGrassProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
@@ -37,12 +40,15 @@ void Engine::SSGrassProgram::onRenderObject(const Engine::Object * obj, Engine::
 	glUniform2fv(uScreenSize, 1, &ss[0]);
 	
 	glUniform1i(uGrassInfoBuffer, 1);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, dr->getGBufferInfo()->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE1);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, dr->getGBufferMaterial()->getTexture()->getTextureId());
 
-	glUniform1i(uPosBuffer, 2);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, dr->getGBufferPos()->getTexture()->getTextureId());
+	glUniform1i(uDepthBuffer, 2);
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, dr->getGBufferDepth()->getTexture()->getTextureId());
+
+	glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
+	glUniformMatrix4fv(uInvProj, 1, GL_FALSE, &invProj[0][0]);
 }
 
 // ======================================================================================
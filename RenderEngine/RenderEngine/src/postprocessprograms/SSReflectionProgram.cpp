@@ -2,6 +2,7 @@
 
 #include "renderers/DeferredRenderer.h"
 #include "WorldConfig.h"
+#include "GLStateCache.h"
 
 
 const std::string Engine::SSReflectionProgram::PROGRAM_NAME = "SSReflectionProgram";
@@ -16,10 +17,10 @@ Engine::SSReflectionProgram::SSReflectionProgram(const Engine::SSReflectionProgr
 	: Engine::PostProcessProgram(other)
 {
 	uProjMat = other.uProjMat;
-	uPosBuffer = other.uPosBuffer;
+	uInvProj = other.uInvProj;
 	uNormalBuffer = other.uNormalBuffer;
 	uDepthBuffer = other.uDepthBuffer;
-	uSpecularBuffer = other.uSpecularBuffer;
+	uMaterialBuffer = other.uMaterialBuffer;
 	uLightDir = other.uLightDir;
 }
 
@@ -28,10 +29,10 @@ void Engine::SSReflectionProgram::configureProgram()
 	Engine::PostProcessProgram::configureProgram();
 
 	uProjMat = glGetUniformLocation(glProgram, "projMat");
-	uPosBuffer = glGetUniformLocation(glProgram, "posBuffer");
+	uInvProj = glGetUniformLocation(glProgram, "invProj");
 	uNormalBuffer = glGetUniformLocation(glProgram, "normalBuffer");
 	uDepthBuffer = glGetUniformLocation(glProgram, "depthBuffer");
-	uSpecularBuffer = glGetUniformLocation(glProgram, "specularBuffer");
+	uMaterialBuffer = glGetUniformLocation(glProgram, "materialBuffer");
 	uLightDir = glGetUniformLocation(glProgram, "lightDirection");
 }
 
@@ -41,19 +42,18 @@ void Engine::SSReflectionProgram::onRenderObject(const Engine::Object * obj, Eng
 
 	Engine::DeferredRenderer * deferred = static_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
 
+	glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
 	glUniformMatrix4fv(uProjMat, 1, GL_FALSE, &(camera->getProjectionMatrix()[0][0]));
-	glUniform1i(uPosBuffer, 1);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, deferred->getGBufferPos()->getTexture()->getTextureId());
+	glUniformMatrix4fv(uInvProj, 1, GL_FALSE, &invProj[0][0]);
 	glUniform1i(uNormalBuffer, 2);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, deferred->getGBufferNormal()->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, deferred->getGBufferNormal()->getTexture()->getTextureId());
 	glUniform1i(uDepthBuffer, 3);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, deferred->getGBufferDepth()->getTexture()->getTextureId());
-	glUniform1i(uSpecularBuffer, 4);
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, deferred->getGBufferSpecular()->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE3);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, deferred->getGBufferDepth()->getTexture()->getTextureId());
+	glUniform1i(uMaterialBuffer, 4);
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE4);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, deferred->getGBufferMaterial()->getTexture()->getTextureId());
 
 	glm::vec3 normalDir = glm::normalize(Engine::Settings::lightDirection);
 	glUniform3fv(uLightDir, 1, &normalDir[0]);
@@ -5,6 +5,7 @@
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
 #include "renderers/DeferredRenderer.h"
+#include "GLStateCache.h"
 
 const std::string Engine::VolumetricCloudProgram::PROGRAM_NAME = "VolumetricCloudProgram";
 
@@ -128,7 +129,8 @@ void Engine::VolumetricCloudProgram::onRenderObject(Engine::Object * obj, Engine
 	glUniform1f(uCloudSpeed, Engine::Settings::windStrength);
 	glUniform3fv(uWindDirection, 1, &Engine::Settings::windDirection[0]);
 	glUniform1f(uCloudType, Engine::Settings::cloudType);
-	glUniform1f(uCoverageMultiplier, Engine::Settings::coverageMultiplier);
+	// Clouds grow in while they fade in after the noise generation
+	glUniform1f(uCoverageMultiplier, Engine::Settings::coverageMultiplier * Engine::CloudSystem::NoiseInitializer::getInstance().getFadeIn());
 
 	float res[2] = { (float)Engine::ScreenManager::SCREEN_WIDTH, (float)Engine::ScreenManager::SCREEN_HEIGHT };
 	glUniform2fv(uResolution, 1, res);
@@ -139,21 +141,21 @@ void Engine::VolumetricCloudProgram::onRenderObject(Engine::Object * obj, Engine
 	const Engine::TextureInstance * wth = Engine::CloudSystem::NoiseInitializer::getInstance().getWeatherData();
 
 	glUniform1i(uPerlinWorley, 0);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_3D, pw->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_3D, pw->getTexture()->getTextureId());
 
 	glUniform1i(uWorley, 1);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_3D, w->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE1);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_3D, w->getTexture()->getTextureId());
 
 	glUniform1i(uWeather, 2);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, wth->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, wth->getTexture()->getTextureId());
 
 	Engine::DeferredRenderer * dr = static_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
 	glUniform1i(uCurrentDepth, 3);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, dr->getGBufferDepth()->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE3);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, dr->getGBufferDepth()->getTexture()->getTextureId());
 
 	glUniform1i(uFrame, (GLint)Engine::Time::frame);
 }
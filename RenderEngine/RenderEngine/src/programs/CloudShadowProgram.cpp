@@ -2,6 +2,7 @@
 
 #include "volumetricclouds/NoiseInitializer.h"
 #include "WorldConfig.h"
+#include "GLStateCache.h"
 
 const std::string Engine::CloudShadowProgram::PROGRAM_NAME = "CloudShadowProgram";
 
@@ -35,9 +36,7 @@ void Engine::CloudShadowProgram::configureMeshBuffers(Engine::Mesh * mesh)
 
 	if (uInPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboVertices);
-		glVertexAttribPointer(uInPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInPos);
+		mesh->bindAttribute(Engine::VERTEX_POSITION, uInPos);
 	}
 
 	if (uInUV != -1)
@@ -52,8 +51,8 @@ void Engine::CloudShadowProgram::onRenderObject(const Engine::Object * obj, Engi
 	//Engine::Program::onRenderObject(obj, camera);
 	const Engine::TextureInstance * weather = Engine::CloudSystem::NoiseInitializer::getInstance().getWeatherData();
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, weather->getTexture()->getTextureId());
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE0);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, weather->getTexture()->getTextureId());
 	glUniform1i(uWeather, 0);
 
 	glUniform1f(uCoverageMult, Engine::Settings::coverageMultiplier);
@@ -5,12 +5,18 @@
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
 #include "CascadeShadowMaps.h"
+#include "RenderStatistics.h"
+#include "GLStateCache.h"
 
 const std::string Engine::ProceduralTerrainProgram::PROGRAM_NAME = "ProceduralTerrainProgram";
 
 const unsigned long long Engine::ProceduralTerrainProgram::WIRE_DRAW_MODE = 0x01;
 const unsigned long long Engine::ProceduralTerrainProgram::POINT_DRAW_MODE = 0x02;
 const unsigned long long Engine::ProceduralTerrainProgram::SHADOW_MAP = 0x04;
+const unsigned long long Engine::ProceduralTerrainProgram::MULTI_DRAW = 0x08;
+
+// Smaller segments do not change the shadow map
+const float SHADOW_TEXELS_PER_SEGMENT = 2.0f;
 
 // ==================================================================================
 
@@ -35,32 +41,15 @@ Engine::ProceduralTerrainProgram::ProceduralTerrainProgram(const ProceduralTerra
 	uModelViewProj = other.uModelViewProj;
 	uNormal = other.uNormal;
 
-	uWaterLevel = other.uWaterLevel;
-	uWorldScale = other.uWorldScale;
-	uRenderRadius = other.uRenderRadius;
-
 	uLightDepthMatrix = other.uLightDepthMatrix;
-	uLightDepthMatrix1 = other.uLightDepthMatrix1;
-	uDepthTexture = other.uDepthTexture;
-	uDepthTexture1 = other.uDepthTexture1;
-	uLightDirection = other.uLightDirection;
-
-	uAmplitude = other.uAmplitude;
-	uFrecuency = other.uFrecuency;
-	uScale = other.uScale;
-	uOctaves = other.uOctaves;
+	uShadowMaps = other.uShadowMaps;
+	uMaxTessLevel = other.uMaxTessLevel;
+	uMinTessLevel = other.uMinTessLevel;
 
 	uInPos = other.uInPos;
 	uInUV = other.uInUV;
 
 	uGridPos = other.uGridPos;
-
-	uTime = other.uTime;
-
-	uGrassCoverage = other.uGrassCoverage;
-	uGrassColor = other.uGrassColor;
-	uSandColor = other.uSandColor;
-	uRockColor = other.uRockColor;
 }
 
 void Engine::ProceduralTerrainProgram::initialize()
@@ -69,56 +58,36 @@ void Engine::ProceduralTerrainProgram::initialize()
 
 	if (parameters & Engine::ProceduralTerrainProgram::WIRE_DRAW_MODE)
 	{
-		configStr += "#define WIRE_MODE";
+		configStr += "#define WIRE_MODE\n";
 	}
 	else if (parameters & Engine::ProceduralTerrainProgram::POINT_DRAW_MODE)
 	{
-		configStr += "#define POINT_MODE";
+		configStr += "#define POINT_MODE\n";
 	}
 
 	if (parameters & Engine::ProceduralTerrainProgram::SHADOW_MAP)
 	{
-		configStr += "#define SHADOW_MAP";
+		configStr += "#define SHADOW_MAP\n";
 	}
 
-	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER, configStr);
-	tcsShader = loadShader(tcsShaderFile, GL_TESS_CONTROL_SHADER, configStr);
-	tevalShader = loadShader(tevalShaderFile, GL_TESS_EVALUATION_SHADER, configStr);
-
-	if (!(parameters & Engine::ProceduralTerrainProgram::SHADOW_MAP))
+	if (parameters & Engine::ProceduralTerrainProgram::MULTI_DRAW)
 	{
-		gShader = loadShader(gShaderFile, GL_GEOMETRY_SHADER, configStr);
+		configStr += "#define MULTI_DRAW\n";
 	}
 
-	fShader = loadShader(fShaderFile, GL_FRAGMENT_SHADER, configStr);
-
-	glProgram = glCreateProgram();
-
-	glAttachShader(glProgram, vShader);
-	glAttachShader(glProgram, tcsShader);
-	glAttachShader(glProgram, tevalShader);
+	gShader = 0;
 
+	std::vector<ShaderStage> stages;
+	stages.push_back({ vShaderFile, GL_VERTEX_SHADER, &vShader });
+	stages.push_back({ tcsShaderFile, GL_TESS_CONTROL_SHADER, &tcsShader });
+	stages.push_back({ tevalShaderFile, GL_TESS_EVALUATION_SHADER, &tevalShader });
 	if (!(parameters & Engine::ProceduralTerrainProgram::SHADOW_MAP))
 	{
-		glAttachShader(glProgram, gShader);
+		stages.push_back({ gShaderFile, GL_GEOMETRY_SHADER, &gShader });
 	}
+	stages.push_back({ fShaderFile, GL_FRAGMENT_SHADER, &fShader });
 
-	glAttachShader(glProgram, fShader);
-
-	glLinkProgram(glProgram);
-
-	int linked;
-	glGetProgramiv(glProgram, GL_LINK_STATUS, &linked);
-	if (!linked)
-	{
-		GLint logLen;
-		glGetProgramiv(glProgram, GL_INFO_LOG_LENGTH, &logLen);
-		char *logString = new char[logLen];
-		glGetProgramInfoLog(glProgram, logLen, NULL, logString);
-		std::cout << "Error: " << logString << std::endl;
-		delete[] logString;
-		exit(-1);
-	}
+	linkProgram(stages, configStr);
 
 	configureProgram();
 }
@@ -131,25 +100,9 @@ void Engine::ProceduralTerrainProgram::configureProgram()
 	uGridPos = glGetUniformLocation(glProgram, "gridPos");
 
 	uLightDepthMatrix = glGetUniformLocation(glProgram, "lightDepthMat");
-	uLightDepthMatrix1 = glGetUniformLocation(glProgram, "lightDepthMat1");
-	uLightDirection = glGetUniformLocation(glProgram, "lightDir");
-	uDepthTexture = glGetUniformLocation(glProgram, "depthTexture");
-	uDepthTexture1 = glGetUniformLocation(glProgram, "depthTexture1");
-
-	uWaterLevel = glGetUniformLocation(glProgram, "waterHeight");
-	uWorldScale = glGetUniformLocation(glProgram, "worldScale");
-	uRenderRadius = glGetUniformLocation(glProgram, "renderRadius");
-
-	uAmplitude = glGetUniformLocation(glProgram, "amplitude");
-	uFrecuency = glGetUniformLocation(glProgram, "frecuency");
-	uScale = glGetUniformLocation(glProgram, "scale");
-	uOctaves = glGetUniformLocation(glProgram, "octaves");
-
-	uGrassCoverage = glGetUniformLocation(glProgram, "grassCoverage");
-	uGrassColor = glGetUniformLocation(glProgram, "grass");
-	uRockColor = glGetUniformLocation(glProgram, "rock");
-	uSandColor = glGetUniformLocation(glProgram, "sand");
-	uTime = glGetUniformLocation(glProgram, "time");
+	uShadowMaps = glGetUniformLocation(glProgram, "shadowMaps");
+	uMaxTessLevel = glGetUniformLocation(glProgram, "maxTessLevel");
+	uMinTessLevel = glGetUniformLocation(glProgram, "minTessLevel");
 
 	uInPos = glGetAttribLocation(glProgram, "inPos");
 	uInUV = glGetAttribLocation(glProgram, "inUV");
@@ -161,16 +114,12 @@ void Engine::ProceduralTerrainProgram::configureMeshBuffers(Engine::Mesh * data)
 
 	if (uInPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data->vboVertices);
-		glVertexAttribPointer(uInPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInPos);
+		data->bindAttribute(Engine::VERTEX_POSITION, uInPos);
 	}
 
 	if (uInUV != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data->vboUVs);
-		glVertexAttribPointer(uInUV, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInUV);
+		data->bindAttribute(Engine::VERTEX_UV, uInUV);
 	}
 }
 
@@ -178,34 +127,28 @@ void Engine::ProceduralTerrainProgram::applyGlobalUniforms()
 {
 	if (!(parameters & Engine::ProceduralTerrainProgram::SHADOW_MAP))
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture0()->getTexture()->getTextureId());
-		glUniform1i(uDepthTexture, 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture1()->getTexture()->getTextureId());
-		glUniform1i(uDepthTexture1, 1);
-
-		glm::vec3 ld = glm::normalize(Engine::Settings::lightDirection);
-		glUniform3fv(uLightDirection, 1, &ld[0]);
-
-		glUniform1f(uGrassCoverage, 1.0f - Engine::Settings::grassCoverage);
-		glUniform3fv(uGrassColor, 1, &Engine::Settings::grassColor[0]);
-		glUniform3fv(uRockColor, 1, &Engine::Settings::rockColor[0]);
-		glUniform3fv(uSandColor, 1, &Engine::Settings::sandColor[0]);
-
-		glUniform1f(uTime, Engine::Time::timeSinceBegining);
+		Engine::CascadeShadowMaps::getInstance().bindShadowMaps(GL_TEXTURE0);
+		glUniform1i(uShadowMaps, 0);
 
-		glUniform1f(uWorldScale, Engine::Settings::worldTileScale);
-		glUniform1f(uRenderRadius, (float)Engine::Settings::worldRenderRadius);
+		Engine::RenderStatistics::uniformUploads++;
+	}
+	else
+	{
+		// Patch edges (a tile side) split in segments no shorter than SHADOW_TEXELS_PER_SEGMENT texels
+		Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+		float segments = Engine::Settings::worldTileScale * csm.getTexelsPerMeter(csm.getCurrentLevel()) / SHADOW_TEXELS_PER_SEGMENT;
+		float maxTessLevel = glm::clamp(floorf(segments), 1.0f, 64.0f);
+		glUniform1f(uMaxTessLevel, maxTessLevel);
+		// The static shadow cache keeps texels rendered from other camera positions, so its tiles are
+		// tessellated evenly
+		bool staticPass = csm.getCasterSet() == Engine::ShadowCasterSet::SHADOW_CASTERS_STATIC;
+		glUniform1f(uMinTessLevel, staticPass ? maxTessLevel : 1.0f);
+
+		Engine::RenderStatistics::uniformUploads += 2;
 	}
 
-	glUniform1f(uWorldScale, Engine::Settings::worldTileScale);
-	glUniform1f(uAmplitude, Engine::Settings::terrainAmplitude);
-	glUniform1f(uFrecuency, Engine::Settings::terrainFrecuency);
-	glUniform1f(uScale, Engine::Settings::terrainScale);
-	glUniform1i(uOctaves, Engine::Settings::terrainOctaves);
-	glUniform1f(uWaterLevel, Engine::Settings::waterHeight);
+	// Terrain, lighting and time settings are read from the FrameGlobals block (see FrameGlobalsBuffer),
+	// the cascade matrices from the ShadowCascades block (see CascadeShadowMaps)
 }
 
 void Engine::ProceduralTerrainProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
@@ -218,6 +161,8 @@ void Engine::ProceduralTerrainProgram::onRenderObject(const Engine::Object * obj
 	glUniformMatrix4fv(uModelViewProj, 1, GL_FALSE, &(modelViewProj[0][0]));
 	glUniformMatrix4fv(uNormal, 1, GL_FALSE, &(normal[0][0]));
 
+	Engine::RenderStatistics::uniformUploads += 3;
+
 	unsigned int vertexPerFace = obj->getMesh()->getNumVerticesPerFace();
 	glPatchParameteri(GL_PATCH_VERTICES, vertexPerFace);
 }
@@ -225,36 +170,48 @@ void Engine::ProceduralTerrainProgram::onRenderObject(const Engine::Object * obj
 void Engine::ProceduralTerrainProgram::setUniformGridPosition(unsigned int i, unsigned int j)
 {
 	glUniform2i(uGridPos, i, j);
+	Engine::RenderStatistics::uniformUploads++;
 }
 
 void Engine::ProceduralTerrainProgram::setUniformLightDepthMatrix(const glm::mat4 & ldm)
 {
 	glUniformMatrix4fv(uLightDepthMatrix, 1, GL_FALSE, &(ldm[0][0]));
-}
-
-void Engine::ProceduralTerrainProgram::setUniformLightDepthMatrix1(const glm::mat4 & ldm)
-{
-	glUniformMatrix4fv(uLightDepthMatrix1, 1, GL_FALSE, &(ldm[0][0]));
+	Engine::RenderStatistics::uniformUploads++;
 }
 
 void Engine::ProceduralTerrainProgram::destroy()
 {
-	glDetachShader(glProgram, vShader);
-	glDeleteShader(vShader);
+	if (vShader != 0)
+	{
+		glDetachShader(glProgram, vShader);
+		glDeleteShader(vShader);
+	}
 
-	glDetachShader(glProgram, tcsShader);
-	glDeleteShader(tcsShader);
+	if (tcsShader != 0)
+	{
+		glDetachShader(glProgram, tcsShader);
+		glDeleteShader(tcsShader);
+	}
 
-	glDetachShader(glProgram, tevalShader);
-	glDeleteShader(tevalShader);
+	if (tevalShader != 0)
+	{
+		glDetachShader(glProgram, tevalShader);
+		glDeleteShader(tevalShader);
+	}
 
-	glDetachShader(glProgram, gShader);
-	glDeleteShader(gShader);
+	if (gShader != 0)
+	{
+		glDetachShader(glProgram, gShader);
+		glDeleteShader(gShader);
+	}
 
-	glDetachShader(glProgram, fShader);
-	glDeleteShader(fShader);
+	if (fShader != 0)
+	{
+		glDetachShader(glProgram, fShader);
+		glDeleteShader(fShader);
+	}
 
-	glDeleteProgram(glProgram);
+	Engine::GLStateCache::getInstance().deleteProgram(glProgram);
 }
 
 // ==============================================================================
@@ -4,6 +4,8 @@
 #include "TimeAccesor.h"
 #include "renderers/DeferredRenderer.h"
 #include "CascadeShadowMaps.h"
+#include "RenderStatistics.h"
+#include "GLStateCache.h"
 
 #include <iostream>
 
@@ -12,6 +14,7 @@ std::string Engine::ProceduralWaterProgram::PROGRAM_NAME = "ProceduralWaterProgr
 const unsigned long long Engine::ProceduralWaterProgram::WIRE_DRAW_MODE = 0x01;
 const unsigned long long Engine::ProceduralWaterProgram::POINT_DRAW_MODE = 0x02;
 const unsigned long long Engine::ProceduralWaterProgram::SHADOW_MAP = 0x04;
+const unsigned long long Engine::ProceduralWaterProgram::MULTI_DRAW = 0x08;
 
 Engine::ProceduralWaterProgram::ProceduralWaterProgram(std::string name, unsigned long long params)
 	:Engine::Program(name, params)
@@ -31,18 +34,11 @@ Engine::ProceduralWaterProgram::ProceduralWaterProgram(const Engine::ProceduralW
 	uNormal = other.uNormal;
 
 	uLightDepthMatrix = other.uLightDepthMatrix;
-	uLightDepthMatrix1 = other.uLightDepthMatrix1;
-	uDepthTexture = other.uDepthTexture;
-	uDepthTexture1 = other.uDepthTexture1;
-	uLightDirection = other.uLightDirection;
+	uShadowMaps = other.uShadowMaps;
 
 	uInInfo = other.uInInfo;
 	uScreenSize = other.uScreenSize;
 
-	uTime = other.uTime;
-	uWaterColor = other.uWaterColor;
-	uWaterSpeed = other.uWaterSpeed;
-
 	uInPos = other.uInPos;
 	uInUV = other.uInUV;
 
@@ -55,51 +51,34 @@ void Engine::ProceduralWaterProgram::initialize()
 
 	if (parameters & Engine::ProceduralWaterProgram::WIRE_DRAW_MODE)
 	{
-		configStr += "#define WIRE_MODE";
+		configStr += "#define WIRE_MODE\n";
 	}
 	else if (parameters & Engine::ProceduralWaterProgram::POINT_DRAW_MODE)
 	{
-		configStr += "#define POINT_MODE";
+		configStr += "#define POINT_MODE\n";
 	}
 
 	if (parameters & Engine::ProceduralWaterProgram::SHADOW_MAP)
 	{
-		configStr += "#define SHADOW_MAP";
+		configStr += "#define SHADOW_MAP\n";
 	}
 
-	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER, configStr);
-
-	if (parameters & Engine::ProceduralWaterProgram::WIRE_DRAW_MODE)
+	if (parameters & Engine::ProceduralWaterProgram::MULTI_DRAW)
 	{
-		gShader = loadShader(gShaderFile, GL_GEOMETRY_SHADER, configStr);
+		configStr += "#define MULTI_DRAW\n";
 	}
 
-	fShader = loadShader(fShaderFile, GL_FRAGMENT_SHADER, configStr);
-
-	glProgram = glCreateProgram();
+	gShader = 0;
 
-	glAttachShader(glProgram, vShader);
+	std::vector<ShaderStage> stages;
+	stages.push_back({ vShaderFile, GL_VERTEX_SHADER, &vShader });
 	if (parameters & Engine::ProceduralWaterProgram::WIRE_DRAW_MODE)
 	{
-		glAttachShader(glProgram, gShader);
+		stages.push_back({ gShaderFile, GL_GEOMETRY_SHADER, &gShader });
 	}
+	stages.push_back({ fShaderFile, GL_FRAGMENT_SHADER, &fShader });
 
-	glAttachShader(glProgram, fShader);
-
-	glLinkProgram(glProgram);
-
-	int linked;
-	glGetProgramiv(glProgram, GL_LINK_STATUS, &linked);
-	if (!linked)
-	{
-		GLint logLen;
-		glGetProgramiv(glProgram, GL_INFO_LOG_LENGTH, &logLen);
-		char *logString = new char[logLen];
-		glGetProgramInfoLog(glProgram, logLen, NULL, logString);
-		std::cout << "Error: " << logString << std::endl;
-		delete[] logString;
-		exit(-1);
-	}
+	linkProgram(stages, configStr);
 
 	configureProgram();
 }
@@ -112,17 +91,10 @@ void Engine::ProceduralWaterProgram::configureProgram()
 	uGridPos = glGetUniformLocation(glProgram, "gridPos");
 
 	uLightDepthMatrix = glGetUniformLocation(glProgram, "lightDepthMat");
-	uLightDepthMatrix1 = glGetUniformLocation(glProgram, "lightDepthMat1");
-	uDepthTexture = glGetUniformLocation(glProgram, "depthTexture");
-	uDepthTexture1 = glGetUniformLocation(glProgram, "depthTexture1");
-	uLightDirection = glGetUniformLocation(glProgram, "lightDir");
+	uShadowMaps = glGetUniformLocation(glProgram, "shadowMaps");
 
 	uInInfo = glGetUniformLocation(glProgram, "inInfo");
 	uScreenSize = glGetUniformLocation(glProgram, "screenSize");
-	
-	uWaterColor = glGetUniformLocation(glProgram, "watercolor");
-	uWaterSpeed = glGetUniformLocation(glProgram, "waterspeed");
-	uTime = glGetUniformLocation(glProgram, "time");
 
 	uInPos = glGetAttribLocation(glProgram, "inPos");
 	uInUV = glGetAttribLocation(glProgram, "inUV");
@@ -131,43 +103,29 @@ void Engine::ProceduralWaterProgram::configureProgram()
 void Engine::ProceduralWaterProgram::setUniformGridPosition(unsigned int i, unsigned int j)
 {
 	glUniform2i(uGridPos, i, j);
+	Engine::RenderStatistics::uniformUploads++;
 }
 
 void Engine::ProceduralWaterProgram::setUniformLightDepthMatrix(const glm::mat4 & ldm)
 {
 	glUniformMatrix4fv(uLightDepthMatrix, 1, GL_FALSE, &(ldm[0][0]));
-}
-
-void Engine::ProceduralWaterProgram::setUniformLightDepthMatrix1(const glm::mat4 & ldm)
-{
-	glUniformMatrix4fv(uLightDepthMatrix1, 1, GL_FALSE, &(ldm[0][0]));
+	Engine::RenderStatistics::uniformUploads++;
 }
 
 void Engine::ProceduralWaterProgram::applyGlobalUniforms()
 {
 	//if (!(parameters & Engine::ProceduralWaterProgram::SHADOW_MAP))
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture0()->getTexture()->getTextureId());
-		glUniform1i(uDepthTexture, 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture1()->getTexture()->getTextureId());
-		glUniform1i(uDepthTexture1, 1);
-
-		glm::vec3 ld = glm::normalize(Engine::Settings::lightDirection);
-		glUniform3fv(uLightDirection, 1, &ld[0]);
-
-		glUniform1f(uTime, Engine::Time::timeSinceBegining);
+		Engine::CascadeShadowMaps::getInstance().bindShadowMaps(GL_TEXTURE0);
+		glUniform1i(uShadowMaps, 0);
 
 		Engine::DeferredRenderer * dr = static_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, dr->getGBufferInfo()->getTexture()->getTextureId());
+		Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+		Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, dr->getGBufferMaterial()->getTexture()->getTextureId());
 		glUniform1i(uInInfo, 2);
 		glUniform2f(uScreenSize, float(Engine::ScreenManager::SCREEN_WIDTH), float(Engine::ScreenManager::SCREEN_HEIGHT));
 
-		glUniform1f(uWaterSpeed, Engine::Settings::waterSpeed);
-		glUniform3fv(uWaterColor, 1, &Engine::Settings::waterColor[0]);
+		Engine::RenderStatistics::uniformUploads += 3;
 	}
 }
 
@@ -180,6 +138,8 @@ void Engine::ProceduralWaterProgram::onRenderObject(const Object * obj, Engine::
 	glUniformMatrix4fv(uModelView, 1, GL_FALSE, &(modelView[0][0]));
 	glUniformMatrix4fv(uModelViewProj, 1, GL_FALSE, &(modelViewProj[0][0]));
 	glUniformMatrix4fv(uNormal, 1, GL_FALSE, &(normal[0][0]));
+
+	Engine::RenderStatistics::uniformUploads += 3;
 }
 
 void Engine::ProceduralWaterProgram::configureMeshBuffers(Engine::Mesh * data)
@@ -188,40 +148,36 @@ void Engine::ProceduralWaterProgram::configureMeshBuffers(Engine::Mesh * data)
 
 	if (uInPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data->vboVertices);
-		glVertexAttribPointer(uInPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInPos);
+		data->bindAttribute(Engine::VERTEX_POSITION, uInPos);
 	}
 
 	if (uInUV != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data->vboUVs);
-		glVertexAttribPointer(uInUV, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInUV);
+		data->bindAttribute(Engine::VERTEX_UV, uInUV);
 	}
 }
 
 void Engine::ProceduralWaterProgram::destroy()
 {
-	if (vShader != -1)
+	if (vShader != 0)
 	{
 		glDetachShader(glProgram, vShader);
 		glDeleteShader(vShader);
 	}
 
-	if (gShader != -1)
+	if (gShader != 0)
 	{
 		glDetachShader(glProgram, gShader);
 		glDeleteShader(gShader);
 	}
 
-	if (fShader != -1)
+	if (fShader != 0)
 	{
 		glDetachShader(glProgram, fShader);
 		glDeleteShader(fShader);
 	}
 
-	glDeleteProgram(glProgram);
+	Engine::GLStateCache::getInstance().deleteProgram(glProgram);
 }
 
 // ========================================================================================
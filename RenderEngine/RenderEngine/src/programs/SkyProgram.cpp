@@ -43,9 +43,7 @@ void Engine::SkyProgram::configureMeshBuffers(Engine::Mesh * m)
 
 	if (inPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, m->vboVertices);
-		glVertexAttribPointer(inPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(inPos);
+		m->bindAttribute(Engine::VERTEX_POSITION, inPos);
 	}
 }
 
@@ -0,0 +1,176 @@
+#include "programs/TreeImpostorProgram.h"
+
+#include "WorldConfig.h"
+#include "CascadeShadowMaps.h"
+#include "RenderStatistics.h"
+#include "GLStateCache.h"
+
+#include <iostream>
+
+const std::string Engine::TreeImpostorProgram::PROGRAM_NAME = "TreeImpostorProgram";
+
+const unsigned long long Engine::TreeImpostorProgram::SHADOW_MAP = 0x01;
+const unsigned long long Engine::TreeImpostorProgram::WIRE_MODE = 0x02;
+const unsigned long long Engine::TreeImpostorProgram::POINT_MODE = 0x04;
+
+Engine::TreeImpostorProgram::TreeImpostorProgram(std::string name, unsigned long long params)
+	:Program(name, params)
+{
+	vShaderFile = "shaders/vegetation/tree/treeimpostor.vert";
+	fShaderFile = "shaders/vegetation/tree/treeimpostor.frag";
+	gShaderFile = "shaders/vegetation/tree/treeimpostor.geom";
+}
+
+Engine::TreeImpostorProgram::TreeImpostorProgram(const TreeImpostorProgram & other)
+	:Program(other)
+{
+	uModelViewProj = other.uModelViewProj;
+	uModelView = other.uModelView;
+	uNormal = other.uNormal;
+	uEyePos = other.uEyePos;
+	uLightDepthMat0 = other.uLightDepthMat0;
+	uShadowMaps = other.uShadowMaps;
+	uColorAtlas = other.uColorAtlas;
+	uNormalAtlas = other.uNormalAtlas;
+	uAtlasSize = other.uAtlasSize;
+	uImpostorExtents = other.uImpostorExtents;
+	uImpostorRow = other.uImpostorRow;
+
+	uInInstance = other.uInInstance;
+}
+
+void Engine::TreeImpostorProgram::initialize()
+{
+	std::string config = "";
+
+	if (parameters & Engine::TreeImpostorProgram::SHADOW_MAP)
+	{
+		config += "#define SHADOW_MAP\n";
+	}
+
+	if (parameters & Engine::TreeImpostorProgram::WIRE_MODE)
+	{
+		config += "#define WIRE_MODE\n";
+	}
+	else if (parameters & Engine::TreeImpostorProgram::POINT_MODE)
+	{
+		config += "#define POINT_MODE\n";
+	}
+
+	std::vector<ShaderStage> stages;
+	stages.push_back({ vShaderFile, GL_VERTEX_SHADER, &vShader });
+	stages.push_back({ gShaderFile, GL_GEOMETRY_SHADER, &gShader });
+	stages.push_back({ fShaderFile, GL_FRAGMENT_SHADER, &fShader });
+
+	linkProgram(stages, config);
+
+	configureProgram();
+}
+
+void Engine::TreeImpostorProgram::configureProgram()
+{
+	uModelViewProj = glGetUniformLocation(glProgram, "modelViewProj");
+	uModelView = glGetUniformLocation(glProgram, "modelView");
+	uNormal = glGetUniformLocation(glProgram, "normal");
+	uEyePos = glGetUniformLocation(glProgram, "eyePos");
+	uLightDepthMat0 = glGetUniformLocation(glProgram, "lightDepthMat");
+	uShadowMaps = glGetUniformLocation(glProgram, "shadowMaps");
+
+	uColorAtlas = glGetUniformLocation(glProgram, "colorAtlas");
+	uNormalAtlas = glGetUniformLocation(glProgram, "normalAtlas");
+	uAtlasSize = glGetUniformLocation(glProgram, "atlasSize");
+	uImpostorExtents = glGetUniformLocation(glProgram, "impostorExtents");
+	uImpostorRow = glGetUniformLocation(glProgram, "impostorRow");
+
+	uInInstance = glGetAttribLocation(glProgram, "inInstance");
+}
+
+void Engine::TreeImpostorProgram::configureMeshBuffers(Engine::Mesh * mesh)
+{
+}
+
+void Engine::TreeImpostorProgram::configureInstanceBuffer(unsigned int vertexArray, unsigned int instanceBuffer)
+{
+	if (uInInstance == -1)
+		return;
+
+	Engine::GLStateCache::getInstance().bindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(uInInstance, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(uInInstance);
+}
+
+void Engine::TreeImpostorProgram::applyGlobalUniforms()
+{
+	if (!(parameters & Engine::TreeImpostorProgram::SHADOW_MAP))
+	{
+		Engine::CascadeShadowMaps::getInstance().bindShadowMaps(GL_TEXTURE0);
+		glUniform1i(uShadowMaps, 0);
+
+		Engine::RenderStatistics::uniformUploads++;
+	}
+}
+
+void Engine::TreeImpostorProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
+{
+	glm::mat4 modelView = camera->getViewMatrix() * obj->getModelMatrix();
+	glm::mat4 modelViewProj = camera->getProjectionMatrix() * modelView;
+	glm::mat4 normal = glm::transpose(glm::inverse(modelView));
+	glm::vec3 eye = glm::vec3(camera->getInvViewMatrix()[3]);
+
+	glUniformMatrix4fv(uModelViewProj, 1, GL_FALSE, &(modelViewProj[0][0]));
+	glUniformMatrix4fv(uModelView, 1, GL_FALSE, &(modelView[0][0]));
+	glUniformMatrix4fv(uNormal, 1, GL_FALSE, &(normal[0][0]));
+	glUniform3fv(uEyePos, 1, &eye[0]);
+
+	Engine::RenderStatistics::uniformUploads += 4;
+}
+
+void Engine::TreeImpostorProgram::setUniformLightDepthMat(const glm::mat4 & ldm)
+{
+	glUniformMatrix4fv(uLightDepthMat0, 1, GL_FALSE, &(ldm[0][0]));
+	Engine::RenderStatistics::uniformUploads++;
+}
+
+void Engine::TreeImpostorProgram::setUniformAtlas(const Engine::TreeImpostorAtlas & atlas)
+{
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE2);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, atlas.getColorTexture());
+	glUniform1i(uColorAtlas, 2);
+
+	Engine::GLStateCache::getInstance().activeTexture(GL_TEXTURE3);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, atlas.getNormalTexture());
+	glUniform1i(uNormalAtlas, 3);
+
+	glUniform2f(uAtlasSize, float(atlas.getNumViews()), float(atlas.getNumTrees()));
+
+	Engine::RenderStatistics::uniformUploads += 3;
+}
+
+void Engine::TreeImpostorProgram::setUniformImpostor(const Engine::TreeImpostorAtlas & atlas, unsigned int tree)
+{
+	glUniform3fv(uImpostorExtents, 1, &atlas.getExtents(tree)[0]);
+	glUniform1f(uImpostorRow, float(tree));
+
+	Engine::RenderStatistics::uniformUploads += 2;
+}
+
+void Engine::TreeImpostorProgram::destroy()
+{
+	if (gShader != 0)
+	{
+		glDetachShader(glProgram, gShader);
+		glDeleteShader(gShader);
+	}
+
+	Engine::Program::destroy();
+}
+// ===========================================================================================
+
+
+Engine::Program * Engine::TreeImpostorProgramFactory::createProgram(unsigned long long params)
+{
+	Engine::TreeImpostorProgram * tp = new Engine::TreeImpostorProgram(Engine::TreeImpostorProgram::PROGRAM_NAME, params);
+	tp->initialize();
+	return tp;
+}
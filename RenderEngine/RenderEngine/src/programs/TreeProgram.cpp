@@ -3,6 +3,8 @@
 #include "WorldConfig.h"
 #include "CascadeShadowMaps.h"
 #include "TimeAccesor.h"
+#include "RenderStatistics.h"
+#include "GLStateCache.h"
 
 #include <iostream>
 
@@ -11,6 +13,8 @@ const std::string Engine::TreeProgram::PROGRAM_NAME = "TreeProgram";
 const unsigned long long Engine::TreeProgram::SHADOW_MAP = 0x01;
 const unsigned long long Engine::TreeProgram::WIRE_MODE = 0x02;
 const unsigned long long Engine::TreeProgram::POINT_MODE = 0x04;
+const unsigned long long Engine::TreeProgram::INSTANCED = 0x08;
+const unsigned long long Engine::TreeProgram::IMPOSTOR_BAKE = 0x10;
 
 Engine::TreeProgram::TreeProgram(std::string name, unsigned long long params)
 	:Program(name, params)
@@ -27,27 +31,15 @@ Engine::TreeProgram::TreeProgram(const TreeProgram & other)
 	uModelView = other.uModelView;
 	uNormal = other.uNormal;
 	uLightDepthMat0 = other.uLightDepthMat0;
-	uLightDepthMat1 = other.uLightDepthMat1;
 	uGridUV = other.uGridUV;
-	uAmplitude = other.uAmplitude;
-	uFrecuency = other.uFrecuency;
-	uScale = other.uScale;
-	uOctaves = other.uOctaves;
-	uWorldScale = other.uWorldScale;
-	uLightDir = other.uLightDir;
-	uWaterLevel = other.uWaterLevel;
-	uMaxHeight = other.uMaxHeight;
-	uDepthMap0 = other.uDepthMap0;
-	uDepthMap1 = other.uDepthMap1;
-	uSinTime = other.uSinTime;
-	uWindDir = other.uWindDir;
-	uWindStrength = other.uWindStrength;
+	uShadowMaps = other.uShadowMaps;
 
 	uInPos = other.uInPos;
 	uInColor = other.uInColor;
 	uInNormal = other.uInNormal;
 	uInEmissive = other.uInEmissive;
 	uInUV = other.uInUV;
+	uInInstance = other.uInInstance;
 }
 
 void Engine::TreeProgram::initialize()
@@ -56,43 +48,35 @@ void Engine::TreeProgram::initialize()
 
 	if (parameters & Engine::TreeProgram::SHADOW_MAP)
 	{
-		config += "#define SHADOW_MAP";
+		config += "#define SHADOW_MAP\n";
 	}
 
 	if (parameters & Engine::TreeProgram::WIRE_MODE)
 	{
-		config += "#define WIRE_MODE";
+		config += "#define WIRE_MODE\n";
 	}
 	else if (parameters & Engine::TreeProgram::POINT_MODE)
 	{
-		config += "#define POINT_MODE";
+		config += "#define POINT_MODE\n";
 	}
 
-	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER, config);
-	gShader = loadShader(gShaderFile, GL_GEOMETRY_SHADER, config);
-	fShader = loadShader(fShaderFile, GL_FRAGMENT_SHADER, config);
-
-	glProgram = glCreateProgram();
-
-	glAttachShader(glProgram, vShader);
-	glAttachShader(glProgram, gShader);
-	glAttachShader(glProgram, fShader);
-
-	glLinkProgram(glProgram);
+	if (parameters & Engine::TreeProgram::INSTANCED)
+	{
+		config += "#define INSTANCED\n";
+	}
 
-	int linked;
-	glGetProgramiv(glProgram, GL_LINK_STATUS, &linked);
-	if (!linked)
+	if (parameters & Engine::TreeProgram::IMPOSTOR_BAKE)
 	{
-		GLint logLen;
-		glGetProgramiv(glProgram, GL_INFO_LOG_LENGTH, &logLen);
-		char *logString = new char[logLen];
-		glGetProgramInfoLog(glProgram, logLen, NULL, logString);
-		std::cout << "Error: " << logString << std::endl;
-		delete[] logString;
-		exit(-1);
+		config += "#define IMPOSTOR_BAKE\n";
 	}
 
+	std::vector<ShaderStage> stages;
+	stages.push_back({ vShaderFile, GL_VERTEX_SHADER, &vShader });
+	stages.push_back({ gShaderFile, GL_GEOMETRY_SHADER, &gShader });
+	stages.push_back({ fShaderFile, GL_FRAGMENT_SHADER, &fShader });
+
+	linkProgram(stages, config);
+
 	configureProgram();
 }
 
@@ -102,28 +86,15 @@ void Engine::TreeProgram::configureProgram()
 	uModelView = glGetUniformLocation(glProgram, "modelView");
 	uNormal = glGetUniformLocation(glProgram, "normal");
 	uGridUV = glGetUniformLocation(glProgram, "tileUV");
-	uAmplitude = glGetUniformLocation(glProgram, "amplitude");
-	uFrecuency = glGetUniformLocation(glProgram, "frecuency");
-	uScale = glGetUniformLocation(glProgram, "scale");
-	uOctaves = glGetUniformLocation(glProgram, "octaves");
 	uLightDepthMat0 = glGetUniformLocation(glProgram, "lightDepthMat");
-	uLightDepthMat1 = glGetUniformLocation(glProgram, "lightDepthMat1");
-	uLightDir = glGetUniformLocation(glProgram, "lightDir");
-	uWaterLevel = glGetUniformLocation(glProgram, "waterHeight");
-	uMaxHeight = glGetUniformLocation(glProgram, "maxHeight");
-	uDepthMap0 = glGetUniformLocation(glProgram, "depthTexture");
-	uDepthMap1 = glGetUniformLocation(glProgram, "depthTexture1");
-	uWorldScale = glGetUniformLocation(glProgram, "worldScale");
-
-	uSinTime = glGetUniformLocation(glProgram, "sinTime");
-	uWindDir = glGetUniformLocation(glProgram, "windDirection");
-	uWindStrength = glGetUniformLocation(glProgram, "windStrength");
+	uShadowMaps = glGetUniformLocation(glProgram, "shadowMaps");
 
 	uInPos = glGetAttribLocation(glProgram, "inPos");
 	uInColor = glGetAttribLocation(glProgram, "inColor");
 	uInNormal = glGetAttribLocation(glProgram, "inNormal");
 	uInEmissive = glGetAttribLocation(glProgram, "inEmission");
 	uInUV = glGetAttribLocation(glProgram, "inTexCoord");
+	uInInstance = glGetAttribLocation(glProgram, "inInstance");
 }
 
 void Engine::TreeProgram::configureMeshBuffers(Mesh * mesh)
@@ -132,64 +103,65 @@ void Engine::TreeProgram::configureMeshBuffers(Mesh * mesh)
 
 	if (uInPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboVertices);
-		glVertexAttribPointer(uInPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInPos);
+		mesh->bindAttribute(Engine::VERTEX_POSITION, uInPos);
 	}
 
 	if (uInColor != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboColors);
-		glVertexAttribPointer(uInColor, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInColor);
+		mesh->bindAttribute(Engine::VERTEX_COLOR, uInColor);
 	}
 
 	if (uInNormal != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboNormals);
-		glVertexAttribPointer(uInNormal, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInNormal);
+		// tree.vert expects octahedral encoded normals
+		if (mesh->getVertexLayout().getAttribute(Engine::VERTEX_NORMAL).format != Engine::VERTEX_FORMAT_OCTAHEDRAL)
+		{
+			std::cout << "TreeProgram: mesh normals are not octahedral encoded" << std::endl;
+		}
+
+		mesh->bindAttribute(Engine::VERTEX_NORMAL, uInNormal);
 	}
 
 	if (uInEmissive != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboEmission);
-		glVertexAttribPointer(uInEmissive, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInEmissive);
+		mesh->bindAttribute(Engine::VERTEX_EMISSION, uInEmissive);
 	}
 
 	if (uInUV != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboUVs);
-		glVertexAttribPointer(uInUV, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInUV);
+		mesh->bindAttribute(Engine::VERTEX_UV, uInUV);
 	}
 }
 
+void Engine::TreeProgram::configureInstanceBuffer(const Mesh * mesh, unsigned int instanceBuffer)
+{
+	if (uInInstance == -1)
+		return;
+
+	mesh->use();
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(uInInstance, 4, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribDivisor(uInInstance, 1);
+	glEnableVertexAttribArray(uInInstance);
+}
+
+void Engine::TreeProgram::setInstanceBufferOffset(unsigned int instanceBuffer, size_t firstInstance)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(uInInstance, 4, GL_FLOAT, GL_FALSE, 0, (void*)(firstInstance * sizeof(glm::vec4)));
+}
+
 void Engine::TreeProgram::applyGlobalUniforms()
 {
 	if (!(parameters & Engine::TreeProgram::SHADOW_MAP))
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture0()->getTexture()->getTextureId());
-		glUniform1i(uDepthMap0, 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture1()->getTexture()->getTextureId());
-		glUniform1i(uDepthMap1, 1);
+		Engine::CascadeShadowMaps::getInstance().bindShadowMaps(GL_TEXTURE0);
+		glUniform1i(uShadowMaps, 0);
 
-		glm::vec3 ld = glm::normalize(Engine::Settings::lightDirection);
-		glUniform3fv(uLightDir, 1, &ld[0]);
+		Engine::RenderStatistics::uniformUploads++;
 	}
 
-	float sinTime = glm::sin(Engine::Time::timeSinceBegining);
-	sinTime *= sinTime;
-	glUniform1f(uSinTime, sinTime);
-	glUniform3fv(uWindDir, 1, &Engine::Settings::windDirection[0]);
-	glUniform1f(uWindStrength, Engine::Settings::windStrength);
-
-	glUniform1f(uMaxHeight, Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight);
-	glUniform1f(uWorldScale, Engine::Settings::worldTileScale);
+	// Wind, terrain and light settings are read from the FrameGlobals block (see FrameGlobalsBuffer)
 }
 
 void Engine::TreeProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
@@ -202,32 +174,41 @@ void Engine::TreeProgram::onRenderObject(const Engine::Object * obj, Engine::Cam
 	glUniformMatrix4fv(uModelView, 1, GL_FALSE, &(modelView[0][0]));
 	glUniformMatrix4fv(uNormal, 1, GL_FALSE, &(normal[0][0]));
 
-	glUniform1f(uAmplitude, Engine::Settings::terrainAmplitude);
-	glUniform1f(uFrecuency, Engine::Settings::terrainFrecuency);
-	glUniform1f(uScale, Engine::Settings::terrainScale);
-	glUniform1i(uOctaves, Engine::Settings::terrainOctaves);
-	glUniform1f(uWaterLevel, Engine::Settings::waterHeight);
+	Engine::RenderStatistics::uniformUploads += 3;
 }
 
 void Engine::TreeProgram::setUniformTileUV(float u, float v)
 {
 	glUniform2f(uGridUV, u, v);
+	Engine::RenderStatistics::uniformUploads++;
 }
 
 void Engine::TreeProgram::setUniformLightDepthMat(const glm::mat4 & ldm)
 {
 	glUniformMatrix4fv(uLightDepthMat0, 1, GL_FALSE, &(ldm[0][0]));
+	Engine::RenderStatistics::uniformUploads++;
 }
 
-void Engine::TreeProgram::setUniformLightDepthMat1(const glm::mat4 & ldp)
+void Engine::TreeProgram::setUniformBakeMatrices(const glm::mat4 & view, const glm::mat4 & proj)
 {
-	glUniformMatrix4fv(uLightDepthMat1, 1, GL_FALSE, &(ldp[0][0]));
+	// Normals are kept on the tree local space
+	glm::mat4 modelViewProj = proj * view;
+	glm::mat4 normal(1.0f);
+
+	glUniformMatrix4fv(uModelViewProj, 1, GL_FALSE, &(modelViewProj[0][0]));
+	glUniformMatrix4fv(uModelView, 1, GL_FALSE, &(view[0][0]));
+	glUniformMatrix4fv(uNormal, 1, GL_FALSE, &(normal[0][0]));
+
+	Engine::RenderStatistics::uniformUploads += 3;
 }
 
 void Engine::TreeProgram::destroy()
 {
-	glDetachShader(glProgram, gShader);
-	glDeleteShader(gShader);
+	if (gShader != 0)
+	{
+		glDetachShader(glProgram, gShader);
+		glDeleteShader(gShader);
+	}
 
 	Engine::Program::destroy();
 }
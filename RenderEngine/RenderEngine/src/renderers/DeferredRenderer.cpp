@@ -4,20 +4,33 @@
 #include "datatables/DeferredObjectsTable.h"
 #include "datatables/MeshTable.h"
 #include "datatables/ProgramTable.h"
+#include "postprocessprograms/HDRToneMappingProgram.h"
+#include "postprocessprograms/DepthOfFieldProgram.h"
+#include "postprocessprograms/BilateralUpsampleProgram.h"
+#include "GLStateCache.h"
+#include "WorldConfig.h"
 
 #include "volumetricclouds/NoiseInitializer.h"
 #include "CascadeShadowMaps.h"
+#include "ClusteredLightBuffer.h"
+#include "Profiler.h"
 
 Engine::DeferredRenderer::DeferredRenderer()
 	:Engine::Renderer()
 {
 	initialized = false;
 
+	chainOutput = toneMappingInput = toneMappingPass = depthOfFieldPass = Engine::RenderGraph::INVALID;
+	fusedOutput = NULL;
+	fusedBuffer = NULL;
+	fusedTexture = NULL;
+
 	renderFunc = &DeferredRenderer::initializeLoop;
 }
 
 Engine::DeferredRenderer::~DeferredRenderer()
 {
+	renderGraph.clean();
 }
 
 void Engine::DeferredRenderer::addPostProcess(Engine::PostProcessChainNode * object)
@@ -25,9 +38,19 @@ void Engine::DeferredRenderer::addPostProcess(Engine::PostProcessChainNode * obj
 	postProcessChain.push_back(object);
 }
 
-const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferPos()
+Engine::RenderGraph & Engine::DeferredRenderer::getRenderGraph()
+{
+	return renderGraph;
+}
+
+const std::list<Engine::PostProcessChainNode *> & Engine::DeferredRenderer::getPostProcessChain()
+{
+	return postProcessChain;
+}
+
+bool Engine::DeferredRenderer::isFusedPostProcessAvailable()
 {
-	return gBufferPos;
+	return fusedOutput != NULL;
 }
 
 const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferColor()
@@ -45,19 +68,19 @@ const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferNormal()
 	return gBufferNormal;
 }
 
-const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferSpecular()
+const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferDepth()
 {
-	return gBufferSpecular;
+	return gBufferDepth;
 }
 
-const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferDepth()
+const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferMaterial()
 {
-	return gBufferDepth;
+	return gBufferMaterial;
 }
 
-const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferInfo()
+size_t Engine::DeferredRenderer::getGBufferMemory()
 {
-	return gBufferInfo;
+	return forwardPassBuffer->getMemoryUsage();
 }
 
 void Engine::DeferredRenderer::initialize()
@@ -69,14 +92,12 @@ void Engine::DeferredRenderer::initialize()
 
 	initialized = true;
 
-	// Create G Buffers
-	forwardPassBuffer = new Engine::DeferredRenderObject(6, true);
+	// Create G Buffers (28 bytes per pixel, the position is reconstructed from the depth)
+	forwardPassBuffer = new Engine::DeferredRenderObject(4, true);
 	gBufferColor = forwardPassBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_COLOR, GL_NEAREST);
-	gBufferNormal = forwardPassBuffer->addColorBuffer(1, GL_RGB32F, GL_RGBA, GL_UNSIGNED_BYTE, 500, 500, Engine::DeferredRenderObject::G_BUFFER_NORMAL, GL_NEAREST);
-	gBufferSpecular = forwardPassBuffer->addColorBuffer(2, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_SPECULAR, GL_NEAREST);
+	gBufferNormal = forwardPassBuffer->addColorBuffer(1, GL_RG16, GL_RG, GL_UNSIGNED_SHORT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_NORMAL, GL_NEAREST);
+	gBufferMaterial = forwardPassBuffer->addColorBuffer(2, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "MaterialBuffer", GL_LINEAR);
 	gBufferEmissive = forwardPassBuffer->addColorBuffer(3, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_EMISSIVE, GL_NEAREST);
-	gBufferPos = forwardPassBuffer->addColorBuffer(4, GL_RGB32F, GL_RGBA, GL_UNSIGNED_BYTE, 500, 500, Engine::DeferredRenderObject::G_BUFFER_POS, GL_NEAREST);
-	gBufferInfo = forwardPassBuffer->addColorBuffer(5, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "InfoBuffer", GL_LINEAR);
 	gBufferDepth = forwardPassBuffer->addDepthBuffer24(500, 500);
 	forwardPassBuffer->initialize();
 
@@ -90,27 +111,73 @@ void Engine::DeferredRenderer::initialize()
 
 	// Creage deferred shading buffer
 	deferredPassBuffer = new Engine::DeferredRenderObject(3, false);
-	deferredPassBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_NEAREST);	// Color info
-	deferredPassBuffer->addColorBuffer(1, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_NEAREST);	// Emission info
-	deferredPassBuffer->addColorBuffer(2, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);		// God rays info
+	Engine::TextureInstance * shadedColor = deferredPassBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_NEAREST);	// Color info
+	Engine::TextureInstance * shadedEmission = deferredPassBuffer->addColorBuffer(1, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_NEAREST);	// Emission info
+	Engine::TextureInstance * shadedInfo = deferredPassBuffer->addColorBuffer(2, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);		// God rays info
 	deferredPassBuffer->addDepthBuffer24(500, 500);
 	deferredPassBuffer->initialize();
 
-	// Linke post processes as a chain
+	// Link post processes as a chain: each pass reads the outputs of the previous one
+	std::vector<unsigned int> previousLink;
+	previousLink.push_back(renderGraph.importTexture("Color", shadedColor));
+	previousLink.push_back(renderGraph.importTexture("Emission", shadedEmission));
+	previousLink.push_back(renderGraph.importTexture("God rays info", shadedInfo));
+
 	std::list<Engine::PostProcessChainNode *>::iterator it = postProcessChain.begin();
-	Engine::DeferredRenderObject * previousLink = deferredPassBuffer;
 	while (it != postProcessChain.end())
 	{
 		Engine::PostProcessChainNode * node = (*it);
-		// Initialize FBO and textures
-		node->renderBuffer->initialize();
-		// Set the output of the previous pass as the input of the next
-		previousLink->populateDeferredObject(node->obj);
-		previousLink = node->renderBuffer;
+		const std::string & name = node->postProcessProgram->getName();
+
+		std::vector<unsigned int> outputs;
+		for (unsigned int i = 0; i < node->outputs.size(); i++)
+		{
+			outputs.push_back(renderGraph.createTexture(name + "_" + std::to_string(i), node->outputs[i]));
+		}
+
+		node->pass = renderGraph.addPass(name, node->postProcessProgram, node->obj, previousLink, outputs);
+		if (name == Engine::HDRToneMappingProgram::PROGRAM_NAME)
+		{
+			toneMappingPass = node->pass;
+			toneMappingInput = previousLink[0];
+		}
+		else if (name == Engine::DepthOfFieldProgram::PROGRAM_NAME)
+		{
+			depthOfFieldPass = node->pass;
+		}
+
+		// Nodes which may run below full resolution are followed by a depth aware upsample
+		// which adds their contribution back to the full resolution input
+		node->upsamplePass = Engine::RenderGraph::INVALID;
+		bool scaled = false;
+		for (unsigned int i = 0; i < Engine::PostProcessQuality::POSTPROCESS_QUALITY_COUNT; i++)
+		{
+			scaled = scaled || node->resolutionScale[i] < 1.0f;
+		}
+
+		if (scaled)
+		{
+			Engine::Program * upsample = Engine::ProgramTable::getInstance().getProgram<Engine::BilateralUpsampleProgram>();
+			upsample->configureMeshBuffers(mi);
+
+			std::vector<unsigned int> upsampleInputs;
+			upsampleInputs.push_back(outputs[0]);
+			upsampleInputs.push_back(previousLink[0]);
+
+			Engine::RenderTargetDesc desc = node->outputs[0];
+			desc.widthScale = desc.heightScale = 1.0f;
+			std::vector<unsigned int> upsampleOutputs;
+			upsampleOutputs.push_back(renderGraph.createTexture(name + "_upsampled", desc));
+
+			node->upsamplePass = renderGraph.addPass("Upsample " + name, upsample, new Engine::PostProcessObject(mi), upsampleInputs, upsampleOutputs);
+			outputs = upsampleOutputs;
+		}
+
+		previousLink = outputs;
 
 		if (node->callBack != 0)
 		{
-			node->callBack->initialize(node->obj, node->postProcessProgram, node->renderBuffer);
+			node->callBack->initialize(node->obj, node->postProcessProgram);
 		}
 
 		it++;
@@ -122,7 +189,16 @@ void Engine::DeferredRenderer::initialize()
 	chainEnd = new Engine::PostProcessObject(mi);
 
 	// Close the final link (will output to screen)
-	previousLink->populateDeferredObject(chainEnd);
+	chainOutput = previousLink[0];
+	renderGraph.setOutput(chainOutput, chainEnd);
+
+	// The fused output replaces the last 2 passes
+	if (toneMappingPass != Engine::RenderGraph::INVALID && toneMappingPass + 1 == depthOfFieldPass
+		&& depthOfFieldPass + 1 == renderGraph.getNumPasses())
+	{
+		fusedOutput = new Engine::FusedPostProcessProgram();
+		fusedOutput->initialize();
+	}
 }
 
 void Engine::DeferredRenderer::doRender()
@@ -139,37 +215,64 @@ void Engine::DeferredRenderer::initializeLoop()
 
 void Engine::DeferredRenderer::renderLoop()
 {
+	// Progressive cloud noise generation (does nothing once it is complete)
+	Engine::CloudSystem::NoiseInitializer::getInstance().render();
+
 	// Prepare shadow projection matrices
 	Engine::CascadeShadowMaps::getInstance().initializeFrame(activeCam);
 
 	Engine::Scene * scene = Engine::SceneManager::getInstance().getActiveScene();
 
 	// Do forward pass
-	glBindFramebuffer(GL_FRAMEBUFFER, forwardPassBuffer->getFrameBufferId());
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	
-	// RENDER TERRAIN (TERRAIN, WATER, TREES, & SHADOWS)
-	scene->getTerrain()->render(activeCam);
+	{
+		Engine::ProfileScope profile("Terrain");
+
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, forwardPassBuffer->getFrameBufferId());
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		Engine::GLStateCache::getInstance().enable(GL_DEPTH_TEST);
+		Engine::GLStateCache::getInstance().enable(GL_CULL_FACE);
+
+		// RENDER TERRAIN (TERRAIN, WATER, TREES, & SHADOWS)
+		scene->getTerrain()->render(activeCam);
+	}
+
+	// Cluster the point and spot lights read by the deferred shading pass
+	{
+		Engine::ProfileScope profile("Light clustering");
+		Engine::GPU::ClusteredLightBuffer::getInstance().update(activeCam);
+	}
 
 	// Do deferred shading pass
-	glDisable(GL_CULL_FACE);
-	glBindFramebuffer(GL_FRAMEBUFFER, deferredPassBuffer->getFrameBufferId());
-	glClear(GL_DEPTH_BUFFER_BIT);
-	deferredShading->use();
-	deferredDrawSurface->getMesh()->use();
-	deferredShading->onRenderObject(deferredDrawSurface, activeCam);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	{
+		Engine::ProfileScope profile("Deferred shading");
+
+		Engine::GLStateCache::getInstance().disable(GL_CULL_FACE);
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, deferredPassBuffer->getFrameBufferId());
+		glClear(GL_DEPTH_BUFFER_BIT);
+		deferredShading->use();
+		deferredDrawSurface->getMesh()->use();
+		deferredShading->onRenderObject(deferredDrawSurface, activeCam);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
 
 	// Render the skybox after shading is performed (SKY, SUN, & CLOUDS)
 	scene->getSkyBox()->render(activeCam);
 
 	// Run the post-process chain
 	runPostProcesses();
-	
+
+	if (isFusedPostProcessAvailable() && Engine::Settings::fusedPostProcess)
+		renderFusedOutput();
+	else
+		renderScreenOutput();
+}
+
+void Engine::DeferredRenderer::renderScreenOutput()
+{
+	Engine::ProfileScope profile("Screen output");
+
 	// Enable default framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, 0);
 	glClear(GL_DEPTH_BUFFER_BIT);
 
 	// Output the final result to screen
@@ -180,36 +283,69 @@ void Engine::DeferredRenderer::renderLoop()
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
-void Engine::DeferredRenderer::runPostProcesses()
+void Engine::DeferredRenderer::renderFusedOutput()
 {
-	glDisable(GL_DEPTH_TEST);
-	std::list<Engine::PostProcessChainNode *>::iterator it = postProcessChain.begin();
-	while (it != postProcessChain.end())
+	Engine::ProfileScope profile("Fused output");
+
+	unsigned int width = Engine::ScreenManager::SCREEN_WIDTH;
+	unsigned int height = Engine::ScreenManager::SCREEN_HEIGHT;
+
+	if (fusedBuffer == NULL)
 	{
-		Engine::PostProcessChainNode * node = (*it);
+		fusedBuffer = new Engine::DeferredRenderObject(1, false);
+		fusedTexture = fusedBuffer->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, width, height, "", GL_NEAREST);
+		fusedBuffer->initialize();
+		fusedBuffer->resizeFBO(width, height);
+	}
 
-		Engine::DeferredRenderObject * buffer = node->renderBuffer;
-		glBindFramebuffer(GL_FRAMEBUFFER, buffer->getFrameBufferId());
+	// The chain input already holds the tone mapping input (see runPostProcesses())
+	Engine::GLStateCache::getInstance().useProgram(fusedOutput->getProgramId());
+	fusedOutput->bindTextures(chainEnd->getTexture("color_0"), gBufferDepth, fusedTexture);
+	fusedOutput->setParameters(activeCam, renderGraph.isPassEnabled(toneMappingPass), renderGraph.isPassEnabled(depthOfFieldPass));
+	fusedOutput->dispatchScreen(width, height, GL_FRAMEBUFFER_BARRIER_BIT);
 
-		Engine::Program * prog = node->postProcessProgram;
-		prog->use();
+	// Copy to the default framebuffer (compute shaders can not write to it)
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_READ_FRAMEBUFFER, fusedBuffer->getFrameBufferId());
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
 
-		//if (node->callBack != 0)
-		//{
-		//	node->callBack->execute(node->obj, node->postProcessProgram, node->renderBuffer, activeCam);
-		//}
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, 0);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
 
-		node->obj->getMesh()->use();
+void Engine::DeferredRenderer::runPostProcesses()
+{
+	Engine::ProfileScope profile("Post processes");
 
-		prog->onRenderObject(node->obj, activeCam);
+	// With the fused output the chain stops before tone mapping, so the last passes are culled
+	bool fused = isFusedPostProcessAvailable() && Engine::Settings::fusedPostProcess;
+	renderGraph.setOutput(fused ? toneMappingInput : chainOutput, chainEnd);
+
+	// Apply the resolution of the current quality preset. The upsample only runs
+	// along with its node, and only when the node is below full resolution
+	std::list<Engine::PostProcessChainNode *>::iterator it = postProcessChain.begin();
+	while (it != postProcessChain.end())
+	{
+		Engine::PostProcessChainNode * node = (*it);
+		float scale = node->resolutionScale[Engine::Settings::postProcessQuality];
+		renderGraph.setPassScale(node->pass, scale);
+
+		if (node->upsamplePass != Engine::RenderGraph::INVALID)
+		{
+			renderGraph.setPassEnabled(node->upsamplePass, scale < 1.0f && renderGraph.isPassEnabled(node->pass));
+		}
 
-		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 		it++;
 	}
-	glEnable(GL_DEPTH_TEST);
+
+	Engine::GLStateCache::getInstance().disable(GL_DEPTH_TEST);
+	// Recompiles the graph only if a pass was toggled or the screen resized
+	renderGraph.execute(activeCam);
+	Engine::GLStateCache::getInstance().enable(GL_DEPTH_TEST);
 }
 
 void Engine::DeferredRenderer::onResize(unsigned int w, unsigned int h)
 {
 	Engine::DeferredObjectsTable::getInstance().onResize(int(w), int(h));
+	renderGraph.onResize(w, h);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "renderers/ForwardRenderer.h"
 
 #include "Scene.h"
+#include "GLStateCache.h"
 
 Engine::ForwardRenderer::ForwardRenderer()
 	:Engine::Renderer()
@@ -47,7 +48,7 @@ void Engine::ForwardRenderer::renderProgram(Engine::Camera * camera, Engine::Pro
 	for (it = renderables->objects.cbegin(); it != renderables->objects.cend(); it++)
 	{
 		// Stablish vao to use
-		glBindVertexArray(it->first);
+		Engine::GLStateCache::getInstance().bindVertexArray(it->first);
 
 		std::list<Engine::Object *> meshes = it->second;
 		std::list<Engine::Object *>::iterator listIt;
@@ -58,7 +59,7 @@ void Engine::ForwardRenderer::renderProgram(Engine::Camera * camera, Engine::Pro
 			program->onRenderObject(objToRender, camera);
 
 			unsigned int vertexPerFace = objToRender->getMesh()->getNumVerticesPerFace();
-			glDrawElements(objToRender->getRenderMode(), objToRender->getMesh()->getNumFaces() * vertexPerFace, GL_UNSIGNED_INT, (void*)0);
+			glDrawElements(objToRender->getRenderMode(), objToRender->getMesh()->getNumFaces() * vertexPerFace, objToRender->getMesh()->getIndexType(), (void*)0);
 		}
 	}
 }
@@ -2,6 +2,7 @@
 
 #include "datatables/MeshTable.h"
 #include "datatables/ProgramTable.h"
+#include "GLStateCache.h"
 
 #include "Scene.h"
 
@@ -62,7 +63,7 @@ void Engine::SideBySideRenderer::doRender()
 	if (clearScreen)
 	{
 		// Needed to clear screen when switching from a full screen renderer
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, 0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		if (c == 1)
 		{
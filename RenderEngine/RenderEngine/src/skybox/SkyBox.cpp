@@ -3,6 +3,7 @@
 #include "datatables/ProgramTable.h"
 #include "datatables/MeshTable.h"
 #include "Scene.h"
+#include "Profiler.h"
 
 #include <iostream>
 
@@ -32,6 +33,8 @@ Engine::SkyBox::~SkyBox()
 
 void Engine::SkyBox::render(Engine::Camera * camera)
 {
+	Engine::ProfileScope profile("Sky box");
+
 	// Switch to less-equal depth testing to be able to render the skybox
 	// on the max depth, behind everything
 	glDepthFunc(GL_LEQUAL);
@@ -47,7 +50,7 @@ void Engine::SkyBox::render(Engine::Camera * camera)
 	cubeMesh->setTranslation(cubePos);
 	shader->onRenderObject(cubeMesh, camera);
 
-	glDrawElements(renderMode, data->getNumFaces() * data->getNumVerticesPerFace(), GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(renderMode, data->getNumFaces() * data->getNumVerticesPerFace(), data->getIndexType(), (void*)0);
 
 	glDepthFunc(GL_LESS);
 
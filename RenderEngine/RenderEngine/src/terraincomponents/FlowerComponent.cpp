@@ -3,9 +3,11 @@
 #include "datatables/ProgramTable.h"
 #include "datatables/MeshTable.h"
 #include "datatables/VegetationTable.h"
+#include "GLStateCache.h"
 
-#include "CascadeShadowMaps.h"
 #include "ProceduralVegetation.h"
+#include "RenderStatistics.h"
+#include "TerrainTileCache.h"
 
 #include <random>
 
@@ -20,6 +22,11 @@ unsigned int Engine::FlowerComponent::getRenderRadius()
 	return 3;
 }
 
+const char * Engine::FlowerComponent::getName()
+{
+	return "Flowers";
+}
+
 void Engine::FlowerComponent::initialize()
 {
 	// SHADERS
@@ -31,7 +38,18 @@ void Engine::FlowerComponent::initialize()
 
 	activeShader = fillShader;
 
+	instancedFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::INSTANCED);
+
+	instancedWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::WIRE_MODE | Engine::TreeProgram::INSTANCED);
+
+	instancedPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::POINT_MODE | Engine::TreeProgram::INSTANCED);
+
+	activeInstancedShader = instancedFillShader;
+
+	instanceCamera = NULL;
+
 	flowersToSpawn = 35;
+	vegetationPatternId = Engine::TerrainTileCache::getInstance().registerScatteredVegetation((unsigned int)flowersToSpawn);
 
 	std::uniform_int_distribution<unsigned int> d(0, 50000);
 	std::default_random_engine e(0);
@@ -57,35 +75,59 @@ void Engine::FlowerComponent::initialize()
 
 	fillShader->configureMeshBuffers(m);
 	wireShader->configureMeshBuffers(m);
+	instancedFillShader->configureMeshBuffers(m);
+	instancedWireShader->configureMeshBuffers(m);
+
+	instances.init(1);
+	instancedFillShader->configureInstanceBuffer(m, instances.getBuffer());
 
 	flower = new Engine::Object(m);
+	computeMeshBounds(m, flowerMin, flowerMax);
 }
 
 void Engine::FlowerComponent::preRenderComponent()
 {
-	glBindVertexArray(flower->getMesh()->vao);
+	Engine::GLStateCache::getInstance().bindVertexArray(flower->getMesh()->vao);
+	instances.clear();
 }
 
 void Engine::FlowerComponent::renderComponent(int i, int j, Engine::Camera * cam)
 {
-	// We have to travel way to much to make this seed system not to work...
-	unsigned int seed = (j << 16) | i;
 	float posX = i * scale;
 	float posZ = j * scale;
 
-	std::uniform_real_distribution<float> dTerrain(0.0f, 1.0f);
-	std::default_random_engine eTerrain(seed);
+	// Flower positions are scattered on the tile cache worker threads. Until the tile is ready, the
+	// same positions are generated here (the GPU discards the ones out of the vegetation band)
+	tilePositions.clear();
+	std::shared_ptr<const Engine::TerrainTile> tile = Engine::TerrainTileCache::getInstance().getTile(i, j);
+	if (tile && vegetationPatternId < tile->vegetation.size())
+	{
+		for (auto & placement : tile->vegetation[vegetationPatternId])
+		{
+			tilePositions.push_back(placement.uv);
+		}
+	}
+	else
+	{
+		Engine::TerrainTileCache::scatterVegetation(i, j, (unsigned int)flowersToSpawn, tilePositions);
+	}
 
-	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	if (Engine::Settings::instancedVegetation)
+	{
+		instanceCamera = cam;
+		for (auto & position : tilePositions)
+		{
+			instances.add(0, posX + position.x * scale, posZ + position.y * scale, abs(i + position.x), abs(j + position.y));
+		}
+		return;
+	}
 
 	const unsigned int numElements = flower->getMesh()->getNumFaces() * 3;
 
-	unsigned int z = 0;
-	while (z < flowersToSpawn)
+	for (auto & position : tilePositions)
 	{
-		z++;
-		float uOffset = dTerrain(eTerrain);
-		float vOffset = dTerrain(eTerrain);
+		float uOffset = position.x;
+		float vOffset = position.y;
 
 		float treePosX = posX + uOffset * scale;
 		float treePosZ = posZ + vOffset * scale;
@@ -96,14 +138,42 @@ void Engine::FlowerComponent::renderComponent(int i, int j, Engine::Camera * cam
 		float v = abs(j + vOffset);
 
 		activeShader->setUniformTileUV(u, v);
-		activeShader->setUniformLightDepthMat(csm.getDepthMatrix0() * flower->getModelMatrix());
-		activeShader->setUniformLightDepthMat1(csm.getDepthMatrix1() * flower->getModelMatrix());
 		activeShader->onRenderObject(flower, cam);
 
-		glDrawElements(GL_TRIANGLES, numElements, GL_UNSIGNED_INT, (void*)0);
+		glDrawElements(GL_TRIANGLES, numElements, flower->getMesh()->getIndexType(), (void*)0);
+		Engine::RenderStatistics::drawCalls++;
+		Engine::RenderStatistics::drawnInstances++;
 	}
 }
 
+void Engine::FlowerComponent::postRenderComponent()
+{
+	if (Engine::Settings::instancedVegetation)
+	{
+		renderInstances();
+	}
+}
+
+void Engine::FlowerComponent::renderInstances()
+{
+	instances.upload();
+	if (instances.getInstanceCount() == 0)
+		return;
+
+	// The flower position comes from the instance data, so the model matrix is the identity
+	flower->setTranslation(glm::vec3(0.0f));
+
+	activeInstancedShader->onRenderObject(flower, instanceCamera);
+
+	Engine::GLStateCache::getInstance().bindVertexArray(flower->getMesh()->vao);
+	activeInstancedShader->setInstanceBufferOffset(instances.getBuffer(), 0);
+
+	size_t count = instances.getTypeCount(0);
+	glDrawElementsInstanced(GL_TRIANGLES, flower->getMesh()->getNumFaces() * 3, flower->getMesh()->getIndexType(), (void*)0, GLsizei(count));
+	Engine::RenderStatistics::drawCalls++;
+	Engine::RenderStatistics::drawnInstances += (unsigned int)count;
+}
+
 void Engine::FlowerComponent::renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
 {
 	
@@ -115,19 +185,27 @@ void Engine::FlowerComponent::notifyRenderModeChange(Engine::RenderMode mode)
 	{
 	case Engine::RenderMode::RENDER_MODE_SHADED:
 		activeShader = fillShader;
+		activeInstancedShader = instancedFillShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_WIRE:
 		activeShader = wireShader;
+		activeInstancedShader = instancedWireShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_POINT:
 		activeShader = pointShader;
+		activeInstancedShader = instancedPointShader;
 		break;
 	}
 }
 
+bool Engine::FlowerComponent::getTileBounds(int i, int j, glm::vec3 & min, glm::vec3 & max)
+{
+	return getVegetationTileBounds(i, j, flowerMin, flowerMax, min, max);
+}
+
 Engine::Program * Engine::FlowerComponent::getActiveShader()
 {
-	return activeShader;
+	return Engine::Settings::instancedVegetation ? activeInstancedShader : activeShader;
 }
 
 Engine::Program * Engine::FlowerComponent::getShadowMapShader()
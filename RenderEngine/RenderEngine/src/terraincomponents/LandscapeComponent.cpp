@@ -2,8 +2,9 @@
 
 #include "datatables/ProgramTable.h"
 #include "datatables/MeshTable.h"
+#include "GLStateCache.h"
 
-#include "CascadeShadowMaps.h"
+#include "RenderStatistics.h"
 
 Engine::LandscapeComponent::LandscapeComponent()
 	:Engine::TerrainComponent()
@@ -16,6 +17,11 @@ unsigned int Engine::LandscapeComponent::getRenderRadius()
 	return 12;
 }
 
+const char * Engine::LandscapeComponent::getName()
+{
+	return "Landscape";
+}
+
 void Engine::LandscapeComponent::initialize()
 {
 	fillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>();
@@ -38,30 +44,87 @@ void Engine::LandscapeComponent::initialize()
 	shadowShader->configureMeshBuffers(tile);
 
 	activeShader = fillShader;
+
+	batchedFillShader = NULL;
+	batchedWireShader = NULL;
+	batchedPointShader = NULL;
+	batchedShadowShader = NULL;
+	activeBatchedShader = NULL;
+	batchOrigin = new Engine::Object(tile);
+	batchCamera = NULL;
+	batchShadow = false;
+
+	if (Engine::TileDrawBatch::isSupported())
+	{
+		batchedFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+			Engine::ProceduralTerrainProgram::MULTI_DRAW);
+
+		batchedWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+			Engine::ProceduralTerrainProgram::WIRE_DRAW_MODE | Engine::ProceduralTerrainProgram::MULTI_DRAW);
+
+		batchedPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+			Engine::ProceduralTerrainProgram::POINT_DRAW_MODE | Engine::ProceduralTerrainProgram::MULTI_DRAW);
+
+		batchedShadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+			Engine::ProceduralTerrainProgram::SHADOW_MAP | Engine::ProceduralTerrainProgram::MULTI_DRAW);
+
+		activeBatchedShader = batchedFillShader;
+
+		// Terrain renders up to (2 * radius)^2 tiles per pass
+		unsigned int diameter = getRenderRadius() * 2;
+		tileBatch.init(size_t(diameter * diameter), tile->getNumFaces() * 3, tile->getIndexType());
+	}
+}
+
+bool Engine::LandscapeComponent::isBatched()
+{
+	return Engine::Settings::batchedTerrain && tileBatch.isInitialized();
 }
 
 void Engine::LandscapeComponent::preRenderComponent()
 {
-	glBindVertexArray(landscapeTile->getMesh()->vao);
+	Engine::GLStateCache::getInstance().bindVertexArray(landscapeTile->getMesh()->vao);
+
+	if (isBatched())
+	{
+		tileBatch.begin();
+	}
 }
 
 void Engine::LandscapeComponent::renderComponent(int i, int j, Engine::Camera * cam)
 {
+	if (isBatched())
+	{
+		batchCamera = cam;
+		batchShadow = false;
+		tileBatch.add(i, j);
+		return;
+	}
+
 	float poxX = i * scale;
 	float posZ = j * scale;
 	landscapeTile->setTranslation(glm::vec3(poxX, 0.0f, posZ));
 
 	activeShader->setUniformGridPosition(i, j);
-	activeShader->setUniformLightDepthMatrix(Engine::CascadeShadowMaps::getInstance().getDepthMatrix0() * landscapeTile->getModelMatrix());
-	activeShader->setUniformLightDepthMatrix1(Engine::CascadeShadowMaps::getInstance().getDepthMatrix1() * landscapeTile->getModelMatrix());
-
 	activeShader->onRenderObject(landscapeTile, cam);
 
-	glDrawElements(GL_PATCHES, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_PATCHES, 6, landscapeTile->getMesh()->getIndexType(), (void*)0);
+	Engine::RenderStatistics::drawCalls++;
+	Engine::RenderStatistics::drawnInstances++;
 }
 
 void Engine::LandscapeComponent::renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
 {
+	if (isBatched())
+	{
+		batchCamera = cam;
+		batchShadow = true;
+		batchShadowProjection = projection;
+		// Static shadow cache passes may cover more tiles than the render radius, the batch grows to fit them
+		tileBatch.add(i, j);
+		return;
+	}
+
 	float poxX = i * scale;
 	float posZ = j * scale;
 	landscapeTile->setTranslation(glm::vec3(poxX, 0.0f, posZ));
@@ -71,7 +134,36 @@ void Engine::LandscapeComponent::renderShadow(const glm::mat4 & projection, int
 
 	shadowShader->onRenderObject(landscapeTile, cam);
 
-	glDrawElements(GL_PATCHES, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_PATCHES, 6, landscapeTile->getMesh()->getIndexType(), (void*)0);
+	Engine::RenderStatistics::drawCalls++;
+	Engine::RenderStatistics::drawnInstances++;
+}
+
+void Engine::LandscapeComponent::postRenderComponent()
+{
+	if (isBatched())
+	{
+		renderBatch();
+	}
+}
+
+void Engine::LandscapeComponent::renderBatch()
+{
+	if (tileBatch.getTileCount() == 0)
+		return;
+
+	// Per pass matrices only, the tile transform is rebuilt on the shaders from its grid position
+	if (batchShadow)
+	{
+		batchedShadowShader->setUniformLightDepthMatrix(batchShadowProjection);
+		batchedShadowShader->onRenderObject(batchOrigin, batchCamera);
+	}
+	else
+	{
+		activeBatchedShader->onRenderObject(batchOrigin, batchCamera);
+	}
+
+	tileBatch.draw(GL_PATCHES);
 }
 
 void Engine::LandscapeComponent::notifyRenderModeChange(Engine::RenderMode mode)
@@ -80,22 +172,25 @@ void Engine::LandscapeComponent::notifyRenderModeChange(Engine::RenderMode mode)
 	{
 	case Engine::RenderMode::RENDER_MODE_SHADED:
 		activeShader = fillShader;
+		activeBatchedShader = batchedFillShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_WIRE:
 		activeShader = wireShader;
+		activeBatchedShader = batchedWireShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_POINT:
 		activeShader = pointShader;
+		activeBatchedShader = batchedPointShader;
 		break;
 	}
 }
 
 Engine::Program * Engine::LandscapeComponent::getActiveShader()
 {
-	return activeShader;
+	return isBatched() ? activeBatchedShader : activeShader;
 }
 
 Engine::Program * Engine::LandscapeComponent::getShadowMapShader()
 {
-	return shadowShader;
+	return isBatched() ? batchedShadowShader : shadowShader;
 }
\ No newline at end of file
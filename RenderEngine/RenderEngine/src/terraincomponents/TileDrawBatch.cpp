@@ -0,0 +1,184 @@
+#include "terraincomponents/TileDrawBatch.h"
+
+#include <iostream>
+
+#include "RenderStatistics.h"
+
+const unsigned int Engine::TileDrawBatch::TILE_INDEX_LOCATION = 2;
+const unsigned int Engine::TileDrawBatch::GRID_POSITIONS_BINDING = 0;
+const unsigned int Engine::TileDrawBatch::NUM_SEGMENTS = 12;
+
+// One second, in nanoseconds
+const GLuint64 FENCE_TIMEOUT = 1000000000;
+
+Engine::TileDrawBatch::TileDrawBatch()
+	:commandBuffer(0)
+	,gridBuffer(0)
+	,tileIndexBuffer(0)
+	,commands(NULL)
+	,gridPositions(NULL)
+	,maxTiles(0)
+	,indexCount(0)
+	,indexType(GL_UNSIGNED_INT)
+	,segment(0)
+	,tileCount(0)
+{
+}
+
+bool Engine::TileDrawBatch::isSupported()
+{
+	return GLEW_ARB_buffer_storage && GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object;
+}
+
+void Engine::TileDrawBatch::init(size_t maxTiles, unsigned int indexCount, unsigned int indexType)
+{
+	this->maxTiles = maxTiles;
+	this->indexCount = indexCount;
+	this->indexType = indexType;
+
+	size_t totalTiles = maxTiles * NUM_SEGMENTS;
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &commandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferStorage(GL_DRAW_INDIRECT_BUFFER, totalTiles * sizeof(DrawElementsIndirectCommand), NULL, flags);
+	commands = (DrawElementsIndirectCommand*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, totalTiles * sizeof(DrawElementsIndirectCommand), flags);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glGenBuffers(1, &gridBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridBuffer);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, totalTiles * sizeof(glm::ivec2), NULL, flags);
+	gridPositions = (glm::ivec2*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, totalTiles * sizeof(glm::ivec2), flags);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// Instanced attribute whose value is the instance number. The base instance of each
+	// command offsets it, giving the shaders the storage buffer index of the tile
+	std::vector<unsigned int> indices(totalTiles);
+	for (size_t k = 0; k < totalTiles; k++)
+	{
+		indices[k] = (unsigned int)k;
+	}
+
+	glGenBuffers(1, &tileIndexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, tileIndexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, totalTiles * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+	fences.resize(NUM_SEGMENTS, 0);
+	segment = 0;
+	tileCount = 0;
+}
+
+void Engine::TileDrawBatch::begin()
+{
+	segment = (segment + 1) % NUM_SEGMENTS;
+	tileCount = 0;
+
+	if (fences[segment] != 0)
+	{
+		GLenum result = glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+		while (result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(fences[segment], 0, FENCE_TIMEOUT);
+		}
+
+		glDeleteSync(fences[segment]);
+		fences[segment] = 0;
+	}
+}
+
+void Engine::TileDrawBatch::add(int i, int j)
+{
+	if (tileCount >= maxTiles)
+		grow(maxTiles > 0 ? maxTiles * 2 : 1);
+
+	size_t index = segment * maxTiles + tileCount;
+
+	DrawElementsIndirectCommand & command = commands[index];
+	command.count = indexCount;
+	command.instanceCount = 1;
+	command.firstIndex = 0;
+	command.baseVertex = 0;
+	command.baseInstance = (unsigned int)index;
+
+	gridPositions[index] = glm::ivec2(i, j);
+
+	tileCount++;
+}
+
+void Engine::TileDrawBatch::draw(GLenum mode)
+{
+	if (tileCount == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, tileIndexBuffer);
+	glVertexAttribIPointer(TILE_INDEX_LOCATION, 1, GL_UNSIGNED_INT, 0, 0);
+	glVertexAttribDivisor(TILE_INDEX_LOCATION, 1);
+	glEnableVertexAttribArray(TILE_INDEX_LOCATION);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GRID_POSITIONS_BINDING, gridBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+
+	size_t offset = segment * maxTiles * sizeof(DrawElementsIndirectCommand);
+	glMultiDrawElementsIndirect(mode, indexType, (void*)offset, GLsizei(tileCount), 0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	Engine::RenderStatistics::drawCalls++;
+	Engine::RenderStatistics::drawnInstances += (unsigned int)tileCount;
+}
+
+void Engine::TileDrawBatch::grow(size_t newMaxTiles)
+{
+	std::vector<glm::ivec2> pending(gridPositions + segment * maxTiles, gridPositions + segment * maxTiles + tileCount);
+
+	std::cout << "TileDrawBatch: Growing from " << maxTiles << " to " << newMaxTiles << " tiles per pass" << std::endl;
+
+	// The driver keeps the old buffers alive until the passes in flight are done with them
+	destroy();
+	init(newMaxTiles, indexCount, indexType);
+
+	for (auto & position : pending)
+	{
+		add(position.x, position.y);
+	}
+}
+
+void Engine::TileDrawBatch::destroy()
+{
+	for (auto & fence : fences)
+	{
+		if (fence != 0)
+		{
+			glDeleteSync(fence);
+			fence = 0;
+		}
+	}
+
+	if (commandBuffer != 0)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glDeleteBuffers(1, &commandBuffer);
+		commandBuffer = 0;
+		commands = NULL;
+	}
+
+	if (gridBuffer != 0)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridBuffer);
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glDeleteBuffers(1, &gridBuffer);
+		gridBuffer = 0;
+		gridPositions = NULL;
+	}
+
+	if (tileIndexBuffer != 0)
+	{
+		glDeleteBuffers(1, &tileIndexBuffer);
+		tileIndexBuffer = 0;
+	}
+}
@@ -3,15 +3,23 @@
 #include "datatables/ProgramTable.h"
 #include "datatables/MeshTable.h"
 #include "datatables/VegetationTable.h"
+#include "GLStateCache.h"
 
+#include "TerrainTileCache.h"
+#include "RenderStatistics.h"
 #include "CascadeShadowMaps.h"
 #include "ProceduralVegetation.h"
 
 #include <algorithm>
+#include <cfloat>
 #include <random>
 
 #include <iostream>
 
+const float Engine::TreeComponent::LOD_DISTANCES[Engine::TreeComponent::MESH_LODS] = { 2.5f, 4.5f, 7.5f };
+const float Engine::TreeComponent::LOD_HYSTERESIS = 0.35f;
+const unsigned int Engine::TreeComponent::SHADOW_LOD_BIAS = 1;
+
 Engine::TreeComponent::TreeComponent()
 	:Engine::TerrainComponent()
 {
@@ -20,7 +28,14 @@ Engine::TreeComponent::TreeComponent()
 
 unsigned int Engine::TreeComponent::getRenderRadius()
 {
-	return 6;
+	// The impostors let the trees reach the terrain tile cache radius. They are only drawn
+	// instanced, without instancing the far tiles would cost a draw call per tree
+	return Engine::Settings::treeLODs && Engine::Settings::instancedVegetation ? Engine::Settings::worldRenderRadius : 6;
+}
+
+const char * Engine::TreeComponent::getName()
+{
+	return "Trees";
 }
 
 void Engine::TreeComponent::initialize()
@@ -36,6 +51,32 @@ void Engine::TreeComponent::initialize()
 
 	activeShader = fillShader;
 
+	instancedFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::INSTANCED);
+
+	instancedWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::WIRE_MODE | Engine::TreeProgram::INSTANCED);
+
+	instancedPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::POINT_MODE | Engine::TreeProgram::INSTANCED);
+
+	instancedShadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::SHADOW_MAP | Engine::TreeProgram::INSTANCED);
+
+	activeInstancedShader = instancedFillShader;
+
+	impostorFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeImpostorProgram>();
+
+	impostorWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeImpostorProgram>(Engine::TreeImpostorProgram::WIRE_MODE);
+
+	impostorPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeImpostorProgram>(Engine::TreeImpostorProgram::POINT_MODE);
+
+	impostorShadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeImpostorProgram>(Engine::TreeImpostorProgram::SHADOW_MAP);
+
+	activeImpostorShader = impostorFillShader;
+
+	shadowInstances = false;
+	instanceCamera = NULL;
+
+	lodFrame = 0;
+	lodPass = false;
+
 	// JITTERED TREE POSITIONS
 	treesToSpawn = 12;
 	size_t jitterSize = treesToSpawn % 2 != 0 ? treesToSpawn + 1 : treesToSpawn;
@@ -65,6 +106,10 @@ void Engine::TreeComponent::initialize()
 	std::shuffle(rawJitter.begin(), rawJitter.end(), std::default_random_engine(0));
 	std::shuffle(rawJitter.begin(), rawJitter.end(), std::default_random_engine(5000));
 	memcpy(jitterPattern, &rawJitter[0], sizeof(glm::vec2) * columns * rows);
+	jitterPatternSize = size_t(columns * rows);
+
+	// Let the tile cache precompute which positions hold a tree on each tile
+	vegetationPatternId = Engine::TerrainTileCache::getInstance().registerVegetationPattern(rawJitter);
 
 	// TREE MESHES
 	initTrees();
@@ -82,9 +127,10 @@ void Engine::TreeComponent::initTrees()
 	std::uniform_real_distribution<float> trunkColor(0.0f, 1.0f);
 	std::default_random_engine eTrunk(d(e) * d(e));
 
+	std::vector<Engine::TreeGenerationData> treeConfigs(8);
 	for (int i = 0; i < 8; i++)
 	{
-		Engine::TreeGenerationData treeData;
+		Engine::TreeGenerationData & treeData = treeConfigs[i];
 		treeData.treeName = std::string("Tree_") + std::to_string(i);
 		treeData.emissiveLeaf = leafColor(eLeaf) > 0.8f;
 		treeData.startTrunkColor = trunkColor(eTrunk) >= 0.5f ? glm::vec3(0.2f, 0.2f, 0.0f) : glm::vec3(0.65f, 0.65f, 0.65f);
@@ -101,37 +147,113 @@ void Engine::TreeComponent::initTrees()
 		treeData.scalingFactor = (glm::vec3(0.75, 1.0, 0.75) + glm::vec3(0.0f, (1.0f - rotFactor) * 0.25f, 0.0f));
 		treeData.seed = d(e);
 		treeData.startBranchingDepth = 2;
+	}
 
-		Engine::Mesh * m = Engine::VegetationTable::getInstance().generateFractalTree(treeData, true);
+	// All the tree types and their levels of detail are built at once on the thread pool
+	std::vector<Engine::TreeLODChain> treeChains;
+	Engine::VegetationTable::getInstance().generateFractalTreeLODs(treeConfigs, MESH_LODS, treeChains, &impostorAtlas, true);
 
-		fillShader->configureMeshBuffers(m);
-		wireShader->configureMeshBuffers(m);
-		shadowShader->configureMeshBuffers(m);
+	for (size_t i = 0; i < treeChains.size(); i++)
+	{
+		for (unsigned int lod = 0; lod < MESH_LODS; lod++)
+		{
+			Engine::Mesh * m = treeChains[i].meshes[lod];
+
+			fillShader->configureMeshBuffers(m);
+			wireShader->configureMeshBuffers(m);
+			shadowShader->configureMeshBuffers(m);
+			instancedFillShader->configureMeshBuffers(m);
+			instancedWireShader->configureMeshBuffers(m);
+			instancedShadowShader->configureMeshBuffers(m);
+
+			treeTypes[lod].push_back(new Engine::Object(m));
+		}
 
-		Engine::Object * tree = new Engine::Object(m);
+		// The full detail tree encloses the rest of levels
+		glm::vec3 meshMin, meshMax;
+		computeMeshBounds(treeChains[i].meshes[0], meshMin, meshMax);
 
-		treeTypes.push_back(tree);
+		// The impostors spin around the trunk
+		const glm::vec3 & extents = impostorAtlas.getExtents((unsigned int)i);
+		meshMin = glm::min(meshMin, glm::vec3(-extents.x, extents.y, -extents.x));
+		meshMax = glm::max(meshMax, glm::vec3(extents.x, extents.z, extents.x));
+
+		treeMin = i == 0 ? meshMin : glm::min(treeMin, meshMin);
+		treeMax = i == 0 ? meshMax : glm::max(treeMax, meshMax);
 	}
 
 	// Amount of each tree type to evenly spawn trees up to treesToSpawn
-	size_t numTypeOfTrees = treeTypes.size();
+	size_t numTypeOfTrees = treeTypes[0].size();
 	equalAmountOfTrees = treesToSpawn / numTypeOfTrees;
 	equalAmountOfTrees = equalAmountOfTrees < 1 ? 1 : equalAmountOfTrees;
+
+	// Tree type spawned on each jitter position, following the same order renderComponent uses
+	jitterTreeType.assign(jitterPatternSize, -1);
+	size_t treeToSpawn = 0;
+	unsigned int z = 0;
+	while (z < treesToSpawn)
+	{
+		int type = int(treeToSpawn % numTypeOfTrees);
+		treeToSpawn++;
+		for (unsigned int k = 0; k < equalAmountOfTrees; k++)
+		{
+			z++;
+			if (z < jitterPatternSize)
+			{
+				jitterTreeType[z] = type;
+			}
+		}
+	}
+
+	// Instance buffer, attached to every tree vertex array
+	instances.init(numTypeOfTrees * MESH_LODS);
+	for (unsigned int lod = 0; lod < MESH_LODS; lod++)
+	{
+		for (auto & tree : treeTypes[lod])
+		{
+			instancedFillShader->configureInstanceBuffer(tree->getMesh(), instances.getBuffer());
+		}
+	}
+
+	// Impostors read their instances as points
+	impostorInstances.init(numTypeOfTrees);
+	glGenVertexArrays(1, &impostorVertexArray);
+	impostorFillShader->configureInstanceBuffer(impostorVertexArray, impostorInstances.getBuffer());
+}
+
+void Engine::TreeComponent::preRenderComponent()
+{
+	instances.clear();
+	impostorInstances.clear();
 }
 
 void Engine::TreeComponent::renderComponent(int i, int j, Engine::Camera * cam)
 {
+	lodPass = true;
+	unsigned int lod = selectTileLOD(i, j, cam, true);
+
+	if (Engine::Settings::instancedVegetation)
+	{
+		instanceCamera = cam;
+		shadowInstances = false;
+		addTileInstances(i, j, lod);
+		return;
+	}
+
+	// Impostors are only drawn instanced
+	unsigned int meshLod = lod < MESH_LODS ? lod : MESH_LODS - 1;
+	std::vector<Engine::Object *> & lodTypes = treeTypes[meshLod];
+
 	float posX = i * scale;
 	float posZ = j * scale;
 
-	size_t numTypeOfTrees = treeTypes.size();
-	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	size_t numTypeOfTrees = lodTypes.size();
 
 	size_t treeToSpawn = 0;
 	unsigned int z = 0;
 	while (z < treesToSpawn)
 	{
-		Engine::Object * randomTree = treeTypes[treeToSpawn % numTypeOfTrees];
+		Engine::Object * randomTree = lodTypes[treeToSpawn % numTypeOfTrees];
 		treeToSpawn++;
 		randomTree->getMesh()->use();
 		unsigned int k = 0;
@@ -153,27 +275,42 @@ void Engine::TreeComponent::renderComponent(int i, int j, Engine::Camera * cam)
 			float v = abs(j + vOffset);
 
 			activeShader->setUniformTileUV(u, v);
-			activeShader->setUniformLightDepthMat(csm.getDepthMatrix0() * randomTree->getModelMatrix());
-			activeShader->setUniformLightDepthMat1(csm.getDepthMatrix1() * randomTree->getModelMatrix());
 			activeShader->onRenderObject(randomTree, cam);
 
-			glDrawElements(GL_TRIANGLES, randomTree->getMesh()->getNumFaces() * 3, GL_UNSIGNED_INT, (void*)0);
+			glDrawElements(GL_TRIANGLES, randomTree->getMesh()->getNumFaces() * 3, randomTree->getMesh()->getIndexType(), (void*)0);
+			Engine::RenderStatistics::drawCalls++;
+			Engine::RenderStatistics::drawnInstances++;
+			Engine::RenderStatistics::treeLODInstances[meshLod]++;
 		}
 	}
 }
 
 void Engine::TreeComponent::renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
 {
+	unsigned int lod = selectShadowLOD(i, j, cam);
+
+	if (Engine::Settings::instancedVegetation)
+	{
+		instanceCamera = cam;
+		shadowInstances = true;
+		shadowProjection = projection;
+		addTileInstances(i, j, lod);
+		return;
+	}
+
+	unsigned int meshLod = lod < MESH_LODS ? lod : MESH_LODS - 1;
+	std::vector<Engine::Object *> & lodTypes = treeTypes[meshLod];
+
 	float posX = i * scale;
 	float posZ = j * scale;
 
-	size_t numTypeOfTrees = treeTypes.size();
+	size_t numTypeOfTrees = lodTypes.size();
 	
 	size_t treeToSpawn = 0;
 	unsigned int z = 0;
 	while (z < treesToSpawn)
 	{
-		Engine::Object * randomTree = treeTypes[treeToSpawn % numTypeOfTrees];
+		Engine::Object * randomTree = lodTypes[treeToSpawn % numTypeOfTrees];
 		treeToSpawn++;
 		randomTree->getMesh()->use();
 		unsigned int k = 0;
@@ -197,7 +334,232 @@ void Engine::TreeComponent::renderShadow(const glm::mat4 & projection, int i, in
 			shadowShader->setUniformLightDepthMat(projection *  randomTree->getModelMatrix());
 			shadowShader->onRenderObject(randomTree, cam);
 
-			glDrawElements(GL_TRIANGLES, randomTree->getMesh()->getNumFaces() * 3, GL_UNSIGNED_INT, (void*)0);
+			glDrawElements(GL_TRIANGLES, randomTree->getMesh()->getNumFaces() * 3, randomTree->getMesh()->getIndexType(), (void*)0);
+			Engine::RenderStatistics::drawCalls++;
+			Engine::RenderStatistics::drawnInstances++;
+		}
+	}
+}
+
+void Engine::TreeComponent::postRenderComponent()
+{
+	if (Engine::Settings::instancedVegetation)
+	{
+		renderInstances();
+	}
+
+	if (lodPass)
+	{
+		lodPass = false;
+		lodFrame++;
+		pruneTileLODs();
+	}
+}
+
+unsigned int Engine::TreeComponent::selectTileLOD(int i, int j, Engine::Camera * cam, bool mainPass)
+{
+	if (!Engine::Settings::treeLODs)
+		return 0;
+
+	// Distance from the camera to the tile center, in tiles, measured like the render radius
+	const glm::vec3 & cameraPosition = cam->getPosition();
+	float dx = fabs(-cameraPosition.x / scale - (float(i) + 0.5f));
+	float dz = fabs(-cameraPosition.z / scale - (float(j) + 0.5f));
+	float distance = std::max(dx, dz);
+
+	unsigned int lod = 0;
+	while (lod < MESH_LODS && distance >= LOD_DISTANCES[lod])
+	{
+		lod++;
+	}
+
+	unsigned long long key = ((unsigned long long)(unsigned int)i << 32) | (unsigned long long)(unsigned int)j;
+	std::unordered_map<unsigned long long, TileLOD>::iterator it = tileLODs.find(key);
+	if (it != tileLODs.end())
+	{
+		// Keep the previous level until the tile is clearly out of its range
+		unsigned int previous = it->second.lod;
+		float minDistance = previous > 0 ? LOD_DISTANCES[previous - 1] - LOD_HYSTERESIS : 0.0f;
+		float maxDistance = previous < MESH_LODS ? LOD_DISTANCES[previous] + LOD_HYSTERESIS : FLT_MAX;
+		if (distance >= minDistance && distance < maxDistance)
+		{
+			lod = previous;
+		}
+	}
+
+	if (mainPass)
+	{
+		TileLOD & tileLOD = tileLODs[key];
+		tileLOD.lod = lod;
+		tileLOD.frame = lodFrame;
+	}
+
+	return lod;
+}
+
+unsigned int Engine::TreeComponent::selectShadowLOD(int i, int j, Engine::Camera * cam)
+{
+	if (!Engine::Settings::treeLODs)
+		return 0;
+
+	unsigned int lod = selectTileLOD(i, j, cam, false);
+
+	// The shadows a cascade receives are at least its near split away from the camera, so trees
+	// close to the camera do not need more detail there than the trees at that distance
+	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	float cascadeDistance = csm.getSplitNear(csm.getCurrentLevel()) / scale;
+	unsigned int cascadeLod = 0;
+	while (cascadeLod < MESH_LODS && cascadeDistance >= LOD_DISTANCES[cascadeLod])
+	{
+		cascadeLod++;
+	}
+
+	lod = std::max(lod, cascadeLod) + SHADOW_LOD_BIAS;
+	return lod < IMPOSTOR_LOD ? lod : IMPOSTOR_LOD;
+}
+
+void Engine::TreeComponent::pruneTileLODs()
+{
+	std::unordered_map<unsigned long long, TileLOD>::iterator it = tileLODs.begin();
+	while (it != tileLODs.end())
+	{
+		if (lodFrame - it->second.frame > 2)
+		{
+			it = tileLODs.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void Engine::TreeComponent::addTileInstances(int i, int j, unsigned int lod)
+{
+	std::shared_ptr<const Engine::TerrainTile> tile = Engine::TerrainTileCache::getInstance().getTile(i, j);
+	if (tile && vegetationPatternId < tile->vegetation.size())
+	{
+		// Only the positions where the terrain height lets a tree grow
+		for (auto & placement : tile->vegetation[vegetationPatternId])
+		{
+			if (jitterTreeType[placement.index] >= 0)
+			{
+				addInstance(i, j, placement.index, lod);
+			}
+		}
+	}
+	else
+	{
+		for (unsigned int z = 0; z < jitterTreeType.size(); z++)
+		{
+			if (jitterTreeType[z] >= 0)
+			{
+				addInstance(i, j, z, lod);
+			}
+		}
+	}
+}
+
+void Engine::TreeComponent::addInstance(int i, int j, unsigned int jitterIndex, unsigned int lod)
+{
+	const glm::vec2 & jitter = jitterPattern[jitterIndex];
+
+	float treePosX = i * scale + jitter.x * scale;
+	float treePosZ = j * scale + jitter.y * scale;
+	float u = abs(i + jitter.x);
+	float v = abs(j + jitter.y);
+
+	size_t type = size_t(jitterTreeType[jitterIndex]);
+	if (lod == IMPOSTOR_LOD)
+	{
+		impostorInstances.add(type, treePosX, treePosZ, u, v);
+	}
+	else
+	{
+		instances.add(lod * treeTypes[0].size() + type, treePosX, treePosZ, u, v);
+	}
+}
+
+void Engine::TreeComponent::renderInstances()
+{
+	instances.upload();
+	impostorInstances.upload();
+	if (instances.getInstanceCount() == 0 && impostorInstances.getInstanceCount() == 0)
+		return;
+
+	// The tree position comes from the instance data, so the model matrix is the identity
+	Engine::Object * origin = treeTypes[0][0];
+	origin->setTranslation(glm::vec3(0.0f));
+
+	const size_t numTypeOfTrees = treeTypes[0].size();
+
+	if (instances.getInstanceCount() > 0)
+	{
+		TreeProgram * program;
+		if (shadowInstances)
+		{
+			program = instancedShadowShader;
+			program->setUniformLightDepthMat(shadowProjection);
+		}
+		else
+		{
+			program = activeInstancedShader;
+		}
+		program->onRenderObject(origin, instanceCamera);
+
+		for (unsigned int lod = 0; lod < MESH_LODS; lod++)
+		{
+			for (size_t t = 0; t < numTypeOfTrees; t++)
+			{
+				size_t group = lod * numTypeOfTrees + t;
+				size_t count = instances.getTypeCount(group);
+				if (count == 0)
+					continue;
+
+				const Engine::Mesh * mesh = treeTypes[lod][t]->getMesh();
+				mesh->use();
+				program->setInstanceBufferOffset(instances.getBuffer(), instances.getTypeOffset(group));
+
+				glDrawElementsInstanced(GL_TRIANGLES, mesh->getNumFaces() * 3, mesh->getIndexType(), (void*)0, GLsizei(count));
+				Engine::RenderStatistics::drawCalls++;
+				Engine::RenderStatistics::drawnInstances += (unsigned int)count;
+				if (!shadowInstances)
+				{
+					Engine::RenderStatistics::treeLODInstances[lod] += (unsigned int)count;
+				}
+			}
+		}
+	}
+
+	if (impostorInstances.getInstanceCount() > 0)
+	{
+		// Terrain only sets up the mesh program, the impostors use their own
+		TreeImpostorProgram * program = shadowInstances ? impostorShadowShader : activeImpostorShader;
+		program->use();
+		program->applyGlobalUniforms();
+		if (shadowInstances)
+		{
+			program->setUniformLightDepthMat(shadowProjection);
+		}
+		program->onRenderObject(origin, instanceCamera);
+		program->setUniformAtlas(impostorAtlas);
+
+		Engine::GLStateCache::getInstance().bindVertexArray(impostorVertexArray);
+		for (size_t t = 0; t < numTypeOfTrees; t++)
+		{
+			size_t count = impostorInstances.getTypeCount(t);
+			if (count == 0)
+				continue;
+
+			program->setUniformImpostor(impostorAtlas, (unsigned int)t);
+
+			glDrawArrays(GL_POINTS, GLint(impostorInstances.getTypeOffset(t)), GLsizei(count));
+			Engine::RenderStatistics::drawCalls++;
+			Engine::RenderStatistics::drawnInstances += (unsigned int)count;
+			if (!shadowInstances)
+			{
+				Engine::RenderStatistics::treeLODInstances[IMPOSTOR_LOD] += (unsigned int)count;
+			}
 		}
 	}
 }
@@ -208,22 +570,33 @@ void Engine::TreeComponent::notifyRenderModeChange(Engine::RenderMode mode)
 	{
 	case Engine::RenderMode::RENDER_MODE_SHADED:
 		activeShader = fillShader;
+		activeInstancedShader = instancedFillShader;
+		activeImpostorShader = impostorFillShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_WIRE:
 		activeShader = wireShader;
+		activeInstancedShader = instancedWireShader;
+		activeImpostorShader = impostorWireShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_POINT:
 		activeShader = pointShader;
+		activeInstancedShader = instancedPointShader;
+		activeImpostorShader = impostorPointShader;
 		break;
 	}
 }
 
+bool Engine::TreeComponent::getTileBounds(int i, int j, glm::vec3 & min, glm::vec3 & max)
+{
+	return getVegetationTileBounds(i, j, treeMin, treeMax, min, max);
+}
+
 Engine::Program * Engine::TreeComponent::getActiveShader()
 {
-	return activeShader;
+	return Engine::Settings::instancedVegetation ? activeInstancedShader : activeShader;
 }
 
 Engine::Program * Engine::TreeComponent::getShadowMapShader()
 {
-	return shadowShader;
+	return Engine::Settings::instancedVegetation ? instancedShadowShader : shadowShader;
 }
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "terraincomponents/VegetationInstances.h"
+
+#include <GL/glew.h>
+
+Engine::VegetationInstances::VegetationInstances()
+	:buffer(0)
+	,bufferCapacity(0)
+{
+}
+
+void Engine::VegetationInstances::init(size_t numTypes)
+{
+	instances.resize(numTypes);
+	typeOffsets.resize(numTypes, 0);
+
+	glGenBuffers(1, &buffer);
+}
+
+void Engine::VegetationInstances::clear()
+{
+	for (auto & typeInstances : instances)
+	{
+		typeInstances.clear();
+	}
+}
+
+void Engine::VegetationInstances::upload()
+{
+	packed.clear();
+	for (size_t t = 0; t < instances.size(); t++)
+	{
+		typeOffsets[t] = packed.size();
+		packed.insert(packed.end(), instances[t].begin(), instances[t].end());
+	}
+
+	if (packed.empty())
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	// Orphan the previous storage (growing it if needed) so we dont wait for the draws still using it
+	size_t size = packed.size() * sizeof(glm::vec4);
+	if (size > bufferCapacity)
+	{
+		bufferCapacity = size * 2;
+	}
+	glBufferData(GL_ARRAY_BUFFER, bufferCapacity, NULL, GL_STREAM_DRAW);
+
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, &packed[0]);
+}
+
+void Engine::VegetationInstances::destroy()
+{
+	if (buffer != 0)
+	{
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+}
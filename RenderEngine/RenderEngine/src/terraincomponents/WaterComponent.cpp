@@ -2,8 +2,10 @@
 
 #include "datatables/ProgramTable.h"
 #include "datatables/MeshTable.h"
+#include "GLStateCache.h"
 
 #include "CascadeShadowMaps.h"
+#include "RenderStatistics.h"
 
 Engine::WaterComponent::WaterComponent()
 	:Engine::TerrainComponent()
@@ -16,6 +18,11 @@ unsigned int Engine::WaterComponent::getRenderRadius()
 	return 12;
 }
 
+const char * Engine::WaterComponent::getName()
+{
+	return "Water";
+}
+
 void Engine::WaterComponent::initialize()
 {
 	fillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>();
@@ -37,32 +44,82 @@ void Engine::WaterComponent::initialize()
 	//shadowShader->configureMeshBuffers(tile);
 
 	activeShader = fillShader;
+
+	batchedFillShader = NULL;
+	batchedWireShader = NULL;
+	batchedPointShader = NULL;
+	activeBatchedShader = NULL;
+	batchOrigin = new Engine::Object(tile);
+	batchCamera = NULL;
+
+	if (Engine::TileDrawBatch::isSupported())
+	{
+		batchedFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>(Engine::ProceduralWaterProgram::MULTI_DRAW);
+
+		batchedWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>(Engine::ProceduralWaterProgram::WIRE_DRAW_MODE | Engine::ProceduralWaterProgram::MULTI_DRAW);
+
+		batchedPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>(Engine::ProceduralWaterProgram::POINT_DRAW_MODE | Engine::ProceduralWaterProgram::MULTI_DRAW);
+
+		activeBatchedShader = batchedFillShader;
+
+		// Water renders up to (2 * radius)^2 tiles per pass
+		unsigned int diameter = getRenderRadius() * 2;
+		tileBatch.init(size_t(diameter * diameter), tile->getNumFaces() * 3, tile->getIndexType());
+	}
+}
+
+bool Engine::WaterComponent::isBatched()
+{
+	return Engine::Settings::batchedTerrain && tileBatch.isInitialized();
 }
 
 void Engine::WaterComponent::preRenderComponent()
 {
-	glBindVertexArray(waterTile->getMesh()->vao);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	Engine::GLStateCache::getInstance().bindVertexArray(waterTile->getMesh()->vao);
+	Engine::GLStateCache::getInstance().enable(GL_BLEND);
+	Engine::GLStateCache::getInstance().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// The material G-Buffer is replaced, its alpha holds the specular intensity. Disabling
+	// GL_BLEND after the water turns it off for every buffer again
+	glDisablei(GL_BLEND, 2);
+
+	if (isBatched())
+	{
+		tileBatch.begin();
+	}
 }
 
 void Engine::WaterComponent::renderComponent(int i, int j, Engine::Camera * cam)
 {
+	if (isBatched())
+	{
+		batchCamera = cam;
+		tileBatch.add(i, j);
+		return;
+	}
+
 	float poxX = i * scale;
 	float posZ = j * scale;
 	waterTile->setTranslation(glm::vec3(poxX, Engine::Settings::waterHeight * scale * 1.5f, posZ));
 
 	activeShader->setUniformGridPosition(i, j);
-	activeShader->setUniformLightDepthMatrix(Engine::CascadeShadowMaps::getInstance().getDepthMatrix0() * waterTile->getModelMatrix());
-	activeShader->setUniformLightDepthMatrix1(Engine::CascadeShadowMaps::getInstance().getDepthMatrix1() * waterTile->getModelMatrix());
 	activeShader->onRenderObject(waterTile, cam);
 
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_TRIANGLES, 6, waterTile->getMesh()->getIndexType(), (void*)0);
+	Engine::RenderStatistics::drawCalls++;
+	Engine::RenderStatistics::drawnInstances++;
 }
 
 void Engine::WaterComponent::postRenderComponent()
 {
-	glDisable(GL_BLEND);
+	if (isBatched() && tileBatch.getTileCount() > 0)
+	{
+		// Per pass matrices only, the tile transform is rebuilt on the shader from its grid position
+		activeBatchedShader->onRenderObject(batchOrigin, batchCamera);
+
+		tileBatch.draw(GL_TRIANGLES);
+	}
+
+	Engine::GLStateCache::getInstance().disable(GL_BLEND);
 }
 
 void Engine::WaterComponent::renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
@@ -77,7 +134,7 @@ void Engine::WaterComponent::renderShadow(const glm::mat4 & projection, int i, i
 
 	shadowShader->onRenderObject(waterTile, cam);
 
-	glDrawElements(GL_PATCHES, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_PATCHES, 6, waterTile->getMesh()->getIndexType(), (void*)0);
 	*/
 }
 
@@ -87,18 +144,30 @@ void Engine::WaterComponent::notifyRenderModeChange(Engine::RenderMode mode)
 	{
 	case Engine::RenderMode::RENDER_MODE_SHADED:
 		activeShader = fillShader;
+		activeBatchedShader = batchedFillShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_POINT:
 		activeShader = pointShader;
+		activeBatchedShader = batchedPointShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_WIRE:
 		activeShader = wireShader;
+		activeBatchedShader = batchedWireShader;
 	}
 }
 
+bool Engine::WaterComponent::getTileBounds(int i, int j, glm::vec3 & min, glm::vec3 & max)
+{
+	// Flat plane at water level
+	float height = Engine::Settings::waterHeight * scale * 1.5f;
+	min = glm::vec3(float(i) * scale, height, float(j) * scale);
+	max = glm::vec3(float(i + 1) * scale, height, float(j + 1) * scale);
+	return true;
+}
+
 Engine::Program * Engine::WaterComponent::getActiveShader()
 {
-	return activeShader;
+	return isBatched() ? activeBatchedShader : activeShader;
 }
 
 Engine::Program * Engine::WaterComponent::getShadowMapShader()
@@ -1,5 +1,9 @@
 #include "textures/Texture2D.h"
 
+#include <cstring>
+
+#include "GLStateCache.h"
+
 Engine::Texture2D::Texture2D(std::string name, unsigned char *data, unsigned int width, unsigned int height)
 	:Engine::AbstractTexture(name),width(width), height(height)
 {
@@ -51,7 +55,7 @@ void Engine::Texture2D::setSize(unsigned int w, unsigned int h, unsigned int d)
 
 void Engine::Texture2D::uploadTexture()
 {
-	glBindTexture(GL_TEXTURE_2D, textureId);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, textureId);
 	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, formatType, pixelType, (GLvoid*)data);
 
 	if (generateMipMaps)
@@ -1,5 +1,7 @@
 #include "textures/Texture3D.h"
 
+#include "GLStateCache.h"
+
 #include <iostream>
 
 Engine::Texture3D::Texture3D(std::string name, unsigned int w, unsigned int h, unsigned int d)
@@ -45,7 +47,7 @@ void Engine::Texture3D::setSize(unsigned int w, unsigned int h, unsigned int d)
 
 void Engine::Texture3D::uploadTexture()
 {
-	glBindTexture(GL_TEXTURE_3D, textureId);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_3D, textureId);
 	glTexStorage3D(GL_TEXTURE_3D, 6, internalFormat, width, height, depth);
 	//glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, width, height, depth, 0, formatType, pixelType, data);
 	
@@ -1,5 +1,9 @@
 #include "textures/TextureCubemap.h"
 
+#include <cstring>
+
+#include "GLStateCache.h"
+
 Engine::TextureCubemap::TextureCubemap(std::string name, unsigned int tileWidth, unsigned int tileHeight)
 	:Engine::AbstractTexture(name),tileWidth(tileWidth), tileHeight(tileHeight)
 {
@@ -7,7 +11,7 @@ Engine::TextureCubemap::TextureCubemap(std::string name, unsigned int tileWidth,
 	formatType = GL_RGBA;
 	pixelType = GL_UNSIGNED_BYTE;
 	generateMipMaps = false;
-	glEnable(GL_TEXTURE_CUBE_MAP);
+	Engine::GLStateCache::getInstance().enable(GL_TEXTURE_CUBE_MAP);
 
 	unsigned int size = tileWidth * tileHeight * 4;
 	for (unsigned int i = 0; i < 6; i++)
@@ -70,7 +74,7 @@ void Engine::TextureCubemap::setSize(unsigned int w, unsigned int h, unsigned in
 
 void Engine::TextureCubemap::uploadTexture()
 {
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureId);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_CUBE_MAP, textureId);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	
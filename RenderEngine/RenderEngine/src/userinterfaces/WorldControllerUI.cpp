@@ -1,5 +1,6 @@
 #include "userinterfaces/WorldControllerUI.h"
 
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
@@ -7,11 +8,29 @@
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
 #include "Scene.h"
+#include "TerrainTileCache.h"
+#include "RenderStatistics.h"
+#include "Profiler.h"
+#include "datatables/MeshTable.h"
+#include "datatables/DeferredObjectsTable.h"
+#include "renderers/DeferredRenderer.h"
+#include "postprocessprograms/HDRToneMappingProgram.h"
+#include "postprocessprograms/DepthOfFieldProgram.h"
+#include "volumetricclouds/NoiseInitializer.h"
+#include "ClusteredLightBuffer.h"
+#include "LightBufferManager.h"
+#include "CascadeShadowMaps.h"
 
 
 Engine::Window::WorldControllerUI::WorldControllerUI(GLFWwindow * surface)
 	:Engine::Window::UserInterface(surface)
 {
+	memset(&treeBenchmark, 0, sizeof(treeBenchmark));
+	memset(&cloudNoiseValidation, 0, sizeof(cloudNoiseValidation));
+	memset(&heightFieldValidation, 0, sizeof(heightFieldValidation));
+	memset(&lightClusterValidation, 0, sizeof(lightClusterValidation));
+	memset(&meshOptimizerValidation, 0, sizeof(meshOptimizerValidation));
+	separatePostMs = fusedPostMs = -1.0;
 }
 
 void Engine::Window::WorldControllerUI::drawGraphics()
@@ -28,6 +47,7 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 		int fps = int(floor(1.0f / Time::deltaTime));
 		std::string fpsStr = "FPS: " + std::to_string(fps);
 		ImGui::Text(fpsStr.c_str());
+		ImGui::Checkbox("Show profiler##app", &Engine::Settings::showProfiler);
 
 		ImGui::Spacing(); ImGui::Spacing();
 		ImGui::Separator();
@@ -47,6 +67,8 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 		ImGui::Separator();
 		ImGui::Spacing(); ImGui::Spacing();
 
+		Engine::DeferredRenderer * renderer = static_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
+		Engine::RenderGraph & renderGraph = renderer->getRenderGraph();
 		if (ImGui::CollapsingHeader("Render settings"))
 		{
 			ImGui::PushItemWidth(150.0f);
@@ -54,6 +76,24 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 			ImGui::Spacing();
 			ImGui::Combo("Travel method##app", reinterpret_cast<int32_t*>(&Engine::Settings::travelMethod), "Manual\0Bezier\0Straight", 3);
 			ImGui::Spacing();
+			ImGui::Checkbox("Instanced vegetation##app", &Engine::Settings::instancedVegetation);
+			ImGui::Spacing();
+			ImGui::Checkbox("Tree levels of detail##app", &Engine::Settings::treeLODs);
+			ImGui::Spacing();
+			ImGui::Checkbox("Batched terrain tiles##app", &Engine::Settings::batchedTerrain);
+			ImGui::Spacing();
+			if (renderer->isFusedPostProcessAvailable())
+			{
+				ImGui::Checkbox("Fused tone mapping and DoF##app", &Engine::Settings::fusedPostProcess);
+				ImGui::Spacing();
+			}
+			ImGui::Combo("Light clusters##app", reinterpret_cast<int32_t*>(&Engine::Settings::lightClusterBuilder), "CPU\0GPU", 2);
+			ImGui::Spacing();
+			ImGui::SliderInt("Shadow cascades##app", reinterpret_cast<int32_t*>(&Engine::Settings::shadowCascades), 1, int(Engine::CascadeShadowMaps::MAX_CASCADES));
+			ImGui::SliderFloat("Cascade split lambda##app", &Engine::Settings::shadowSplitLambda, 0.0f, 1.0f);
+			ImGui::SliderFloat("Shadow distance##app", &Engine::Settings::shadowDistance, 10.0f, 1000.0f);
+			ImGui::Checkbox("Cache terrain shadows##app", &Engine::Settings::shadowCache);
+			ImGui::Spacing();
 			ImGui::ColorEdit3("Tint", &Engine::Settings::hdrTint[0]);
 		}
 
@@ -110,6 +150,7 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 			ImGui::InputFloat("High freq UV scale", &Engine::Settings::highFrequencyNoiseUVScale, 0.1f, 1.0f);
 			ImGui::InputFloat("High freq H scale", &Engine::Settings::highFrequencyNoiseHScale, 0.1f, 1.0f);
 			ImGui::ColorEdit3("Cloud Color multiplier", &Engine::Settings::cloudColor[0]);
+			ImGui::SliderFloat("Noise generation budget (ms)", &Engine::Settings::cloudNoiseFrameBudgetMs, 0.0f, 16.0f);
 		}
 
 		if (ImGui::CollapsingHeader("Depth of Field settings"))
@@ -125,6 +166,321 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 			ImGui::SliderFloat("Decay##app", &Engine::Settings::godRaysDecay, 0.0f, 1.0f);
 			ImGui::SliderFloat("Density##app", &Engine::Settings::godRaysDensity, 0.1f, 10.0f);
 		}
+
+		if (ImGui::CollapsingHeader("Post processes"))
+		{
+			ImGui::PushItemWidth(150.0f);
+			ImGui::Combo("Quality##app", reinterpret_cast<int32_t*>(&Engine::Settings::postProcessQuality), "Low\0Medium\0High", 3);
+			ImGui::PopItemWidth();
+			ImGui::Spacing();
+
+			// Upsample passes follow their node (see DeferredRenderer::runPostProcesses())
+			for (auto node : renderer->getPostProcessChain())
+			{
+				bool enabled = renderGraph.isPassEnabled(node->pass);
+				if (ImGui::Checkbox((renderGraph.getPassName(node->pass) + "##app").c_str(), &enabled))
+				{
+					renderGraph.setPassEnabled(node->pass, enabled);
+				}
+				ImGui::SameLine();
+				ImGui::Text("(%.0f%%)", node->resolutionScale[Engine::Settings::postProcessQuality] * 100.0f);
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Statistics"))
+		{
+			Engine::Terrain * terrain = Engine::SceneManager::getInstance().getActiveScene()->getTerrain();
+			if (terrain != NULL)
+			{
+				ImGui::Text("Visible terrain tiles: %u / %u", terrain->getVisibleTileCount(), terrain->getTestedTileCount());
+				if (ImGui::Button("Validate tile culling##app"))
+				{
+					tileCullingValidation = Engine::TileCuller::validate(terrain->getTileScale(), terrain->getRenderRadius());
+				}
+				for (auto & pose : tileCullingValidation.poses)
+				{
+					ImGui::Text("Pose (%.0f, %.0f, %.0f): %u / %u tiles", pose.eye.x, pose.eye.y, pose.eye.z, pose.visibleTiles, pose.testedTiles);
+				}
+				if (!tileCullingValidation.poses.empty())
+				{
+					ImGui::Text("%u false negatives, %u false positives, %u out of bounds", tileCullingValidation.falseNegatives,
+						tileCullingValidation.falsePositives, tileCullingValidation.boundViolations);
+				}
+				ImGui::Spacing();
+			}
+
+			ImGui::Text("Draw calls: %u (%u instances)", Engine::RenderStatistics::drawCalls, Engine::RenderStatistics::drawnInstances);
+			ImGui::Text("Uniform uploads: %u", Engine::RenderStatistics::uniformUploads);
+			ImGui::Text("Storage buffer uploads: %u", Engine::RenderStatistics::storageUploads);
+			ImGui::Text("State changes: %u issued, %u filtered", Engine::RenderStatistics::issuedStateChanges, Engine::RenderStatistics::filteredStateChanges);
+			ImGui::Text("Terrain CPU submit: %.3f ms (%s)", Engine::RenderStatistics::terrainSubmitMs, Engine::Settings::batchedTerrain ? "batched" : "per tile");
+			const unsigned int * treeLODs = Engine::RenderStatistics::treeLODInstances;
+			ImGui::Text("Trees per LOD: %u / %u / %u, %u impostors", treeLODs[0], treeLODs[1], treeLODs[2], treeLODs[3]);
+			if (ImGui::Button("Validate mesh optimizer##app"))
+			{
+				meshOptimizerValidation = Engine::MeshOptimizer::validate();
+			}
+			if (meshOptimizerValidation.shuffledInput.vertexTransforms > 0)
+			{
+				ImGui::Text("ACMR shuffled grid: %.3f -> %.3f", meshOptimizerValidation.shuffledInput.acmr, meshOptimizerValidation.shuffledOptimized.acmr);
+				ImGui::Text("ACMR ordered grid: %.3f -> %.3f", meshOptimizerValidation.orderedInput.acmr, meshOptimizerValidation.orderedOptimized.acmr);
+				ImGui::Text("%u triangles lost", meshOptimizerValidation.triangleMismatches);
+			}
+			ImGui::Spacing();
+
+			Engine::CloudSystem::NoiseInitializer & noise = Engine::CloudSystem::NoiseInitializer::getInstance();
+			const std::vector<Engine::CloudSystem::CloudNoiseSlab> & slabs = noise.getSlabs();
+			if (ImGui::TreeNode("cloudnoise##app", "Cloud noise: %.0f%% generated", noise.getProgress() * 100.0f))
+			{
+				const char * names[] = { "Perlin-Worley", "Worley", "Weather" };
+				for (auto & slab : slabs)
+				{
+					if (slab.gpuMs >= 0.0)
+						ImGui::Text("%s [%u, %u): %.3f ms", names[slab.texture], slab.offset, slab.offset + slab.size, slab.gpuMs);
+					else
+						ImGui::Text("%s [%u, %u): pending", names[slab.texture], slab.offset, slab.offset + slab.size);
+				}
+				ImGui::TreePop();
+			}
+			ImGui::Spacing();
+
+			Engine::TerrainTileCacheStats tileStats = Engine::TerrainTileCache::getInstance().getStats();
+			ImGui::Text("Terrain tile cache");
+			ImGui::Text("Resident tiles: %u (%u pending)", (unsigned int)tileStats.residentTiles, (unsigned int)tileStats.pendingTiles);
+			ImGui::Text("Hits: %llu  Misses: %llu  Evictions: %llu", tileStats.hits, tileStats.misses, tileStats.evictions);
+			ImGui::Text("Build latency (ms): last %.2f  avg %.2f  max %.2f", tileStats.lastLatencyMs, tileStats.avgLatencyMs, tileStats.maxLatencyMs);
+			if (ImGui::Button("Reset statistics##app"))
+			{
+				Engine::TerrainTileCache::getInstance().resetStats();
+			}
+			if (ImGui::Button("Validate terrain height field##app"))
+			{
+				heightFieldValidation = Engine::TerrainTileCache::getInstance().getHeightField().validate(10000);
+			}
+			if (heightFieldValidation.samples > 0)
+			{
+				ImGui::Text("%u/%u heights within tolerance, max error %.7f, %u batch mismatches", heightFieldValidation.samples - heightFieldValidation.failures,
+					heightFieldValidation.samples, heightFieldValidation.maxError, heightFieldValidation.batchMismatches);
+			}
+			ImGui::Spacing();
+
+			const float mb = 1024.0f * 1024.0f;
+			size_t fboMemory = Engine::DeferredObjectsTable::getInstance().getMemoryUsage() + Engine::CascadeShadowMaps::getInstance().getMemoryUsage()
+				+ Engine::CascadeShadowMaps::getInstance().getCacheMemoryUsage();
+			ImGui::Text("Render target memory: %.1f MB", float(fboMemory + renderGraph.getAllocatedMemory()) / mb);
+			size_t screenPixels = size_t(Engine::ScreenManager::SCREEN_WIDTH) * size_t(Engine::ScreenManager::SCREEN_HEIGHT);
+			ImGui::Text("G-Buffer: %u bytes per pixel", (unsigned int)(renderer->getGBufferMemory() / (screenPixels > 0 ? screenPixels : 1)));
+			ImGui::Text("Post processes: %u passes, %u targets", renderGraph.getNumScheduledPasses(), renderGraph.getNumAllocatedTargets());
+			ImGui::Text("Post process targets: %.1f MB (%.1f MB unaliased)", float(renderGraph.getAllocatedMemory()) / mb, float(renderGraph.getUnaliasedMemory()) / mb);
+			ImGui::Spacing();
+
+			Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+			ImGui::Text("Shadow cascades: %u x %u^2 (%.1f MB)", csm.getCascadeLevels(), Engine::CascadeShadowMaps::RESOLUTION, float(csm.getMemoryUsage()) / mb);
+			if (Engine::Settings::shadowCache)
+			{
+				ImGui::Text("Shadow cache: %u/%u cascades, %u texels rendered (%.1f MB)", csm.getCachedCascades(), csm.getCascadeLevels(),
+					Engine::RenderStatistics::shadowCacheTexels, float(csm.getCacheMemoryUsage()) / mb);
+			}
+			// GPU times only while the profiler is enabled
+			double shadowGpuMs = -1.0;
+			double cascadeGpuMs[Engine::CascadeShadowMaps::MAX_CASCADES];
+			for (unsigned int i = 0; i < Engine::CascadeShadowMaps::MAX_CASCADES; i++)
+			{
+				cascadeGpuMs[i] = -1.0;
+			}
+			for (auto & stage : Engine::Profiler::getInstance().getStageStats())
+			{
+				if (stage.name == "Shadow maps")
+					shadowGpuMs = stage.gpuMs;
+				for (unsigned int i = 0; i < csm.getCascadeLevels(); i++)
+				{
+					if (stage.name == "Cascade " + std::to_string(i))
+						cascadeGpuMs[i] = stage.gpuMs;
+				}
+			}
+			if (shadowGpuMs >= 0.0)
+				ImGui::Text("Shadow pass: %.3f ms CPU, %.3f ms GPU", Engine::RenderStatistics::shadowPassMs, shadowGpuMs);
+			else
+				ImGui::Text("Shadow pass: %.3f ms CPU", Engine::RenderStatistics::shadowPassMs);
+			for (unsigned int i = 0; i < csm.getCascadeLevels(); i++)
+			{
+				ImGui::Text("Cascade %u: %.1f - %.1f, %.1f texels/m", i, csm.getSplitNear(i), csm.getSplitFar(i), csm.getTexelsPerMeter(i));
+				if (cascadeGpuMs[i] >= 0.0)
+					ImGui::Text("  %u caster tiles, %.3f ms GPU", Engine::RenderStatistics::shadowCasterTiles[i], cascadeGpuMs[i]);
+				else
+					ImGui::Text("  %u caster tiles", Engine::RenderStatistics::shadowCasterTiles[i]);
+			}
+			ImGui::Spacing();
+
+			Engine::GPU::ClusteredLightBuffer & clusteredLights = Engine::GPU::ClusteredLightBuffer::getInstance();
+			if (Engine::Settings::lightClusterBuilder == Engine::LightClusterBuilderType::LIGHT_CLUSTERS_CPU)
+				ImGui::Text("Clustered lights: %u (%u cluster indices)", clusteredLights.getNumLights(), (unsigned int)clusteredLights.getNumIndices());
+			else
+				ImGui::Text("Clustered lights: %u", clusteredLights.getNumLights());
+			if (ImGui::Button("Benchmark light clustering##app"))
+			{
+				lightClusterBenchmark = Engine::LightClusterBuilder::benchmark();
+			}
+			for (auto & entry : lightClusterBenchmark)
+			{
+				ImGui::Text("%u lights, %u thread(s): %.3f ms (%u indices)", entry.lights, entry.threads, entry.buildMs, (unsigned int)entry.indices);
+			}
+			if (ImGui::Button("Validate light clusters##app"))
+			{
+				// Current lights and projection
+				lightClusterValidation = clusteredLights.validate();
+			}
+			if (lightClusterValidation.clusters > 0)
+			{
+				ImGui::Text("%u/%u clusters match the brute force test", lightClusterValidation.clusters - lightClusterValidation.mismatches,
+					lightClusterValidation.clusters);
+			}
+
+			const Engine::GPU::LightStorage & lightStorage = Engine::GPU::LightBufferManager::getInstance().getLightStorage();
+			ImGui::Text("Light slots: %u (%u used), %u updated", lightStorage.getNumSlots(), lightStorage.getNumLights(), lightStorage.getUpdatedSlots());
+			ImGui::Text("Light uploads: %.1f KB in %u copies", float(lightStorage.getRing().getFrameBytes()) / 1024.0f, lightStorage.getRing().getFrameCopies());
+			if (ImGui::Button("Benchmark light updates##app"))
+			{
+				lightUpdateBenchmark = Engine::GPU::LightStorage::benchmark();
+			}
+			for (auto & entry : lightUpdateBenchmark)
+			{
+				ImGui::Text("%u lights, %u moved: %.3f ms (%.0f lights/ms)", entry.lights, entry.updated, entry.frameMs, entry.lightsPerMs);
+			}
+			ImGui::Spacing();
+
+			Engine::MeshTable & meshTable = Engine::MeshTable::getInstance();
+			if (ImGui::TreeNode("meshes##app", "Mesh memory: %.1f KB", float(meshTable.getTotalMeshSize()) / 1024.0f))
+			{
+				std::vector<std::pair<std::string, size_t>> meshSizes;
+				meshTable.getMeshSizes(meshSizes);
+				for (auto & mesh : meshSizes)
+				{
+					ImGui::Text("%s: %.1f KB", mesh.first.c_str(), float(mesh.second) / 1024.0f);
+				}
+				ImGui::TreePop();
+			}
+			ImGui::Spacing();
+
+			if (ImGui::Button("Benchmark tree generation##app"))
+			{
+				treeBenchmark = Engine::VegetationTable::getInstance().benchmarkTreeGeneration(20);
+			}
+			if (treeBenchmark.trees > 0)
+			{
+				ImGui::Text("Recursive: %.0f trees/s, peak %.1f KB, %u vertices/tree", treeBenchmark.recursiveTreesPerSecond,
+					float(treeBenchmark.recursivePeakBytes) / 1024.0f, (unsigned int)(treeBenchmark.recursiveVertices / treeBenchmark.trees));
+				ImGui::Text("Arena: %.0f trees/s (%.0f parallel), peak %.1f KB, %u vertices/tree", treeBenchmark.serialTreesPerSecond,
+					treeBenchmark.parallelTreesPerSecond, float(treeBenchmark.peakBytes) / 1024.0f, (unsigned int)(treeBenchmark.vertices / treeBenchmark.trees));
+			}
+			ImGui::Spacing();
+
+			if (ImGui::Button("Benchmark cloud noise baking##app"))
+			{
+				cloudNoiseBenchmark = Engine::CloudSystem::CloudNoiseBaker::benchmark();
+			}
+			for (auto & entry : cloudNoiseBenchmark)
+			{
+				ImGui::Text("%u thread(s): %.1f ms (%.1f + %.1f + %.1f)", entry.threads, entry.totalMs,
+					entry.textureMs[Engine::CloudSystem::CLOUD_NOISE_PERLIN_WORLEY], entry.textureMs[Engine::CloudSystem::CLOUD_NOISE_WORLEY],
+					entry.textureMs[Engine::CloudSystem::CLOUD_NOISE_WEATHER]);
+			}
+			if (ImGui::Button("Validate cloud noise##app"))
+			{
+				Engine::CloudSystem::CloudNoiseBaker baker;
+				baker.bake();
+				cloudNoiseValidation = baker.validate(1000);
+			}
+			if (cloudNoiseValidation.samples > 0)
+			{
+				ImGui::Text("%u/%u texels within tolerance, max error %.5f", cloudNoiseValidation.samples - cloudNoiseValidation.failures,
+					cloudNoiseValidation.samples, cloudNoiseValidation.maxError);
+			}
+		}
 		ImGui::End();
 	}
+
+	if (Engine::Settings::showProfiler)
+	{
+		drawProfiler();
+	}
+}
+
+void Engine::Window::WorldControllerUI::drawProfiler()
+{
+	ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+	ImGui::SetNextWindowSize(ImVec2(420.0f, 0.0f));
+
+	if (ImGui::Begin("Profiler##app", &Engine::Settings::showProfiler))
+	{
+		Engine::Profiler & profiler = Engine::Profiler::getInstance();
+
+		bool enabled = profiler.isEnabled();
+		if (ImGui::Checkbox("Enabled##profiler", &enabled))
+		{
+			profiler.setEnabled(enabled);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Save Chrome trace##profiler"))
+		{
+			bool saved = profiler.exportChromeTrace();
+			traceStatus = saved ? "Saved " + Engine::Profiler::DEFAULT_TRACE_FILE : "Could not write " + Engine::Profiler::DEFAULT_TRACE_FILE;
+		}
+		if (!traceStatus.empty())
+		{
+			ImGui::Text(traceStatus.c_str());
+		}
+		ImGui::Spacing();
+
+		// Averages of the last Profiler::ROLLING_FRAMES frames
+		ImGui::Columns(3, "stages##profiler");
+		ImGui::SetColumnWidth(0, 240.0f);
+		ImGui::Text("Stage"); ImGui::NextColumn();
+		ImGui::Text("CPU ms"); ImGui::NextColumn();
+		ImGui::Text("GPU ms"); ImGui::NextColumn();
+		ImGui::Separator();
+
+		for (auto & stage : profiler.getStageStats())
+		{
+			ImGui::Text("%*s%s", int(stage.depth * 2), "", stage.name.c_str()); ImGui::NextColumn();
+			ImGui::Text("%.3f", stage.cpuMs); ImGui::NextColumn();
+			if (stage.gpuMs >= 0.0)
+				ImGui::Text("%.3f", stage.gpuMs);
+			else
+				ImGui::Text("-");
+			ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+
+		// Tone mapping + depth of field + screen output, remembered for both paths to compare them
+		double separateMs = 0.0;
+		bool separate = false;
+		for (auto & stage : profiler.getStageStats())
+		{
+			if (stage.gpuMs < 0.0)
+				continue;
+
+			if (stage.name == "Fused output")
+				fusedPostMs = stage.gpuMs;
+			else if (stage.name == "Screen output" || stage.name == Engine::HDRToneMappingProgram::PROGRAM_NAME || stage.name == Engine::DepthOfFieldProgram::PROGRAM_NAME)
+			{
+				separateMs += stage.gpuMs;
+				separate = separate || stage.name == "Screen output";
+			}
+		}
+		if (separate)
+			separatePostMs = separateMs;
+
+		ImGui::Spacing();
+		ImGui::Text("Tone mapping + DoF + output (GPU ms)");
+		if (separatePostMs >= 0.0)
+			ImGui::Text("Separate passes: %.3f", separatePostMs);
+		else
+			ImGui::Text("Separate passes: -");
+		if (fusedPostMs >= 0.0)
+			ImGui::Text("Fused compute: %.3f", fusedPostMs);
+		else
+			ImGui::Text("Fused compute: -");
+	}
+	ImGui::End();
 }
\ No newline at end of file
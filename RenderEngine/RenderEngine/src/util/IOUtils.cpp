@@ -1,7 +1,9 @@
 #include "util/IOUtils.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 char * Engine::IO::loadStringFromFile(const char * fileName, unsigned long long & fileLen)
 {
@@ -12,22 +14,17 @@ char * Engine::IO::loadStringFromFile(const char * fileName, unsigned long long
 		return 0;
 	}
 
-	file.seekg(0, std::ios::end);
-	fileLen = file.tellg();
-	file.seekg(std::ios::beg);
+	// Read the whole file at once (text mode, so line endings might shrink the content)
+	std::ostringstream buffer;
+	buffer << file.rdbuf();
+	file.close();
 
-	char * content = new char[fileLen + 1];
-
-	int i = 0;
-	while (file.good())
-	{
-		content[i] = char(file.get());
-		if (!file.eof()) i++;
-		else fileLen = i;
-	}
+	const std::string & str = buffer.str();
+	fileLen = str.size();
 
+	char * content = new char[fileLen + 1];
+	memcpy(content, str.c_str(), fileLen);
 	content[fileLen] = '\0';
-	file.close();
 
 	return content;
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "util/MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Engine::IO::MappedFile::MappedFile()
+	:data(0)
+	,size(0)
+#ifdef _WIN32
+	,fileHandle(INVALID_HANDLE_VALUE)
+	,mappingHandle(NULL)
+#else
+	,fileDescriptor(-1)
+#endif
+{
+}
+
+Engine::IO::MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool Engine::IO::MappedFile::open(const std::string & fileName)
+{
+	close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+	{
+		close();
+		return false;
+	}
+
+	data = (const unsigned char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	size = data != 0 ? (size_t)fileSize.QuadPart : 0;
+#else
+	fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fileDescriptor, &info) != 0 || info.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void * mapping = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping != MAP_FAILED)
+	{
+		data = (const unsigned char *)mapping;
+		size = (size_t)info.st_size;
+	}
+#endif
+
+	if (data == 0)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void Engine::IO::MappedFile::close()
+{
+#ifdef _WIN32
+	if (data != 0)
+		UnmapViewOfFile(data);
+	if (mappingHandle != NULL)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != 0)
+		munmap((void *)data, size);
+	if (fileDescriptor >= 0)
+		::close(fileDescriptor);
+
+	fileDescriptor = -1;
+#endif
+
+	data = 0;
+	size = 0;
+}
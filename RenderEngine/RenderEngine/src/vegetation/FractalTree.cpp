@@ -5,17 +5,29 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+const size_t Engine::FractalTree::CHUNKS_PER_TASK = 64;
 
 Engine::FractalTree::FractalTree(const TreeGenerationData & data) :Engine::ProceduralVegetation(data)
 {
 	// Get base shape to build the trees
 	base = Engine::MeshTable::getInstance().getMesh("trunk");
-	leaf = Engine::MeshTable::getInstance().getMesh("leaf");
 
-	// Initialize random generator engine
-	randEngine = std::default_random_engine(treeData.seed);
-	randGen = std::uniform_real_distribution<float>(0.0f, 1.0f);
+	// Height of the base shape, used to apply the leaf color gradient
+	const float * verts = base->getVertices();
+	float highestY = -99999.9f, lowestY = 99999.9f;
+	for (unsigned int i = 0; i < base->getNumVertices(); i++)
+	{
+		highestY = std::max(highestY, verts[i * 3 + 1]);
+		lowestY = std::min(lowestY, verts[i * 3 + 1]);
+	}
+	baseHeight = highestY - lowestY;
+
+	vertices = colors = emission = uvs = 0;
+	faces = 0;
+	numVertices = numFaces = 0;
 
 	// For ease config, data is setted on degrees, but we need radians
 	treeData.minBranchRotation.x = glm::radians(treeData.minBranchRotation.x);
@@ -28,92 +40,97 @@ Engine::FractalTree::FractalTree(const TreeGenerationData & data) :Engine::Proce
 
 Engine::Mesh * Engine::FractalTree::generate()
 {
+	prepare();
+
+	Engine::Concurrent::CountDownLatch latch;
+	buildChunksAsync(latch);
+	latch.wait();
+
+	return createMesh();
+}
+
+void Engine::FractalTree::prepare()
+{
+	chunks.clear();
+	numVertices = numFaces = 0;
+
 	// Initial data to start growin the tree
 	glm::vec3 scale = glm::vec3(0.04f, 0.2f, 0.04f) * treeData.scalingFactor;
 	glm::vec3 translation(0, 0, 0);
-	glm::vec3 rotation;
+	glm::vec3 rotation(0, 0, 0);
 
+	unsigned long long rootKey = childKey(treeData.seed, 0);
 	if (treeData.rotateMainTrunk)
 	{
 		glm::vec3 & min = treeData.minBranchRotation;
 		glm::vec3 & max = treeData.maxBranchRotation;
-		rotation.x = randInInterval(min.x, max.x);
-		rotation.y = randInInterval(min.y, max.y);
-		rotation.z = randInInterval(min.z, max.z);
-	}
-	else
-	{
-		rotation = glm::vec3(0, 0, 0);
-	}
-	
-	processChunk(glm::mat4(1.0f), scale, translation, rotation, 0, 1);
-
-	// Copy generated data to the Engine::Mesh class format
-	float * newVertices = new float[vertices.size() * 3];
-	float * newColors = new float[vertices.size() * 3];
-	float * newEmission = new float[vertices.size() * 3];
-	float * newUVs = new float[vertices.size() * 2];
-	for (size_t i = 0; i < vertices.size(); i++)
-	{
-		size_t index = i * 3;
-		// Copy vertex pos
-		glm::vec3 & v = vertices[i];
-		newVertices[index] = v.x;
-		newVertices[index + 1] = v.y;
-		newVertices[index + 2] = v.z;
-		// Copy vertex color
-		glm::vec3 & c = colors[i];
-		newColors[index] = c.x;
-		newColors[index + 1] = c.y;
-		newColors[index + 2] = c.z;
-		// Copy vertex emission
-		glm::vec3 & e = emission[i];
-		newEmission[index] = e.x;
-		newEmission[index + 1] = e.y;
-		newEmission[index + 2] = e.z;
-
-		size_t uvIndex = i * 2;
-		glm::vec2 & uv = uvs[i];
-		newUVs[uvIndex] = uv.x;
-		newUVs[uvIndex + 1] = uv.y;
+		rotation.x = randInInterval(rootKey, 3, min.x, max.x);
+		rotation.y = randInInterval(rootKey, 4, min.y, max.y);
+		rotation.z = randInInterval(rootKey, 5, min.z, max.z);
 	}
 
-	unsigned int * newFaces = new unsigned int[faces.size() * 3];
-	for (size_t i = 0; i < faces.size(); i++)
-	{
-		size_t index = i * 3;
-		glm::ivec3 & f = faces[i];
-		newFaces[index] = f.x;
-		newFaces[index + 1] = f.y;
-		newFaces[index + 2] = f.z;
-	}
+	processChunk(glm::mat4(1.0f), scale, translation, rotation, 0, 1, rootKey);
 
-	// Generate new mesh. Normals are automatically computed if not present in the constructor
-	Engine::Mesh * tree = new Engine::Mesh(unsigned int(faces.size()), unsigned int(vertices.size()), newFaces, newVertices, newColors, 0, newUVs, 0, newEmission);
+	// Lay out every attribute and the faces on a single block
+	const size_t vertexBytes = numVertices * 3 * sizeof(float);
+	const size_t uvBytes = numVertices * 2 * sizeof(float);
+	const size_t faceBytes = numFaces * 3 * sizeof(unsigned int);
+	arena.resize(vertexBytes * 3 + uvBytes + faceBytes);
 
-	return tree;
+	unsigned char * block = arena.empty() ? 0 : &arena[0];
+	vertices = (float*)block;
+	colors = (float*)(block + vertexBytes);
+	emission = (float*)(block + vertexBytes * 2);
+	uvs = (float*)(block + vertexBytes * 3);
+	faces = (unsigned int*)(block + vertexBytes * 3 + uvBytes);
 }
 
-void Engine::FractalTree::processChunk(glm::mat4 origin, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth)
+void Engine::FractalTree::processChunk(const glm::mat4 & origin, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth, unsigned long long key)
 {
-	if (depth >= treeData.depthStartingLeaf)
+	const size_t shapeVertices = base->getNumVertices();
+	const size_t shapeFaces = base->getNumFaces();
+
+	TreeChunk chunk;
+	chunk.depth = depth;
+	chunk.parentOffset = vOffset;
+	chunk.hasLeaf = depth >= treeData.depthStartingLeaf;
+	chunk.hasBranch = !chunk.hasLeaf || depth < treeData.maxDepth;
+
+	if (chunk.hasLeaf)
 	{
-		addLeaf(origin, scale / treeData.scalingFactor, vOffset, depth);
-		if(depth >= treeData.maxDepth)
-			return;
+		glm::vec3 lastScaling = scale / treeData.scalingFactor;
+		float maxScale = glm::max(glm::max(lastScaling.x, lastScaling.y), lastScaling.z);
+
+		//0.4 0.3 0.4
+		chunk.leafModel = origin * glm::translate(glm::mat4(1.0f), glm::vec3(0, maxScale, 0));
+		chunk.leafScale = glm::vec3(maxScale) * glm::vec3(0.4, 0.3, 0.4);
+		chunk.leafVertex = numVertices;
+		chunk.leafFace = numFaces;
+		numVertices += shapeVertices;
+		numFaces += shapeFaces;
+	}
+
+	if (!chunk.hasBranch)
+	{
+		chunks.push_back(chunk);
+		return;
 	}
 
 	// Generate local branch model matrix
-	glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), scale);
 	glm::mat4 translateMat = glm::translate(glm::mat4(1.0f), translate);
 	glm::quat q(rotation);
 	glm::mat4 rotateMat = glm::mat4_cast(q);
 
 	// Compute global branch model matrix
-	glm::mat4 modelMat = origin * translateMat * rotateMat;
+	chunk.branchModel = origin * translateMat * rotateMat;
+	chunk.branchScale = scale;
+	chunk.branchVertex = numVertices;
+	chunk.branchFace = numFaces;
+	// The first branch includes its base, the rest reuse the parent top vertices
+	numVertices += depth == 1 ? shapeVertices : shapeVertices - shapeVertices / 2;
+	numFaces += shapeFaces;
 
-	// Add vertices and faces applying the transformation
-	appendVerticesAndFaces(base, modelMat, scale, depth, vOffset, depth==1, false);
+	chunks.push_back(chunk);
 
 	// Generate common translation to prevent branches from growing inside parent branches
 	translate.y = scale.y;
@@ -122,23 +139,24 @@ void Engine::FractalTree::processChunk(glm::mat4 origin, glm::vec3 scale, glm::v
 	unsigned int intBranches = 1;
 	if (depth >= treeData.startBranchingDepth)
 	{
-		float branches = randGen(randEngine) * float(treeData.maxBranchesSplit);
-		intBranches = unsigned int(ceil(branches)); // ceil ensures there will be at least 1 branch
+		float branches = random(key, 0) * float(treeData.maxBranchesSplit);
+		intBranches = (unsigned int)ceil(branches); // ceil ensures there will be at least 1 branch
+		intBranches = intBranches < 1 ? 1 : intBranches;
 	}
 
-	size_t currentOffset = vertices.size();
+	size_t currentOffset = numVertices;
 
-	float xRotation = randInInterval(treeData.minBranchRotation.x, treeData.maxBranchRotation.x);;// *(depth + 1);
+	float xRotation = randInInterval(key, 1, treeData.minBranchRotation.x, treeData.maxBranchRotation.x);
 
 	float deltaAngle = (2.f * 3.1415f) / intBranches;
-	float sign = randSign();
+	float sign = random(key, 2) < 0.5f ? -1.0f : 1.0f;
 	// Apply branching
+	const glm::mat4 modelMat = chunk.branchModel;
 	for (unsigned int i = 0; i < intBranches; i++)
 	{
 		// Copy and adjust next branch random data
 		glm::vec3 scaleCopy = scale;
 		scaleCopy *= treeData.scalingFactor;
-		//scaleCopy.y *= 1.1f;
 
 		glm::vec3 rotationCopy = rotation;
 		rotationCopy.x = xRotation * sign;
@@ -146,113 +164,150 @@ void Engine::FractalTree::processChunk(glm::mat4 origin, glm::vec3 scale, glm::v
 		rotationCopy.z = 0.0f;
 
 		// Next branch
-		processChunk(modelMat, scaleCopy, translate, rotationCopy, currentOffset, depth + 1);
+		processChunk(modelMat, scaleCopy, translate, rotationCopy, currentOffset, depth + 1, childKey(key, i + 1));
 	}
 }
 
-void Engine::FractalTree::addLeaf(glm::mat4 origin, glm::vec3 lastScaling, size_t offset, unsigned int depth)
+void Engine::FractalTree::buildChunks(size_t begin, size_t end)
 {
-	float maxScale = glm::max(glm::max(lastScaling.x, lastScaling.y), lastScaling.z);
-
-	glm::vec3 translation(0, maxScale, 0);
-	glm::mat4 model = origin * glm::translate(glm::mat4(1.0f), translation);
+	end = std::min(end, chunks.size());
+	for (size_t c = begin; c < end; c++)
+	{
+		const TreeChunk & chunk = chunks[c];
+		if (chunk.hasLeaf)
+		{
+			writeBaseShape(chunk.leafModel, chunk.leafScale, 0, chunk.parentOffset, chunk.leafVertex, chunk.leafFace, true, true);
+		}
 
-	//0.4 0.3 0.4
-	appendVerticesAndFaces(base, model, glm::vec3(maxScale) * glm::vec3(0.4, 0.3, 0.4), 0, offset, true, true);
+		if (chunk.hasBranch)
+		{
+			writeBaseShape(chunk.branchModel, chunk.branchScale, chunk.depth, chunk.parentOffset, chunk.branchVertex, chunk.branchFace, chunk.depth == 1, false);
+		}
+	}
 }
 
-void Engine::FractalTree::appendVerticesAndFaces(Engine::Mesh * source, glm::mat4 model, glm::vec3 scale, unsigned int depth, size_t vOffset, bool keepBase, bool isLeaf)
+void Engine::FractalTree::buildChunksAsync(Engine::Concurrent::CountDownLatch & latch)
 {
-	// Add faces adding the offset of vertices already added to the main tree
-	const unsigned int * fac = source->getFaces();
-	size_t realOffset = vertices.size();
-	for (unsigned int i = 0; i < source->getNumFaces(); i++)
+	const size_t numTasks = (chunks.size() + CHUNKS_PER_TASK - 1) / CHUNKS_PER_TASK;
+	latch.add(numTasks);
+
+	for (size_t t = 0; t < numTasks; t++)
 	{
-		unsigned int index = i * 3;
+		size_t begin = t * CHUNKS_PER_TASK;
+		std::unique_ptr<Engine::Concurrent::Runnable> task(new Engine::FractalTreeTask(this, begin, begin + CHUNKS_PER_TASK, &latch));
+		Engine::Concurrent::ThreadPool::getInstance().addTask(std::move(task));
+	}
+}
+
+Engine::Mesh * Engine::FractalTree::createMesh() const
+{
+	// Generate new mesh. Normals are automatically computed if not present in the constructor
+	// The branches are laid out in generation order, let the mesh reorder them for the GPU
+	Engine::VertexLayout layout = Engine::VertexLayout::compact();
+	layout.setOptimized(true);
+	return new Engine::Mesh((unsigned int)numFaces, (unsigned int)numVertices, faces, vertices, colors, 0, uvs, 0, emission, layout);
+}
 
-		size_t a = fac[index];
-		size_t b = fac[index + 1];
-		size_t c = fac[index + 2];
+size_t Engine::FractalTree::getMemoryUsage() const
+{
+	return arena.capacity() + chunks.capacity() * sizeof(TreeChunk);
+}
 
+void Engine::FractalTree::writeBaseShape(const glm::mat4 & model, glm::vec3 scale, unsigned int depth, size_t vOffset, size_t vertex, size_t face, bool keepBase, bool isLeaf)
+{
+	// Add faces adding the offset of vertices already added to the main tree
+	const unsigned int * fac = base->getFaces();
+	const size_t half = base->getNumVertices() / 2;
+	for (unsigned int i = 0; i < base->getNumFaces() * 3; i++)
+	{
+		size_t a = fac[i];
 		if (!keepBase)
 		{
-			a = a < 4 ? a + vOffset - 4 : a + realOffset - 4;
-			b = b < 4 ? b + vOffset - 4 : b + realOffset - 4;
-			c = c < 4 ? c + vOffset - 4 : c + realOffset - 4;
+			a = a < half ? a + vOffset - half : a + vertex - half;
 		}
 		else
 		{
-			a += realOffset;
-			b += realOffset;
-			c += realOffset;
+			a += vertex;
 		}
 
-		glm::ivec3 f(a, b, c);
-		faces.push_back(f);
+		faces[face * 3 + i] = (unsigned int)a;
 	}
 
 	// Add new vertices applying the transformations
-	const float * verts = source->getVertices();
-	unsigned int start = keepBase ? 0 : source->getNumVertices() / 2;
-	float highestY = -99999.9f, lowestY = 99999.9f;
-	for (unsigned int i = start; i < source->getNumVertices(); i++)
-	{
-		unsigned int index = (i * 3) + 1;
+	const float * verts = base->getVertices();
+	const float * baseUVs = base->getUVs();
+	unsigned int start = keepBase ? 0 : (unsigned int)half;
 
-		if (verts[index] > highestY)
-			highestY = verts[index];
-		if (verts[index] < lowestY)
-			lowestY = verts[index];
-	}
-	float delta = highestY - lowestY;
-
-	for (unsigned int i = start; i < source->getNumVertices(); i++)
+	for (unsigned int i = start; i < base->getNumVertices(); i++, vertex++)
 	{
 		unsigned int index = i * 3;
 		float x = verts[index] * scale.x;
-		float y = verts[index + 1] * scale.y; 
+		float y = verts[index + 1] * scale.y;
 		float z = verts[index + 2] * scale.z;
-		glm::vec4 v(x, y, z, 1.0);
-
-		unsigned int uvIndex = i * 2;
-		float s = source->getUVs()[uvIndex] +  - 4;
-		float t = source->getUVs()[uvIndex + 1] + vOffset - 4;
-		glm::vec2 uv(s, t);
-		uvs.push_back(uv);
+		glm::vec4 transformedV = model * glm::vec4(x, y, z, 1.0);
 
-		glm::vec4 transformedV = model * v;
+		size_t dst = vertex * 3;
+		vertices[dst] = transformedV.x;
+		vertices[dst + 1] = transformedV.y;
+		vertices[dst + 2] = transformedV.z;
 
-		vertices.push_back(glm::vec3(transformedV.x, transformedV.y, transformedV.z));
+		unsigned int uvIndex = i * 2;
+		uvs[vertex * 2] = baseUVs[uvIndex] - 4.0f;
+		uvs[vertex * 2 + 1] = baseUVs[uvIndex + 1] + float(vOffset) - 4.0f;
 
+		glm::vec3 color, extra;
 		if (!isLeaf)
 		{
 			// Add color gradient based on depth + vertex height
-			colors.push_back(glm::mix(treeData.startTrunkColor, treeData.endTrunkColor, depth * 2.0f + y));
-			emission.push_back(glm::vec3(0, 0, 0));
+			color = glm::mix(treeData.startTrunkColor, treeData.endTrunkColor, depth * 2.0f + y);
+			extra = glm::vec3(0, 0, 0);
 		}
 		else
 		{
-			glm::vec3 color = glm::mix(treeData.leafStartColor, treeData.leafEndColor, verts[index + 1] / delta);
 			// Add leaf color and possible emission
-			glm::vec3 data;
-			data.x = 1.0f;
-			data.y = treeData.emissiveLeaf ? 1.0f : 0.0f;
-			emission.push_back(data);
-			colors.push_back(color);
+			color = glm::mix(treeData.leafStartColor, treeData.leafEndColor, verts[index + 1] / baseHeight);
+			extra = glm::vec3(1.0f, treeData.emissiveLeaf ? 1.0f : 0.0f, 0.0f);
 		}
+
+		memcpy(colors + dst, &color[0], sizeof(glm::vec3));
+		memcpy(emission + dst, &extra[0], sizeof(glm::vec3));
 	}
 }
 
-float Engine::FractalTree::randSign()
+float Engine::FractalTree::random(unsigned long long key, unsigned int n)
+{
+	// splitmix64 finalizer
+	unsigned long long x = key + (unsigned long long)(n + 1) * 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	x = x ^ (x >> 31);
+
+	// Upper 24 bits, to get an uniform float within [0, 1)
+	return float(x >> 40) * (1.0f / 16777216.0f);
+}
+
+unsigned long long Engine::FractalTree::childKey(unsigned long long key, unsigned int child)
+{
+	unsigned long long x = (key ^ 0xD6E8FEB86659FD93ull) + (unsigned long long)child * 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 32)) * 0xD6E8FEB86659FD93ull;
+	x = (x ^ (x >> 32)) * 0xD6E8FEB86659FD93ull;
+	return x ^ (x >> 32);
+}
+
+float Engine::FractalTree::randInInterval(unsigned long long key, unsigned int n, float a, float b)
+{
+	return a + (b - a) * random(key, n);
+}
+
+// ====================================================================================================================
+
+Engine::FractalTreeTask::FractalTreeTask(Engine::FractalTree * tree, size_t begin, size_t end, Engine::Concurrent::CountDownLatch * latch)
+	:tree(tree), begin(begin), end(end), latch(latch)
 {
-	float v = randGen(randEngine);
-	if (v < 0.5)
-		return -1.0f;
-	else
-		return 1.0f;
 }
 
-float Engine::FractalTree::randInInterval(float a, float b)
+void Engine::FractalTreeTask::run()
 {
-	return a + (b - a) * randGen(randEngine);
+	tree->buildChunks(begin, end);
+	latch->countDown();
 }
@@ -0,0 +1,154 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "vegetation/TreeImpostorAtlas.h"
+
+#include "datatables/ProgramTable.h"
+#include "programs/TreeProgram.h"
+#include "RenderStatistics.h"
+#include "GLStateCache.h"
+
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+const unsigned int Engine::TreeImpostorAtlas::DEFAULT_VIEWS = 8;
+const unsigned int Engine::TreeImpostorAtlas::DEFAULT_FRAME_SIZE = 128;
+
+static unsigned int createAtlasTexture(unsigned int width, unsigned int height)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+Engine::TreeImpostorAtlas::TreeImpostorAtlas(unsigned int numViews, unsigned int frameSize)
+	:numViews(numViews)
+	,frameSize(frameSize)
+	,colorTexture(0)
+	,normalTexture(0)
+{
+}
+
+void Engine::TreeImpostorAtlas::bake(const std::vector<Engine::Mesh *> & trees)
+{
+	destroy();
+	extents.clear();
+	if (trees.empty())
+		return;
+
+	const unsigned int width = numViews * frameSize;
+	const unsigned int height = (unsigned int)trees.size() * frameSize;
+
+	colorTexture = createAtlasTexture(width, height);
+	normalTexture = createAtlasTexture(width, height);
+
+	unsigned int depthBuffer;
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	// Keep the state the engine is using
+	GLuint previousFbo = Engine::GLStateCache::getInstance().getDrawFramebuffer();
+	GLint previousViewport[4];
+	GLfloat previousClearColor[4];
+	Engine::GLStateCache::getInstance().getViewport(previousViewport);
+	Engine::GLStateCache::getInstance().getClearColor(previousClearColor);
+
+	unsigned int fbo;
+	glGenFramebuffers(1, &fbo);
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, buffers);
+
+	if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+	{
+		std::cout << "TreeImpostorAtlas: Could not create the impostor framebuffer" << std::endl;
+		exit(-1);
+	}
+
+	Engine::GLStateCache::getInstance().clearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	Engine::TreeProgram * program = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::IMPOSTOR_BAKE);
+	program->use();
+
+	for (unsigned int t = 0; t < trees.size(); t++)
+	{
+		Engine::Mesh * mesh = trees[t];
+		program->configureMeshBuffers(mesh);
+
+		// Billboard extents, the billboard rotates around the trunk (y) axis
+		const float * vertices = mesh->getVertices();
+		float radius = 0.0f, minY = vertices[1], maxY = vertices[1];
+		for (unsigned int v = 0; v < mesh->getNumVertices(); v++)
+		{
+			const float * p = vertices + v * 3;
+			radius = std::max(radius, sqrtf(p[0] * p[0] + p[2] * p[2]));
+			minY = std::min(minY, p[1]);
+			maxY = std::max(maxY, p[1]);
+		}
+		extents.push_back(glm::vec3(radius, minY, maxY));
+
+		glm::vec3 center(0.0f, (minY + maxY) * 0.5f, 0.0f);
+		glm::mat4 proj = glm::ortho(-radius, radius, minY - center.y, maxY - center.y, 0.0f, radius * 2.0f + 2.0f);
+
+		for (unsigned int v = 0; v < numViews; v++)
+		{
+			// Same view direction the impostor shader uses to pick the frame
+			float angle = (2.0f * 3.14159265f * float(v)) / float(numViews);
+			glm::vec3 direction(sinf(angle), 0.0f, cosf(angle));
+			glm::mat4 view = glm::lookAt(center + direction * (radius + 1.0f), center, glm::vec3(0, 1, 0));
+
+			Engine::GLStateCache::getInstance().viewport(v * frameSize, t * frameSize, frameSize, frameSize);
+			program->setUniformBakeMatrices(view, proj);
+
+			glDrawElements(GL_TRIANGLES, mesh->getNumFaces() * 3, mesh->getIndexType(), (void*)0);
+			Engine::RenderStatistics::drawCalls++;
+		}
+	}
+
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+	Engine::GLStateCache::getInstance().viewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	Engine::GLStateCache::getInstance().clearColor(previousClearColor[0], previousClearColor[1], previousClearColor[2], previousClearColor[3]);
+
+	Engine::GLStateCache::getInstance().deleteFramebuffer(fbo);
+	glDeleteRenderbuffers(1, &depthBuffer);
+
+	// Impostors are seen from far away
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, colorTexture);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, normalTexture);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Engine::TreeImpostorAtlas::destroy()
+{
+	if (colorTexture != 0)
+	{
+		Engine::GLStateCache::getInstance().deleteTexture(colorTexture);
+		colorTexture = 0;
+	}
+
+	if (normalTexture != 0)
+	{
+		Engine::GLStateCache::getInstance().deleteTexture(normalTexture);
+		normalTexture = 0;
+	}
+}
@@ -0,0 +1,1078 @@
+/*
+* @author Nadir Román Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "volumetricclouds/CloudNoiseBaker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include <emmintrin.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/noise.hpp>
+
+const std::string Engine::CloudSystem::CloudNoiseBaker::DEFAULT_CACHE_FILE = "cloudnoise.bin";
+const unsigned int Engine::CloudSystem::CloudNoiseBaker::GENERATOR_VERSION = 1;
+const float Engine::CloudSystem::CloudNoiseBaker::VALIDATION_TOLERANCE = 0.5f / 255.0f + 1.0e-4f;
+
+// Cache file layout: header, then every texture aligned to a page boundary
+const unsigned int CACHE_MAGIC = 0x5a4e4352; // RCNZ
+const unsigned int CACHE_FILE_VERSION = 1;
+const size_t CACHE_ALIGNMENT = 4096;
+
+typedef struct CloudNoiseCacheHeader
+{
+	unsigned int magic;
+	unsigned int fileVersion;
+	unsigned long long key;
+	unsigned int sizes[Engine::CloudSystem::CLOUD_NOISE_TEXTURE_COUNT];
+	unsigned int padding;
+	unsigned long long offsets[Engine::CloudSystem::CLOUD_NOISE_TEXTURE_COUNT];
+	unsigned long long lengths[Engine::CloudSystem::CLOUD_NOISE_TEXTURE_COUNT];
+} CloudNoiseCacheHeader;
+
+// Rows each task takes at once
+const unsigned int ROWS_PER_STEP = 16;
+
+// Cell counts of the Worley octaves. perlinworley.comp: 4 * frequenceMul[0..2] for the Perlin-Worley
+// channel, then 4 * (2, 4, 8, 16) (8 and 32 are shared). worley.comp: 2 * (1, 2, 4, 8)
+const unsigned int PERLIN_WORLEY_CELLS[] = { 8, 32, 56, 16, 64 };
+const unsigned int WORLEY_CELLS[] = { 2, 4, 8, 16 };
+// Perlin FBM octave frequencies of perlinworley.comp, and their weights
+const unsigned int PERLIN_FREQUENCIES[] = { 8, 16, 32 };
+const float PERLIN_WEIGHTS[] = { 0.5f, 0.25f, 0.0625f };
+
+// ========================================================================================
+// Shader formulas shared by the fast path and the literal port
+
+static float fract(float x)
+{
+	return x - floorf(x);
+}
+
+static unsigned char toUnorm8(float value)
+{
+	value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+	return (unsigned char)floorf(value * 255.0f + 0.5f);
+}
+
+// hash() of the Worley cells
+static float cellHash(int n, unsigned int seed)
+{
+	return fract(sinf(float(n + int(seed & 0xffff)) + 1.951f) * 43758.5453123f);
+}
+
+// random2D() of the weather noise
+static float random2D(float x, float y)
+{
+	return fract(sinf(x * 12.9898f + y * 78.233f) * 43758.5453123f);
+}
+
+static float weatherSeedOffset(unsigned int seed)
+{
+	return float(seed & 0xfff);
+}
+
+static float mod289(float x)
+{
+	return x - floorf(x * 1.0f / 289.0f) * 289.0f;
+}
+
+static float permute(float x)
+{
+	return mod289(((x * 34.0f) + 1.0f) * x);
+}
+
+static float fadeCurve(float t)
+{
+	return (t * t * t) * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static float smoothWeight(float t)
+{
+	t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+	return t * t * (3.0f - 2.0f * t);
+}
+
+static int wrap(int i, int count)
+{
+	return i < 0 ? i + count : (i >= count ? i - count : i);
+}
+
+// ========================================================================================
+// Literal port of the compute shaders, used to validate the fast path
+
+static float shaderNoise(const glm::vec3 & x, unsigned int seed)
+{
+	glm::vec3 p = glm::floor(x);
+	glm::vec3 f = glm::fract(x);
+
+	f = f*f*(glm::vec3(3.0f) - glm::vec3(2.0f) * f);
+	float n = p.x + p.y*57.0f + 113.0f*p.z;
+	return glm::mix(
+		glm::mix(
+			glm::mix(cellHash(int(n + 0.0f), seed), cellHash(int(n + 1.0f), seed), f.x),
+			glm::mix(cellHash(int(n + 57.0f), seed), cellHash(int(n + 58.0f), seed), f.x),
+			f.y),
+		glm::mix(
+			glm::mix(cellHash(int(n + 113.0f), seed), cellHash(int(n + 114.0f), seed), f.x),
+			glm::mix(cellHash(int(n + 170.0f), seed), cellHash(int(n + 171.0f), seed), f.x),
+			f.y),
+		f.z);
+}
+
+static float shaderCells(const glm::vec3 & p, float cellCount, unsigned int seed)
+{
+	glm::vec3 pCell = p * cellCount;
+	float d = 1.0e10f;
+	for (int xo = -1; xo <= 1; xo++)
+	{
+		for (int yo = -1; yo <= 1; yo++)
+		{
+			for (int zo = -1; zo <= 1; zo++)
+			{
+				glm::vec3 tp = glm::floor(pCell) + glm::vec3(float(xo), float(yo), float(zo));
+
+				tp = pCell - tp - shaderNoise(glm::mod(tp, cellCount / 1.0f), seed);
+
+				d = std::min(d, glm::dot(tp, tp));
+			}
+		}
+	}
+	d = std::min(d, 1.0f);
+	d = std::max(d, 0.0f);
+
+	return d;
+}
+
+static float shaderPerlin3D(const glm::vec3 & pIn, float frequency, int octaveCount)
+{
+	float sum = 0.0f;
+	float weightSum = 0.0f;
+	float weight = 0.5f;
+	for (int oct = 0; oct < octaveCount; oct++)
+	{
+		glm::vec4 p = glm::vec4(pIn.x, pIn.y, pIn.z, 0.0f) * glm::vec4(frequency);
+		float val = glm::perlin(p, glm::vec4(frequency));
+
+		sum += val * weight;
+		weightSum += weight;
+
+		weight *= weight;
+		frequency *= 2.0f;
+	}
+
+	float noise = (sum / weightSum);
+	noise = std::min(noise, 1.0f);
+	noise = std::max(noise, 0.0f);
+	return noise;
+}
+
+static glm::vec4 shaderPerlinWorley(unsigned int x, unsigned int y, unsigned int z, unsigned int size, unsigned int seed)
+{
+	glm::vec3 coord = glm::vec3(float(x), float(y), float(z)) / float(size);
+
+	float perlinNoise = shaderPerlin3D(coord, 8.0f, 3);
+
+	float worleyNoise0 = (1.0f - shaderCells(coord, 4.0f * 2.0f, seed));
+	float worleyNoise1 = (1.0f - shaderCells(coord, 4.0f * 8.0f, seed));
+	float worleyNoise2 = (1.0f - shaderCells(coord, 4.0f * 14.0f, seed));
+	float worleyFBM = worleyNoise0*0.625f + worleyNoise1*0.25f + worleyNoise2*0.125f;
+	float perlinWorley = worleyFBM + (((perlinNoise - 0.0f) / (1.0f - 0.0f)) * (1.0f - worleyFBM));
+
+	float w1 = (1.0f - shaderCells(coord, 4.0f * 2.0f, seed));
+	float w2 = (1.0f - shaderCells(coord, 4.0f * 4.0f, seed));
+	float w3 = (1.0f - shaderCells(coord, 4.0f * 8.0f, seed));
+	float w4 = (1.0f - shaderCells(coord, 4.0f * 16.0f, seed));
+
+	float worleyFBM0 = w1*0.625f + w2*0.25f + w3*0.125f;
+	float worleyFBM1 = w2*0.625f + w3*0.25f + w4*0.125f;
+	float worleyFBM2 = w3*0.75f + w4*0.25f;
+
+	return glm::vec4(perlinWorley * perlinWorley, worleyFBM0, worleyFBM1, worleyFBM2);
+}
+
+static glm::vec4 shaderWorley(unsigned int x, unsigned int y, unsigned int z, unsigned int size, unsigned int seed)
+{
+	glm::vec3 coord = glm::vec3(float(x), float(y), float(z)) / float(size);
+
+	float worleyNoise0 = (1.0f - shaderCells(coord, 2.0f * 1.0f, seed));
+	float worleyNoise1 = (1.0f - shaderCells(coord, 2.0f * 2.0f, seed));
+	float worleyNoise2 = (1.0f - shaderCells(coord, 2.0f * 4.0f, seed));
+	float worleyNoise3 = (1.0f - shaderCells(coord, 2.0f * 8.0f, seed));
+
+	float worleyFBM0 = worleyNoise0*0.625f + worleyNoise1*0.25f + worleyNoise2*0.125f;
+	float worleyFBM1 = worleyNoise1*0.625f + worleyNoise2*0.25f + worleyNoise3*0.125f;
+	float worleyFBM2 = worleyNoise2*0.75f + worleyNoise3*0.25f;
+
+	return glm::vec4(worleyFBM0, worleyFBM1, worleyFBM2, 1.0f);
+}
+
+static float shaderNoiseInterpolation(const glm::vec2 & coord, float size, float seedOffset)
+{
+	glm::vec2 grid = coord * size;
+
+	glm::vec2 randomInput = glm::floor(grid) + glm::vec2(seedOffset);
+	glm::vec2 weights = glm::fract(grid);
+
+	float p0 = random2D(randomInput.x, randomInput.y);
+	float p1 = random2D(randomInput.x + 1.0f, randomInput.y);
+	float p2 = random2D(randomInput.x, randomInput.y + 1.0f);
+	float p3 = random2D(randomInput.x + 1.0f, randomInput.y + 1.0f);
+
+	weights.x = smoothWeight(weights.x);
+	weights.y = smoothWeight(weights.y);
+
+	return p0 +
+		(p1 - p0) * (weights.x) +
+		(p2 - p0) * (weights.y) * (1.0f - weights.x) +
+		(p3 - p1) * (weights.y * weights.x);
+}
+
+static glm::vec4 shaderWeather(unsigned int x, unsigned int y, const Engine::CloudSystem::CloudNoiseParameters & params)
+{
+	float texel = 1.0f / float(params.weatherSize);
+	glm::vec2 uv = glm::vec2(float(x) * texel, float(y) * texel);
+
+	float noiseValue = 0.0f;
+	float localAplitude = params.weatherAmplitude;
+	float localFrecuency = params.weatherFrecuency;
+	for (unsigned int index = 0; index < params.weatherOctaves; index++)
+	{
+		noiseValue += shaderNoiseInterpolation(uv, params.weatherScale * localFrecuency, weatherSeedOffset(params.seed)) * localAplitude;
+
+		localAplitude *= 0.5f;
+		localFrecuency *= 2.0f;
+	}
+	float coverage = (noiseValue - 0.2f) / 0.8f;
+
+	return glm::vec4(coverage, glm::clamp(coverage, 0.0f, 1.0f), 0.0f, 1.0f);
+}
+
+// ========================================================================================
+
+Engine::CloudSystem::CloudNoiseParameters Engine::CloudSystem::CloudNoiseBaker::getDefaultParameters()
+{
+	Engine::CloudSystem::CloudNoiseParameters params;
+	params.perlinWorleySize = 128;
+	params.worleySize = 32;
+	params.weatherSize = 2048;
+	params.weatherAmplitude = 0.5f;
+	params.weatherFrecuency = 0.92f;
+	params.weatherScale = 50.0f;
+	params.weatherOctaves = 8;
+	params.seed = 0;
+	return params;
+}
+
+Engine::CloudSystem::CloudNoiseBaker::CloudNoiseBaker(const Engine::CloudSystem::CloudNoiseParameters & params)
+	:params(params)
+{
+	for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		data[i] = NULL;
+	}
+}
+
+unsigned int Engine::CloudSystem::CloudNoiseBaker::getSize(Engine::CloudSystem::CloudNoiseTexture texture) const
+{
+	switch (texture)
+	{
+	case CLOUD_NOISE_PERLIN_WORLEY:
+		return params.perlinWorleySize;
+	case CLOUD_NOISE_WORLEY:
+		return params.worleySize;
+	case CLOUD_NOISE_WEATHER:
+		return params.weatherSize;
+	default:
+		return 0;
+	}
+}
+
+size_t Engine::CloudSystem::CloudNoiseBaker::getDataSize(Engine::CloudSystem::CloudNoiseTexture texture) const
+{
+	size_t size = getSize(texture);
+	return size * size * (isVolume(texture) ? size : 1) * 4;
+}
+
+bool Engine::CloudSystem::CloudNoiseBaker::isReady() const
+{
+	for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		if (data[i] == NULL)
+			return false;
+	}
+	return true;
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::release()
+{
+	for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		std::vector<unsigned char>().swap(baked[i]);
+		data[i] = NULL;
+	}
+	cache.close();
+
+	worleyTables.clear();
+	perlinTables.clear();
+	weatherOctaves.clear();
+}
+
+unsigned long long Engine::CloudSystem::CloudNoiseBaker::computeKey() const
+{
+	// FNV-1a over every parameter (one by one, so struct padding is never hashed)
+	unsigned long long hash = 14695981039346656037ULL;
+	auto add = [&hash](const void * value, size_t size)
+	{
+		const unsigned char * bytes = (const unsigned char *)value;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+
+	add(&GENERATOR_VERSION, sizeof(GENERATOR_VERSION));
+	add(&params.perlinWorleySize, sizeof(params.perlinWorleySize));
+	add(&params.worleySize, sizeof(params.worleySize));
+	add(&params.weatherSize, sizeof(params.weatherSize));
+	add(&params.weatherAmplitude, sizeof(params.weatherAmplitude));
+	add(&params.weatherFrecuency, sizeof(params.weatherFrecuency));
+	add(&params.weatherScale, sizeof(params.weatherScale));
+	add(&params.weatherOctaves, sizeof(params.weatherOctaves));
+	add(&params.seed, sizeof(params.seed));
+
+	return hash;
+}
+
+bool Engine::CloudSystem::CloudNoiseBaker::loadCache(const std::string & fileName)
+{
+	release();
+
+	if (!cache.open(fileName))
+		return false;
+
+	CloudNoiseCacheHeader header;
+	bool valid = cache.getSize() >= sizeof(header);
+	if (valid)
+	{
+		memcpy(&header, cache.getData(), sizeof(header));
+		valid = header.magic == CACHE_MAGIC && header.fileVersion == CACHE_FILE_VERSION && header.key == computeKey();
+	}
+
+	for (unsigned int i = 0; valid && i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		CloudNoiseTexture texture = CloudNoiseTexture(i);
+		valid = header.sizes[i] == getSize(texture)
+			&& header.lengths[i] == getDataSize(texture)
+			&& header.offsets[i] + header.lengths[i] <= cache.getSize();
+
+		if (valid)
+		{
+			data[i] = cache.getData() + header.offsets[i];
+		}
+	}
+
+	if (!valid)
+	{
+		std::cout << "CloudNoiseBaker: " << fileName << " was baked with other parameters, ignoring it" << std::endl;
+		release();
+		return false;
+	}
+
+	return true;
+}
+
+bool Engine::CloudSystem::CloudNoiseBaker::saveCache(const std::string & fileName) const
+{
+	if (!isReady())
+		return false;
+
+	CloudNoiseCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CACHE_MAGIC;
+	header.fileVersion = CACHE_FILE_VERSION;
+	header.key = computeKey();
+
+	unsigned long long offset = CACHE_ALIGNMENT;
+	for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		CloudNoiseTexture texture = CloudNoiseTexture(i);
+		header.sizes[i] = getSize(texture);
+		header.offsets[i] = offset;
+		header.lengths[i] = getDataSize(texture);
+		offset += ((header.lengths[i] + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT) * CACHE_ALIGNMENT;
+	}
+
+	std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "CloudNoiseBaker: Could not write " << fileName << std::endl;
+		return false;
+	}
+
+	std::vector<char> padding(CACHE_ALIGNMENT, 0);
+	file.write((const char *)&header, sizeof(header));
+	file.write(&padding[0], CACHE_ALIGNMENT - sizeof(header));
+
+	for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		file.write((const char *)data[i], header.lengths[i]);
+		size_t rest = header.lengths[i] % CACHE_ALIGNMENT;
+		if (rest != 0)
+		{
+			file.write(&padding[0], CACHE_ALIGNMENT - rest);
+		}
+	}
+
+	return file.good();
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::bake(unsigned int numThreads)
+{
+	for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		bakeTexture(CloudNoiseTexture(i), numThreads);
+	}
+}
+
+double Engine::CloudSystem::CloudNoiseBaker::bakeTexture(Engine::CloudSystem::CloudNoiseTexture texture, unsigned int numThreads)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	prepareTables(texture);
+
+	baked[texture].resize(getDataSize(texture));
+	data[texture] = &baked[texture][0];
+
+	const unsigned int size = getSize(texture);
+	const unsigned int numRows = isVolume(texture) ? size * size : size;
+
+	unsigned int poolSize = Engine::Concurrent::ThreadPool::getInstance().getPoolSize();
+	numThreads = numThreads == 0 || numThreads > poolSize ? poolSize : numThreads;
+
+	std::atomic<unsigned int> nextRow(0);
+	Engine::Concurrent::CountDownLatch latch;
+	latch.add(numThreads);
+	for (unsigned int t = 0; t < numThreads; t++)
+	{
+		std::unique_ptr<Engine::Concurrent::Runnable> task(new Engine::CloudSystem::CloudNoiseTask(this, texture, &nextRow, numRows, &latch));
+		Engine::Concurrent::ThreadPool::getInstance().addTask(std::move(task));
+	}
+	latch.wait();
+
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::prepareTables(Engine::CloudSystem::CloudNoiseTexture texture)
+{
+	worleyTables.clear();
+	perlinTables.clear();
+	weatherOctaves.clear();
+
+	const unsigned int size = getSize(texture);
+
+	if (texture == CLOUD_NOISE_PERLIN_WORLEY)
+	{
+		worleyTables.resize(sizeof(PERLIN_WORLEY_CELLS) / sizeof(unsigned int));
+		for (size_t i = 0; i < worleyTables.size(); i++)
+		{
+			worleyTables[i].cells = PERLIN_WORLEY_CELLS[i];
+			prepareWorleyTable(worleyTables[i], size);
+		}
+
+		perlinTables.resize(sizeof(PERLIN_FREQUENCIES) / sizeof(unsigned int));
+		for (size_t i = 0; i < perlinTables.size(); i++)
+		{
+			perlinTables[i].frequency = PERLIN_FREQUENCIES[i];
+			preparePerlinTable(perlinTables[i], size);
+		}
+	}
+	else if (texture == CLOUD_NOISE_WORLEY)
+	{
+		worleyTables.resize(sizeof(WORLEY_CELLS) / sizeof(unsigned int));
+		for (size_t i = 0; i < worleyTables.size(); i++)
+		{
+			worleyTables[i].cells = WORLEY_CELLS[i];
+			prepareWorleyTable(worleyTables[i], size);
+		}
+	}
+	else
+	{
+		const unsigned int padded = (size + 3) & ~3u;
+		const float texel = 1.0f / float(size);
+
+		float amplitude = params.weatherAmplitude;
+		float frecuency = params.weatherFrecuency;
+		weatherOctaves.resize(params.weatherOctaves);
+		for (auto & octave : weatherOctaves)
+		{
+			octave.size = params.weatherScale * frecuency;
+			octave.amplitude = amplitude;
+			octave.weight.resize(padded);
+			octave.lattice.resize(padded);
+			for (unsigned int x = 0; x < padded; x++)
+			{
+				float grid = float(std::min(x, size - 1)) * texel * octave.size;
+				float cell = floorf(grid);
+				octave.lattice[x] = int(cell);
+				octave.weight[x] = smoothWeight(grid - cell);
+			}
+
+			octave.latticeWidth = (unsigned int)octave.lattice[size - 1] + 2;
+			octave.cacheRows = octave.latticeWidth <= size;
+
+			amplitude *= 0.5f;
+			frecuency *= 2.0f;
+		}
+	}
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::prepareWorleyTable(WorleyTable & table, unsigned int size) const
+{
+	const int cells = int(table.cells);
+
+	// mod(tp, cellCount) is an integer cell, where noise() is just hash()
+	table.hashes.resize(size_t(cells) * cells * cells);
+	for (int z = 0; z < cells; z++)
+	{
+		for (int y = 0; y < cells; y++)
+		{
+			for (int x = 0; x < cells; x++)
+			{
+				table.hashes[(size_t(z) * cells + y) * cells + x] = cellHash(x + y * 57 + 113 * z, params.seed);
+			}
+		}
+	}
+
+	const unsigned int padded = (size + 3) & ~3u;
+	for (int o = 0; o < 3; o++)
+	{
+		table.offsets[o].resize(padded);
+		table.indices[o].resize(padded);
+		for (unsigned int x = 0; x < padded; x++)
+		{
+			float p = (float(std::min(x, size - 1)) / float(size)) * float(cells);
+			float t = floorf(p) + float(o - 1);
+			table.offsets[o][x] = p - t;
+			table.indices[o][x] = wrap(int(t), cells);
+		}
+	}
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::preparePerlinTable(PerlinTable & table, unsigned int size) const
+{
+	const int frequency = int(table.frequency);
+
+	// Same gradients glm::perlin(vec4, vec4) computes, for the corners with w = 0
+	table.gradients.resize(size_t(frequency) * frequency * frequency * 3);
+	for (int z = 0; z < frequency; z++)
+	{
+		for (int y = 0; y < frequency; y++)
+		{
+			for (int x = 0; x < frequency; x++)
+			{
+				float h = permute(permute(permute(permute(float(x)) + float(y)) + float(z)) + 0.0f);
+
+				float gx = h / 7.0f;
+				float gy = floorf(gx) / 7.0f;
+				float gz = floorf(gy) / 6.0f;
+				gx = fract(gx) - 0.5f;
+				gy = fract(gy) - 0.5f;
+				gz = fract(gz) - 0.5f;
+				float gw = 0.75f - fabsf(gx) - fabsf(gy) - fabsf(gz);
+				float sw = 0.0f < gw ? 0.0f : 1.0f;
+				gx -= sw * ((gx < 0.0f ? 0.0f : 1.0f) - 0.5f);
+				gy -= sw * ((gy < 0.0f ? 0.0f : 1.0f) - 0.5f);
+
+				float norm = 1.79284291400159f - 0.85373472095314f * (gx * gx + gy * gy + gz * gz + gw * gw);
+
+				float * g = &table.gradients[((size_t(z) * frequency + y) * frequency + x) * 3];
+				g[0] = gx * norm;
+				g[1] = gy * norm;
+				g[2] = gz * norm;
+			}
+		}
+	}
+
+	const unsigned int padded = (size + 3) & ~3u;
+	table.fraction.resize(padded);
+	table.fade.resize(padded);
+	table.corner0.resize(padded);
+	table.corner1.resize(padded);
+	for (unsigned int x = 0; x < padded; x++)
+	{
+		float p = (float(std::min(x, size - 1)) / float(size)) * float(frequency);
+		float cell = floorf(p);
+		table.fraction[x] = p - cell;
+		table.fade[x] = fadeCurve(p - cell);
+		table.corner0[x] = int(cell) % frequency;
+		table.corner1[x] = (table.corner0[x] + 1) % frequency;
+	}
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::bakeRows(Engine::CloudSystem::CloudNoiseTexture texture, unsigned int begin, unsigned int end)
+{
+	const unsigned int size = getSize(texture);
+	const unsigned int padded = (size + 3) & ~3u;
+
+	// One row per worley octave, plus the perlin noise and its accumulation
+	std::vector<float> scratch(padded * (worleyTables.size() + 2));
+	unsigned char * out = &baked[texture][0];
+
+	if (texture == CLOUD_NOISE_WEATHER)
+	{
+		bakeWeatherRows(begin, end, &scratch[0]);
+		return;
+	}
+
+	for (unsigned int row = begin; row < end; row++)
+	{
+		unsigned int y = row % size;
+		unsigned int z = row / size;
+		unsigned char * rowOut = out + size_t(row) * size * 4;
+
+		if (texture == CLOUD_NOISE_PERLIN_WORLEY)
+		{
+			bakePerlinWorleyRow(y, z, &scratch[0], rowOut);
+		}
+		else
+		{
+			bakeWorleyRow(y, z, &scratch[0], rowOut);
+		}
+	}
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::worleyRow(const WorleyTable & table, float y, float z, float * out) const
+{
+	const int cells = int(table.cells);
+	const unsigned int padded = (unsigned int)table.offsets[0].size();
+	const float * hashes = &table.hashes[0];
+
+	float py = y * float(cells);
+	float pz = z * float(cells);
+	float cy = floorf(py);
+	float cz = floorf(pz);
+
+	for (unsigned int x = 0; x < padded; x += 4)
+	{
+		__m128 best = _mm_set1_ps(1.0e10f);
+
+		for (int oz = -1; oz <= 1; oz++)
+		{
+			float tz = cz + float(oz);
+			int iz = wrap(int(tz), cells);
+			__m128 dz = _mm_set1_ps(pz - tz);
+
+			for (int oy = -1; oy <= 1; oy++)
+			{
+				float ty = cy + float(oy);
+				int iy = wrap(int(ty), cells);
+				__m128 dy = _mm_set1_ps(py - ty);
+				const float * slice = hashes + (size_t(iz) * cells + iy) * cells;
+
+				for (int ox = 0; ox < 3; ox++)
+				{
+					const int * index = &table.indices[ox][x];
+					__m128 h = _mm_set_ps(slice[index[3]], slice[index[2]], slice[index[1]], slice[index[0]]);
+
+					__m128 ex = _mm_sub_ps(_mm_loadu_ps(&table.offsets[ox][x]), h);
+					__m128 ey = _mm_sub_ps(dy, h);
+					__m128 ez = _mm_sub_ps(dz, h);
+					__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez));
+					best = _mm_min_ps(best, d);
+				}
+			}
+		}
+
+		best = _mm_max_ps(_mm_min_ps(best, _mm_set1_ps(1.0f)), _mm_setzero_ps());
+		_mm_storeu_ps(out + x, best);
+	}
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::perlinRow(const PerlinTable & table, float y, float z, float * out) const
+{
+	const int frequency = int(table.frequency);
+	const unsigned int padded = (unsigned int)table.fraction.size();
+	const float * gradients = &table.gradients[0];
+
+	float py = y * float(frequency);
+	float pz = z * float(frequency);
+	float cy = floorf(py);
+	float cz = floorf(pz);
+	int y0 = int(cy) % frequency, y1 = (y0 + 1) % frequency;
+	int z0 = int(cz) % frequency, z1 = (z0 + 1) % frequency;
+
+	// Lattice rows of the 4 (y, z) corners: y0z0, y1z0, y0z1, y1z1
+	const float * rows[4] =
+	{
+		gradients + (size_t(z0) * frequency + y0) * frequency * 3,
+		gradients + (size_t(z0) * frequency + y1) * frequency * 3,
+		gradients + (size_t(z1) * frequency + y0) * frequency * 3,
+		gradients + (size_t(z1) * frequency + y1) * frequency * 3
+	};
+
+	const __m128 fy0 = _mm_set1_ps(py - cy);
+	const __m128 fy1 = _mm_set1_ps(py - cy - 1.0f);
+	const __m128 fz0 = _mm_set1_ps(pz - cz);
+	const __m128 fz1 = _mm_set1_ps(pz - cz - 1.0f);
+	const __m128 fadeY = _mm_set1_ps(fadeCurve(py - cy));
+	const __m128 fadeZ = _mm_set1_ps(fadeCurve(pz - cz));
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (unsigned int x = 0; x < padded; x += 4)
+	{
+		const __m128 fx0 = _mm_loadu_ps(&table.fraction[x]);
+		const __m128 fx1 = _mm_sub_ps(fx0, one);
+
+		// Dot product of every corner gradient (xyz, w is always multiplied by 0) with the
+		// offset to the texel. Corners are ordered as glm: x fastest, then y, then z
+		__m128 n[8];
+		for (int c = 0; c < 8; c++)
+		{
+			const int * corner = (c & 1) ? &table.corner1[x] : &table.corner0[x];
+			const float * row = rows[c >> 1];
+
+			alignas(16) float g[3][4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				const float * gradient = row + corner[lane] * 3;
+				g[0][lane] = gradient[0];
+				g[1][lane] = gradient[1];
+				g[2][lane] = gradient[2];
+			}
+
+			__m128 dx = (c & 1) ? fx1 : fx0;
+			__m128 dy = (c & 2) ? fy1 : fy0;
+			__m128 dz = (c & 4) ? fz1 : fz0;
+			n[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(g[0]), dx), _mm_mul_ps(_mm_load_ps(g[1]), dy)), _mm_mul_ps(_mm_load_ps(g[2]), dz));
+		}
+
+		// mix(a, b, t) = a + t * (b - a)
+		__m128 xy[4];
+		for (int c = 0; c < 4; c++)
+		{
+			xy[c] = _mm_add_ps(n[c], _mm_mul_ps(fadeZ, _mm_sub_ps(n[c + 4], n[c])));
+		}
+		__m128 x0 = _mm_add_ps(xy[0], _mm_mul_ps(fadeY, _mm_sub_ps(xy[2], xy[0])));
+		__m128 x1 = _mm_add_ps(xy[1], _mm_mul_ps(fadeY, _mm_sub_ps(xy[3], xy[1])));
+		__m128 fadeX = _mm_loadu_ps(&table.fade[x]);
+		__m128 result = _mm_add_ps(x0, _mm_mul_ps(fadeX, _mm_sub_ps(x1, x0)));
+
+		_mm_storeu_ps(out + x, _mm_mul_ps(result, _mm_set1_ps(2.2f)));
+	}
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::bakePerlinWorleyRow(unsigned int y, unsigned int z, float * scratch, unsigned char * out) const
+{
+	const unsigned int size = params.perlinWorleySize;
+	const unsigned int padded = (size + 3) & ~3u;
+	const float cy = float(y) / float(size);
+	const float cz = float(z) / float(size);
+
+	// Worley cells 8, 32, 56, 16, 64
+	float * worley[5];
+	for (unsigned int i = 0; i < 5; i++)
+	{
+		worley[i] = scratch + i * padded;
+		worleyRow(worleyTables[i], cy, cz, worley[i]);
+	}
+
+	// Perlin FBM
+	float * octave = scratch + 5 * padded;
+	float * perlin = scratch + 6 * padded;
+	float weightSum = 0.0f;
+	for (unsigned int i = 0; i < perlinTables.size(); i++)
+	{
+		perlinRow(perlinTables[i], cy, cz, octave);
+		for (unsigned int x = 0; x < padded; x++)
+		{
+			perlin[x] = (i == 0 ? 0.0f : perlin[x]) + octave[x] * PERLIN_WEIGHTS[i];
+		}
+		weightSum += PERLIN_WEIGHTS[i];
+	}
+
+	for (unsigned int x = 0; x < size; x++)
+	{
+		float perlinNoise = std::max(std::min(perlin[x] / weightSum, 1.0f), 0.0f);
+
+		float w8 = 1.0f - worley[0][x];
+		float w32 = 1.0f - worley[1][x];
+		float w56 = 1.0f - worley[2][x];
+		float w16 = 1.0f - worley[3][x];
+		float w64 = 1.0f - worley[4][x];
+
+		float worleyFBM = w8 * 0.625f + w32 * 0.25f + w56 * 0.125f;
+		float perlinWorley = worleyFBM + perlinNoise * (1.0f - worleyFBM);
+
+		unsigned char * texel = out + x * 4;
+		texel[0] = toUnorm8(perlinWorley * perlinWorley);
+		texel[1] = toUnorm8(w8 * 0.625f + w16 * 0.25f + w32 * 0.125f);
+		texel[2] = toUnorm8(w16 * 0.625f + w32 * 0.25f + w64 * 0.125f);
+		texel[3] = toUnorm8(w32 * 0.75f + w64 * 0.25f);
+	}
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::bakeWorleyRow(unsigned int y, unsigned int z, float * scratch, unsigned char * out) const
+{
+	const unsigned int size = params.worleySize;
+	const unsigned int padded = (size + 3) & ~3u;
+	const float cy = float(y) / float(size);
+	const float cz = float(z) / float(size);
+
+	// Worley cells 2, 4, 8, 16
+	float * worley[4];
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		worley[i] = scratch + i * padded;
+		worleyRow(worleyTables[i], cy, cz, worley[i]);
+	}
+
+	for (unsigned int x = 0; x < size; x++)
+	{
+		float w0 = 1.0f - worley[0][x];
+		float w1 = 1.0f - worley[1][x];
+		float w2 = 1.0f - worley[2][x];
+		float w3 = 1.0f - worley[3][x];
+
+		unsigned char * texel = out + x * 4;
+		texel[0] = toUnorm8(w0 * 0.625f + w1 * 0.25f + w2 * 0.125f);
+		texel[1] = toUnorm8(w1 * 0.625f + w2 * 0.25f + w3 * 0.125f);
+		texel[2] = toUnorm8(w2 * 0.75f + w3 * 0.25f);
+		texel[3] = 255;
+	}
+}
+
+void Engine::CloudSystem::CloudNoiseBaker::bakeWeatherRows(unsigned int begin, unsigned int end, float * scratch)
+{
+	const unsigned int size = params.weatherSize;
+	const unsigned int padded = (size + 3) & ~3u;
+	const float texel = 1.0f / float(size);
+	const float seedOffset = weatherSeedOffset(params.seed);
+
+	// Lattice rows (y and y + 1) of each octave, kept while consecutive texel rows use them
+	std::vector<std::vector<float>> lattice(weatherOctaves.size() * 2);
+	std::vector<int> latticeRow(weatherOctaves.size(), -2);
+	for (size_t o = 0; o < weatherOctaves.size(); o++)
+	{
+		if (weatherOctaves[o].cacheRows)
+		{
+			lattice[o * 2].resize(weatherOctaves[o].latticeWidth);
+			lattice[o * 2 + 1].resize(weatherOctaves[o].latticeWidth);
+		}
+	}
+
+	float * noise = scratch;
+	unsigned char * out = &baked[CLOUD_NOISE_WEATHER][0];
+
+	for (unsigned int y = begin; y < end; y++)
+	{
+		const float v = float(y) * texel;
+		memset(noise, 0, padded * sizeof(float));
+
+		for (size_t o = 0; o < weatherOctaves.size(); o++)
+		{
+			const WeatherOctave & octave = weatherOctaves[o];
+			float grid = v * octave.size;
+			float cell = floorf(grid);
+			const __m128 wy = _mm_set1_ps(smoothWeight(grid - cell));
+			const __m128 amplitude = _mm_set1_ps(octave.amplitude);
+			const float ly0 = cell + seedOffset;
+			const float ly1 = cell + seedOffset + 1.0f;
+
+			std::vector<float> & row0 = lattice[o * 2];
+			std::vector<float> & row1 = lattice[o * 2 + 1];
+			if (octave.cacheRows && latticeRow[o] != int(cell))
+			{
+				if (latticeRow[o] + 1 == int(cell))
+				{
+					row0.swap(row1);
+				}
+				else
+				{
+					for (unsigned int lx = 0; lx < octave.latticeWidth; lx++)
+						row0[lx] = random2D(float(lx) + seedOffset, ly0);
+				}
+
+				for (unsigned int lx = 0; lx < octave.latticeWidth; lx++)
+					row1[lx] = random2D(float(lx) + seedOffset, ly1);
+
+				latticeRow[o] = int(cell);
+			}
+
+			for (unsigned int x = 0; x < padded; x += 4)
+			{
+				alignas(16) float p[4][4];
+				const int * lx = &octave.lattice[x];
+				for (int lane = 0; lane < 4; lane++)
+				{
+					if (octave.cacheRows)
+					{
+						p[0][lane] = row0[lx[lane]];
+						p[1][lane] = row0[lx[lane] + 1];
+						p[2][lane] = row1[lx[lane]];
+						p[3][lane] = row1[lx[lane] + 1];
+					}
+					else
+					{
+						float fx = float(lx[lane]) + seedOffset;
+						p[0][lane] = random2D(fx, ly0);
+						p[1][lane] = random2D(fx + 1.0f, ly0);
+						p[2][lane] = random2D(fx, ly1);
+						p[3][lane] = random2D(fx + 1.0f, ly1);
+					}
+				}
+
+				__m128 p0 = _mm_load_ps(p[0]);
+				__m128 p1 = _mm_load_ps(p[1]);
+				__m128 p2 = _mm_load_ps(p[2]);
+				__m128 p3 = _mm_load_ps(p[3]);
+				__m128 wx = _mm_loadu_ps(&octave.weight[x]);
+
+				// p0 + (p1 - p0) * wx + (p2 - p0) * wy * (1 - wx) + (p3 - p1) * (wy * wx)
+				__m128 value = _mm_add_ps(p0, _mm_mul_ps(_mm_sub_ps(p1, p0), wx));
+				value = _mm_add_ps(value, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(p2, p0), wy), _mm_sub_ps(_mm_set1_ps(1.0f), wx)));
+				value = _mm_add_ps(value, _mm_mul_ps(_mm_sub_ps(p3, p1), _mm_mul_ps(wy, wx)));
+
+				_mm_storeu_ps(noise + x, _mm_add_ps(_mm_loadu_ps(noise + x), _mm_mul_ps(value, amplitude)));
+			}
+		}
+
+		unsigned char * rowOut = out + size_t(y) * size * 4;
+		for (unsigned int x = 0; x < size; x++)
+		{
+			float coverage = (noise[x] - 0.2f) / 0.8f;
+			unsigned char value = toUnorm8(coverage);
+			rowOut[x * 4] = value;
+			rowOut[x * 4 + 1] = value;
+			rowOut[x * 4 + 2] = 0;
+			rowOut[x * 4 + 3] = 255;
+		}
+	}
+}
+
+Engine::CloudSystem::CloudNoiseValidation Engine::CloudSystem::CloudNoiseBaker::validate(unsigned int samplesPerTexture) const
+{
+	Engine::CloudSystem::CloudNoiseValidation result;
+	result.samples = 0;
+	result.failures = 0;
+	result.maxError = 0.0f;
+
+	for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		CloudNoiseTexture texture = CloudNoiseTexture(i);
+		if (data[i] == NULL)
+			continue;
+
+		const unsigned int size = getSize(texture);
+		const size_t numTexels = getDataSize(texture) / 4;
+
+		// Spread the samples with a LCG, starting at the first texel (all lattice edges meet there)
+		unsigned long long state = 0x9e3779b97f4a7c15ULL + i;
+		for (unsigned int s = 0; s < samplesPerTexture; s++)
+		{
+			size_t index = 0;
+			if (s > 0)
+			{
+				state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+				index = size_t(state >> 33) % numTexels;
+			}
+
+			unsigned int x = (unsigned int)(index % size);
+			unsigned int y = (unsigned int)((index / size) % size);
+			unsigned int z = (unsigned int)(index / (size_t(size) * size));
+
+			glm::vec4 expected;
+			if (texture == CLOUD_NOISE_PERLIN_WORLEY)
+				expected = shaderPerlinWorley(x, y, z, size, params.seed);
+			else if (texture == CLOUD_NOISE_WORLEY)
+				expected = shaderWorley(x, y, z, size, params.seed);
+			else
+				expected = shaderWeather(x, y, params);
+
+			const unsigned char * texel = data[i] + index * 4;
+			bool failed = false;
+			for (int c = 0; c < 4; c++)
+			{
+				float error = fabsf(float(texel[c]) / 255.0f - glm::clamp(expected[c], 0.0f, 1.0f));
+				result.maxError = std::max(result.maxError, error);
+				failed = failed || error > VALIDATION_TOLERANCE;
+			}
+
+			result.failures += failed ? 1 : 0;
+			result.samples++;
+		}
+	}
+
+	std::cout << "CloudNoiseBaker: " << result.samples - result.failures << "/" << result.samples
+		<< " texels within tolerance of the shader formulas (max error " << result.maxError << ")" << std::endl;
+
+	return result;
+}
+
+std::vector<Engine::CloudSystem::CloudNoiseBenchmark> Engine::CloudSystem::CloudNoiseBaker::benchmark(const Engine::CloudSystem::CloudNoiseParameters & params)
+{
+	std::vector<Engine::CloudSystem::CloudNoiseBenchmark> result;
+	Engine::CloudSystem::CloudNoiseBaker baker(params);
+
+	const unsigned int poolSize = Engine::Concurrent::ThreadPool::getInstance().getPoolSize();
+
+	std::cout << "CloudNoiseBaker: Bake benchmark (ms: Perlin-Worley " << params.perlinWorleySize << "^3, Worley "
+		<< params.worleySize << "^3, weather " << params.weatherSize << "^2)" << std::endl;
+
+	for (unsigned int threads = 1; ; threads *= 2)
+	{
+		threads = std::min(threads, poolSize);
+
+		Engine::CloudSystem::CloudNoiseBenchmark entry;
+		entry.threads = threads;
+		entry.totalMs = 0.0;
+		for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+		{
+			entry.textureMs[i] = baker.bakeTexture(CloudNoiseTexture(i), threads);
+			entry.totalMs += entry.textureMs[i];
+		}
+		result.push_back(entry);
+
+		std::cout << "\t" << threads << " thread(s): " << entry.textureMs[CLOUD_NOISE_PERLIN_WORLEY] << " + "
+			<< entry.textureMs[CLOUD_NOISE_WORLEY] << " + " << entry.textureMs[CLOUD_NOISE_WEATHER]
+			<< " = " << entry.totalMs << std::endl;
+
+		if (threads == poolSize)
+			break;
+	}
+
+	baker.release();
+	return result;
+}
+
+// ========================================================================================
+
+Engine::CloudSystem::CloudNoiseTask::CloudNoiseTask(Engine::CloudSystem::CloudNoiseBaker * baker, Engine::CloudSystem::CloudNoiseTexture texture, std::atomic<unsigned int> * nextRow, unsigned int numRows, Engine::Concurrent::CountDownLatch * latch)
+	:baker(baker), texture(texture), nextRow(nextRow), numRows(numRows), latch(latch)
+{
+}
+
+void Engine::CloudSystem::CloudNoiseTask::run()
+{
+	while (true)
+	{
+		unsigned int begin = nextRow->fetch_add(ROWS_PER_STEP);
+		if (begin >= numRows)
+			break;
+
+		baker->bakeRows(texture, begin, std::min(begin + ROWS_PER_STEP, numRows));
+	}
+
+	latch->countDown();
+}
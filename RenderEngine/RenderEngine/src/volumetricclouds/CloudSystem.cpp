@@ -1,11 +1,14 @@
 #include "volumetricclouds/CloudSystem.h"
 
 #include "TimeAccesor.h"
+#include "GLStateCache.h"
 
 #include "datatables/ProgramTable.h"
 #include "datatables/MeshTable.h"
 #include "WorldConfig.h"
 #include "CascadeShadowMaps.h"
+#include "volumetricclouds/NoiseInitializer.h"
+#include "Profiler.h"
 
 #include <iostream>
 
@@ -48,39 +51,50 @@ void dbg(int point)
 
 void Engine::CloudSystem::VolumetricClouds::render(Engine::Camera * cam)
 {
-	int prevFBO;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFBO);
-	glDisable(GL_DEPTH_TEST);
+	// Noise textures still being generated
+	if (!Engine::CloudSystem::NoiseInitializer::getInstance().isComplete())
+		return;
+
+	unsigned int prevFBO = Engine::GLStateCache::getInstance().getDrawFramebuffer();
+	Engine::GLStateCache::getInstance().disable(GL_DEPTH_TEST);
 
 	renderPlane->use();
 
 	int frameMod = Engine::Time::frame % 2;
 
 	// Render clouds
-	glBindFramebuffer(GL_FRAMEBUFFER, reprojectionBuffer[frameMod]->getFrameBufferId());
+	{
+		Engine::ProfileScope profile("Clouds render");
 
-	glClear(GL_COLOR_BUFFER_BIT);
-	shader->use();
-	shader->onRenderObject(NULL, cam);
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, reprojectionBuffer[frameMod]->getFrameBufferId());
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		glClear(GL_COLOR_BUFFER_BIT);
+		shader->use();
+		shader->onRenderObject(NULL, cam);
+
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
 
 	// Filter clouds
-	glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	{
+		Engine::ProfileScope profile("Clouds filter");
+
+		Engine::GLStateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, prevFBO);
+		Engine::GLStateCache::getInstance().enable(GL_BLEND);
+		Engine::GLStateCache::getInstance().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	filterShader->use();
-	filterShader->setBufferInput(&reproBuffer[0]);
-	filterShader->setVelocityInput(&pixelVelocityMap[0]);
-	filterShader->onRenderObject(NULL, cam);
+		filterShader->use();
+		filterShader->setBufferInput(&reproBuffer[0]);
+		filterShader->setVelocityInput(&pixelVelocityMap[0]);
+		filterShader->onRenderObject(NULL, cam);
 
-	//dbg(11);
+		//dbg(11);
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
 
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
+	Engine::GLStateCache::getInstance().disable(GL_BLEND);
+	Engine::GLStateCache::getInstance().enable(GL_DEPTH_TEST);
 }
 
 void Engine::CloudSystem::VolumetricClouds::renderShadow(Camera * camera, const glm::mat4 & projectionMatrix)
@@ -95,7 +109,7 @@ void Engine::CloudSystem::VolumetricClouds::renderShadow(Camera * camera, const
 	shadowShader->use();
 	shadowShader->setUniformLightProjMatrix(projectionMatrix * skyPlane->getModelMatrix());
 	shadowShader->onRenderObject(skyPlane, camera);
-	glDrawElements(GL_TRIANGLE_STRIP, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_TRIANGLE_STRIP, 6, skyPlane->getMesh()->getIndexType(), (void*)0);
 }
 
 void Engine::CloudSystem::VolumetricClouds::createTileMesh()
@@ -1,15 +1,22 @@
 #include "volumetricclouds/NoiseInitializer.h"
 
-#include <gl/glew.h>
+#include <GL/glew.h>
 #include <iostream>
 
 #include "datatables/MeshTable.h"
 #include "datatables/ProgramTable.h"
 #include "textures/Texture2D.h"
 #include "textures/Texture3D.h"
+#include "WorldConfig.h"
+#include "TimeAccesor.h"
+#include "Profiler.h"
+#include "GLStateCache.h"
 
 Engine::CloudSystem::NoiseInitializer * Engine::CloudSystem::NoiseInitializer::INSTANCE = new Engine::CloudSystem::NoiseInitializer();
 
+const unsigned int Engine::CloudSystem::NoiseInitializer::SLAB_TEXELS = 128 * 128 * 4;
+const float Engine::CloudSystem::NoiseInitializer::FADE_IN_SECONDS = 2.0f;
+
 Engine::CloudSystem::NoiseInitializer & Engine::CloudSystem::NoiseInitializer::getInstance()
 {
 	return *Engine::CloudSystem::NoiseInitializer::INSTANCE;
@@ -24,7 +31,18 @@ Engine::CloudSystem::NoiseInitializer::NoiseInitializer()
 	CurlNoise = NULL;
 	WeatherData = NULL;
 
+	nextSlab = nextTiming = 0;
+	generatedTexels = totalTexels = 0;
+	generationFrames = 0;
+	for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+	{
+		measuredMs[i] = 0.0;
+		measuredSlabs[i] = 0;
+	}
+
 	initialized = false;
+	complete = false;
+	completeTime = 0.0f;
 }
 
 const Engine::TextureInstance * Engine::CloudSystem::NoiseInitializer::getPerlinWorleyFBM() const
@@ -47,12 +65,38 @@ const Engine::TextureInstance * Engine::CloudSystem::NoiseInitializer::getWeathe
 	return WeatherData;
 }
 
+bool Engine::CloudSystem::NoiseInitializer::isComplete() const
+{
+	return complete;
+}
+
+float Engine::CloudSystem::NoiseInitializer::getProgress() const
+{
+	if (complete)
+		return 1.0f;
+
+	return totalTexels > 0 ? float(generatedTexels) / float(totalTexels) : 0.0f;
+}
+
+float Engine::CloudSystem::NoiseInitializer::getFadeIn() const
+{
+	if (!complete)
+		return 0.0f;
+
+	float fade = (Engine::Time::timeSinceBegining - completeTime) / FADE_IN_SECONDS;
+	return fade < 0.0f ? 0.0f : (fade > 1.0f ? 1.0f : fade);
+}
+
+const std::vector<Engine::CloudSystem::CloudNoiseSlab> & Engine::CloudSystem::NoiseInitializer::getSlabs() const
+{
+	return slabs;
+}
+
 void Engine::CloudSystem::NoiseInitializer::init()
 {
 	if (initialized)
 		return;
 
-	initShader();
 	initTextures();
 	
 	initialized = true;
@@ -70,7 +114,12 @@ void Engine::CloudSystem::NoiseInitializer::initShader()
 
 void Engine::CloudSystem::NoiseInitializer::initTextures()
 {
-	Engine::Texture3D * perlinWorley = new Engine::Texture3D("perlinworleyfbm", 128, 128, 128);
+	// Both generation paths produce the resolutions of the baker parameters
+	const unsigned int perlinWorleySize = baker.getSize(CLOUD_NOISE_PERLIN_WORLEY);
+	const unsigned int worleySize = baker.getSize(CLOUD_NOISE_WORLEY);
+	const unsigned int weatherSize = baker.getSize(CLOUD_NOISE_WEATHER);
+
+	Engine::Texture3D * perlinWorley = new Engine::Texture3D("perlinworleyfbm", perlinWorleySize, perlinWorleySize, perlinWorleySize);
 	perlinWorley->setGenerateMipMaps(false);
 	perlinWorley->setMemoryLayoutFormat(GL_RGBA8);
 	perlinWorley->setImageFormatType(GL_RGBA);
@@ -87,7 +136,7 @@ void Engine::CloudSystem::NoiseInitializer::initTextures()
 	PerlinWorleyFBM->uploadTexture();
 	//PerlinWorleyFBM->configureTexture();
 
-	Engine::Texture3D * worley = new Engine::Texture3D("worleyfbm", 32, 32, 32);
+	Engine::Texture3D * worley = new Engine::Texture3D("worleyfbm", worleySize, worleySize, worleySize);
 	worley->setGenerateMipMaps(false);
 	worley->setMemoryLayoutFormat(GL_RGBA8);
 	worley->setImageFormatType(GL_RGBA);
@@ -120,7 +169,7 @@ void Engine::CloudSystem::NoiseInitializer::initTextures()
 	CurlNoise->uploadTexture();
 	CurlNoise->configureTexture();
 
-	Engine::Texture2D * weather = new Engine::Texture2D("weather", 0, 2048, 2048);
+	Engine::Texture2D * weather = new Engine::Texture2D("weather", 0, weatherSize, weatherSize);
 	weather->setGenerateMipMaps(false);
 	weather->setMemoryLayoutFormat(GL_RGBA8);
 	weather->setImageFormatType(GL_RGBA);
@@ -155,32 +204,246 @@ void Engine::CloudSystem::NoiseInitializer::clean()
 
 void Engine::CloudSystem::NoiseInitializer::render()
 {
+	if (complete)
+	{
+		// Keep collecting the timings of the last slabs
+		if (nextTiming < slabs.size())
+		{
+			readSlabTimings();
+		}
+		return;
+	}
+
 	init();
-	
-	std::cout << "Generating Perlin-Worley + 3 Worley octaves volume texture (128x128x128)..." << std::endl;
-	glUseProgram(perlinWorleyGen->getProgramId());
-	perlinWorleyGen->bindOutput(PerlinWorleyFBM);
-	perlinWorleyGen->dispatch(128, 128, 128, GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	std::cout << "Done!" << std::endl;
-
-	glBindTexture(GL_TEXTURE_3D, PerlinWorleyFBM->getTexture()->getTextureId());
-	glGenerateMipmap(GL_TEXTURE_3D);
-	PerlinWorleyFBM->configureTexture();
-	
-	std::cout << "Generating 3 Worley octave volume texture (32x32x32)..." << std::endl;
-	glUseProgram(worleyGen->getProgramId());
-	worleyGen->bindOutput(WorleyFBM);
-	worleyGen->dispatch(32, 32, 32, GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	std::cout << "Done!" << std::endl;
-
-	glBindTexture(GL_TEXTURE_3D, WorleyFBM->getTexture()->getTextureId());
-	glGenerateMipmap(GL_TEXTURE_3D);
-	WorleyFBM->configureTexture();
-
-	std::cout << "Generating Weather texture (1024x1024)..." << std::endl;
-	glUseProgram(weatherGen->getProgramId());
-	weatherGen->bindOutput(WeatherData);
-	weatherGen->dispatch(2048, 2048, 1, GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	std::cout << "Done!" << std::endl;
-	//clean();
-}
\ No newline at end of file
+
+	if (Engine::Settings::bakeCloudNoiseOnCPU)
+	{
+		renderOnCPU();
+	}
+	else
+	{
+		renderOnGPU();
+	}
+}
+
+void Engine::CloudSystem::NoiseInitializer::renderOnGPU()
+{
+	Engine::ProfileScope profile("Cloud noise generation");
+
+	if (perlinWorleyGen == NULL)
+	{
+		initShader();
+		createSlabs();
+
+		std::cout << "Generating cloud noise textures on the GPU (" << slabs.size() << " slabs)..." << std::endl;
+	}
+
+	readSlabTimings();
+
+	// Without a budget everything is dispatched now, still split in slabs so no single
+	// submission runs for too long
+	const double budgetMs = Engine::Settings::cloudNoiseFrameBudgetMs;
+	const bool progressive = budgetMs > 0.0;
+
+	double frameMs = 0.0;
+	unsigned int dispatched = 0;
+	while (nextSlab < slabs.size())
+	{
+		CloudNoiseSlab & slab = slabs[nextSlab];
+		double estimatedMs = estimateSlabMs(slab.texture, budgetMs);
+		if (progressive && dispatched > 0 && frameMs + estimatedMs > budgetMs)
+			break;
+
+		dispatchSlab(slab);
+		frameMs += estimatedMs;
+		dispatched++;
+		nextSlab++;
+
+		if (!progressive)
+		{
+			glFlush();
+		}
+	}
+
+	generationFrames++;
+
+	if (nextSlab == slabs.size())
+	{
+		finishGeneration(progressive);
+	}
+}
+
+void Engine::CloudSystem::NoiseInitializer::createSlabs()
+{
+	// The weather map goes first, it is also sampled outside of the clouds (shadows)
+	const CloudNoiseTexture order[CLOUD_NOISE_TEXTURE_COUNT] = { CLOUD_NOISE_WEATHER, CLOUD_NOISE_PERLIN_WORLEY, CLOUD_NOISE_WORLEY };
+
+	for (unsigned int t = 0; t < CLOUD_NOISE_TEXTURE_COUNT; t++)
+	{
+		// Volumes are split along z, the weather texture along y
+		const CloudNoiseTexture i = order[t];
+		const unsigned int size = baker.getSize(i);
+		const unsigned int layers = size;
+		const unsigned int layerTexels = i == CLOUD_NOISE_WEATHER ? size : size * size;
+
+		unsigned int slabLayers = SLAB_TEXELS / layerTexels;
+		slabLayers = slabLayers < 1 ? 1 : slabLayers;
+		if (i == CLOUD_NOISE_WEATHER)
+		{
+			// Keep whole workgroups within a slab
+			slabLayers = ((slabLayers + WeatherTextureProgram::LOCAL_SIZE_Y - 1) / WeatherTextureProgram::LOCAL_SIZE_Y) * WeatherTextureProgram::LOCAL_SIZE_Y;
+		}
+
+		for (unsigned int offset = 0; offset < layers; offset += slabLayers)
+		{
+			CloudNoiseSlab slab;
+			slab.texture = i;
+			slab.offset = offset;
+			slab.size = offset + slabLayers > layers ? layers - offset : slabLayers;
+			slab.texels = slab.size * layerTexels;
+			slab.query = 0;
+			slab.gpuMs = -1.0;
+			slabs.push_back(slab);
+
+			totalTexels += slab.texels;
+		}
+	}
+
+	std::vector<GLuint> queries(slabs.size());
+	glGenQueries((GLsizei)queries.size(), &queries[0]);
+	for (size_t i = 0; i < slabs.size(); i++)
+	{
+		slabs[i].query = queries[i];
+	}
+}
+
+void Engine::CloudSystem::NoiseInitializer::dispatchSlab(Engine::CloudSystem::CloudNoiseSlab & slab)
+{
+	const unsigned int barrier = GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT;
+	const unsigned int size = baker.getSize(slab.texture);
+
+	glBeginQuery(GL_TIME_ELAPSED, slab.query);
+	if (slab.texture == CLOUD_NOISE_WEATHER)
+	{
+		Engine::GLStateCache::getInstance().useProgram(weatherGen->getProgramId());
+		weatherGen->bindOutput(WeatherData);
+		weatherGen->dispatchSlab(slab.offset, size, slab.size, barrier);
+	}
+	else
+	{
+		VolumeTextureProgram * program = slab.texture == CLOUD_NOISE_PERLIN_WORLEY ? perlinWorleyGen : worleyGen;
+		TextureInstance * volume = slab.texture == CLOUD_NOISE_PERLIN_WORLEY ? PerlinWorleyFBM : WorleyFBM;
+		Engine::GLStateCache::getInstance().useProgram(program->getProgramId());
+		program->bindOutput(volume);
+		program->dispatchSlab(slab.offset, size, size, slab.size, barrier);
+
+		// Last slab of the volume
+		if (slab.offset + slab.size == size)
+		{
+			Engine::GLStateCache::getInstance().bindTexture(GL_TEXTURE_3D, volume->getTexture()->getTextureId());
+			glGenerateMipmap(GL_TEXTURE_3D);
+			volume->configureTexture();
+		}
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+
+	generatedTexels += slab.texels;
+}
+
+void Engine::CloudSystem::NoiseInitializer::readSlabTimings()
+{
+	// Results become available in submission order, never wait for them
+	while (nextTiming < nextSlab)
+	{
+		CloudNoiseSlab & slab = slabs[nextTiming];
+
+		GLint available = 0;
+		glGetQueryObjectiv(slab.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(slab.query, GL_QUERY_RESULT, &elapsed);
+		glDeleteQueries(1, &slab.query);
+		slab.query = 0;
+		slab.gpuMs = double(elapsed) / 1000000.0;
+
+		measuredMs[slab.texture] += slab.gpuMs;
+		measuredSlabs[slab.texture]++;
+		nextTiming++;
+	}
+
+	if (complete && nextTiming == slabs.size())
+	{
+		double totalMs = 0.0, maxMs = 0.0;
+		for (auto & slab : slabs)
+		{
+			totalMs += slab.gpuMs;
+			maxMs = slab.gpuMs > maxMs ? slab.gpuMs : maxMs;
+		}
+		std::cout << "Cloud noise generated: " << slabs.size() << " slabs over " << generationFrames << " frame(s), "
+			<< totalMs << " ms of GPU time (longest slab " << maxMs << " ms)" << std::endl;
+	}
+}
+
+double Engine::CloudSystem::NoiseInitializer::estimateSlabMs(Engine::CloudSystem::CloudNoiseTexture texture, double budgetMs) const
+{
+	// Until a slab of this texture has been measured, assume it takes the whole budget
+	if (measuredSlabs[texture] == 0)
+		return budgetMs;
+
+	return measuredMs[texture] / double(measuredSlabs[texture]);
+}
+
+void Engine::CloudSystem::NoiseInitializer::finishGeneration(bool fadeIn)
+{
+	complete = true;
+	completeTime = fadeIn ? Engine::Time::timeSinceBegining : Engine::Time::timeSinceBegining - FADE_IN_SECONDS;
+}
+
+void Engine::CloudSystem::NoiseInitializer::renderOnCPU()
+{
+	if (baker.loadCache())
+	{
+		std::cout << "Cloud noise textures mapped from " << CloudNoiseBaker::DEFAULT_CACHE_FILE << std::endl;
+	}
+	else
+	{
+		std::cout << "Baking cloud noise textures on the CPU..." << std::endl;
+		double bakeMs = 0.0;
+		for (unsigned int i = 0; i < CLOUD_NOISE_TEXTURE_COUNT; i++)
+		{
+			bakeMs += baker.bakeTexture(CloudNoiseTexture(i));
+		}
+		std::cout << "Done! (" << bakeMs << " ms)" << std::endl;
+
+		baker.saveCache();
+	}
+
+	uploadBaked(CLOUD_NOISE_PERLIN_WORLEY, PerlinWorleyFBM);
+	uploadBaked(CLOUD_NOISE_WORLEY, WorleyFBM);
+	uploadBaked(CLOUD_NOISE_WEATHER, WeatherData);
+
+	baker.release();
+
+	finishGeneration(false);
+}
+
+void Engine::CloudSystem::NoiseInitializer::uploadBaked(Engine::CloudSystem::CloudNoiseTexture texture, Engine::TextureInstance * instance)
+{
+	const unsigned int size = baker.getSize(texture);
+	const GLenum target = baker.isVolume(texture) ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	Engine::GLStateCache::getInstance().bindTexture(target, instance->getTexture()->getTextureId());
+	if (baker.isVolume(texture))
+	{
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, size, size, size, GL_RGBA, GL_UNSIGNED_BYTE, baker.getData(texture));
+		glGenerateMipmap(GL_TEXTURE_3D);
+		instance->configureTexture();
+	}
+	else
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, baker.getData(texture));
+	}
+}
@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "imgui/imgui.h"
+#include "GLStateCache.h"
 
 #include "Renderer.h"
 #include "Scene.h"
@@ -10,6 +11,7 @@
 #include "userinterfaces/WorldControllerUI.h"
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
+#include "Profiler.h"
 
 double lastMouseXPos = 0.0, lastMouseYPos = 0.0;
 
@@ -27,7 +29,7 @@ void Engine::Window::defaultGLFWKeyboardCallback(GLFWwindow * window, int key, i
 	if (action == GLFW_PRESS)
 	{
 		io.KeysDown[key] = true;
-		io.AddInputCharacter(unsigned short(key));
+		io.AddInputCharacter((unsigned short)key);
 	}
 	if (action == GLFW_RELEASE)
 		io.KeysDown[key] = false;
@@ -66,7 +68,7 @@ void Engine::Window::defaultGLFWResizeCallback(GLFWwindow * window, int width, i
 {
 	Engine::SceneManager::getInstance().getActiveScene()->onViewportResize(width, height);
 	Engine::RenderManager::getInstance().doResize(width, height);
-	glViewport(0, 0, width, height);
+	Engine::GLStateCache::getInstance().viewport(0, 0, width, height);
 }
 
 // ======================================================================================
@@ -133,7 +135,10 @@ void Engine::Window::GLFWWindow::mainLoop()
 		Engine::RenderManager::getInstance().doRender();
 
 		// Update user interface
-		updateUI();
+		{
+			Engine::ProfileScope profile("User interface");
+			updateUI();
+		}
 
 		Engine::RenderableNotifier::getInstance().checkUpdatedConfig();
 
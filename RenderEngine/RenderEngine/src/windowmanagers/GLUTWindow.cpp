@@ -1,7 +1,7 @@
 #include "windowmanagers/GLUTWindow.h"
 
 #define SOLVE_FGLUT_WARNING
-#include <gl/freeglut.h> 
+#include <GL/freeglut.h> 
 #include <string>
 #include <chrono>
 
@@ -9,12 +9,13 @@
 #include "Scene.h"
 #include "windowmanagers/WindowManager.h"
 #include "TimeAccesor.h"
+#include "GLStateCache.h"
 
 void Engine::Window::defaultResizeCallback(int width, int height)
 {
 	Engine::SceneManager::getInstance().getActiveScene()->onViewportResize(width, height);
 	Engine::RenderManager::getInstance().doResize(width, height);
-	glViewport(0, 0, width, height);
+	Engine::GLStateCache::getInstance().viewport(0, 0, width, height);
 }
 
 void Engine::Window::defaultKeyboardInputCallback(unsigned char key, int x, int y)
@@ -0,0 +1,293 @@
+#include "windowmanagers/HeadlessWindow.h"
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <FreeImage.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include "Renderer.h"
+#include "Scene.h"
+#include "WorldConfig.h"
+#include "TimeAccesor.h"
+#include "Profiler.h"
+#include "GLStateCache.h"
+#include "RenderStatistics.h"
+
+const std::string Engine::Window::HeadlessWindow::DEFAULT_CSV_FILE = "benchmark.csv";
+
+Engine::Window::HeadlessWindow::HeadlessWindow(std::string title, unsigned int width, unsigned int height)
+	:Engine::Window::WindowToolkit(title, 0, 0, width, height)
+	,display(0)
+	,surface(0)
+	,context(0)
+	,frameCount(600)
+	,timeStep(1.0f / 60.0f)
+	,travelMethod(Engine::TravelMethod::TRAVEL_BEZIER)
+	,csvFile(DEFAULT_CSV_FILE)
+	,pngInterval(1)
+{
+}
+
+Engine::Window::HeadlessWindow::~HeadlessWindow()
+{
+#ifndef _WIN32
+	if (display != 0)
+	{
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != 0)
+			eglDestroyContext(display, context);
+		if (surface != 0)
+			eglDestroySurface(display, surface);
+		eglTerminate(display);
+	}
+#endif
+}
+
+void Engine::Window::HeadlessWindow::initializeContext()
+{
+#ifdef _WIN32
+	std::cerr << "Headless: EGL is not available on this platform, use the Linux build (CMakeLists.txt)" << std::endl;
+	exit(-1);
+#else
+	// Prefer Mesa's surfaceless platform, it does not need a display server
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	if (getPlatformDisplay != NULL)
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (eglDisplay == EGL_NO_DISPLAY)
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+	{
+		std::cerr << "Headless: Couldnt initialize EGL" << std::endl;
+		exit(-1);
+	}
+	display = eglDisplay;
+
+	const EGLint configAttribs[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+	{
+		std::cerr << "Headless: No pbuffer capable EGL config found" << std::endl;
+		exit(-1);
+	}
+
+	const EGLint surfaceAttribs[] =
+	{
+		EGL_WIDTH, EGLint(windowWidth),
+		EGL_HEIGHT, EGLint(windowHeight),
+		EGL_NONE
+	};
+
+	surface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttribs);
+	if (surface == EGL_NO_SURFACE)
+	{
+		std::cerr << "Headless: Couldnt create pbuffer surface" << std::endl;
+		exit(-1);
+	}
+
+	eglBindAPI(EGL_OPENGL_API);
+
+	const EGLint contextAttribs[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, EGLint(oglMajorV),
+		EGL_CONTEXT_MINOR_VERSION, EGLint(oglMinorV),
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	context = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, surface, surface, context))
+	{
+		std::cerr << "Headless: Couldnt create OpenGL " << oglMajorV << "." << oglMinorV << " context" << std::endl;
+		exit(-1);
+	}
+
+	initGlew();
+
+	Engine::GLStateCache::getInstance().viewport(0, 0, windowWidth, windowHeight);
+#endif
+}
+
+void Engine::Window::HeadlessWindow::mainLoop()
+{
+	Engine::Profiler & profiler = Engine::Profiler::getInstance();
+	profiler.setEnabled(true);
+	profiler.setFrameCapture(true);
+
+	Engine::Settings::travelMethod = travelMethod;
+
+	std::vector<HeadlessFrame> measures;
+	measures.reserve(frameCount);
+
+	std::cout << "Headless: Rendering " << frameCount << " frames of " << windowWidth << "x" << windowHeight << std::endl;
+
+	for (unsigned int frame = 0; frame < frameCount; frame++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		// Update secondary settings based on main settings changes
+		Engine::Settings::update();
+
+		// Render scene
+		Engine::RenderManager::getInstance().doRender();
+
+		Engine::RenderableNotifier::getInstance().checkUpdatedConfig();
+
+#ifndef _WIN32
+		eglSwapBuffers(display, surface);
+#endif
+
+		HeadlessFrame measure;
+		measure.wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		measure.terrainSubmitMs = Engine::RenderStatistics::terrainSubmitMs;
+		measure.drawCalls = Engine::RenderStatistics::drawCalls;
+		measures.push_back(measure);
+
+		if (!pngFolder.empty() && frame % pngInterval == 0)
+		{
+			saveFrame(frame);
+		}
+
+		// Update animations, always with the same time step so every run renders the same frames
+		Engine::SceneManager::getInstance().getActiveScene()->getAnimationHandler()->tick();
+
+		Engine::Time::update(double(frame + 1) * double(timeStep));
+	}
+
+	profiler.flush();
+	writeCSV(measures);
+	profiler.setFrameCapture(false);
+}
+
+void Engine::Window::HeadlessWindow::setFrameCount(unsigned int frames)
+{
+	frameCount = frames;
+}
+
+void Engine::Window::HeadlessWindow::setTimeStep(float seconds)
+{
+	timeStep = seconds;
+}
+
+void Engine::Window::HeadlessWindow::setTravelMethod(unsigned int method)
+{
+	travelMethod = method;
+}
+
+void Engine::Window::HeadlessWindow::setCSVFile(const std::string & fileName)
+{
+	csvFile = fileName;
+}
+
+void Engine::Window::HeadlessWindow::setPNGOutput(const std::string & folder, unsigned int interval)
+{
+	pngFolder = folder;
+	pngInterval = interval > 0 ? interval : 1;
+}
+
+void Engine::Window::HeadlessWindow::saveFrame(unsigned int frame)
+{
+	std::vector<unsigned char> pixels(windowWidth * windowHeight * 3);
+
+	// FreeImage stores the pixels as BGR, bottom row first (same as OpenGL)
+	Engine::GLStateCache::getInstance().bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, windowWidth, windowHeight, GL_BGR, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "/frame_%05u.png", frame);
+
+	FIBITMAP * img = FreeImage_ConvertFromRawBits(&pixels[0], windowWidth, windowHeight, windowWidth * 3, 24,
+		FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, FALSE);
+	if (img == NULL || !FreeImage_Save(FIF_PNG, img, (pngFolder + fileName).c_str(), PNG_DEFAULT))
+	{
+		std::cout << "Headless: Could not save " << pngFolder << fileName << std::endl;
+	}
+
+	if (img != NULL)
+		FreeImage_Unload(img);
+}
+
+void Engine::Window::HeadlessWindow::writeCSV(const std::vector<HeadlessFrame> & measures)
+{
+	std::vector<Engine::ProfileFrame> frames;
+	Engine::Profiler::getInstance().takeCapturedFrames(frames);
+
+	// Not every stage runs on every frame (cloud noise generation), gather them all first
+	std::vector<std::string> columns;
+	std::map<std::string, unsigned int> columnIndex;
+	for (auto & frame : frames)
+	{
+		for (auto & stage : frame.stages)
+		{
+			if (columnIndex.find(stage.path) == columnIndex.end())
+			{
+				columnIndex[stage.path] = (unsigned int)columns.size();
+				columns.push_back(stage.path);
+			}
+		}
+	}
+
+	std::ofstream file(csvFile.c_str(), std::ios::out | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "Headless: Could not write " << csvFile << std::endl;
+		return;
+	}
+
+	file << "frame,time,wall ms,terrain submit ms,draw calls";
+	for (auto & column : columns)
+	{
+		file << "," << column << " CPU ms," << column << " GPU ms";
+	}
+	file << std::endl;
+
+	file << std::fixed << std::setprecision(4);
+
+	// Every rendered frame was captured, in the same order
+	size_t rows = frames.size() < measures.size() ? frames.size() : measures.size();
+	for (size_t i = 0; i < rows; i++)
+	{
+		std::vector<const Engine::ProfileStageStats *> values(columns.size(), NULL);
+		for (auto & stage : frames[i].stages)
+		{
+			values[columnIndex[stage.path]] = &stage;
+		}
+
+		file << i << "," << double(i) * double(timeStep) << "," << measures[i].wallMs << "," << measures[i].terrainSubmitMs << "," << measures[i].drawCalls;
+		for (auto value : values)
+		{
+			file << ",";
+			if (value != NULL)
+				file << value->cpuMs;
+			file << ",";
+			if (value != NULL && value->gpuMs >= 0.0)
+				file << value->gpuMs;
+		}
+		file << std::endl;
+	}
+
+	std::cout << "Headless: " << rows << " frames written to " << csvFile << std::endl;
+}